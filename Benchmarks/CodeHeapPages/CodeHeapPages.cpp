@@ -0,0 +1,144 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "NativeJIT/CodeGen/CodeHeap.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionSpecification.h"
+#include "Temporary/Allocator.h"
+
+
+using NativeJIT::Allocator;
+using NativeJIT::CodeHeap;
+using NativeJIT::FunctionBuffer;
+using NativeJIT::FunctionSpecification;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Measures the cost of calling many small generated functions in random
+// order when the code heap is backed by default-sized pages and by huge
+// pages. Each function is
+//
+//     sub  rsp, 8
+//     mov  eax, <index>
+//     add  rsp, 8
+//     ret
+//
+// and occupies a single 128 byte block, so with 4 KiB pages nearly every
+// call touches a different page than the previous one and misses the iTLB.
+//
+// Usage: CodeHeapPages [functionCount [passCount]]
+//
+///////////////////////////////////////////////////////////////////////////////
+
+typedef int32_t (*BenchmarkFunction)();
+
+// Capacity of each function buffer. Together with the block header it
+// rounds up to the 128 byte size class.
+static const unsigned c_functionCapacity = 112;
+
+
+static void RunBenchmark(CodeHeap::PageType pageType,
+                         unsigned functionCount,
+                         unsigned passCount)
+{
+    CodeHeap heap(CodeHeap::c_hugePageSize,
+                  (std::numeric_limits<size_t>::max)(),
+                  pageType);
+    Allocator allocator(8192);
+
+    FunctionSpecification spec(allocator,
+                               -1,
+                               0,
+                               0,
+                               0,
+                               FunctionSpecification::BaseRegisterType::Unused,
+                               nullptr);
+
+    std::vector<std::unique_ptr<FunctionBuffer>> buffers;
+    std::vector<BenchmarkFunction> functions;
+
+    for (unsigned i = 0; i < functionCount; ++i)
+    {
+        buffers.emplace_back(new FunctionBuffer(heap, c_functionCapacity));
+        auto & code = *buffers.back();
+
+        code.BeginFunctionBodyGeneration(spec);
+        code.EmitImmediate<NativeJIT::OpCode::Mov>(NativeJIT::eax, static_cast<int32_t>(i));
+        code.EndFunctionBodyGeneration(spec);
+
+        functions.push_back(reinterpret_cast<BenchmarkFunction>(
+                                const_cast<void*>(code.GetEntryPoint())));
+    }
+
+    // Call the functions in a random order to defeat the prefetchers and
+    // make the working set of code pages as large as possible.
+    std::mt19937 generator(12345);
+    std::shuffle(functions.begin(), functions.end(), generator);
+
+    int64_t checksum = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned pass = 0; pass < passCount; ++pass)
+    {
+        for (auto function : functions)
+        {
+            checksum += function();
+        }
+    }
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    const double nanoseconds
+        = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    const double callCount = static_cast<double>(functionCount) * passCount;
+
+    std::cout << (pageType == CodeHeap::PageType::Huge ? "2 MiB pages" : "4 KiB pages")
+              << ": " << heap.GetSegmentCount() << " segment(s), "
+              << heap.GetHugePageSegmentCount() << " from the huge page pool, "
+              << nanoseconds / callCount << " ns/call, "
+              << callCount / nanoseconds * 1000.0 << " M calls/s"
+              << " (checksum " << checksum << ")" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const unsigned functionCount = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 100000;
+    const unsigned passCount = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : 50;
+
+    std::cout << "Calling " << functionCount << " functions "
+              << passCount << " times each." << std::endl;
+
+    RunBenchmark(CodeHeap::PageType::Small, functionCount, passCount);
+    RunBenchmark(CodeHeap::PageType::Huge, functionCount, passCount);
+
+    return 0;
+}
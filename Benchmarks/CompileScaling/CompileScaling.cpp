@@ -0,0 +1,193 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/CompileContextPool.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+
+
+using NativeJIT::Allocator;
+using NativeJIT::CompileContextPool;
+using NativeJIT::ExecutionBuffer;
+using NativeJIT::Function;
+using NativeJIT::FunctionBuffer;
+using NativeJIT::JccType;
+using NativeJIT::Node;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Measures the number of functions compiled per second as the number of
+// compiling threads grows. Each thread repeatedly compiles a small scoring
+// function three times: with fresh resources (arena allocator, executable
+// memory, FunctionBuffer and Function<>) constructed for every compile, with
+// contexts checked out from a shared CompileContextPool and a Function<>
+// constructed on top of them, and with the Function<> held by the pooled
+// context reset and reused as well.
+//
+// Usage: CompileScaling [compilesPerThread [maxThreadCount]]
+//
+///////////////////////////////////////////////////////////////////////////////
+
+struct Document
+{
+    int64_t m_clicks;
+    int64_t m_views;
+    int64_t m_age;
+    int64_t m_length;
+};
+
+
+static const unsigned c_allocatorCapacity = 1 << 16;
+static const unsigned c_codeCapacity = 1 << 13;
+
+
+// Builds and compiles
+//     score = sum(field[i % 4] * (i + 2)),
+//     return score > 0 ? score : 0
+// and returns the result of calling it on the document as a checksum.
+typedef Function<int64_t, Document const *> ScoringFunction;
+
+static int64_t CompileScoringFunction(ScoringFunction& expression,
+                                      Document const & document)
+{
+    static int64_t Document::* const c_fields[]
+        = { &Document::m_clicks, &Document::m_views, &Document::m_age, &Document::m_length };
+
+    auto & documentNode = expression.GetP1();
+    Node<int64_t>* score = &expression.Immediate<int64_t>(0);
+
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        auto & field = expression.Deref(expression.FieldPointer(documentNode, c_fields[i % 4]));
+        score = &expression.Add(*score,
+                                expression.Mul(field, expression.Immediate(static_cast<int64_t>(i + 2))));
+    }
+
+    auto & zero = expression.Immediate<int64_t>(0);
+    auto & result = expression.Conditional(expression.Compare<JccType::JG>(*score, zero),
+                                           *score,
+                                           zero);
+
+    return expression.Compile(result)(&document);
+}
+
+
+template <typename COMPILE>
+static void RunBenchmark(char const * name,
+                         unsigned threadCount,
+                         unsigned compilesPerThread,
+                         COMPILE compile)
+{
+    std::vector<std::thread> threads;
+    std::vector<int64_t> checksums(threadCount, 0);
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&checksums, &compile, t, compilesPerThread]()
+        {
+            const Document document { 1, 2, 3, static_cast<int64_t>(t) };
+
+            for (unsigned i = 0; i < compilesPerThread; ++i)
+            {
+                checksums[t] += compile(document);
+            }
+        });
+    }
+
+    for (auto & thread : threads)
+    {
+        thread.join();
+    }
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    const double seconds
+        = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+    const double compileCount = static_cast<double>(threadCount) * compilesPerThread;
+
+    int64_t checksum = 0;
+    for (auto value : checksums)
+    {
+        checksum += value;
+    }
+
+    std::cout << "  " << name << ": " << threadCount << " thread(s), "
+              << compileCount / seconds << " compiles/s"
+              << " (checksum " << checksum << ")" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const unsigned compilesPerThread = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 20000;
+    const unsigned maxThreadCount = argc > 2
+        ? static_cast<unsigned>(atoi(argv[2]))
+        : (std::max)(1u, std::thread::hardware_concurrency());
+
+    std::cout << "Compiling " << compilesPerThread << " functions per thread." << std::endl;
+
+    for (unsigned threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2)
+    {
+        RunBenchmark("unpooled", threadCount, compilesPerThread, [](Document const & document)
+        {
+            Allocator allocator(c_allocatorCapacity);
+            ExecutionBuffer codeAllocator(c_codeCapacity);
+            FunctionBuffer code(codeAllocator, c_codeCapacity);
+            ScoringFunction expression(allocator, code);
+
+            return CompileScoringFunction(expression, document);
+        });
+
+        CompileContextPool pool(threadCount, c_allocatorCapacity, c_codeCapacity);
+
+        RunBenchmark("pooled  ", threadCount, compilesPerThread, [&pool](Document const & document)
+        {
+            auto lease = pool.Acquire();
+            ScoringFunction expression(lease.GetAllocator(), lease.GetCode());
+
+            return CompileScoringFunction(expression, document);
+        });
+
+        CompileContextPool reusedPool(threadCount, c_allocatorCapacity, c_codeCapacity);
+
+        RunBenchmark("reused  ", threadCount, compilesPerThread, [&reusedPool](Document const & document)
+        {
+            auto lease = reusedPool.Acquire();
+
+            return CompileScoringFunction(lease.GetFunction<ScoringFunction>(), document);
+        });
+    }
+
+    return 0;
+}
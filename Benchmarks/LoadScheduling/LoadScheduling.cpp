@@ -0,0 +1,216 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+
+
+using NativeJIT::Allocator;
+using NativeJIT::ExecutionBuffer;
+using NativeJIT::Function;
+using NativeJIT::FunctionBuffer;
+using NativeJIT::LoadScheduling;
+using NativeJIT::Node;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Measures the time to score a document that isn't cached with the loads
+// issued in order and hoisted ahead of the arithmetic (see LoadScheduling).
+// Every feature of a document lives in its own cache line and the documents
+// are scored in random order, so each call misses the cache once per feature
+// and its latency depends on how many of the misses overlap.
+//
+// Usage: LoadScheduling [documentCount [passCount]]
+//
+///////////////////////////////////////////////////////////////////////////////
+
+struct Document
+{
+    // Padded to the size of a cache line. Note: the vector below doesn't
+    // honor alignas() in C++14, so the lines are not aligned but the
+    // features are still 64 bytes apart.
+    struct Feature
+    {
+        int64_t m_value;
+        char m_padding[56];
+    };
+
+    Feature m_clicks;
+    Feature m_views;
+    Feature m_age;
+    Feature m_length;
+    Feature m_quality;
+    Feature m_freshness;
+    Feature m_links;
+    Feature m_anchors;
+};
+
+
+typedef int64_t (*ScoringFunction)(Document const *);
+
+
+// The number of dependent operations applied to each feature. Makes the code
+// for each feature long enough that, with the loads issued in order, the load
+// of the next feature is outside of the window of instructions the processor
+// looks ahead while it waits for a miss.
+static const unsigned c_transformLength = 32;
+
+
+// Builds and compiles
+//     score = sum(transform(feature[i]) * (i + 2)) - max(views, clicks)
+// where transform() is a chain of multiplications and additions, so that
+// every feature of the document is read and the tree is large.
+static ScoringFunction CompileScoringFunction(Function<int64_t, Document const *>& expression,
+                                              LoadScheduling scheduling)
+{
+    static Document::Feature Document::* const c_features[]
+        = { &Document::m_clicks, &Document::m_views, &Document::m_age,
+            &Document::m_length, &Document::m_quality, &Document::m_freshness,
+            &Document::m_links, &Document::m_anchors };
+
+    auto & document = expression.GetP1();
+    std::vector<Node<int64_t>*> values;
+
+    for (auto feature : c_features)
+    {
+        values.push_back(&expression.Deref(
+            expression.FieldPointer(expression.FieldPointer(document, feature),
+                                    &Document::Feature::m_value)));
+    }
+
+    Node<int64_t>* score = &expression.Immediate<int64_t>(0);
+
+    for (unsigned i = 0; i < values.size(); ++i)
+    {
+        Node<int64_t>* value = values[i];
+
+        for (unsigned j = 0; j < c_transformLength; ++j)
+        {
+            value = &expression.Add(expression.Mul(*value, expression.Immediate<int64_t>(7)),
+                                    expression.Immediate(static_cast<int64_t>(j)));
+        }
+
+        score = &expression.Add(*score,
+                                expression.Mul(*value,
+                                               expression.Immediate(static_cast<int64_t>(i + 2))));
+    }
+
+    auto & clicks = *values[0];
+    auto & views = *values[1];
+    auto & maxEngagement
+        = expression.Conditional(expression.Compare<NativeJIT::JccType::JG>(views, clicks),
+                                 views,
+                                 clicks);
+
+    expression.SetLoadScheduling(scheduling);
+
+    return expression.Compile(expression.Sub(*score, maxEngagement));
+}
+
+
+static void RunBenchmark(char const * name,
+                         LoadScheduling scheduling,
+                         std::vector<Document> const & documents,
+                         std::vector<unsigned> const & order,
+                         unsigned passCount)
+{
+    Allocator allocator(1 << 20);
+    ExecutionBuffer codeAllocator(1 << 16);
+    FunctionBuffer code(codeAllocator, 1 << 16);
+    Function<int64_t, Document const *> expression(allocator, code);
+
+    auto function = CompileScoringFunction(expression, scheduling);
+
+    int64_t checksum = 0;
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned pass = 0; pass < passCount; ++pass)
+    {
+        for (auto index : order)
+        {
+            checksum += function(&documents[index]);
+        }
+    }
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    const double nanoseconds
+        = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start).count();
+
+    std::cout << "  " << name << ": "
+              << nanoseconds / (static_cast<double>(order.size()) * passCount)
+              << " ns/document (checksum " << checksum << ")" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const unsigned documentCount = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 1 << 18;
+    const unsigned passCount = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : 4;
+
+    std::mt19937 random(12345);
+    std::vector<Document> documents(documentCount);
+
+    for (auto & document : documents)
+    {
+        document.m_clicks.m_value = random() % 100;
+        document.m_views.m_value = random() % 1000;
+        document.m_age.m_value = random() % 365;
+        document.m_length.m_value = random() % 10000;
+        document.m_quality.m_value = random() % 10;
+        document.m_freshness.m_value = random() % 10;
+        document.m_links.m_value = random() % 50;
+        document.m_anchors.m_value = random() % 50;
+    }
+
+    std::vector<unsigned> order(documentCount);
+
+    for (unsigned i = 0; i < documentCount; ++i)
+    {
+        order[i] = i;
+    }
+
+    std::shuffle(order.begin(), order.end(), random);
+
+    std::cout << "Scoring " << documentCount << " documents ("
+              << documentCount * sizeof(Document) / (1 << 20) << " MiB) in random order, "
+              << passCount << " pass(es)." << std::endl;
+
+    // Alternate the strategies so that neither benefits from a warmer cache.
+    for (unsigned run = 0; run < 3; ++run)
+    {
+        RunBenchmark("in order", LoadScheduling::InOrder, documents, order, passCount);
+        RunBenchmark("hoisted ", LoadScheduling::Hoisted, documents, order, passCount);
+    }
+
+    return 0;
+}
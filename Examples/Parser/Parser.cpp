@@ -238,8 +238,7 @@ namespace Examples
                 Consume('(');
                 auto& parameter = ParseSum();
                 Consume(')');
-                auto & sqrtFunction = m_expression.Immediate(sqrtf);
-                return m_expression.Call(sqrtFunction, parameter);
+                return m_expression.Sqrt(parameter);
             }
             else
             {
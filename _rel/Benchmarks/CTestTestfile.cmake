@@ -0,0 +1,9 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/Benchmarks
+# Build directory: /root/repo/_rel/Benchmarks
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+subdirs("CodeHeapPages")
+subdirs("CompileScaling")
+subdirs("LoadScheduling")
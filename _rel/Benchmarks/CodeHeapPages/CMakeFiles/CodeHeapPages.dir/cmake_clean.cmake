@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/CodeHeapPages.dir/CodeHeapPages.cpp.o"
+  "CMakeFiles/CodeHeapPages.dir/CodeHeapPages.cpp.o.d"
+  "CodeHeapPages"
+  "CodeHeapPages.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/CodeHeapPages.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/Benchmarks/CompileScaling/CompileScaling.cpp" "Benchmarks/CompileScaling/CMakeFiles/CompileScaling.dir/CompileScaling.cpp.o" "gcc" "Benchmarks/CompileScaling/CMakeFiles/CompileScaling.dir/CompileScaling.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_rel/src/NativeJIT/CMakeFiles/NativeJIT.dir/DependInfo.cmake"
+  "/root/repo/_rel/src/CodeGen/CMakeFiles/CodeGen.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/CompileScaling.dir/CompileScaling.cpp.o"
+  "CMakeFiles/CompileScaling.dir/CompileScaling.cpp.o.d"
+  "CompileScaling"
+  "CompileScaling.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/CompileScaling.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
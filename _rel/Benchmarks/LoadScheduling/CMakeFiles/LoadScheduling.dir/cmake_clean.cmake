@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/LoadScheduling.dir/LoadScheduling.cpp.o"
+  "CMakeFiles/LoadScheduling.dir/LoadScheduling.cpp.o.d"
+  "LoadScheduling"
+  "LoadScheduling.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/LoadScheduling.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,14 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_rel
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+subdirs("googletest")
+subdirs("src/CodeGen")
+subdirs("src/NativeJIT")
+subdirs("test/CodeGen")
+subdirs("test/NativeJIT")
+subdirs("test/Shared")
+subdirs("Examples")
+subdirs("Benchmarks")
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "AreaOfCircle"
+  "AreaOfCircle.pdb"
+  "CMakeFiles/AreaOfCircle.dir/AreaOfCircle.cpp.o"
+  "CMakeFiles/AreaOfCircle.dir/AreaOfCircle.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/AreaOfCircle.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,8 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/Examples
+# Build directory: /root/repo/_rel/Examples
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+subdirs("AreaOfCircle")
+subdirs("Parser")
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/Parser.dir/Parser.cpp.o"
+  "CMakeFiles/Parser.dir/Parser.cpp.o.d"
+  "Parser"
+  "Parser.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/Parser.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
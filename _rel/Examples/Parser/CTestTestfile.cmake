@@ -0,0 +1,6 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/Examples/Parser
+# Build directory: /root/repo/_rel/Examples/Parser
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
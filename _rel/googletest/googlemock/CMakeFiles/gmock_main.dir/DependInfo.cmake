@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/googletest/googletest/src/gtest-all.cc" "googletest/googlemock/CMakeFiles/gmock_main.dir/__/googletest/src/gtest-all.cc.o" "gcc" "googletest/googlemock/CMakeFiles/gmock_main.dir/__/googletest/src/gtest-all.cc.o.d"
+  "/root/repo/googletest/googlemock/src/gmock-all.cc" "googletest/googlemock/CMakeFiles/gmock_main.dir/src/gmock-all.cc.o" "gcc" "googletest/googlemock/CMakeFiles/gmock_main.dir/src/gmock-all.cc.o.d"
+  "/root/repo/googletest/googlemock/src/gmock_main.cc" "googletest/googlemock/CMakeFiles/gmock_main.dir/src/gmock_main.cc.o" "gcc" "googletest/googlemock/CMakeFiles/gmock_main.dir/src/gmock_main.cc.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,30 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/CodeGen/Allocator.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/Allocator.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/Allocator.cpp.o.d"
+  "/root/repo/src/CodeGen/Assert.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/Assert.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/Assert.cpp.o.d"
+  "/root/repo/src/CodeGen/CodeBuffer.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/CodeBuffer.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/CodeBuffer.cpp.o.d"
+  "/root/repo/src/CodeGen/CodeHeap.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/CodeHeap.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/CodeHeap.cpp.o.d"
+  "/root/repo/src/CodeGen/ExecutionBuffer.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/ExecutionBuffer.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/ExecutionBuffer.cpp.o.d"
+  "/root/repo/src/CodeGen/FunctionBuffer.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/FunctionBuffer.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/FunctionBuffer.cpp.o.d"
+  "/root/repo/src/CodeGen/FunctionSpecification.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/FunctionSpecification.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/FunctionSpecification.cpp.o.d"
+  "/root/repo/src/CodeGen/JumpTable.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/JumpTable.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/JumpTable.cpp.o.d"
+  "/root/repo/src/CodeGen/Register.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/Register.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/Register.cpp.o.d"
+  "/root/repo/src/CodeGen/UnwindCode.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/UnwindCode.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/UnwindCode.cpp.o.d"
+  "/root/repo/src/CodeGen/ValuePredicates.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/ValuePredicates.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/ValuePredicates.cpp.o.d"
+  "/root/repo/src/CodeGen/X64CodeGenerator.cpp" "src/CodeGen/CMakeFiles/CodeGen.dir/X64CodeGenerator.cpp.o" "gcc" "src/CodeGen/CMakeFiles/CodeGen.dir/X64CodeGenerator.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,33 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/CodeGen.dir/Allocator.cpp.o"
+  "CMakeFiles/CodeGen.dir/Allocator.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/Assert.cpp.o"
+  "CMakeFiles/CodeGen.dir/Assert.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/CodeBuffer.cpp.o"
+  "CMakeFiles/CodeGen.dir/CodeBuffer.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/CodeHeap.cpp.o"
+  "CMakeFiles/CodeGen.dir/CodeHeap.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/ExecutionBuffer.cpp.o"
+  "CMakeFiles/CodeGen.dir/ExecutionBuffer.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/FunctionBuffer.cpp.o"
+  "CMakeFiles/CodeGen.dir/FunctionBuffer.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/FunctionSpecification.cpp.o"
+  "CMakeFiles/CodeGen.dir/FunctionSpecification.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/JumpTable.cpp.o"
+  "CMakeFiles/CodeGen.dir/JumpTable.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/Register.cpp.o"
+  "CMakeFiles/CodeGen.dir/Register.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/UnwindCode.cpp.o"
+  "CMakeFiles/CodeGen.dir/UnwindCode.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/ValuePredicates.cpp.o"
+  "CMakeFiles/CodeGen.dir/ValuePredicates.cpp.o.d"
+  "CMakeFiles/CodeGen.dir/X64CodeGenerator.cpp.o"
+  "CMakeFiles/CodeGen.dir/X64CodeGenerator.cpp.o.d"
+  "libCodeGen.a"
+  "libCodeGen.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/CodeGen.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
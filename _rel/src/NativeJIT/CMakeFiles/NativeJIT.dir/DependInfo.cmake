@@ -0,0 +1,28 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/NativeJIT/BatchCompiler.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/BatchCompiler.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/BatchCompiler.cpp.o.d"
+  "/root/repo/src/NativeJIT/BranchProfile.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/BranchProfile.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/BranchProfile.cpp.o.d"
+  "/root/repo/src/NativeJIT/CallNode.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/CallNode.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/CallNode.cpp.o.d"
+  "/root/repo/src/NativeJIT/CompileCache.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/CompileCache.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/CompileCache.cpp.o.d"
+  "/root/repo/src/NativeJIT/CompileContextPool.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/CompileContextPool.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/CompileContextPool.cpp.o.d"
+  "/root/repo/src/NativeJIT/ExpressionNodeFactory.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/ExpressionNodeFactory.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/ExpressionNodeFactory.cpp.o.d"
+  "/root/repo/src/NativeJIT/ExpressionTree.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/ExpressionTree.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/ExpressionTree.cpp.o.d"
+  "/root/repo/src/NativeJIT/Interpreter.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/Interpreter.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/Interpreter.cpp.o.d"
+  "/root/repo/src/NativeJIT/Node.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/Node.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/Node.cpp.o.d"
+  "/root/repo/src/NativeJIT/StructuralKey.cpp" "src/NativeJIT/CMakeFiles/NativeJIT.dir/StructuralKey.cpp.o" "gcc" "src/NativeJIT/CMakeFiles/NativeJIT.dir/StructuralKey.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,29 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/NativeJIT.dir/BatchCompiler.cpp.o"
+  "CMakeFiles/NativeJIT.dir/BatchCompiler.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/BranchProfile.cpp.o"
+  "CMakeFiles/NativeJIT.dir/BranchProfile.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/CallNode.cpp.o"
+  "CMakeFiles/NativeJIT.dir/CallNode.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/CompileCache.cpp.o"
+  "CMakeFiles/NativeJIT.dir/CompileCache.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/CompileContextPool.cpp.o"
+  "CMakeFiles/NativeJIT.dir/CompileContextPool.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/ExpressionNodeFactory.cpp.o"
+  "CMakeFiles/NativeJIT.dir/ExpressionNodeFactory.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/ExpressionTree.cpp.o"
+  "CMakeFiles/NativeJIT.dir/ExpressionTree.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/Interpreter.cpp.o"
+  "CMakeFiles/NativeJIT.dir/Interpreter.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/Node.cpp.o"
+  "CMakeFiles/NativeJIT.dir/Node.cpp.o.d"
+  "CMakeFiles/NativeJIT.dir/StructuralKey.cpp.o"
+  "CMakeFiles/NativeJIT.dir/StructuralKey.cpp.o.d"
+  "libNativeJIT.a"
+  "libNativeJIT.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/NativeJIT.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
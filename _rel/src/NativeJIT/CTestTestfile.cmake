@@ -0,0 +1,8 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/src/NativeJIT
+# Build directory: /root/repo/_rel/src/NativeJIT
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(NativeJITTest "/root/repo/_rel/test/NativeJIT/NativeJITTest")
+set_tests_properties(NativeJITTest PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/src/NativeJIT/CMakeLists.txt;67;add_test;/root/repo/src/NativeJIT/CMakeLists.txt;0;")
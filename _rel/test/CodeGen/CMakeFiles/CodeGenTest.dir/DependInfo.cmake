@@ -0,0 +1,29 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/test/CodeGen/BitOperationsTest.cpp" "test/CodeGen/CMakeFiles/CodeGenTest.dir/BitOperationsTest.cpp.o" "gcc" "test/CodeGen/CMakeFiles/CodeGenTest.dir/BitOperationsTest.cpp.o.d"
+  "/root/repo/test/CodeGen/CodeGenTest.cpp" "test/CodeGen/CMakeFiles/CodeGenTest.dir/CodeGenTest.cpp.o" "gcc" "test/CodeGen/CMakeFiles/CodeGenTest.dir/CodeGenTest.cpp.o.d"
+  "/root/repo/test/CodeGen/CodeHeapTest.cpp" "test/CodeGen/CMakeFiles/CodeGenTest.dir/CodeHeapTest.cpp.o" "gcc" "test/CodeGen/CMakeFiles/CodeGenTest.dir/CodeHeapTest.cpp.o.d"
+  "/root/repo/test/CodeGen/ExecutionBufferTest.cpp" "test/CodeGen/CMakeFiles/CodeGenTest.dir/ExecutionBufferTest.cpp.o" "gcc" "test/CodeGen/CMakeFiles/CodeGenTest.dir/ExecutionBufferTest.cpp.o.d"
+  "/root/repo/test/CodeGen/FunctionBufferTest.cpp" "test/CodeGen/CMakeFiles/CodeGenTest.dir/FunctionBufferTest.cpp.o" "gcc" "test/CodeGen/CMakeFiles/CodeGenTest.dir/FunctionBufferTest.cpp.o.d"
+  "/root/repo/test/CodeGen/InstructionEncodingTest.cpp" "test/CodeGen/CMakeFiles/CodeGenTest.dir/InstructionEncodingTest.cpp.o" "gcc" "test/CodeGen/CMakeFiles/CodeGenTest.dir/InstructionEncodingTest.cpp.o.d"
+  "/root/repo/test/CodeGen/ML64Verifier.cpp" "test/CodeGen/CMakeFiles/CodeGenTest.dir/ML64Verifier.cpp.o" "gcc" "test/CodeGen/CMakeFiles/CodeGenTest.dir/ML64Verifier.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_rel/test/Shared/CMakeFiles/TestShared.dir/DependInfo.cmake"
+  "/root/repo/_rel/src/CodeGen/CMakeFiles/CodeGen.dir/DependInfo.cmake"
+  "/root/repo/_rel/googletest/googlemock/gtest/CMakeFiles/gtest.dir/DependInfo.cmake"
+  "/root/repo/_rel/googletest/googlemock/gtest/CMakeFiles/gtest_main.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,23 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/CodeGenTest.dir/BitOperationsTest.cpp.o"
+  "CMakeFiles/CodeGenTest.dir/BitOperationsTest.cpp.o.d"
+  "CMakeFiles/CodeGenTest.dir/CodeGenTest.cpp.o"
+  "CMakeFiles/CodeGenTest.dir/CodeGenTest.cpp.o.d"
+  "CMakeFiles/CodeGenTest.dir/CodeHeapTest.cpp.o"
+  "CMakeFiles/CodeGenTest.dir/CodeHeapTest.cpp.o.d"
+  "CMakeFiles/CodeGenTest.dir/ExecutionBufferTest.cpp.o"
+  "CMakeFiles/CodeGenTest.dir/ExecutionBufferTest.cpp.o.d"
+  "CMakeFiles/CodeGenTest.dir/FunctionBufferTest.cpp.o"
+  "CMakeFiles/CodeGenTest.dir/FunctionBufferTest.cpp.o.d"
+  "CMakeFiles/CodeGenTest.dir/InstructionEncodingTest.cpp.o"
+  "CMakeFiles/CodeGenTest.dir/InstructionEncodingTest.cpp.o.d"
+  "CMakeFiles/CodeGenTest.dir/ML64Verifier.cpp.o"
+  "CMakeFiles/CodeGenTest.dir/ML64Verifier.cpp.o.d"
+  "CodeGenTest"
+  "CodeGenTest.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/CodeGenTest.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,8 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/test/CodeGen
+# Build directory: /root/repo/_rel/test/CodeGen
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(CodeGenTest "/root/repo/_rel/test/CodeGen/CodeGenTest")
+set_tests_properties(CodeGenTest PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CodeGen/CMakeLists.txt;24;add_test;/root/repo/test/CodeGen/CMakeLists.txt;0;")
@@ -0,0 +1,46 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/test/NativeJIT/BatchCompilerTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BatchCompilerTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BatchCompilerTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/BitFunnelAcceptanceTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BitFunnelAcceptanceTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BitFunnelAcceptanceTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/BitManipulationTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BitManipulationTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BitManipulationTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/BranchProfileTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BranchProfileTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/BranchProfileTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/CastTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/CastTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/CastTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/CompileCacheTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/CompileCacheTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/CompileCacheTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/CompileContextPoolTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/CompileContextPoolTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/CompileContextPoolTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/ConditionalAutoGenTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ConditionalAutoGenTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ConditionalAutoGenTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/ConditionalTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ConditionalTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ConditionalTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/ConstantFoldingTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ConstantFoldingTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ConstantFoldingTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/DivisionTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/DivisionTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/DivisionTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/ExpressionTreeTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ExpressionTreeTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ExpressionTreeTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/FloatingPointTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/FloatingPointTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/FloatingPointTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/FunctionTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/FunctionTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/FunctionTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/InterpreterTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/InterpreterTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/InterpreterTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/NodeInterningTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/NodeInterningTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/NodeInterningTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/PackedTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/PackedTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/PackedTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/ReduceTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ReduceTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/ReduceTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/SpecializationTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/SpecializationTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/SpecializationTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/StrengthReductionTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/StrengthReductionTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/StrengthReductionTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/SwitchTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/SwitchTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/SwitchTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/TieredFunctionTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/TieredFunctionTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/TieredFunctionTest.cpp.o.d"
+  "/root/repo/test/NativeJIT/UnsignedTest.cpp" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/UnsignedTest.cpp.o" "gcc" "test/NativeJIT/CMakeFiles/NativeJITTest.dir/UnsignedTest.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_rel/test/Shared/CMakeFiles/TestShared.dir/DependInfo.cmake"
+  "/root/repo/_rel/src/NativeJIT/CMakeFiles/NativeJIT.dir/DependInfo.cmake"
+  "/root/repo/_rel/src/CodeGen/CMakeFiles/CodeGen.dir/DependInfo.cmake"
+  "/root/repo/_rel/googletest/googlemock/gtest/CMakeFiles/gtest.dir/DependInfo.cmake"
+  "/root/repo/_rel/googletest/googlemock/gtest/CMakeFiles/gtest_main.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,55 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/NativeJITTest.dir/BatchCompilerTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/BatchCompilerTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/BitFunnelAcceptanceTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/BitFunnelAcceptanceTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/BitManipulationTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/BitManipulationTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/BranchProfileTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/BranchProfileTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/CastTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/CastTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/CompileCacheTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/CompileCacheTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/CompileContextPoolTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/CompileContextPoolTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/ConditionalAutoGenTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/ConditionalAutoGenTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/ConditionalTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/ConditionalTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/ConstantFoldingTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/ConstantFoldingTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/DivisionTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/DivisionTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/ExpressionTreeTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/ExpressionTreeTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/FloatingPointTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/FloatingPointTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/FunctionTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/FunctionTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/InterpreterTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/InterpreterTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/NodeInterningTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/NodeInterningTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/PackedTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/PackedTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/ReduceTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/ReduceTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/SpecializationTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/SpecializationTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/StrengthReductionTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/StrengthReductionTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/SwitchTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/SwitchTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/TieredFunctionTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/TieredFunctionTest.cpp.o.d"
+  "CMakeFiles/NativeJITTest.dir/UnsignedTest.cpp.o"
+  "CMakeFiles/NativeJITTest.dir/UnsignedTest.cpp.o.d"
+  "NativeJITTest"
+  "NativeJITTest.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/NativeJITTest.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
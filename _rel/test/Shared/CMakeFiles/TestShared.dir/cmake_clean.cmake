@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestShared.dir/TestSetup.cpp.o"
+  "CMakeFiles/TestShared.dir/TestSetup.cpp.o.d"
+  "libTestShared.a"
+  "libTestShared.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestShared.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,6 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/test/Shared
+# Build directory: /root/repo/_rel/test/Shared
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
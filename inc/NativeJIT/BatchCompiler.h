@@ -0,0 +1,140 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <functional>
+#include <memory>                                   // For std::unique_ptr.
+#include <mutex>
+#include <stddef.h>                                 // For ::size_t
+#include <vector>
+
+#include "NativeJIT/CodeGen/CodeHeap.h"             // Embedded member.
+#include "NativeJIT/CodeGen/FunctionBuffer.h"       // RUNTIME_FUNCTION embedded.
+#include "Temporary/NonCopyable.h"
+
+
+namespace NativeJIT
+{
+    class CompileContextPool;
+
+
+    // The functions compiled by one BatchCompiler::Compile() call. The code of
+    // all the functions is placed into a single CodeHeap owned by the batch
+    // and stays valid for the lifetime of the object.
+    class CompiledBatch : public NonCopyable
+    {
+    public:
+        ~CompiledBatch();
+
+        unsigned GetFunctionCount() const;
+
+        // Returns the entry point of the function built by the builder at
+        // the specified index.
+        void const * GetEntryPoint(unsigned index) const;
+
+        // Returns the entry point cast to the function pointer type F.
+        template <typename F>
+        F GetEntryPoint(unsigned index) const;
+
+        // Returns the number of bytes reserved from the OS for the code.
+        size_t GetBytesReserved() const;
+
+    private:
+        friend class BatchCompiler;
+
+        struct CompiledFunction
+        {
+            // Start of the copy of the FunctionBuffer. The offsets in the
+            // runtime function are relative to it.
+            uint8_t const * m_base;
+            RUNTIME_FUNCTION m_runtimeFunction;
+        };
+
+        CompiledBatch(size_t segmentSize, unsigned functionCount);
+
+        // Makes the functions available for execution.
+        void Publish();
+
+        CodeHeap m_codeHeap;
+
+        // Protects m_codeHeap while the batch is being compiled.
+        std::mutex m_codeHeapMutex;
+
+        std::vector<CompiledFunction> m_functions;
+        bool m_isPublished;
+    };
+
+
+    // Compiles many functions in parallel. Each function is described by a
+    // builder which constructs a Function<> on top of the allocator and the
+    // FunctionBuffer it is passed and compiles it. The builders run on worker
+    // threads using contexts from a CompileContextPool, so they must not share
+    // mutable state without synchronization.
+    //
+    // After each function is compiled, the worker copies its code into a
+    // sub-arena of the batch's shared CodeHeap. The sub-arenas are large
+    // blocks carved from the heap's segments under a lock, after which
+    // each worker fills its own sub-arena without synchronization. All entry
+    // points are published together once every builder has completed.
+    class BatchCompiler : public NonCopyable
+    {
+    public:
+        typedef std::function<void (Allocators::IAllocator& allocator,
+                                    FunctionBuffer& code)> Builder;
+
+        // The default number of bytes in each sub-arena. It leaves room for
+        // CodeHeap's block header so that the sub-arena fits a 64 KiB block.
+        static const size_t c_defaultSubArenaSize = (1 << 16) - 64;
+
+        BatchCompiler(CompileContextPool& pool,
+                      unsigned threadCount,
+                      size_t subArenaSize = c_defaultSubArenaSize,
+                      size_t segmentSize = CodeHeap::c_defaultSegmentSize);
+
+        // Runs the builders on the worker threads and returns the compiled
+        // functions in the order of the builders. If any of the builders
+        // throws, the first exception is rethrown after all workers finish.
+        std::unique_ptr<CompiledBatch> Compile(std::vector<Builder> const & builders);
+
+    private:
+        class SubArena;
+
+        CompileContextPool& m_pool;
+        const unsigned m_threadCount;
+        const size_t m_subArenaSize;
+        const size_t m_segmentSize;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for CompiledBatch
+    //
+    //*************************************************************************
+    template <typename F>
+    F CompiledBatch::GetEntryPoint(unsigned index) const
+    {
+        return reinterpret_cast<F>(const_cast<void*>(GetEntryPoint(index)));
+    }
+}
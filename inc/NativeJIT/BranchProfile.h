@@ -0,0 +1,111 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+#include "NativeJIT/ExpressionTreeDecls.h"          // Storage embedded in ProfileCounterEmitter.
+#include "Temporary/NonCopyable.h"
+
+
+namespace NativeJIT
+{
+    // Counts of the outcomes of the conditional branches of a function. The
+    // counts are collected by the code compiled after a call to
+    // ExpressionTree::SetInstrumentationProfile() and are used to lay out
+    // the branches of the function when it's recompiled after a call to
+    // ExpressionTree::SetLayoutProfile().
+    //
+    // The branches are identified by the IDs of their nodes, so the tree
+    // which is recompiled must be constructed in the same way as the
+    // instrumented one. The instrumented code updates the counters without
+    // synchronization, so it should not be called concurrently.
+    class BranchProfile : public NonCopyable
+    {
+    public:
+        struct Counters
+        {
+            uint64_t m_trueCount;
+            uint64_t m_falseCount;
+        };
+
+        // Specifies which outcome of a condition is more frequent.
+        enum class HotBranch { Unknown, True, False };
+
+        BranchProfile();
+
+        // Returns the counter of calls to the instrumented function.
+        uint64_t& GetCallCounter();
+        uint64_t GetCallCount() const;
+
+        // Return the counters for the ConditionalNode or LazyConditionalNode
+        // with the specified ID and for the ExecuteOnlyIf precondition with
+        // the specified condition node ID, creating zeroed counters if
+        // needed. The addresses of the counters don't change for the lifetime
+        // of the profile, so they can be embedded in the generated code.
+        Counters& GetConditionalCounters(unsigned nodeId);
+        Counters& GetPreconditionCounters(unsigned conditionNodeId);
+
+        // Return the outcome of the conditions that was observed more often
+        // or HotBranch::Unknown if neither was.
+        HotBranch GetConditionalHotBranch(unsigned nodeId) const;
+        HotBranch GetPreconditionHotBranch(unsigned conditionNodeId) const;
+
+        // Sets all the counts to zero.
+        void Reset();
+
+    private:
+        static HotBranch GetHotBranch(std::map<unsigned, Counters> const & counters,
+                                      unsigned id);
+
+        uint64_t m_callCount;
+        std::map<unsigned, Counters> m_conditionals;
+        std::map<unsigned, Counters> m_preconditions;
+    };
+
+
+    // Emits the code which increments the counters of the instrumented code.
+    // The registers used by the code are allocated and pinned by the
+    // constructor, which must be called before the conditional jump whose
+    // outcomes are counted so that both branches see the same register
+    // allocation. The counting code modifies the flags. If the emitter is
+    // not enabled, no registers are allocated and no code is emitted.
+    class ProfileCounterEmitter : public NonCopyable
+    {
+    public:
+        ProfileCounterEmitter(ExpressionTree& tree, bool isEnabled);
+
+        void EmitIncrement(uint64_t& counter);
+
+    private:
+        ExpressionTree& m_tree;
+        const bool m_isEnabled;
+
+        ExpressionTree::Storage<uint64_t*> m_address;
+        ExpressionTree::Storage<uint64_t> m_value;
+        ReferenceCounter m_addressPin;
+        ReferenceCounter m_valuePin;
+    };
+}
@@ -45,7 +45,9 @@ namespace NativeJIT
         // Allocates a buffer from the code allocator. If the code inside
         // the buffer is to be executed (and not just f. ex. transferred over the
         // network), the allocator must return memory that is executable (see
-        // ExecutionBuffer class for an example).
+        // ExecutionBuffer class for an example). If the allocator implements
+        // IExecutableAllocator, the code will be executed through the alias
+        // that it reports (see ExecutableBufferStart()).
         CodeBuffer(Allocators::IAllocator& codeAllocator, unsigned capacity);
 
         // Frees the buffer.
@@ -97,6 +99,12 @@ namespace NativeJIT
         // the function pointer.
         uint8_t* BufferStart() const;
 
+        // Returns the address at which the start of the buffer is executed.
+        // This is the same as BufferStart() unless the code allocator maps
+        // the buffer twice, in which case BufferStart() is the writable view
+        // and ExecutableBufferStart() is the executable one.
+        uint8_t const * ExecutableBufferStart() const;
+
         // Return the offset of the current write position in the buffer.
         unsigned CurrentPosition() const;
 
@@ -123,6 +131,7 @@ namespace NativeJIT
 
         uint8_t* m_bufferStart;
         uint8_t* m_bufferEnd;
+        ptrdiff_t m_executableAliasOffset;
         uint8_t* m_current;
 
         JumpTable m_localJumpTable;    // Jumps within a single CodeBuffer.
@@ -0,0 +1,194 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <limits>                           // For std::numeric_limits.
+#include <stddef.h>                         // For ::size_t
+#include <vector>
+
+#include "Temporary/IAllocator.h"           // Base class.
+#include "Temporary/NonCopyable.h"          // Base class.
+
+
+namespace NativeJIT
+{
+    // An executable memory allocator for long-running processes that compile
+    // and retire functions continuously. Unlike ExecutionBuffer, which is a
+    // single fixed-size region with a bump pointer, CodeHeap reserves
+    // executable segments on demand and recycles blocks returned through
+    // Deallocate().
+    //
+    // Blocks are rounded up to a power-of-two size class (including a small
+    // header that records the class) and freed blocks are kept in per-class
+    // free lists for reuse. Requests that do not fit into a regular segment
+    // get a dedicated segment that is returned to the OS when deallocated.
+    //
+    // CodeHeap plugs into CodeBuffer/FunctionBuffer like any other
+    // IAllocator: destroying the FunctionBuffer returns its code block to the
+    // heap. The class is not thread safe.
+    //
+    // To reduce iTLB misses when many functions are resident, the segments
+    // can be backed by huge pages (see PageType). Since small blocks are
+    // packed densely into segments, a single huge page then covers the code
+    // of thousands of small functions.
+    class CodeHeap : public Allocators::IAllocator, private NonCopyable
+    {
+    public:
+        // Specifies the pages backing the segments. Small uses the default
+        // OS page size. Huge rounds the segments up to c_hugePageSize and
+        // first tries to reserve them from the explicit huge page pool
+        // (MAP_HUGETLB on Linux, MEM_LARGE_PAGES on Windows). If that fails,
+        // the segments are aligned to the huge page size and, on Linux,
+        // marked with madvise(MADV_HUGEPAGE) to be backed by transparent
+        // huge pages.
+        enum class PageType { Small, Huge };
+
+        // Default size of the executable segments reserved on demand.
+        static const size_t c_defaultSegmentSize = 1 << 20;
+
+        // The size of huge pages used with PageType::Huge.
+        static const size_t c_hugePageSize = 1 << 21;
+
+        // Every block handed out by the heap is aligned to this boundary.
+        static const size_t c_blockAlignment = 16;
+
+        // Creates a heap that reserves executable segments of segmentSize
+        // bytes (rounded up to the next power of two and to at least one
+        // page) as needed. The total number of bytes
+        // reserved from the OS will not exceed maxReservedSize.
+        explicit CodeHeap(size_t segmentSize = c_defaultSegmentSize,
+                          size_t maxReservedSize = (std::numeric_limits<size_t>::max)(),
+                          PageType pageType = PageType::Small);
+
+        virtual ~CodeHeap() override;
+
+
+        //
+        // IAllocator methods
+        //
+
+        // Allocates a block of a specified byte size.
+        virtual void* Allocate(size_t size) override;
+
+        // Frees a block, making it available for reuse by a later Allocate()
+        // of the same size class.
+        virtual void Deallocate(void* block) override;
+
+        // Returns the maximum legal allocation size in bytes.
+        virtual size_t MaxSize() const override;
+
+        // Frees all blocks that have been allocated since construction or the
+        // last call to Reset(). Returns all segments except the first one to
+        // the OS.
+        virtual void Reset() override;
+
+
+        //
+        // Statistics
+        //
+
+        // Returns the number of segments currently reserved from the OS.
+        size_t GetSegmentCount() const;
+
+        // Returns the number of bytes currently reserved from the OS.
+        size_t GetBytesReserved() const;
+
+        // Returns the number of bytes in blocks that are currently allocated,
+        // including the block headers and size class rounding.
+        size_t GetBytesInUse() const;
+
+        // Returns the number of segments currently reserved from the explicit
+        // huge page pool. Always zero for PageType::Small.
+        size_t GetHugePageSegmentCount() const;
+
+    private:
+        struct BlockHeader;
+
+        struct Segment
+        {
+            unsigned char* m_base;
+            size_t m_size;
+            size_t m_bytesAllocated;
+            bool m_isHugePage;
+        };
+
+        // Size classes cover blocks of 2^c_minSizeClass up to 2^c_maxSizeClass
+        // bytes. The class c_dedicatedSizeClass marks a block that owns its
+        // segment.
+        static const unsigned c_minSizeClass = 6;
+        static const unsigned c_maxSizeClass = 8 * sizeof(size_t) - 1;
+        static const unsigned c_dedicatedSizeClass = c_maxSizeClass + 1;
+
+        // Returns the smallest size class that can hold a block of the
+        // specified size, header included.
+        static unsigned GetSizeClass(size_t blockSize);
+
+        // Reserves an executable segment of the specified size. Throws
+        // std::runtime_error if the reservation would exceed the configured
+        // maximum or if the OS fails to provide the memory.
+        Segment AllocateSegment(size_t size);
+
+        // Attempts to reserve the segment from the explicit huge page pool
+        // and, failing that, reserves a huge page aligned segment. Returns
+        // nullptr on failure.
+        static unsigned char* MapHugePageSegment(size_t size, bool& isHugePage);
+
+        // Reserves an executable segment backed by pages of the default size.
+        // Returns nullptr on failure.
+        static unsigned char* MapSegment(size_t size);
+
+        // Returns the segment to the OS.
+        void FreeSegment(Segment const & segment);
+
+        // Carves the unused tail of the current segment into free blocks so
+        // that it isn't lost when bump allocation moves to a new segment.
+        void RetireCurrentSegmentTail();
+
+        // Pushes a block onto the free list of the specified class.
+        void PushFreeBlock(unsigned char* start, unsigned sizeClass);
+
+        // Allocates a block from a fresh dedicated segment.
+        void* AllocateDedicated(size_t blockSize);
+
+        const PageType m_pageType;
+        const size_t m_pageSize;
+        const size_t m_segmentSize;
+        const size_t m_maxReservedSize;
+        const unsigned m_segmentSizeClass;
+
+        size_t m_bytesReserved;
+        size_t m_bytesInUse;
+
+        // Regular segments, used for bump allocation. The last one is the
+        // current segment.
+        std::vector<Segment> m_segments;
+
+        // Segments holding a single oversized block.
+        std::vector<Segment> m_dedicatedSegments;
+
+        // Heads of the singly-linked free lists, indexed by size class.
+        BlockHeader* m_freeLists[c_maxSizeClass + 1];
+    };
+}
@@ -23,8 +23,8 @@
 
 #pragma once
 
-#include "NativeJIT/CodeGen/CodeBuffer.h"       // Embedded class.
-#include "Temporary/IAllocator.h"
+#include "NativeJIT/CodeGen/CodeBuffer.h"               // Embedded class.
+#include "NativeJIT/CodeGen/IExecutableAllocator.h"     // Base class.
 
 
 namespace NativeJIT
@@ -33,10 +33,21 @@ namespace NativeJIT
     struct UnwindInfo;
     struct UnwindCode;
 
-    class ExecutionBuffer : public Allocators::IAllocator
+    class ExecutionBuffer : public IExecutableAllocator
     {
     public:
-        ExecutionBuffer(size_t bufferSize);
+        // Specifies how the buffer is mapped into memory. SingleReadWriteExecute
+        // maps a single view with read, write and execute permissions.
+        // DualReadWriteAndReadExecute maps the same shared memory object
+        // twice: a read-write view that the code is emitted into and a
+        // read-execute view that the code runs from. No page is ever writable
+        // and executable at the same time, so the buffer works on kernels that
+        // reject W+X mappings and code can be written without mprotect() calls.
+        // The dual mapping is currently supported only on Linux.
+        enum class MappingType { SingleReadWriteExecute, DualReadWriteAndReadExecute };
+
+        ExecutionBuffer(size_t bufferSize,
+                        MappingType mappingType = MappingType::SingleReadWriteExecute);
 
         virtual ~ExecutionBuffer() override;
 
@@ -58,11 +69,26 @@ namespace NativeJIT
         // last call to Reset().
         virtual void Reset() override;
 
+
+        //
+        // IExecutableAllocator methods
+        //
+
+        // Returns the distance between the executable and the writable view
+        // of the buffer. Zero unless the buffer is dual mapped.
+        virtual ptrdiff_t GetExecutableAliasOffset(void const * block) const override;
+
     private:
         void DebugInitialize();
 
+        void MapDualViews();
+
         size_t m_bufferSize;
         size_t m_bytesAllocated;
+
+        // The writable view of the buffer and the view that the code is
+        // executed from. The two are the same for a single mapping.
         unsigned char* m_buffer;
+        unsigned char* m_executableBuffer;
     };
 }
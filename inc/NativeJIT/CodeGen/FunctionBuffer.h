@@ -56,7 +56,8 @@ namespace NativeJIT
         ~FunctionBuffer();
 
         // Returns the entry point to the function, i.e. untyped function
-        // pointer.
+        // pointer. For code allocators that map the code twice, the entry
+        // point is in the executable view.
         void const * GetEntryPoint() const;
 
         // The following functions return the information about the contents
@@ -85,6 +86,13 @@ namespace NativeJIT
         // patched with the actual values.
         void EndFunctionBodyGeneration(FunctionSpecification const & spec);
 
+        // Optionally called by clients before EndFunctionBodyGeneration() to
+        // fill in the unwind info and prolog and to write the epilog right
+        // away. The code emitted between the two calls is placed behind the
+        // epilog, out of the way of the code which falls through to it, and
+        // can only be reached by jumps from the function body.
+        void EmitEpilog(FunctionSpecification const & spec);
+
         // Resets the buffer to the same state it had after its construction.
         virtual void Reset() override;
 
@@ -100,6 +108,7 @@ namespace NativeJIT
         unsigned m_unwindInfoByteLength;
         unsigned m_prologStartOffset;
         unsigned m_prologLength;
+        bool m_isEpilogEmitted;
         bool m_isCodeGenerationCompleted;
 
         // The callback function for RtlInstallFunctionTableCallback. Context
@@ -56,14 +56,20 @@ namespace NativeJIT
         // Larger values allow for more extreme prolog sizes, but lead to more
         // wasted space in common case (in the scenario when prolog space is
         // reserved and then filled in). Close to 144 bytes is needed when all
-        // 8 RXX (plus RSP separately) and 10 XMM non-volatiles need to be saved.
-        static const size_t c_maxPrologOrEpilogSize = 144;
+        // 8 RXX (plus RSP separately) and 10 XMM non-volatiles need to be saved
+        // plus up to 32 bytes for the stack probe of frames larger than a page.
+        static const size_t c_maxPrologOrEpilogSize = 176;
         static_assert(c_maxPrologOrEpilogSize <= 256,
                       "Prolog/epilog cannot be larger than 256 bytes");
 
-        // A value larger than 4096 would require the generated code to call _chkstk.
-        static const unsigned c_maxStackSize = 4096;
-        static_assert(c_maxStackSize <= 4096, "Cannot have stack larger than 4096 bytes");
+        // Frames larger than a page are probed page by page in the prolog
+        // before RSP is adjusted, so that the guard page is always touched
+        // first (the same thing that _chkstk does).
+        static const unsigned c_stackProbePageSize = 4096;
+
+        // The largest allocation that the two-code version of UWOP_ALLOC_LARGE
+        // can describe: 65535 quadwords.
+        static const unsigned c_maxStackSize = 0xffff * 8;
 
         // Builds unwind info, prolog and epilog code from the information about
         // function's behavior: maximum number of parameters for the functions
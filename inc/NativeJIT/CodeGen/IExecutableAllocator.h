@@ -0,0 +1,46 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <stddef.h>                     // For ::ptrdiff_t
+
+#include "Temporary/IAllocator.h"       // Base class.
+
+
+namespace NativeJIT
+{
+    // An allocator of code memory that may make the blocks it hands out
+    // executable at a different virtual address than the one they are written
+    // through (f. ex. a read-write view and a read-execute view of the same
+    // physical pages). CodeBuffer queries the allocator for this interface
+    // and uses the offset to translate addresses that will be executed.
+    class IExecutableAllocator : public Allocators::IAllocator
+    {
+    public:
+        // Returns the distance in bytes between the executable and writable
+        // addresses of the specified block. The executable address of any byte
+        // inside the block is its writable address plus the returned offset.
+        virtual ptrdiff_t GetExecutableAliasOffset(void const * block) const = 0;
+    };
+}
@@ -41,15 +41,43 @@ namespace NativeJIT
     unsigned Size(int64_t value);
 
 
+    // Returns true if the conversion from FROM to TO is a floating point to
+    // unsigned integer conversion. Such conversions of negative values are
+    // undefined in C++, so ForcedCast() handles them separately.
+    template <typename TO, typename FROM>
+    struct IsFloatToUnsignedCast
+        : std::integral_constant<bool,
+                                 std::is_floating_point<FROM>::value
+                                 && std::is_integral<TO>::value
+                                 && std::is_unsigned<TO>::value
+                                 && !std::is_same<TO, bool>::value>
+    {
+    };
+
+
     // Cast using a static_cast for convertible immediates.
     template <typename TO, typename FROM>
     TO ForcedCast(FROM from,
-                  typename std::enable_if<std::is_convertible<FROM, TO>::value>::type* = nullptr)
+                  typename std::enable_if<std::is_convertible<FROM, TO>::value
+                                          && !IsFloatToUnsignedCast<TO, FROM>::value>::type* = nullptr)
     {
         return static_cast<TO>(from);
     }
 
 
+    // Cast from floating point to unsigned integer. Negative values are
+    // converted through int64_t to match the cvttss2si/cvttsd2si sequence
+    // emitted by CastNode.
+    template <typename TO, typename FROM>
+    TO ForcedCast(FROM from,
+                  typename std::enable_if<IsFloatToUnsignedCast<TO, FROM>::value>::type* = nullptr)
+    {
+        return from < 0
+            ? static_cast<TO>(static_cast<int64_t>(from))
+            : static_cast<TO>(from);
+    }
+
+
     // Cast using a reinterpret_cast for non-convertible immediates of the
     // same size.
     template <typename TO, typename FROM>
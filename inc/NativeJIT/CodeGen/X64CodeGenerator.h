@@ -28,6 +28,7 @@
 // http://felixcloutier.com/x86/
 
 #include <ostream>                              // Debugging output.
+#include <type_traits>                          // std::integral_constant.
 
 #include "NativeJIT/BitOperations.h"
 #include "NativeJIT/CodeGen/CodeBuffer.h"       // Inherits from CodeBuffer.
@@ -75,38 +76,81 @@ namespace NativeJIT
     };
 
 
+    // The condition code which holds exactly when JCC doesn't. The encodings
+    // of x64 condition codes pair each condition with its negation in the
+    // lowest bit.
+    template <JccType JCC>
+    struct InverseJcc
+        : std::integral_constant<JccType,
+                                 static_cast<JccType>(static_cast<unsigned>(JCC) ^ 1u)>
+    {
+    };
+
+
     // WARNING: When modifying OpCode, be sure to also modify the function OpCodeName().
     enum class OpCode : unsigned
     {
         Add,
         And,
+        AndN,       // andn dest, src1, src2 computes ~src1 & src2, requires BMI1.
+        BSwap,
+        Bzhi,       // bzhi dest, src, index zeroes the bits of src from index up, requires BMI2.
         Call,
         Cmp,
+        Cqo,        // Cwd/Cdq/Cqo depending on the size of the operand, which must be the accumulator.
         CvtFP2FP,
         CvtFP2SI,
         CvtSI2FP,
-        IMul,
+        Div,
+        IDiv,
+        IMul,       // Note: the single operand form multiplies rax into rdx:rax.
         Lea,
+        LZCnt,      // Requires LZCNT, executes as bsr on processors without it.
+        Max,        // MaxSS/MaxSD, returns the second operand if either is NaN or both are zeros.
+        Min,        // MinSS/MinSD, likewise.
         Mov,
         MovSX,
         MovZX,
         MovAP,      // Aligned 128-bit SSE move.
+        Mul,
+        Neg,
         Nop,
         Or,
+        Pdep,       // Parallel bit deposit, requires BMI2.
+        Pext,       // Parallel bit extract, requires BMI2.
         Pop,
+        PopCnt,     // Requires POPCNT.
         Push,
         Ret,
         Rol,
+        Round,      // RoundSS/RoundSD, requires SSE4.1.
+        Sar,
         Shl,        // Note: Shl and Sal are aliases, unlike Shr and Sar.
         Shld,
         Shr,
+        Sqrt,
         Sub,
+        TZCnt,      // Requires BMI1, executes as bsf on processors without it.
         Xor,
         // The following value must be the last one.
         OpCodeCount
     };
 
 
+    // Instruction set extensions whose instructions the code generator
+    // emits only when they are enabled, see X64CodeGenerator::IsSupported().
+    enum class CpuFeature : unsigned
+    {
+        Bmi1,       // andn, tzcnt.
+        Bmi2,       // bzhi, pdep, pext.
+        LZCnt,      // lzcnt, reported as ABM by AMD.
+        PopCnt,
+        Sse41,      // roundss, roundsd.
+        // The following value must be the last one.
+        CpuFeatureCount
+    };
+
+
     class X64CodeGenerator : public CodeBuffer
     {
     public:
@@ -121,12 +165,31 @@ namespace NativeJIT
         bool IsDiagnosticsStreamAvailable() const;
         std::ostream& GetDiagnosticsStream() const;
 
+        // Returns whether the instructions from the extension may be emitted.
+        // Initially, exactly the extensions supported by the processor the
+        // code generator runs on are enabled.
+        bool IsSupported(CpuFeature feature) const;
+
+        // Enables or disables the use of the extension, f. ex. to generate
+        // and test the code used on processors which lack it. Note that
+        // enabling an extension the processor doesn't support results in code
+        // which faults or, for lzcnt and tzcnt, silently computes bsr/bsf.
+        void SetSupported(CpuFeature feature, bool isSupported);
+
         // This override allows for printing of debugging information.
         virtual void PlaceLabel(Label l) override;
 
         void Jmp(Label l);
         void Jmp(void* functionPtr);
 
+        // Jumps to the address held by the register (jmp rax).
+        void Jmp(Register<8, false> target);
+
+        // Emits a jump table entry: the 32-bit signed offset of the label from
+        // the end of the entry. Adding the entry to its end address yields the
+        // address of the label regardless of where the buffer is mapped.
+        void EmitJumpTableEntry(Label l);
+
         // These two methods are public in order to allow access for BinaryNode debugging text.
         static char const * OpCodeName(OpCode op);
         static char const * JccName(JccType jcc);
@@ -141,6 +204,22 @@ namespace NativeJIT
         template <JccType JCC>
         void EmitConditionalJump(Label l);
 
+        // Moves src into dest if the condition JCC holds (cmovcc). Byte
+        // registers are not supported by the instruction, their 32-bit
+        // aliases can be used instead. Does not modify the flags.
+        template <JccType JCC, unsigned SIZE>
+        void EmitConditionalMove(Register<SIZE, false> dest, Register<SIZE, false> src);
+
+        // Memory source form of the conditional move, i.e. cmovcc reg, [src + srcOffset].
+        // Note that the memory is read even if the condition doesn't hold.
+        template <JccType JCC, unsigned SIZE>
+        void EmitConditionalMove(Register<SIZE, false> dest, Register<8, false> src, int32_t srcOffset);
+
+        // Sets dest to 1 if the condition JCC holds and to 0 otherwise (setcc).
+        // Does not modify the flags.
+        template <JccType JCC>
+        void EmitConditionalSet(Register<1, false> dest);
+
         // No operand (e.g nop, ret)
         template <OpCode OP>
         void Emit();
@@ -191,6 +270,28 @@ namespace NativeJIT
         template <OpCode OP, unsigned SIZE, bool ISFLOAT, typename T>
         void EmitImmediate(Register<SIZE, ISFLOAT> dest, Register<SIZE, ISFLOAT> src, T value);
 
+        // Three register operands of the same size for the VEX encoded BMI
+        // instructions (andn, bzhi, pdep, pext) which write the result into
+        // dest without modifying either source. The operands are in the Intel
+        // syntax order, f. ex. andn dest, src1, src2 computes ~src1 & src2.
+        // Only 32 and 64-bit registers are supported.
+        template <OpCode OP, unsigned SIZE>
+        void EmitVex(Register<SIZE, false> dest,
+                     Register<SIZE, false> src1,
+                     Register<SIZE, false> src2);
+
+        // Two operands - register destination and the base + index * scale +
+        // offset indirect source (f. ex. lea rax, [rbx + rcx * 4]). Only lea
+        // is supported. Destinations narrower than 32 bits are written through
+        // their 32-bit alias, which leaves the same lower bits and avoids the
+        // operand size prefix.
+        template <OpCode OP, unsigned SIZE>
+        void EmitScaledIndex(Register<SIZE, false> dest,
+                             Register<8, false> base,
+                             Register<8, false> index,
+                             uint8_t scale,
+                             int32_t offset);
+
     private:
         void Call(Register<8, false> r);
 
@@ -212,6 +313,13 @@ namespace NativeJIT
                  Register<8, false> src,
                  int32_t srcOffset);
 
+        template <unsigned SIZE>
+        void Lea(Register<SIZE, false> dest,
+                 Register<8, false> base,
+                 Register<8, false> index,
+                 uint8_t scale,
+                 int32_t offset);
+
         template <unsigned SIZE, typename T>
         void MovImmediate(Register<SIZE, false> dest,
                           T value);
@@ -240,12 +348,42 @@ namespace NativeJIT
         template <unsigned SIZE1, unsigned SIZE2>
         void MovZX(Register<SIZE1, false> dest, Register<8, false> src, int32_t srcOffset);
 
+        template <unsigned SIZE>
+        void Cqo(Register<SIZE, false> accumulator);
+
+        template <unsigned SIZE>
+        void BSwap(Register<SIZE, false> dest);
+
+        // The bit counting instructions (popcnt, lzcnt, tzcnt) are encoded as
+        // [66] F3 [REX] 0F OPCODE, with the mandatory F3 prefix following the
+        // operand size override.
+        template <uint8_t OPCODE, unsigned SIZE>
+        void BitCount(Register<SIZE, false> dest, Register<SIZE, false> src);
+
+        template <uint8_t OPCODE, unsigned SIZE>
+        void BitCount(Register<SIZE, false> dest, Register<8, false> src, int32_t srcOffset);
+
+        // Emits a VEX encoded instruction from the 0F 38 opcode map with the
+        // implied prefix pp (0: none, 1: 66, 2: F3, 3: F2), the reg and rm
+        // operands of the ModR/M byte and the vvvv operand of the VEX prefix.
+        template <unsigned SIZE>
+        void Vex(uint8_t pp,
+                 uint8_t opcode,
+                 Register<SIZE, false> reg,
+                 Register<SIZE, false> vvvv,
+                 Register<SIZE, false> rm);
+
         template <unsigned SIZE>
         void Shld(Register<SIZE, false> dest, Register<SIZE, false> src, uint8_t bitCount);
 
         template <unsigned SIZE>
         void Shld(Register<SIZE, false> dest, Register<SIZE, false> src);
 
+        // The mode rounds to nearest (0), down (1), up (2) or toward zero
+        // (3). Setting bit 3 suppresses the precision exception.
+        template <unsigned SIZE>
+        void Round(Register<SIZE, true> dest, Register<SIZE, true> src, uint8_t mode);
+
         // Scalar SSE instructions are encoded as XX 0F OPCODE, where XX is
         // either 0xF2 or 0xF3 depending on the register size. Used for
         // instructions operating on scalars (f. ex. MovSS/SD, AddSS/SD) rather
@@ -310,7 +448,7 @@ namespace NativeJIT
         template <uint8_t OPCODE, unsigned SIZE1, bool ISFLOAT1, unsigned SIZE2, bool ISFLOAT2>
         void SSEx66(Register<8, false> dest, int32_t destOffset, Register<SIZE2, ISFLOAT2> src);
 
-        // Group 1/2 instructions.
+        // Group 1/2/3 instructions.
 
         template <unsigned SIZE>
         void Group1(uint8_t baseOpCode,
@@ -344,6 +482,10 @@ namespace NativeJIT
                     uint8_t shift,
                     Register<SIZE, false> dest);
 
+        template <unsigned SIZE>
+        void Group3(uint8_t extensionOpCode,
+                    Register<SIZE, false> dest);
+
         // Methods for emitting the 0x66 operand size override prefix if
         // size of either operand is 16-bit. Note: for indirect addressing, the
         // size of the operand is the size of the memory being accessed, not the
@@ -404,6 +546,12 @@ namespace NativeJIT
         template <unsigned RMSIZE, bool RMISFLOAT, unsigned REGSIZE, bool REGISFLOAT>
         void EmitRexIndirect(Register<REGSIZE, REGISFLOAT> reg, Register<8, false> rm);
 
+        // Indirect base + index * scale operand, sets REX.X for the index.
+        template <unsigned RMSIZE, bool RMISFLOAT, unsigned REGSIZE, bool REGISFLOAT>
+        void EmitRexIndirect(Register<REGSIZE, REGISFLOAT> reg,
+                             Register<8, false> base,
+                             Register<8, false> index);
+
         // Methods for emitting the ModR/M byte.
         // Reference: http://wiki.osdev.org/X86-64_Instruction_Encoding#ModR.2FM
 
@@ -416,6 +564,15 @@ namespace NativeJIT
         template <unsigned SIZE, bool ISFLOAT>
         void EmitModRMOffset(Register<SIZE, ISFLOAT> dest, Register<8, false> src, int32_t srcOffset);
 
+        // Emits the ModR/M byte, the SIB byte and the displacement for the
+        // base + index * scale + offset operand.
+        template <unsigned SIZE, bool ISFLOAT>
+        void EmitModRMScaledIndex(Register<SIZE, ISFLOAT> reg,
+                                  Register<8, false> base,
+                                  Register<8, false> index,
+                                  uint8_t scale,
+                                  int32_t offset);
+
         // Helper class used to provide partial specializations by OpCode,
         // ISFLOAT and SIZE for the Emit() methods.
         template <OpCode OP>
@@ -446,6 +603,9 @@ namespace NativeJIT
 
                 template <unsigned SIZE, typename T>
                 static void EmitImmediate(X64CodeGenerator& code, Register<SIZE, ISFLOAT> dest, Register<SIZE, ISFLOAT> src, T value);
+
+                template <unsigned SIZE>
+                static void EmitVex(X64CodeGenerator& code, Register<SIZE, ISFLOAT> dest, Register<SIZE, ISFLOAT> src1, Register<SIZE, ISFLOAT> src2);
             };
 
 
@@ -490,10 +650,30 @@ namespace NativeJIT
 
             void PrintJump(void *function);
             void PrintJump(Label label);
+            void PrintJump(Register<8, false> target);
+            void PrintJumpTableEntry(Label label);
 
             template <JccType JCC>
             void Print(Label l);
 
+            // Prints the instructions whose mnemonic is formed by the prefix
+            // and the condition code (f. ex. cmovne, sete).
+            template <unsigned SIZE>
+            void PrintConditional(char const * prefix, JccType jcc, Register<SIZE, false> dest);
+
+            template <unsigned SIZE>
+            void PrintConditional(char const * prefix,
+                                  JccType jcc,
+                                  Register<SIZE, false> dest,
+                                  Register<SIZE, false> src);
+
+            template <unsigned SIZE>
+            void PrintConditional(char const * prefix,
+                                  JccType jcc,
+                                  Register<SIZE, false> dest,
+                                  Register<8, false> src,
+                                  int32_t srcOffset);
+
             void Print(OpCode op);
 
             template <unsigned SIZE, bool ISFLOAT>
@@ -508,12 +688,26 @@ namespace NativeJIT
             template <unsigned SIZE1, bool ISFLOAT1, unsigned SIZE2, bool ISFLOAT2>
             void Print(OpCode op, Register<8, false> dest, int32_t destOffset, Register<SIZE2, ISFLOAT2> src);
 
+            template <unsigned SIZE, bool ISFLOAT>
+            void Print(OpCode op,
+                       Register<SIZE, ISFLOAT> dest,
+                       Register<SIZE, ISFLOAT> src1,
+                       Register<SIZE, ISFLOAT> src2);
+
             template <unsigned SIZE, bool ISFLOAT, typename T>
             void PrintImmediate(OpCode op, Register<SIZE, ISFLOAT> dest, T value);
 
             template <unsigned SIZE, bool ISFLOAT, typename T>
             void PrintImmediate(OpCode op, Register<SIZE, ISFLOAT> dest, Register<SIZE, ISFLOAT> src, T value);
 
+            template <unsigned SIZE>
+            void PrintScaledIndex(OpCode op,
+                                  Register<SIZE, false> dest,
+                                  Register<8, false> base,
+                                  Register<8, false> index,
+                                  uint8_t scale,
+                                  int32_t offset);
+
         private:
             X64CodeGenerator& m_code;
             unsigned m_startPosition;
@@ -546,6 +740,9 @@ namespace NativeJIT
         };
 
         std::ostream* m_diagnosticsStream;
+
+        // Bit i is set if the CpuFeature with value i is enabled.
+        unsigned m_cpuFeatures;
     };
 
 
@@ -587,6 +784,73 @@ namespace NativeJIT
     }
 
 
+    template <unsigned SIZE>
+    void X64CodeGenerator::CodePrinter::PrintConditional(char const * prefix,
+                                                         JccType jcc,
+                                                         Register<SIZE, false> dest)
+    {
+        if (m_out != nullptr)
+        {
+            PrintBytes(m_startPosition, m_code.CurrentPosition());
+
+            // Skip the 'j' of the jump mnemonic.
+            *m_out << prefix << (JccName(jcc) + 1) << ' ' << dest.GetName() << std::endl;
+        }
+    }
+
+
+    template <unsigned SIZE>
+    void X64CodeGenerator::CodePrinter::PrintConditional(char const * prefix,
+                                                         JccType jcc,
+                                                         Register<SIZE, false> dest,
+                                                         Register<SIZE, false> src)
+    {
+        if (m_out != nullptr)
+        {
+            PrintBytes(m_startPosition, m_code.CurrentPosition());
+
+            *m_out << prefix << (JccName(jcc) + 1)
+                   << ' ' << dest.GetName() << ", " << src.GetName() << std::endl;
+        }
+    }
+
+
+    template <unsigned SIZE>
+    void X64CodeGenerator::CodePrinter::PrintConditional(char const * prefix,
+                                                         JccType jcc,
+                                                         Register<SIZE, false> dest,
+                                                         Register<8, false> src,
+                                                         int32_t srcOffset)
+    {
+        if (m_out != nullptr)
+        {
+            IosMiniStateRestorer state(*m_out);
+
+            PrintBytes(m_startPosition, m_code.CurrentPosition());
+
+            *m_out << prefix << (JccName(jcc) + 1)
+                   << ' ' << dest.GetName()
+                   << ", "
+                   << GetPointerName(SIZE)
+                   << " ptr ["
+                   << src.GetName()
+                   << std::uppercase
+                   << std::hex;
+
+            if (srcOffset > 0)
+            {
+                *m_out << " + " << srcOffset << "h";
+            }
+            else if (srcOffset < 0)
+            {
+                *m_out << " - " << -static_cast<int64_t>(srcOffset) << "h";
+            }
+
+            *m_out << "]" << std::endl;
+        }
+    }
+
+
     template <unsigned SIZE, bool ISFLOAT>
     void X64CodeGenerator::CodePrinter::Print(OpCode op, Register<SIZE, ISFLOAT> dest)
     {
@@ -682,6 +946,64 @@ namespace NativeJIT
     }
 
 
+    template <unsigned SIZE, bool ISFLOAT>
+    void X64CodeGenerator::CodePrinter::Print(OpCode op,
+                                              Register<SIZE, ISFLOAT> dest,
+                                              Register<SIZE, ISFLOAT> src1,
+                                              Register<SIZE, ISFLOAT> src2)
+    {
+        if (m_out != nullptr)
+        {
+            PrintBytes(m_startPosition, m_code.CurrentPosition());
+
+            *m_out << OpCodeName(op)
+                   << ' ' << dest.GetName()
+                   << ", " << src1.GetName()
+                   << ", " << src2.GetName()
+                   << std::endl;
+        }
+    }
+
+
+    template <unsigned SIZE>
+    void X64CodeGenerator::CodePrinter::PrintScaledIndex(OpCode op,
+                                                         Register<SIZE, false> dest,
+                                                         Register<8, false> base,
+                                                         Register<8, false> index,
+                                                         uint8_t scale,
+                                                         int32_t offset)
+    {
+        if (m_out != nullptr)
+        {
+            IosMiniStateRestorer state(*m_out);
+
+            PrintBytes(m_startPosition, m_code.CurrentPosition());
+
+            *m_out << OpCodeName(op)
+                   << ' ' << dest.GetName()
+                   << ", ["
+                   << base.GetName()
+                   << " + "
+                   << index.GetName()
+                   << " * "
+                   << static_cast<unsigned>(scale)
+                   << std::uppercase
+                   << std::hex;
+
+            if (offset > 0)
+            {
+                *m_out << " + " << offset << "h";
+            }
+            else if (offset < 0)
+            {
+                *m_out << " - " << -static_cast<int64_t>(offset) << "h";
+            }
+
+            *m_out << "]"  << std::endl;
+        }
+    }
+
+
     template <typename T, bool ISSIGNED>
     T X64CodeGenerator::CodePrinter::IntegralAbs<T, ISSIGNED>::operator()(T value)
     {
@@ -777,6 +1099,56 @@ namespace NativeJIT
     }
 
 
+    template <JccType JCC, unsigned SIZE>
+    void X64CodeGenerator::EmitConditionalMove(Register<SIZE, false> dest, Register<SIZE, false> src)
+    {
+        static_assert(SIZE != 1, "cmov does not support byte registers.");
+
+        CodePrinter printer(*this);
+
+        EmitOpSizeOverrideDirect(dest, src);
+        EmitRexDirect(dest, src);
+        Emit8(0x0f);
+        Emit8(0x40 + static_cast<uint8_t>(JCC));
+        EmitModRM(dest, src);
+
+        printer.PrintConditional("cmov", JCC, dest, src);
+    }
+
+
+    template <JccType JCC, unsigned SIZE>
+    void X64CodeGenerator::EmitConditionalMove(Register<SIZE, false> dest,
+                                               Register<8, false> src,
+                                               int32_t srcOffset)
+    {
+        static_assert(SIZE != 1, "cmov does not support byte registers.");
+
+        CodePrinter printer(*this);
+
+        EmitOpSizeOverrideIndirect<SIZE, false>(dest, src);
+        EmitRexIndirect<SIZE, false>(dest, src);
+        Emit8(0x0f);
+        Emit8(0x40 + static_cast<uint8_t>(JCC));
+        EmitModRMOffset(dest, src, srcOffset);
+
+        printer.PrintConditional("cmov", JCC, dest, src, srcOffset);
+    }
+
+
+    template <JccType JCC>
+    void X64CodeGenerator::EmitConditionalSet(Register<1, false> dest)
+    {
+        CodePrinter printer(*this);
+
+        EmitRex(dest);
+        Emit8(0x0f);
+        Emit8(0x90 + static_cast<uint8_t>(JCC));
+        EmitModRM(0, dest);
+
+        printer.PrintConditional("set", JCC, dest);
+    }
+
+
     template <OpCode OP>
     void X64CodeGenerator::Emit()
     {
@@ -891,6 +1263,37 @@ namespace NativeJIT
     }
 
 
+    template <OpCode OP, unsigned SIZE>
+    void X64CodeGenerator::EmitVex(Register<SIZE, false> dest,
+                                   Register<SIZE, false> src1,
+                                   Register<SIZE, false> src2)
+    {
+        CodePrinter printer(*this);
+
+        Helper<OP>::template ArgTypes1<false>::template EmitVex<SIZE>(*this, dest, src1, src2);
+
+        printer.Print(OP, dest, src1, src2);
+    }
+
+
+    template <OpCode OP, unsigned SIZE>
+    void X64CodeGenerator::EmitScaledIndex(Register<SIZE, false> dest,
+                                           Register<8, false> base,
+                                           Register<8, false> index,
+                                           uint8_t scale,
+                                           int32_t offset)
+    {
+        static_assert(OP == OpCode::Lea, "Only lea supports the scaled index source.");
+
+        const Register<(SIZE < 4 ? 4 : SIZE), false> target(dest);
+        CodePrinter printer(*this);
+
+        Lea(target, base, index, scale, offset);
+
+        printer.PrintScaledIndex(OP, target, base, index, scale, offset);
+    }
+
+
     //*************************************************************************
     //
     // Template definitions for X64CodeGenerator - private methods.
@@ -977,6 +1380,21 @@ namespace NativeJIT
     }
 
 
+    template <unsigned SIZE>
+    void X64CodeGenerator::Lea(Register<SIZE, false> dest,
+                               Register<8, false> base,
+                               Register<8, false> index,
+                               uint8_t scale,
+                               int32_t offset)
+    {
+        static_assert(SIZE >= 4, "Lea with a scaled index requires a 32 or 64-bit destination.");
+
+        EmitRexIndirect<SIZE, false>(dest, base, index);
+        Emit8(0x8d);
+        EmitModRMScaledIndex(dest, base, index, scale, offset);
+    }
+
+
     template <unsigned SIZE, typename T>
     void X64CodeGenerator::MovImmediate(Register<SIZE, false> dest,
                                         T value)
@@ -1160,6 +1578,86 @@ namespace NativeJIT
     }
 
 
+    template <unsigned SIZE>
+    void X64CodeGenerator::Cqo(Register<SIZE, false> accumulator)
+    {
+        static_assert(SIZE >= 2, "There is no sign extension of al into a byte register.");
+        LogThrowAssert(accumulator.GetId() == 0,
+                       "Only the accumulator can be sign extended, not %s",
+                       accumulator.GetName());
+
+        EmitOpSizeOverride(accumulator);
+        EmitRex(accumulator);
+        Emit8(0x99);
+    }
+
+
+    template <unsigned SIZE>
+    void X64CodeGenerator::BSwap(Register<SIZE, false> dest)
+    {
+        static_assert(SIZE == 4 || SIZE == 8,
+                      "bswap supports only 32 and 64-bit registers, 16-bit values can be rotated by 8 instead.");
+
+        EmitRex(dest);
+        Emit8(0x0f);
+        Emit8(0xc8 + dest.GetId8());
+    }
+
+
+    template <uint8_t OPCODE, unsigned SIZE>
+    void X64CodeGenerator::BitCount(Register<SIZE, false> dest, Register<SIZE, false> src)
+    {
+        static_assert(SIZE >= 2, "There are no byte variants of popcnt, lzcnt and tzcnt.");
+
+        EmitOpSizeOverrideDirect(dest, src);
+        Emit8(0xf3);
+        EmitRexDirect(dest, src);
+        Emit8(0x0f);
+        Emit8(OPCODE);
+        EmitModRM(dest, src);
+    }
+
+
+    template <uint8_t OPCODE, unsigned SIZE>
+    void X64CodeGenerator::BitCount(Register<SIZE, false> dest, Register<8, false> src, int32_t srcOffset)
+    {
+        static_assert(SIZE >= 2, "There are no byte variants of popcnt, lzcnt and tzcnt.");
+
+        EmitOpSizeOverrideIndirect<SIZE, false>(dest, src);
+        Emit8(0xf3);
+        EmitRexIndirect<SIZE, false>(dest, src);
+        Emit8(0x0f);
+        Emit8(OPCODE);
+        EmitModRMOffset(dest, src, srcOffset);
+    }
+
+
+    template <unsigned SIZE>
+    void X64CodeGenerator::Vex(uint8_t pp,
+                               uint8_t opcode,
+                               Register<SIZE, false> reg,
+                               Register<SIZE, false> vvvv,
+                               Register<SIZE, false> rm)
+    {
+        static_assert(SIZE == 4 || SIZE == 8, "VEX encoded BMI instructions support only 32 and 64-bit registers.");
+
+        // Three byte VEX prefix. The R, X, B and vvvv fields are stored
+        // inverted. The X bit is unused since there is no index register and
+        // the 00010 map selects the 0F 38 opcode map. In the second byte, the
+        // W bit selects the 64-bit operand size and L (vector length) is 0.
+        Emit8(0xc4);
+        Emit8((reg.IsExtended() ? 0 : 0x80)
+              | 0x40
+              | (rm.IsExtended() ? 0 : 0x20)
+              | 0x02);
+        Emit8((SIZE == 8 ? 0x80 : 0)
+              | ((~vvvv.GetId() & 0xf) << 3)
+              | (pp & 3));
+        Emit8(opcode);
+        EmitModRM(reg, rm);
+    }
+
+
     template <unsigned SIZE>
     void X64CodeGenerator::Shld(Register<SIZE, false> dest, Register<SIZE, false> src)
     {
@@ -1173,6 +1671,21 @@ namespace NativeJIT
     }
 
 
+    template <unsigned SIZE>
+    void X64CodeGenerator::Round(Register<SIZE, true> dest, Register<SIZE, true> src, uint8_t mode)
+    {
+        static_assert(SIZE == 4 || SIZE == 8, "Invalid register size for RoundSS/RoundSD.");
+
+        Emit8(0x66);
+        EmitRexDirect(dest, src);
+        Emit8(0x0f);
+        Emit8(0x3a);
+        Emit8(SIZE == 8 ? 0x0b : 0x0a);
+        EmitModRM(dest, src);
+        Emit8(mode);
+    }
+
+
     //
     // Scalar SSE instructions
     //
@@ -1524,6 +2037,28 @@ namespace NativeJIT
     }
 
 
+    //
+    // X64 group3 opcodes
+    //
+
+    template <unsigned SIZE>
+    void X64CodeGenerator::Group3(uint8_t extensionOpCode,
+                                  Register<SIZE, false> dest)
+    {
+        EmitOpSizeOverride(dest);
+        EmitRex(dest);
+        if (SIZE == 1)
+        {
+            Emit8(0xf6);
+        }
+        else
+        {
+            Emit8(0xf7);
+        }
+        EmitModRM(extensionOpCode, dest);
+    }
+
+
     //
     // X64 opcode encoding - operand size override.
     //
@@ -1594,10 +2129,9 @@ namespace NativeJIT
                       "Only direct addressing or indirect addresing with 64-bit "
                       "general purpose base register can be used.");
 
-        // This code currently doesn't support the REX.X bit.
-        // REX.X is an extra bit for the SIB index field. SIB is scale index
-        // base (think `lea`). We don't currently support this addressing
-        // mode. The old assembler might support SIB?
+        // This overload doesn't set the REX.X bit, which is an extra bit for
+        // the SIB (scale index base) index field. The scaled index addressing
+        // mode is only used by the EmitRexIndirect() overload with the index.
         //
         // Note that the REX.W bit is never set when two floating point operands
         // are used.
@@ -1655,6 +2189,26 @@ namespace NativeJIT
     }
 
 
+    template <unsigned RMSIZE, bool RMISFLOAT, unsigned REGSIZE, bool REGISFLOAT>
+    void X64CodeGenerator::EmitRexIndirect(Register<REGSIZE, REGISFLOAT> reg,
+                                           Register<8, false> base,
+                                           Register<8, false> index)
+    {
+        const bool w = (REGSIZE == 8 && !REGISFLOAT) || (RMSIZE == 8 && !RMISFLOAT);
+        const bool forceRex = (reg == spl || reg == bpl || reg == sil || reg == dil);
+
+        if (forceRex || w || reg.IsExtended() || index.IsExtended() || base.IsExtended())
+        {
+            // WRXB
+            Emit8(0x40
+                  | (w ? 8 : 0)
+                  | (reg.IsExtended() ? 4 : 0)
+                  | (index.IsExtended() ? 2 : 0)
+                  | (base.IsExtended() ? 1 : 0));
+        }
+    }
+
+
     //
     // X64 opcode encoding - ModR/M.
     //
@@ -1748,6 +2302,61 @@ namespace NativeJIT
     }
 
 
+    template <unsigned SIZE, bool ISFLOAT>
+    void X64CodeGenerator::EmitModRMScaledIndex(Register<SIZE, ISFLOAT> reg,
+                                                Register<8, false> base,
+                                                Register<8, false> index,
+                                                uint8_t scale,
+                                                int32_t offset)
+    {
+        LogThrowAssert(!index.IsStackPointer(), "rsp cannot be used as an index");
+        LogThrowAssert(!base.IsRIP(), "RIP-relative addressing cannot be scaled");
+
+        uint8_t scaleField = 0;
+
+        switch (scale)
+        {
+        case 1:
+            scaleField = 0;
+            break;
+        case 2:
+            scaleField = 1;
+            break;
+        case 4:
+            scaleField = 2;
+            break;
+        case 8:
+            scaleField = 3;
+            break;
+        default:
+            LogThrowAbort("Invalid scale %u", scale);
+        }
+
+        uint8_t mod = Mod(offset);
+
+        if (base.GetId8() == 5 && mod == 0)
+        {
+            // With mod == 0, the base field 5 (rbp or r13) means that there
+            // is no base register. Convert to mod 01 and emit an 8-bit
+            // displacement of 0.
+            mod = 1;
+        }
+
+        // The R/M field of 4 indicates that the SIB byte follows.
+        Emit8((mod << 6) | (reg.GetId8() << 3) | 4);
+        Emit8((scaleField << 6) | (index.GetId8() << 3) | base.GetId8());
+
+        if (mod == 1)
+        {
+            Emit8(static_cast<uint8_t>(offset));
+        }
+        else if (mod == 2)
+        {
+            Emit32(offset);
+        }
+    }
+
+
     //*************************************************************************
     //
     // X64CodeGenerator::Helper definitions for each opcode and addressing mode.
@@ -1888,6 +2497,32 @@ namespace NativeJIT
     }
 
 
+    template <>
+    template <>
+    template <unsigned SIZE>
+    void X64CodeGenerator::Helper<OpCode::IMul>::ArgTypes1<false>::Emit(
+        X64CodeGenerator& code,
+        Register<SIZE, false> dest)
+    {
+        code.Group3(5, dest);
+    }
+
+
+    //
+    // Cqo
+    //
+
+    template <>
+    template <>
+    template <unsigned SIZE>
+    void X64CodeGenerator::Helper<OpCode::Cqo>::ArgTypes1<false>::Emit(
+        X64CodeGenerator& code,
+        Register<SIZE, false> dest)
+    {
+        code.Cqo(dest);
+    }
+
+
     //
     // MovSX
     //
@@ -1996,6 +2631,102 @@ namespace NativeJIT
     }
 
 
+    //
+    // Round
+    //
+
+    template <>
+    template <>
+    template <unsigned SIZE, typename T>
+    void X64CodeGenerator::Helper<OpCode::Round>::ArgTypes1<true>::EmitImmediate(
+        X64CodeGenerator& code,
+        Register<SIZE, true> dest,
+        Register<SIZE, true> src,
+        T mode)
+    {
+        code.Round(dest, src, mode);
+    }
+
+
+    //
+    // BSwap
+    //
+
+    template <>
+    template <>
+    template <unsigned SIZE>
+    void X64CodeGenerator::Helper<OpCode::BSwap>::ArgTypes1<false>::Emit(
+        X64CodeGenerator& code,
+        Register<SIZE, false> dest)
+    {
+        code.BSwap(dest);
+    }
+
+
+// Bit counting instructions, both operands of the same size.
+#define DEFINE_BIT_COUNT(name, opcode)                                                          \
+    template <>                                                                                 \
+    template <>                                                                                 \
+    template <unsigned SIZE>                                                                    \
+    void X64CodeGenerator::Helper<OpCode::name>::ArgTypes1<false>::Emit(                        \
+        X64CodeGenerator& code,                                                                 \
+        Register<SIZE, false> dest,                                                             \
+        Register<SIZE, false> src)                                                              \
+    {                                                                                           \
+        code.BitCount<opcode>(dest, src);                                                       \
+    }                                                                                           \
+                                                                                                \
+                                                                                                \
+    template <>                                                                                 \
+    template <>                                                                                 \
+    template <unsigned SIZE>                                                                    \
+    void X64CodeGenerator::Helper<OpCode::name>::ArgTypes1<false>::Emit(                        \
+        X64CodeGenerator& code,                                                                 \
+        Register<SIZE, false> dest,                                                             \
+        Register<8, false> src,                                                                 \
+        int32_t srcOffset)                                                                      \
+    {                                                                                           \
+        code.BitCount<opcode>(dest, src, srcOffset);                                            \
+    }
+
+    DEFINE_BIT_COUNT(LZCnt, 0xbd);
+    DEFINE_BIT_COUNT(PopCnt, 0xb8);
+    DEFINE_BIT_COUNT(TZCnt, 0xbc);
+
+#undef DEFINE_BIT_COUNT
+
+
+// VEX encoded BMI instructions. The isSrc1InRM parameter selects whether the
+// first source operand is encoded in the R/M field of the ModR/M byte and the
+// second one in VEX.vvvv or vice versa.
+#define DEFINE_VEX(name, pp, opcode, isSrc1InRM)                                                \
+    template <>                                                                                 \
+    template <>                                                                                 \
+    template <unsigned SIZE>                                                                    \
+    void X64CodeGenerator::Helper<OpCode::name>::ArgTypes1<false>::EmitVex(                     \
+        X64CodeGenerator& code,                                                                 \
+        Register<SIZE, false> dest,                                                             \
+        Register<SIZE, false> src1,                                                             \
+        Register<SIZE, false> src2)                                                             \
+    {                                                                                           \
+        if (isSrc1InRM)                                                                         \
+        {                                                                                       \
+            code.Vex(pp, opcode, dest, src2, src1);                                             \
+        }                                                                                       \
+        else                                                                                    \
+        {                                                                                       \
+            code.Vex(pp, opcode, dest, src1, src2);                                             \
+        }                                                                                       \
+    }
+
+    DEFINE_VEX(AndN, 0, 0xf2, false);
+    DEFINE_VEX(Bzhi, 0, 0xf5, true);
+    DEFINE_VEX(Pdep, 3, 0xf5, false);
+    DEFINE_VEX(Pext, 2, 0xf5, false);
+
+#undef DEFINE_VEX
+
+
 #define DEFINE_GROUP1(name, baseOpCode, extensionOpCode) \
     template <>                                                                                 \
     template <>                                                                                 \
@@ -2080,12 +2811,34 @@ namespace NativeJIT
     }
 
     DEFINE_GROUP2(Rol, 0);
+    DEFINE_GROUP2(Sar, 7);
     DEFINE_GROUP2(Shl, 4);
     DEFINE_GROUP2(Shr, 5);
 
 #undef DEFINE_GROUP2
 
 
+// Single operand group 3 instructions. Except for neg, they operate on the
+// rdx:rax pair.
+#define DEFINE_GROUP3(name, extensionOpCode)                                                    \
+    template <>                                                                                 \
+    template <>                                                                                 \
+    template <unsigned SIZE>                                                                    \
+    void X64CodeGenerator::Helper<OpCode::name>::ArgTypes1<false>::Emit(                        \
+        X64CodeGenerator& code,                                                                 \
+        Register<SIZE, false> dest)                                                             \
+    {                                                                                           \
+        code.Group3(extensionOpCode, dest);                                                     \
+    }
+
+    DEFINE_GROUP3(Div, 6);
+    DEFINE_GROUP3(IDiv, 7);
+    DEFINE_GROUP3(Mul, 4);
+    DEFINE_GROUP3(Neg, 3);
+
+#undef DEFINE_GROUP3
+
+
 // SSE instruction, both arguments of the same type and size.
 #define DEFINE_SSE_ARGS1(name, emitMethod, opcode) \
     template <>                                                                         \
@@ -2113,11 +2866,17 @@ namespace NativeJIT
     }                                                                                   \
 
     DEFINE_SSE_ARGS1(Add,            ScalarSSE, 0x58);  // AddSS/AddSD.
+    DEFINE_SSE_ARGS1(And,            SSEx66,    0x54);  // AndPS/AndPD, memory operand must be 16-byte aligned.
     DEFINE_SSE_ARGS1(Cmp,            SSEx66,    0x2f);  // ComISS/ComISD.
+    DEFINE_SSE_ARGS1(Div,            ScalarSSE, 0x5e);  // DivSS/DivSD.
     DEFINE_SSE_ARGS1(IMul,           ScalarSSE, 0x59);  // MulSS/MulSD.
+    DEFINE_SSE_ARGS1(Max,            ScalarSSE, 0x5f);  // MaxSS/MaxSD.
+    DEFINE_SSE_ARGS1(Min,            ScalarSSE, 0x5d);  // MinSS/MinSD.
     DEFINE_SSE_ARGS1(Mov,            ScalarSSE, 0x10);  // MovSS/MovSD.
     DEFINE_SSE_ARGS1(MovAP,          SSEx66,    0x28);  // MovAPS/MovAPD.
+    DEFINE_SSE_ARGS1(Sqrt,           ScalarSSE, 0x51);  // SqrtSS/SqrtSD.
     DEFINE_SSE_ARGS1(Sub,            ScalarSSE, 0x5c);  // SubSS/SubSD.
+    DEFINE_SSE_ARGS1(Xor,            SSEx66,    0x57);  // XorPS/XorPD, memory operand must be 16-byte aligned.
 
 #undef DEFINE_SSE_ARGS1
 
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <cstdint>
+#include <type_traits>
 
 #include "NativeJIT/CodeGen/FunctionBuffer.h"   // Emit<OP> referenced by template definition.
 #include "NativeJIT/ExpressionTreeDecls.h"      // ExpressionTree::Storage<T> parameter.
@@ -283,5 +284,385 @@ namespace NativeJIT
                 LogThrowAbort("Invalid storage class.");
             }
         }
+
+
+        //
+        // Branchless selection.
+        //
+
+        // Returns trueValue if the CPU flags satisfy the condition JCC and
+        // falseValue otherwise without branching. Integer values are selected
+        // with cmov and floating point values are blended through a mask
+        // built by setcc. The flags must be set by the caller right before
+        // the call; the code emitted before the selection itself does not
+        // modify them. The registers of the values which are owned solely by
+        // their storages may be reused for the result.
+        template <JccType JCC, typename T>
+        ExpressionTree::Storage<T> Select(ExpressionTree& tree,
+                                          ExpressionTree::Storage<T>& trueValue,
+                                          ExpressionTree::Storage<T>& falseValue);
+
+
+        // The register which cmov uses for a value held in a register of
+        // the given size. cmov has no byte form, so 32-bit aliases are used
+        // for bytes.
+        template <unsigned SIZE>
+        struct ConditionalMoveRegister
+        {
+            typedef Register<SIZE, false> Type;
+        };
+
+
+        template <>
+        struct ConditionalMoveRegister<1>
+        {
+            typedef Register<4, false> Type;
+        };
+
+
+        // Selects between two integer values with cmov. The value that ends up
+        // in the result register is moved there unconditionally.
+        template <JccType JCC, typename T>
+        ExpressionTree::Storage<T> SelectInteger(ExpressionTree& tree,
+                                                 ExpressionTree::Storage<T>& trueValue,
+                                                 ExpressionTree::Storage<T>& falseValue)
+        {
+            typedef typename ExpressionTree::Storage<T>::DirectRegister RegisterType;
+            typedef typename ConditionalMoveRegister<RegisterType::c_size>::Type MoveRegisterType;
+
+            auto & code = tree.GetCodeGenerator();
+
+            ExpressionTree::Storage<T> result;
+            ExpressionTree::Storage<T>* source;
+            bool isSourceTrueValue;
+
+            // See ConditionalNode::CodeGenValue() for the reuse of registers.
+            if (falseValue.GetStorageClass() == StorageClass::Direct
+                && falseValue.IsSoleDataOwner())
+            {
+                falseValue.ConvertToDirect(true);
+                result = falseValue;
+                source = &trueValue;
+                isSourceTrueValue = true;
+            }
+            else if (trueValue.GetStorageClass() == StorageClass::Direct
+                     && trueValue.IsSoleDataOwner())
+            {
+                trueValue.ConvertToDirect(true);
+                result = trueValue;
+                source = &falseValue;
+                isSourceTrueValue = false;
+            }
+            else
+            {
+                result = tree.Direct<T>();
+                Emit<OpCode::Mov>(code, result.GetDirectRegister(), falseValue);
+                source = &trueValue;
+                isSourceTrueValue = true;
+            }
+
+            // cmov only takes the source from a register or from memory. The
+            // memory form is not used since it accesses the memory regardless
+            // of the condition, which makes it no cheaper than a load.
+            if (source->GetStorageClass() != StorageClass::Direct)
+            {
+                ReferenceCounter resultPin = result.GetPin();
+                source->ConvertToDirect(false);
+            }
+
+            const MoveRegisterType dest(result.GetDirectRegister());
+            const MoveRegisterType src(source->GetDirectRegister());
+
+            if (isSourceTrueValue)
+            {
+                code.EmitConditionalMove<JCC>(dest, src);
+            }
+            else
+            {
+                code.EmitConditionalMove<InverseJcc<JCC>::value>(dest, src);
+            }
+
+            return result;
+        }
+
+
+        // Selects between two floating point values as
+        // base ^ ((other ^ base) & mask), where the mask has all bits set if
+        // the other value is selected. The exclusive or of the values is
+        // computed in place in the register of the other value if it is owned
+        // solely by its storage.
+        template <JccType JCC, typename T>
+        ExpressionTree::Storage<T> SelectFloat(ExpressionTree& tree,
+                                               ExpressionTree::Storage<T>& trueValue,
+                                               ExpressionTree::Storage<T>& falseValue)
+        {
+            typedef typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type MaskType;
+            typedef typename ExpressionTree::Storage<MaskType>::DirectRegister MaskRegisterType;
+
+            auto & code = tree.GetCodeGenerator();
+
+            // The aligned memory operands of andps/xorps cannot be used for
+            // scalar values, so both values are moved into registers.
+            trueValue.ConvertToDirect(false);
+            ReferenceCounter truePin = trueValue.GetPin();
+            falseValue.ConvertToDirect(false);
+            ReferenceCounter falsePin = falseValue.GetPin();
+
+            ExpressionTree::Storage<T> difference;
+            ExpressionTree::Storage<T>* base;
+            bool isOtherTrueValue;
+
+            if (trueValue.IsSoleDataOwner())
+            {
+                trueValue.ConvertToDirect(true);
+                difference = trueValue;
+                base = &falseValue;
+                isOtherTrueValue = true;
+            }
+            else if (falseValue.IsSoleDataOwner())
+            {
+                falseValue.ConvertToDirect(true);
+                difference = falseValue;
+                base = &trueValue;
+                isOtherTrueValue = false;
+            }
+            else
+            {
+                difference = tree.Direct<T>();
+                code.Emit<OpCode::MovAP>(difference.GetDirectRegister(),
+                                         trueValue.GetDirectRegister());
+                base = &falseValue;
+                isOtherTrueValue = true;
+            }
+
+            ReferenceCounter differencePin = difference.GetPin();
+            ExpressionTree::Storage<MaskType> mask = tree.Direct<MaskType>();
+            ExpressionTree::Storage<T> result = tree.Direct<T>();
+
+            // All registers are allocated, so nothing can be spilled from here
+            // on. Capture the condition before any instruction modifies the
+            // flags.
+            const MaskRegisterType maskRegister = mask.GetDirectRegister();
+
+            if (isOtherTrueValue)
+            {
+                code.EmitConditionalSet<JCC>(Register<1, false>(maskRegister));
+            }
+            else
+            {
+                code.EmitConditionalSet<InverseJcc<JCC>::value>(Register<1, false>(maskRegister));
+            }
+
+            code.Emit<OpCode::MovZX>(Register<4, false>(maskRegister), Register<1, false>(maskRegister));
+            code.Emit<OpCode::Neg>(maskRegister);
+
+            code.Emit<OpCode::Xor>(difference.GetDirectRegister(), base->GetDirectRegister());
+            code.Emit<OpCode::Mov>(result.GetDirectRegister(), maskRegister);
+            code.Emit<OpCode::And>(result.GetDirectRegister(), difference.GetDirectRegister());
+            code.Emit<OpCode::Xor>(result.GetDirectRegister(), base->GetDirectRegister());
+
+            return result;
+        }
+
+
+        // Selects between two bool constants with setcc, falls back to cmov
+        // for other bool values.
+        template <JccType JCC>
+        ExpressionTree::Storage<bool> SelectFlag(ExpressionTree& tree,
+                                                 ExpressionTree::Storage<bool>& trueValue,
+                                                 ExpressionTree::Storage<bool>& falseValue)
+        {
+            if (trueValue.GetStorageClass() == StorageClass::Immediate
+                && falseValue.GetStorageClass() == StorageClass::Immediate
+                && trueValue.GetImmediate() != falseValue.GetImmediate())
+            {
+                ExpressionTree::Storage<bool> result = tree.Direct<bool>();
+
+                if (trueValue.GetImmediate())
+                {
+                    tree.GetCodeGenerator().EmitConditionalSet<JCC>(result.GetDirectRegister());
+                }
+                else
+                {
+                    tree.GetCodeGenerator().EmitConditionalSet<InverseJcc<JCC>::value>(result.GetDirectRegister());
+                }
+
+                return result;
+            }
+
+            return SelectInteger<JCC>(tree, trueValue, falseValue);
+        }
+
+
+        template <JccType JCC, typename T>
+        ExpressionTree::Storage<T> SelectByType(ExpressionTree& tree,
+                                                ExpressionTree::Storage<T>& trueValue,
+                                                ExpressionTree::Storage<T>& falseValue,
+                                                std::true_type /* isFloat */)
+        {
+            return SelectFloat<JCC>(tree, trueValue, falseValue);
+        }
+
+
+        template <JccType JCC, typename T>
+        ExpressionTree::Storage<T> SelectByType(ExpressionTree& tree,
+                                                ExpressionTree::Storage<T>& trueValue,
+                                                ExpressionTree::Storage<T>& falseValue,
+                                                std::false_type /* isFloat */)
+        {
+            return SelectInteger<JCC>(tree, trueValue, falseValue);
+        }
+
+
+        template <JccType JCC>
+        ExpressionTree::Storage<bool> SelectByType(ExpressionTree& tree,
+                                                   ExpressionTree::Storage<bool>& trueValue,
+                                                   ExpressionTree::Storage<bool>& falseValue,
+                                                   std::false_type /* isFloat */)
+        {
+            return SelectFlag<JCC>(tree, trueValue, falseValue);
+        }
+
+
+        template <JccType JCC, typename T>
+        ExpressionTree::Storage<T> Select(ExpressionTree& tree,
+                                          ExpressionTree::Storage<T>& trueValue,
+                                          ExpressionTree::Storage<T>& falseValue)
+        {
+            return SelectByType<JCC>(tree,
+                                     trueValue,
+                                     falseValue,
+                                     std::is_floating_point<T>());
+        }
+
+
+        //
+        // Out of line code.
+        //
+
+        // A ColdBlock which moves the value of the storage into the register
+        // and jumps to the exit label. The location of the value at the time
+        // of the construction is captured rather than the storage itself, so
+        // the block doesn't keep the storage's register allocated until it's
+        // emitted. The block must be entered when the registers still hold
+        // what they held at the time of the construction, i.e. by a jump
+        // emitted right after the construction.
+        template <typename T>
+        class ColdMove : public ColdBlock
+        {
+        public:
+            typedef typename ExpressionTree::Storage<T>::DirectRegister RegisterType;
+
+            ColdMove(Label entry,
+                     Label exit,
+                     RegisterType dest,
+                     const ExpressionTree::Storage<T>& src);
+
+            virtual void Emit(X64CodeGenerator& code) override;
+
+        private:
+            typedef typename std::remove_const<T>::type ValueType;
+            typedef std::integral_constant<bool, CanBeInImmediateStorage<T>::value> IsImmediateAllowed;
+
+            void CaptureImmediate(const ExpressionTree::Storage<T>& src, std::true_type);
+            void CaptureImmediate(const ExpressionTree::Storage<T>& src, std::false_type);
+            void EmitImmediate(X64CodeGenerator& code, std::true_type);
+            void EmitImmediate(X64CodeGenerator& code, std::false_type);
+
+            const Label m_entry;
+            const Label m_exit;
+            const RegisterType m_dest;
+
+            StorageClass m_storageClass;
+            RegisterType m_direct;
+            PointerRegister m_base;
+            int32_t m_offset;
+            ValueType m_immediate;
+        };
+
+
+        template <typename T>
+        ColdMove<T>::ColdMove(Label entry,
+                              Label exit,
+                              RegisterType dest,
+                              const ExpressionTree::Storage<T>& src)
+            : m_entry(entry),
+              m_exit(exit),
+              m_dest(dest),
+              m_storageClass(src.GetStorageClass()),
+              m_offset(0),
+              m_immediate()
+        {
+            switch (m_storageClass)
+            {
+            case StorageClass::Immediate:
+                CaptureImmediate(src, IsImmediateAllowed());
+                break;
+            case StorageClass::Direct:
+                m_direct = src.GetDirectRegister();
+                break;
+            case StorageClass::Indirect:
+                m_base = src.GetBaseRegister();
+                m_offset = src.GetOffset();
+                break;
+            default:
+                LogThrowAbort("Invalid storage class.");
+            }
+        }
+
+
+        template <typename T>
+        void ColdMove<T>::Emit(X64CodeGenerator& code)
+        {
+            code.PlaceLabel(m_entry);
+
+            switch (m_storageClass)
+            {
+            case StorageClass::Immediate:
+                EmitImmediate(code, IsImmediateAllowed());
+                break;
+            case StorageClass::Direct:
+                if (!m_direct.IsSameHardwareRegister(m_dest))
+                {
+                    code.Emit<OpCode::Mov>(m_dest, m_direct);
+                }
+                break;
+            case StorageClass::Indirect:
+                code.Emit<OpCode::Mov>(m_dest, m_base, m_offset);
+                break;
+            default:
+                LogThrowAbort("Invalid storage class.");
+            }
+
+            code.Jmp(m_exit);
+        }
+
+
+        template <typename T>
+        void ColdMove<T>::CaptureImmediate(const ExpressionTree::Storage<T>& src, std::true_type)
+        {
+            m_immediate = src.GetImmediate();
+        }
+
+
+        template <typename T>
+        void ColdMove<T>::CaptureImmediate(const ExpressionTree::Storage<T>& /* src */, std::false_type)
+        {
+            LogThrowAbort("Invalid storage class.");
+        }
+
+
+        template <typename T>
+        void ColdMove<T>::EmitImmediate(X64CodeGenerator& code, std::true_type)
+        {
+            code.EmitImmediate<OpCode::Mov>(m_dest, m_immediate);
+        }
+
+
+        template <typename T>
+        void ColdMove<T>::EmitImmediate(X64CodeGenerator& /* code */, std::false_type)
+        {
+            LogThrowAbort("Invalid storage class.");
+        }
     }
 }
@@ -0,0 +1,193 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>                                   // For std::shared_ptr.
+#include <stddef.h>                                 // For ::size_t
+#include <unordered_map>
+#include <vector>
+
+#include "NativeJIT/CodeGen/CodeBuffer.h"           // Embedded member.
+#include "NativeJIT/CodeGen/FunctionBuffer.h"       // RUNTIME_FUNCTION embedded.
+#include "NativeJIT/StructuralKey.h"                // StructuralKey parameter.
+#include "Temporary/NonCopyable.h"
+
+
+namespace Allocators
+{
+    class IAllocator;
+}
+
+
+namespace NativeJIT
+{
+    // A copy of a compiled function that is independent of the FunctionBuffer
+    // it was compiled into. The code is placed into a block allocated from
+    // the code allocator and the block is returned to the allocator when
+    // the object is destroyed.
+    class CompiledCode : public NonCopyable
+    {
+    public:
+        // Copies the code of the function that has been compiled into the
+        // function buffer.
+        CompiledCode(Allocators::IAllocator& codeAllocator,
+                     FunctionBuffer const & code);
+
+        ~CompiledCode();
+
+        // Returns the entry point to the function. For code allocators that
+        // map the code twice, the entry point is in the executable view.
+        void const * GetEntryPoint() const;
+
+        // Returns the entry point cast to the function pointer type F.
+        template <typename F>
+        F GetEntryPoint() const;
+
+        // Returns the number of bytes of code (including static data and
+        // unwind information).
+        unsigned GetCodeByteSize() const;
+
+    private:
+        CodeBuffer m_code;
+        unsigned m_entryPointOffset;
+
+        // Structure used to register stack unwind information with Windows.
+        RUNTIME_FUNCTION m_runtimeFunction;
+    };
+
+
+    // A cache of compiled functions keyed by the structure of the expressions
+    // they were compiled from (see StructuralKey). The cache is bounded both by
+    // the number of entries and by the number of bytes used by the code and
+    // the keys. When either bound is exceeded, the least recently used entries
+    // are evicted.
+    //
+    // The code of the cached functions is allocated from the code allocator
+    // passed to the constructor (f. ex. a CodeHeap) and returned to it on
+    // eviction. Since the entries are reference counted, the code of an
+    // evicted entry is not released until all of its users are gone.
+    //
+    // The class is not thread safe.
+    class CompileCache : public NonCopyable
+    {
+    public:
+        typedef std::shared_ptr<CompiledCode const> Entry;
+
+        CompileCache(Allocators::IAllocator& codeAllocator,
+                     unsigned maxEntryCount,
+                     size_t maxByteSize);
+
+        // Returns the cached code for the key and marks it as the most recently
+        // used or an empty pointer if there is no such entry. Invalid keys are
+        // never found.
+        Entry Find(StructuralKey const & key);
+
+        // Copies the function compiled into the function buffer into the cache
+        // and returns the new entry, evicting the least recently used entries
+        // if needed. If the key is invalid or if the function alone exceeds
+        // the size limit, nothing is cached and an empty pointer is returned.
+        // The key must not be present in the cache.
+        Entry Add(StructuralKey const & key, FunctionBuffer const & code);
+
+        // Removes all entries from the cache. The counters are not reset.
+        void Clear();
+
+        unsigned GetEntryCount() const;
+
+        // Returns the number of bytes used by the cached code and keys.
+        size_t GetByteSize() const;
+
+        uint64_t GetHitCount() const;
+        uint64_t GetMissCount() const;
+        uint64_t GetEvictionCount() const;
+
+    private:
+        // The words of a key and its hash. Refers either to the key being
+        // looked up or to the copy of the words owned by an entry.
+        struct KeyView
+        {
+            uint64_t const * m_words;
+            size_t m_wordCount;
+            size_t m_hash;
+        };
+
+        struct CacheEntry
+        {
+            // The keys are allocated from the allocators of the expression
+            // trees, which the entries outlive, so the words are copied.
+            std::vector<uint64_t> m_words;
+            size_t m_hash;
+            Entry m_code;
+            size_t m_byteSize;
+        };
+
+        typedef std::list<CacheEntry> EntryList;
+
+        struct KeyViewHasher
+        {
+            size_t operator()(KeyView const & key) const;
+        };
+
+        struct KeyViewEqual
+        {
+            bool operator()(KeyView const & left, KeyView const & right) const;
+        };
+
+        static KeyView GetView(StructuralKey const & key);
+        static KeyView GetView(CacheEntry const & entry);
+
+        void EvictLeastRecentlyUsed();
+
+        Allocators::IAllocator& m_codeAllocator;
+        const unsigned m_maxEntryCount;
+        const size_t m_maxByteSize;
+
+        // Entries ordered from the most to the least recently used. The index
+        // refers to the words stored in the list.
+        EntryList m_entries;
+        std::unordered_map<KeyView,
+                           EntryList::iterator,
+                           KeyViewHasher,
+                           KeyViewEqual> m_index;
+
+        size_t m_byteSize;
+        uint64_t m_hitCount;
+        uint64_t m_missCount;
+        uint64_t m_evictionCount;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for CompiledCode
+    //
+    //*************************************************************************
+    template <typename F>
+    F CompiledCode::GetEntryPoint() const
+    {
+        return reinterpret_cast<F>(const_cast<void*>(GetEntryPoint()));
+    }
+}
@@ -0,0 +1,222 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <memory>                                   // For std::unique_ptr.
+#include <mutex>
+#include <vector>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"      // Embedded member.
+#include "NativeJIT/CodeGen/FunctionBuffer.h"       // Embedded member.
+#include "Temporary/Allocator.h"                    // Embedded member.
+#include "Temporary/NonCopyable.h"
+
+
+namespace NativeJIT
+{
+    // The resources needed to compile one function at a time: an arena
+    // allocator for the expression nodes and a FunctionBuffer with its own
+    // executable memory. Constructing these involves allocating memory from
+    // the heap and from the OS, whereas resetting them is cheap, so contexts
+    // are meant to be reused through CompileContextPool.
+    //
+    // The context also holds the Function<> returned by GetFunction(), so that
+    // the expression tree is not constructed again for every compile either.
+    // Resetting the context resets the function, see ExpressionTree::Reset().
+    //
+    // The class is not thread safe, but different contexts can be used
+    // concurrently from different threads.
+    class CompileContext : public NonCopyable
+    {
+    public:
+        CompileContext(unsigned allocatorCapacity, unsigned codeCapacity);
+
+        Allocators::IAllocator& GetAllocator();
+        FunctionBuffer& GetCode();
+
+        // Returns the Function<> of the specified type which is constructed
+        // on top of the context's allocator and code when first requested and
+        // is then reused. Requesting a different type of function destroys
+        // the current one and resets the context first. The function must not
+        // be mixed with other users of GetAllocator() since resetting the
+        // function resets the allocator.
+        template <typename FUNCTION>
+        FUNCTION& GetFunction();
+
+        // Frees all the nodes and the code allocated through the context.
+        // Any function compiled in the context becomes invalid.
+        void Reset();
+
+    private:
+        // Type-erased owner of the function returned by GetFunction().
+        class FunctionHolderBase : public NonCopyable
+        {
+        public:
+            virtual ~FunctionHolderBase();
+
+            virtual void Reset() = 0;
+        };
+
+        template <typename FUNCTION>
+        class FunctionHolder : public FunctionHolderBase
+        {
+        public:
+            FunctionHolder(Allocators::IAllocator& allocator, FunctionBuffer& code);
+
+            FUNCTION& GetFunction();
+
+            virtual void Reset() override;
+
+        private:
+            FUNCTION m_function;
+        };
+
+        Allocator m_allocator;
+        ExecutionBuffer m_codeAllocator;
+        FunctionBuffer m_code;
+
+        std::unique_ptr<FunctionHolderBase> m_function;
+    };
+
+
+    // A thread safe pool of compile contexts. Worker threads check a context
+    // out with Acquire(), get the context's Function<> and compile it.
+    // When the Lease returned by Acquire() goes out of scope, the context is
+    // reset and returned to the pool. Since the code compiled in the context
+    // is invalidated at that point, it needs to be copied elsewhere if it is
+    // to be used later, for example through a CompileCache.
+    //
+    // The pool creates the initial contexts in advance and creates additional
+    // ones on demand when all contexts are checked out.
+    class CompileContextPool : public NonCopyable
+    {
+    public:
+        // Exclusive ownership of a context checked out from the pool.
+        class Lease : public NonCopyable
+        {
+        public:
+            Lease(Lease&& other);
+            ~Lease();
+
+            CompileContext& GetContext() const;
+
+            Allocators::IAllocator& GetAllocator() const;
+            FunctionBuffer& GetCode() const;
+
+            // See CompileContext::GetFunction().
+            template <typename FUNCTION>
+            FUNCTION& GetFunction() const;
+
+        private:
+            friend class CompileContextPool;
+
+            Lease(CompileContextPool& pool, std::unique_ptr<CompileContext> context);
+
+            CompileContextPool* m_pool;
+            std::unique_ptr<CompileContext> m_context;
+        };
+
+        CompileContextPool(unsigned initialContextCount,
+                           unsigned allocatorCapacity,
+                           unsigned codeCapacity);
+
+        // Checks out an available context, creating a new one if needed.
+        Lease Acquire();
+
+        // Returns the number of contexts created by the pool so far.
+        unsigned GetContextCount() const;
+
+        // Returns the number of contexts that are not checked out.
+        unsigned GetAvailableContextCount() const;
+
+    private:
+        void Release(std::unique_ptr<CompileContext> context);
+
+        const unsigned m_allocatorCapacity;
+        const unsigned m_codeCapacity;
+
+        // Protects the members below.
+        mutable std::mutex m_mutex;
+
+        std::vector<std::unique_ptr<CompileContext>> m_availableContexts;
+        unsigned m_contextCount;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for CompileContext
+    //
+    //*************************************************************************
+    template <typename FUNCTION>
+    FUNCTION& CompileContext::GetFunction()
+    {
+        auto holder = dynamic_cast<FunctionHolder<FUNCTION>*>(m_function.get());
+
+        if (holder == nullptr)
+        {
+            m_function.reset();
+            Reset();
+
+            holder = new FunctionHolder<FUNCTION>(m_allocator, m_code);
+            m_function.reset(holder);
+        }
+
+        return holder->GetFunction();
+    }
+
+
+    template <typename FUNCTION>
+    CompileContext::FunctionHolder<FUNCTION>::FunctionHolder(Allocators::IAllocator& allocator,
+                                                             FunctionBuffer& code)
+        : m_function(allocator, code)
+    {
+    }
+
+
+    template <typename FUNCTION>
+    FUNCTION& CompileContext::FunctionHolder<FUNCTION>::GetFunction()
+    {
+        return m_function;
+    }
+
+
+    template <typename FUNCTION>
+    void CompileContext::FunctionHolder<FUNCTION>::Reset()
+    {
+        m_function.Reset();
+    }
+
+
+    //*************************************************************************
+    //
+    // Template definitions for CompileContextPool::Lease
+    //
+    //*************************************************************************
+    template <typename FUNCTION>
+    FUNCTION& CompileContextPool::Lease::GetFunction() const
+    {
+        return GetContext().template GetFunction<FUNCTION>();
+    }
+}
@@ -23,7 +23,9 @@
 
 #pragma once
 
+#include "NativeJIT/BranchProfile.h"
 #include "NativeJIT/CodeGen/X64CodeGenerator.h"
+#include "NativeJIT/CodeGenHelpers.h"
 #include "NativeJIT/ExpressionTree.h"
 #include "NativeJIT/Nodes/ConditionalNode.h"
 #include "NativeJIT/Nodes/ImmediateNode.h"
@@ -41,6 +43,15 @@ namespace NativeJIT
         // condition is satisfied. Otherwise, places an alternative fixed value
         // into the return register and jumps to function's epilog.
         virtual void Evaluate(ExpressionTree& tree) = 0;
+
+        // Describes the nodes and values used by the test to the builder.
+        // See NodeBase::DescribeStructure() for more information.
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const = 0;
+
+        // Interpreter counterpart of Evaluate(). Returns true if the regular
+        // flow should continue. Otherwise, sets the interpreter's result to
+        // the alternative fixed value and returns false.
+        virtual bool Interpret(Interpreter& interpreter) = 0;
     };
 
 
@@ -67,8 +78,14 @@ namespace NativeJIT
         // Overrides of ExecutionPreconditionTest.
         //
         virtual void Evaluate(ExpressionTree& tree) override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual bool Interpret(Interpreter& interpreter) override;
 
     private:
+        // Generates the code for the layout in which the regular flow falls
+        // through and the early return is moved out of line.
+        void EvaluateWithColdReturn(ExpressionTree& tree);
+
         FlagExpressionNode<JCC>& m_condition;
         ImmediateNode<T>& m_otherwiseValue;
     };
@@ -95,13 +112,36 @@ namespace NativeJIT
     template <typename T, JccType JCC>
     void ExecuteOnlyIfStatement<T, JCC>::Evaluate(ExpressionTree& tree)
     {
+        // If the condition is usually satisfied, the early return is moved
+        // out of line. Otherwise, the default layout already falls through
+        // to the early return.
+        if (tree.GetLayoutProfile() != nullptr
+            && tree.GetLayoutProfile()->GetPreconditionHotBranch(m_condition.GetId())
+               == BranchProfile::HotBranch::True)
+        {
+            EvaluateWithColdReturn(tree);
+            return;
+        }
+
         X64CodeGenerator& code = tree.GetCodeGenerator();
         Label continueWithRegularFlow = code.AllocateLabel();
 
-        // Evaluate the condition to update the CPU flags. If condition is
-        // satisfied, continue with the regular flow.
-        m_condition.CodeGenFlags(tree);
-        code.EmitConditionalJump<JCC>(continueWithRegularFlow);
+        BranchProfile::Counters* counters
+            = tree.GetInstrumentationProfile() != nullptr
+              ? &tree.GetInstrumentationProfile()->GetPreconditionCounters(m_condition.GetId())
+              : nullptr;
+        ProfileCounterEmitter counter(tree, counters != nullptr);
+
+        // Evaluate the condition. If it is satisfied, continue with the
+        // regular flow.
+        m_condition.CodeGenBranch(tree, continueWithRegularFlow, true);
+
+        // The counter is updated before the result register is set since
+        // the counter may use the result register.
+        if (counters != nullptr)
+        {
+            counter.EmitIncrement(counters->m_falseCount);
+        }
 
         // Otherwise, return early with the constant value: move the constant
         // into the return register and jump to epilog.
@@ -131,5 +171,52 @@ namespace NativeJIT
         code.Jmp(tree.GetStartOfEpilogue());
 
         code.PlaceLabel(continueWithRegularFlow);
+
+        if (counters != nullptr)
+        {
+            counter.EmitIncrement(counters->m_trueCount);
+        }
+    }
+
+
+    template <typename T, JccType JCC>
+    void ExecuteOnlyIfStatement<T, JCC>::EvaluateWithColdReturn(ExpressionTree& tree)
+    {
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+        Label returnEarly = code.AllocateLabel();
+
+        m_condition.CodeGenBranch(tree, returnEarly, false);
+
+        // See the comment in Evaluate() about ImmediateNode's CodeGen(),
+        // which emits no code, so the value is where it was at the jump.
+        auto otherwiseValue = m_otherwiseValue.CodeGen(tree);
+
+        tree.AddColdBlock(tree.PlacementConstruct<CodeGenHelpers::ColdMove<T>>(
+            returnEarly,
+            tree.GetStartOfEpilogue(),
+            tree.GetResultRegister<T>(),
+            otherwiseValue));
+    }
+
+
+    template <typename T, JccType JCC>
+    void ExecuteOnlyIfStatement<T, JCC>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_condition);
+        builder.AddNode(m_otherwiseValue);
+    }
+
+
+    template <typename T, JccType JCC>
+    bool ExecuteOnlyIfStatement<T, JCC>::Interpret(Interpreter& interpreter)
+    {
+        if (m_condition.Interpret(interpreter))
+        {
+            return true;
+        }
+
+        interpreter.SetResult(InterpreterValue<T>::ToWord(m_otherwiseValue.Interpret(interpreter)));
+
+        return false;
     }
 }
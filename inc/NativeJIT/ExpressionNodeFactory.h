@@ -32,23 +32,34 @@
 // Implementation includes
 //
 #include <cstdint>
+#include <typeinfo>
+#include <utility>                              // For std::forward.
 
 #include "NativeJIT/BitOperations.h"
 #include "NativeJIT/Nodes/BinaryImmediateNode.h"
 #include "NativeJIT/Nodes/BinaryNode.h"
+#include "NativeJIT/Nodes/BitBinaryNode.h"
+#include "NativeJIT/Nodes/BitUnaryNode.h"
 #include "NativeJIT/Nodes/CallNode.h"
 #include "NativeJIT/Nodes/CastNode.h"
 #include "NativeJIT/Nodes/ConditionalNode.h"
 #include "NativeJIT/Nodes/DependentNode.h"
 #include "NativeJIT/Nodes/FieldPointerNode.h"
+#include "NativeJIT/Nodes/FloatUnaryNode.h"
 #include "NativeJIT/Nodes/ImmediateNode.h"
 #include "NativeJIT/Nodes/IndirectNode.h"
+#include "NativeJIT/Nodes/LazyConditionalNode.h"
+#include "NativeJIT/Nodes/LeaNode.h"
+#include "NativeJIT/Nodes/LogicalNode.h"
+#include "NativeJIT/Nodes/MulDivNode.h"
 #include "NativeJIT/Nodes/Node.h"
 #include "NativeJIT/Nodes/PackedMinMaxNode.h"
 #include "NativeJIT/Nodes/ParameterNode.h"
+#include "NativeJIT/Nodes/ReduceNode.h"
 #include "NativeJIT/Nodes/ReturnNode.h"
 #include "NativeJIT/Nodes/ShldNode.h"
 #include "NativeJIT/Nodes/StackVariableNode.h"
+#include "NativeJIT/Nodes/SwitchNode.h"
 #include "Temporary/Allocator.h"
 
 
@@ -66,7 +77,7 @@ namespace NativeJIT
     template <typename T>
     ImmediateNode<T>& ExpressionNodeFactory::Immediate(T value)
     {
-        return PlacementConstruct<ImmediateNode<T>>(*this, value);
+        return InternedConstruct<ImmediateNode<T>>(value);
     }
 
 
@@ -105,7 +116,7 @@ namespace NativeJIT
     template <typename TO, typename FROM>
     Node<TO>& ExpressionNodeFactory::Cast(Node<FROM>& source)
     {
-        return PlacementConstruct<CastNode<TO, FROM>>(*this, source);
+        return InternedConstruct<CastNode<TO, FROM>>(source);
     }
 
 
@@ -160,7 +171,12 @@ namespace NativeJIT
     template <typename T>
     Node<T>& ExpressionNodeFactory::Deref(Node<T*>& pointer, int32_t index)
     {
-        return PlacementConstruct<IndirectNode<T>>(*this, pointer, index);
+        // The loads are not merged across the calls to impure functions,
+        // which may modify the memory.
+        StructuralKeyBuilder key(GetAllocator());
+        key.AddValue(m_impureCallCount);
+
+        return InternedConstruct<IndirectNode<T>>(key, pointer, index);
     }
 
 
@@ -179,7 +195,7 @@ namespace NativeJIT
                                    typename std::remove_const<OBJECT1>::type>::value,
                       "Mismatch between the provided object type and field's parent object type");
 
-        return PlacementConstruct<FieldPointerNode<OBJECT, FIELD>>(*this, object, field);
+        return InternedConstruct<FieldPointerNode<OBJECT, FIELD>>(object, field);
     }
 
 
@@ -198,6 +214,50 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Abs(Node<T>& value)
+    {
+        return FloatUnary<FloatUnaryOperation::Abs>(value);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Ceil(Node<T>& value)
+    {
+        return FloatUnary<FloatUnaryOperation::Ceil>(value);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Floor(Node<T>& value)
+    {
+        return FloatUnary<FloatUnaryOperation::Floor>(value);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Sqrt(Node<T>& value)
+    {
+        return FloatUnary<FloatUnaryOperation::Sqrt>(value);
+    }
+
+
+    template <FloatUnaryOperation OP, typename T>
+    Node<T>& ExpressionNodeFactory::FloatUnary(Node<T>& value)
+    {
+        static_assert(std::is_floating_point<T>::value, "The operation requires a floating point operand.");
+
+        if ((OP == FloatUnaryOperation::Ceil || OP == FloatUnaryOperation::Floor)
+            && !GetCodeGenerator().IsSupported(CpuFeature::Sse41))
+        {
+            // RoundSS/RoundSD are unavailable, round with the C++ function.
+            return Call(Immediate(&FloatUnaryNode<T, OP>::Apply), value);
+        }
+
+        return InternedConstruct<FloatUnaryNode<T, OP>>(value);
+    }
+
+
     //
     // Binary arithmetic operators
     //
@@ -232,31 +292,470 @@ namespace NativeJIT
     template <typename L, typename R>
     Node<L>& ExpressionNodeFactory::MulImmediate(Node<L>& left, R right)
     {
-        Node<L>* result;
+        // The product depends only on the lower bits of the factor, so the
+        // factor is reduced to the size of L and split into an odd part and
+        // a power of two. The odd parts 3, 5 and 9 and their pairwise products
+        // are multiplied by one or two lea instructions, 2^k + 1 and 2^k - 1
+        // by a shift and an add or a sub. The remaining factors use imul.
+        const uint64_t factor = Interpretation::OperandWord(right)
+                                & Interpretation::ValueMask<L>();
+
+        if (factor == 0)
+        {
+            return Immediate<L>(0);
+        }
+
+        // Note: not checking return value of GetLowestBitSet() as it's
+        // guaranteed to return an index when a bit is set.
+        unsigned shift;
+        BitOp::GetLowestBitSet(factor, &shift);
+
+        Node<L>* odd = MulByLeaFactors(left, factor >> shift);
 
-        if (right == 0)
+        if (odd != nullptr)
         {
-            result = &Immediate<L>(0);
+            return shift == 0 ? *odd : Shl(*odd, static_cast<uint8_t>(shift));
         }
-        else if (right == 1)
+
+        unsigned bitIndex;
+
+        if (BitOp::GetNonZeroBitCount(factor - 1) == 1)
         {
-            result = &left;
+            BitOp::GetLowestBitSet(factor - 1, &bitIndex);
+            return Add(Shl(left, static_cast<uint8_t>(bitIndex)), left);
         }
-        else if (BitOp::GetNonZeroBitCount(right) == 1)
+
+        if (BitOp::GetNonZeroBitCount(factor + 1) == 1
+            && BitOp::GetLowestBitSet(factor + 1, &bitIndex)
+            && bitIndex < 8 * sizeof(L))
         {
-            // Note: not checking return value of GetLowestBitSet() as it's
-            // guaranteed to return an index when a bit is set.
-            unsigned bitIndex;
-            BitOp::GetLowestBitSet(right, &bitIndex);
+            return Sub(Shl(left, static_cast<uint8_t>(bitIndex)), left);
+        }
+
+        return BinaryImmediate<OpCode::IMul>(left, right);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Max(Node<T>& left, Node<T>& right)
+    {
+        static_assert(std::is_floating_point<T>::value, "Max requires floating point operands.");
+
+        return Binary<OpCode::Max>(left, right);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Min(Node<T>& left, Node<T>& right)
+    {
+        static_assert(std::is_floating_point<T>::value, "Min requires floating point operands.");
+
+        return Binary<OpCode::Min>(left, right);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Div(Node<T>& left, Node<T>& right)
+    {
+        return Div(left, right, std::is_floating_point<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Div(Node<T>& left, Node<T>& right, std::true_type /* isFloat */)
+    {
+        return Binary<OpCode::Div>(left, right);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Div(Node<T>& left, Node<T>& right, std::false_type /* isFloat */)
+    {
+        return right.IsConstant()
+            ? DivImmediate(left, right.GetConstantValue())
+            : MulDiv<MulDivOperation::Div>(left, right, IsNarrowDivision<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::DivImmediate(Node<T>& left, T right)
+    {
+        static_assert(std::is_integral<T>::value, "Division requires integer operands.");
+        LogThrowAssert(right != 0, "Division by zero");
 
-            result = &Shl(left, static_cast<uint8_t>(bitIndex));
+        return DivImmediate(left, right, IsNarrowDivision<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::Mod(Node<T>& left, Node<T>& right)
+    {
+        return right.IsConstant()
+            ? ModImmediate(left, right.GetConstantValue())
+            : MulDiv<MulDivOperation::Mod>(left, right, IsNarrowDivision<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::ModImmediate(Node<T>& left, T right)
+    {
+        static_assert(std::is_integral<T>::value, "Division requires integer operands.");
+        LogThrowAssert(right != 0, "Division by zero");
+
+        return ModImmediate(left, right, IsNarrowDivision<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::MulHigh(Node<T>& left, Node<T>& right)
+    {
+        return InternedConstruct<MulDivNode<T, MulDivOperation::MulHigh>>(left, right);
+    }
+
+
+    template <BitUnaryOperation OP, typename T>
+    Node<T>& ExpressionNodeFactory::BitUnary(Node<T>& value, std::true_type /* isNarrow */)
+    {
+        static_assert(std::is_integral<T>::value, "The operation requires an integer operand.");
+
+        const uint32_t bitCount = 8 * sizeof(T);
+
+        switch (OP)
+        {
+        case BitUnaryOperation::ByteSwap:
+            // A byte is its own byte swap, the bytes of a word are swapped by
+            // rotating it by 8 bits.
+            return sizeof(T) == 1 ? value : Rol(value, static_cast<uint8_t>(8));
+
+        case BitUnaryOperation::LeadingZeroCount:
+            // Zero extension adds 32 - bitCount leading zeros.
+            return Cast<T>(Sub(LeadingZeroCount(ZeroExtendBits(value)),
+                               Immediate(32 - bitCount)));
+
+        case BitUnaryOperation::PopCount:
+            return Cast<T>(PopCount(ZeroExtendBits(value)));
+
+        default:
+            // The bit above the value limits the count for zero to bitCount.
+            return Cast<T>(TrailingZeroCount(Or(ZeroExtendBits(value),
+                                                Immediate(1u << bitCount))));
         }
-        else
+    }
+
+
+    template <BitUnaryOperation OP, typename T>
+    Node<T>& ExpressionNodeFactory::BitUnary(Node<T>& value, std::false_type /* isNarrow */)
+    {
+        static_assert(std::is_integral<T>::value, "The operation requires an integer operand.");
+
+        auto & code = GetCodeGenerator();
+        const T allOnes = static_cast<T>(~static_cast<T>(0));
+
+        switch (OP)
+        {
+        case BitUnaryOperation::LeadingZeroCount:
+            if (!code.IsSupported(CpuFeature::LZCnt))
+            {
+                // Copy the highest set bit into all lower ones, which leaves
+                // the leading zeros as the only zeros.
+                Node<T>* smeared = &value;
+
+                for (uint8_t shift = 1; shift < 8 * sizeof(T); shift *= 2)
+                {
+                    smeared = &Or(*smeared, Shr(*smeared, shift));
+                }
+
+                return PopCount(Sub(Immediate(allOnes), *smeared));
+            }
+            break;
+
+        case BitUnaryOperation::PopCount:
+            if (!code.IsSupported(CpuFeature::PopCnt))
+            {
+                return PopCountWithoutPopCnt(value);
+            }
+            break;
+
+        case BitUnaryOperation::TrailingZeroCount:
+            if (!code.IsSupported(CpuFeature::Bmi1))
+            {
+                // ~value & (value - 1) has the trailing zeros of the value
+                // set and the other bits cleared.
+                return PopCount(And(Sub(Immediate(allOnes), value),
+                                    Sub(value, Immediate(static_cast<T>(1)))));
+            }
+            break;
+
+        default:
+            // bswap is available on all x64 processors.
+            break;
+        }
+
+        return InternedConstruct<BitUnaryNode<T, OP>>(value);
+    }
+
+
+    template <BitBinaryOperation OP, typename T>
+    Node<T>& ExpressionNodeFactory::BitBinary(Node<T>& left, Node<T>& right, std::true_type /* isNarrow */)
+    {
+        static_assert(std::is_integral<T>::value, "The operation requires integer operands.");
+
+        // The upper bits of the zero extended operands are zero in the
+        // results, which are therefore the zero extended results for T. This
+        // includes bzhi with an index between the width of T and 32.
+        return Cast<T>(BitBinary<OP>(ZeroExtendBits(left),
+                                     ZeroExtendBits(right),
+                                     std::false_type()));
+    }
+
+
+    template <BitBinaryOperation OP, typename T>
+    Node<T>& ExpressionNodeFactory::BitBinary(Node<T>& left, Node<T>& right, std::false_type /* isNarrow */)
+    {
+        static_assert(std::is_integral<T>::value, "The operation requires integer operands.");
+
+        const CpuFeature feature = OP == BitBinaryOperation::AndNot
+            ? CpuFeature::Bmi1
+            : CpuFeature::Bmi2;
+
+        if (GetCodeGenerator().IsSupported(feature))
         {
-            result = &BinaryImmediate<OpCode::IMul>(left, right);
+            return InternedConstruct<BitBinaryNode<T, OP>>(left, right);
         }
 
-        return *result;
+        switch (OP)
+        {
+        case BitBinaryOperation::AndNot:
+            return And(Sub(Immediate(static_cast<T>(~static_cast<T>(0))), left), right);
+
+        case BitBinaryOperation::DepositBits:
+            return Call(Immediate(&Interpretation::ApplyDepositBits<T>), left, right);
+
+        case BitBinaryOperation::ExtractBits:
+            return Call(Immediate(&Interpretation::ApplyExtractBits<T>), left, right);
+
+        default:
+            return Call(Immediate(&Interpretation::ApplyZeroHighBits<T>), left, right);
+        }
+    }
+
+
+    template <typename T>
+    Node<ExpressionNodeFactory::BitOperationType<T>>&
+    ExpressionNodeFactory::ZeroExtendBits(Node<T>& value)
+    {
+        typedef typename std::make_unsigned<T>::type U;
+
+        // Casting a signed value directly would sign extend it.
+        return Cast<BitOperationType<T>>(Cast<U>(value));
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::PopCountWithoutPopCnt(Node<T>& value)
+    {
+        typedef typename std::make_unsigned<T>::type U;
+
+        const U c_pairs = static_cast<U>(0x5555555555555555ull);
+        const U c_nibblePairs = static_cast<U>(0x3333333333333333ull);
+        const U c_nibbles = static_cast<U>(0x0f0f0f0f0f0f0f0full);
+        const U c_bytes = static_cast<U>(0x0101010101010101ull);
+
+        // Each pair of bits holds the count of its set bits, then each nibble
+        // and each byte.
+        auto & pairs = Sub(value, And(Shr(value, static_cast<uint8_t>(1)),
+                                      Immediate(static_cast<T>(c_pairs))));
+        auto & nibbles = Add(And(pairs, Immediate(static_cast<T>(c_nibblePairs))),
+                             And(Shr(pairs, static_cast<uint8_t>(2)),
+                                 Immediate(static_cast<T>(c_nibblePairs))));
+        auto & bytes = And(Add(nibbles, Shr(nibbles, static_cast<uint8_t>(4))),
+                           Immediate(static_cast<T>(c_nibbles)));
+
+        // The multiplication adds up all byte counts in the highest byte.
+        return Shr(Mul(bytes, Immediate(static_cast<T>(c_bytes))),
+                   static_cast<uint8_t>(8 * sizeof(T) - 8));
+    }
+
+
+    template <MulDivOperation OP, typename T>
+    Node<T>& ExpressionNodeFactory::MulDiv(Node<T>& left, Node<T>& right, std::true_type /* isNarrow */)
+    {
+        typedef DivisionType<T> W;
+
+        return Cast<T>(InternedConstruct<MulDivNode<W, OP>>(Cast<W>(left), Cast<W>(right)));
+    }
+
+
+    template <MulDivOperation OP, typename T>
+    Node<T>& ExpressionNodeFactory::MulDiv(Node<T>& left, Node<T>& right, std::false_type /* isNarrow */)
+    {
+        return InternedConstruct<MulDivNode<T, OP>>(left, right);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::DivImmediate(Node<T>& left, T right, std::true_type /* isNarrow */)
+    {
+        typedef DivisionType<T> W;
+
+        return Cast<T>(DivImmediate(Cast<W>(left), static_cast<W>(right)));
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::DivImmediate(Node<T>& left, T right, std::false_type /* isNarrow */)
+    {
+        return DivByConstant(left, right, std::is_signed<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::ModImmediate(Node<T>& left, T right, std::true_type /* isNarrow */)
+    {
+        typedef DivisionType<T> W;
+
+        return Cast<T>(ModImmediate(Cast<W>(left), static_cast<W>(right)));
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::ModImmediate(Node<T>& left, T right, std::false_type /* isNarrow */)
+    {
+        const uint64_t divisor = static_cast<uint64_t>(right);
+
+        if (!std::is_signed<T>::value && BitOp::GetNonZeroBitCount(divisor) == 1)
+        {
+            return And(left, Immediate<T>(right - 1));
+        }
+
+        if (right == 1 || (std::is_signed<T>::value && right == static_cast<T>(-1)))
+        {
+            return Immediate<T>(0);
+        }
+
+        // The divisors outside of the range of imul's 32-bit immediate are
+        // multiplied through a register.
+        auto & quotient = DivImmediate(left, right);
+        const int64_t factor = static_cast<int64_t>(right);
+
+        if (factor != static_cast<int32_t>(factor))
+        {
+            return Sub(left, Mul(quotient, Immediate(right)));
+        }
+
+        return Sub(left, MulImmediate(quotient, static_cast<int32_t>(factor)));
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::DivByConstant(Node<T>& left, T right, std::false_type /* isSigned */)
+    {
+        const uint64_t divisor = right;
+        unsigned shift;
+
+        if (BitOp::GetNonZeroBitCount(divisor) == 1)
+        {
+            BitOp::GetLowestBitSet(divisor, &shift);
+            return Shr(left, static_cast<uint8_t>(shift));
+        }
+
+        const DivisionMagic magic = GetUnsignedDivisionMagic(divisor, 8 * sizeof(T));
+        auto & high = MulHigh(left, Immediate(static_cast<T>(magic.m_multiplier)));
+
+        if (!magic.m_isAddNeeded)
+        {
+            return Shr(high, static_cast<uint8_t>(magic.m_shift));
+        }
+
+        // The multiplier lacks its highest bit, i.e. the dividend itself
+        // needs to be added to the upper half of the product. The sum is
+        // computed as high + (left - high) / 2 to avoid the overflow, with
+        // the halving compensated in the final shift.
+        return Shr(Add(Shr(Sub(left, high), static_cast<uint8_t>(1)), high),
+                   static_cast<uint8_t>(magic.m_shift - 1));
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::DivByConstant(Node<T>& left, T right, std::true_type /* isSigned */)
+    {
+        const unsigned bitCount = 8 * sizeof(T);
+        const uint64_t magnitude = (right < 0 ? 0 - static_cast<uint64_t>(right)
+                                              : static_cast<uint64_t>(right))
+                                   & Interpretation::ValueMask<T>();
+
+        if (magnitude == 1)
+        {
+            return right > 0 ? left : Sub(Immediate<T>(0), left);
+        }
+
+        unsigned shift;
+
+        if (BitOp::GetNonZeroBitCount(magnitude) == 1)
+        {
+            // Shifting rounds toward negative infinity, so the negative
+            // dividends are biased by magnitude - 1 first.
+            BitOp::GetLowestBitSet(magnitude, &shift);
+
+            auto & bias = Shr(Sar(left, static_cast<uint8_t>(bitCount - 1)),
+                              static_cast<uint8_t>(bitCount - shift));
+            auto & quotient = Sar(Add(left, bias), static_cast<uint8_t>(shift));
+
+            return right > 0 ? quotient : Sub(Immediate<T>(0), quotient);
+        }
+
+        const DivisionMagic magic = GetSignedDivisionMagic(right, bitCount);
+        const T multiplier = static_cast<T>(magic.m_multiplier);
+        Node<T>* high = &MulHigh(left, Immediate(multiplier));
+
+        // The multipliers whose sign differs from the divisor's stand for
+        // the multiplier plus or minus 2^bitCount.
+        if (right > 0 && multiplier < 0)
+        {
+            high = &Add(*high, left);
+        }
+        else if (right < 0 && multiplier > 0)
+        {
+            high = &Sub(*high, left);
+        }
+
+        // Add one to the negative quotients to round them toward zero. The
+        // sign of the divisor is already accounted for by the multiplier.
+        auto & shifted = Sar(*high, static_cast<uint8_t>(magic.m_shift));
+
+        return Add(shifted, Shr(shifted, static_cast<uint8_t>(bitCount - 1)));
+    }
+
+
+    template <typename L>
+    Node<L>* ExpressionNodeFactory::MulByLeaFactors(Node<L>& left, uint64_t factor)
+    {
+        if (factor == 1)
+        {
+            return &left;
+        }
+
+        // Lea multiplies by 3, 5 or 9 by adding the value scaled by 2, 4 or
+        // 8 to itself.
+        for (uint8_t scale = 2; scale <= 8; scale *= 2)
+        {
+            if (factor == scale + 1u)
+            {
+                return &Lea(left, left, scale);
+            }
+        }
+
+        for (uint8_t scale = 2; scale <= 8; scale *= 2)
+        {
+            const uint64_t rest = factor / (scale + 1u);
+
+            if (factor % (scale + 1u) == 0 && (rest == 3 || rest == 5 || rest == 9))
+            {
+                return MulByLeaFactors(Lea(left, left, scale), rest);
+            }
+        }
+
+        return nullptr;
     }
 
 
@@ -274,6 +773,13 @@ namespace NativeJIT
     }
 
 
+    template <typename L, typename R>
+    Node<L>& ExpressionNodeFactory::Sar(Node<L>& left, R right)
+    {
+        return BinaryImmediate<OpCode::Sar>(left, right);
+    }
+
+
     template <typename L, typename R>
     Node<L>& ExpressionNodeFactory::Shl(Node<L>& left, R right)
     {
@@ -291,7 +797,14 @@ namespace NativeJIT
     template <typename T>
     Node<T>& ExpressionNodeFactory::Shld(Node<T>& shiftee, Node<T>& filler, uint8_t bitCount)
     {
-        return PlacementConstruct<ShldNode<T>>(*this, shiftee, filler, bitCount);
+        return InternedConstruct<ShldNode<T>>(shiftee, filler, bitCount);
+    }
+
+
+    template <typename T, typename INDEX>
+    Node<T>& ExpressionNodeFactory::Lea(Node<T>& base, Node<INDEX>& index, uint8_t scale)
+    {
+        return InternedConstruct<LeaNode<T, INDEX>>(base, index, scale);
     }
 
 
@@ -307,9 +820,19 @@ namespace NativeJIT
         // The IMul instruction doesn't suport 64-bit immediates, but there's
         // also no need to support types whose size is larger than UINT32_MAX.
         static_assert(sizeof(T) <= UINT32_MAX, "Unsupported type");
-        auto & offset = MulImmediate(index64, static_cast<uint32_t>(sizeof(T)));
 
-        return Binary<OpCode::Add>(array, offset);
+        // The largest SIB scale which divides the element size is applied by
+        // the lea which adds the offset to the array, the rest of the element
+        // size is multiplied beforehand.
+        const uint8_t scale = sizeof(T) % 8 == 0
+            ? 8
+            : sizeof(T) % 4 == 0
+                ? 4
+                : sizeof(T) % 2 == 0 ? 2 : 1;
+        auto & scaledIndex = MulImmediate(index64,
+                                          static_cast<uint32_t>(sizeof(T) / scale));
+
+        return Lea(array, scaledIndex, scale);
     }
 
 
@@ -320,6 +843,65 @@ namespace NativeJIT
     }
 
 
+    //
+    // Bit manipulation
+    //
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::PopCount(Node<T>& value)
+    {
+        return BitUnary<BitUnaryOperation::PopCount>(value, IsNarrowBitOperation<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::LeadingZeroCount(Node<T>& value)
+    {
+        return BitUnary<BitUnaryOperation::LeadingZeroCount>(value, IsNarrowBitOperation<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::TrailingZeroCount(Node<T>& value)
+    {
+        return BitUnary<BitUnaryOperation::TrailingZeroCount>(value, IsNarrowBitOperation<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::ByteSwap(Node<T>& value)
+    {
+        return BitUnary<BitUnaryOperation::ByteSwap>(value, IsNarrowBitOperation<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::AndNot(Node<T>& left, Node<T>& right)
+    {
+        return BitBinary<BitBinaryOperation::AndNot>(left, right, IsNarrowBitOperation<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::ExtractBits(Node<T>& value, Node<T>& mask)
+    {
+        return BitBinary<BitBinaryOperation::ExtractBits>(value, mask, IsNarrowBitOperation<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::DepositBits(Node<T>& value, Node<T>& mask)
+    {
+        return BitBinary<BitBinaryOperation::DepositBits>(value, mask, IsNarrowBitOperation<T>());
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::ZeroHighBits(Node<T>& value, Node<T>& bitIndex)
+    {
+        return BitBinary<BitBinaryOperation::ZeroHighBits>(value, bitIndex, IsNarrowBitOperation<T>());
+    }
+
+
     //
     // Model related
     //
@@ -338,7 +920,36 @@ namespace NativeJIT
     FlagExpressionNode<JCC>&
     ExpressionNodeFactory::Compare(Node<T>& left, Node<T>& right)
     {
-        return PlacementConstruct<RelationalOperatorNode<T, JCC>>(*this, left, right);
+        return InternedConstruct<RelationalOperatorNode<T, JCC>>(left, right);
+    }
+
+
+    //
+    // Logical operators
+    //
+    template <JccType LEFTJCC, JccType RIGHTJCC>
+    FlagExpressionNode<JccType::JNE>&
+    ExpressionNodeFactory::LogicalAnd(FlagExpressionNode<LEFTJCC>& left,
+                                      FlagExpressionNode<RIGHTJCC>& right)
+    {
+        return InternedConstruct<LogicalNode<OpCode::And, LEFTJCC, RIGHTJCC>>(left, right);
+    }
+
+
+    template <JccType LEFTJCC, JccType RIGHTJCC>
+    FlagExpressionNode<JccType::JNE>&
+    ExpressionNodeFactory::LogicalOr(FlagExpressionNode<LEFTJCC>& left,
+                                     FlagExpressionNode<RIGHTJCC>& right)
+    {
+        return InternedConstruct<LogicalNode<OpCode::Or, LEFTJCC, RIGHTJCC>>(left, right);
+    }
+
+
+    template <JccType JCC>
+    FlagExpressionNode<InverseJcc<JCC>::value>&
+    ExpressionNodeFactory::LogicalNot(FlagExpressionNode<JCC>& condition)
+    {
+        return InternedConstruct<LogicalNotNode<JCC>>(condition);
     }
 
 
@@ -350,7 +961,7 @@ namespace NativeJIT
                                                 Node<T>& trueValue,
                                                 Node<T>& falseValue)
     {
-        return PlacementConstruct<ConditionalNode<T, JCC>>(*this, condition, trueValue, falseValue);
+        return InternedConstruct<ConditionalNode<T, JCC>>(condition, trueValue, falseValue);
     }
 
 
@@ -370,13 +981,124 @@ namespace NativeJIT
     }
 
 
+    template <typename T, JccType JCC>
+    Node<T>& ExpressionNodeFactory::LazyConditional(FlagExpressionNode<JCC>& condition,
+                                                    Node<T>& trueValue,
+                                                    Node<T>& falseValue)
+    {
+        return InternedConstruct<LazyConditionalNode<T, JCC>>(condition, trueValue, falseValue);
+    }
+
+
+    template <typename CONDT, typename T>
+    Node<T>& ExpressionNodeFactory::LazyIfNotZero(Node<CONDT>& conditionValue, Node<T>& trueValue, Node<T>& falseValue)
+    {
+        auto & conditionNode = Compare<JccType::JNE>(conditionValue, Immediate<CONDT>(0));
+
+        return LazyConditional(conditionNode, trueValue, falseValue);
+    }
+
+
+    template <typename T>
+    Node<T>& ExpressionNodeFactory::LazyIf(Node<bool>& conditionValue, Node<T>& thenValue, Node<T>& elseValue)
+    {
+        return LazyIfNotZero(conditionValue, thenValue, elseValue);
+    }
+
+
+    //
+    // Loops
+    //
+    template <typename E>
+    ReduceElementNode<E>& ExpressionNodeFactory::ReduceElement()
+    {
+        // Never interned, each element is bound to its own loop.
+        return PlacementConstruct<ReduceElementNode<E>>(*this);
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    Node<T>& ExpressionNodeFactory::Reduce(Node<E*>& array,
+                                           Node<uint32_t>& count,
+                                           ReduceElementNode<E>& element,
+                                           Node<T>& body,
+                                           Node<T>& initial,
+                                           unsigned unrollCount)
+    {
+        return InternedConstruct<ReduceNode<OP, T, E>>(array,
+                                                       count,
+                                                       element,
+                                                       body,
+                                                       initial,
+                                                       unrollCount);
+    }
+
+
+    template <typename E, JccType JCC>
+    Node<uint32_t>& ExpressionNodeFactory::ReduceCount(Node<E*>& array,
+                                                       Node<uint32_t>& count,
+                                                       ReduceElementNode<E>& element,
+                                                       FlagExpressionNode<JCC>& predicate,
+                                                       unsigned unrollCount)
+    {
+        auto & matches = Conditional(predicate, Immediate<uint32_t>(1), Immediate<uint32_t>(0));
+
+        return Reduce<OpCode::Add>(array,
+                                   count,
+                                   element,
+                                   matches,
+                                   Immediate<uint32_t>(0),
+                                   unrollCount);
+    }
+
+
+    //
+    // Switch
+    //
+    template <typename T, typename S>
+    Node<T>& ExpressionNodeFactory::Switch(Node<S>& selector,
+                                           std::vector<S> const & keys,
+                                           std::vector<Node<T>*> const & cases,
+                                           Node<T>& defaultCase)
+    {
+        static_assert(std::is_integral<S>::value && !std::is_same<S, bool>::value,
+                      "The selector must be an integer.");
+
+        // The node dispatches on the selector extended to 64 bits.
+        typedef typename std::conditional<std::is_signed<S>::value, int64_t, uint64_t>::type W;
+
+        std::vector<W> wideKeys(keys.begin(), keys.end());
+
+        return InternedConstruct<SwitchNode<T, W>>(Cast<W>(selector),
+                                                   wideKeys,
+                                                   cases,
+                                                   defaultCase);
+    }
+
+
+    template <typename T, typename S>
+    Node<T>& ExpressionNodeFactory::Switch(Node<S>& selector,
+                                           std::vector<Node<T>*> const & cases,
+                                           Node<T>& defaultCase)
+    {
+        std::vector<S> keys(cases.size());
+
+        for (unsigned i = 0; i < keys.size(); ++i)
+        {
+            keys[i] = static_cast<S>(i);
+        }
+
+        return Switch(selector, keys, cases, defaultCase);
+    }
+
+
     //
     // Call external function
     //
     template <typename R>
     Node<R>& ExpressionNodeFactory::Call(Node<R (*)()>& function)
     {
-        return PlacementConstruct<CallNode<R>>(*this, function);
+        return CallConstruct<CallNode<R>>(function);
     }
 
 
@@ -384,7 +1106,7 @@ namespace NativeJIT
     Node<R>& ExpressionNodeFactory::Call(Node<R (*)(P1)>& function,
                                          Node<P1>& param1)
     {
-        return PlacementConstruct<CallNode<R, P1>>(*this, function, param1);
+        return CallConstruct<CallNode<R, P1>>(function, param1);
     }
 
 
@@ -393,7 +1115,7 @@ namespace NativeJIT
                                          Node<P1>& param1,
                                          Node<P2>& param2)
     {
-        return PlacementConstruct<CallNode<R, P1, P2>>(*this, function, param1, param2);
+        return CallConstruct<CallNode<R, P1, P2>>(function, param1, param2);
     }
 
 
@@ -403,7 +1125,7 @@ namespace NativeJIT
                                          Node<P2>& param2,
                                          Node<P3>& param3)
     {
-        return PlacementConstruct<CallNode<R, P1, P2, P3>>(*this, function, param1, param2, param3);
+        return CallConstruct<CallNode<R, P1, P2, P3>>(function, param1, param2, param3);
     }
 
 
@@ -414,8 +1136,8 @@ namespace NativeJIT
                                          Node<P3>& param3,
                                          Node<P4>& param4)
     {
-        return PlacementConstruct<CallNode<R, P1, P2, P3, P4>>(
-            *this, function, param1, param2, param3, param4);
+        return CallConstruct<CallNode<R, P1, P2, P3, P4>>(
+            function, param1, param2, param3, param4);
     }
 
 
@@ -425,14 +1147,14 @@ namespace NativeJIT
     template <typename PACKED>
     Node<PACKED>& ExpressionNodeFactory::PackedMax(Node<PACKED>& left, Node<PACKED>& right)
     {
-        return PlacementConstruct<PackedMinMaxNode<PACKED, true>>(*this, left, right);
+        return InternedConstruct<PackedMinMaxNode<PACKED, true>>(left, right);
     }
 
 
     template <typename PACKED>
     Node<PACKED>& ExpressionNodeFactory::PackedMin(Node<PACKED>& left, Node<PACKED>& right)
     {
-        return PlacementConstruct<PackedMinMaxNode<PACKED, false>>(*this, left, right);
+        return InternedConstruct<PackedMinMaxNode<PACKED, false>>(left, right);
     }
 
 
@@ -442,13 +1164,86 @@ namespace NativeJIT
     template <OpCode OP, typename L, typename R>
     Node<L>& ExpressionNodeFactory::Binary(Node<L>& left, Node<R>& right)
     {
-        return PlacementConstruct<BinaryNode<OP, L, R>>(*this, left, right);
+        return InternedConstruct<BinaryNode<OP, L, R>>(left, right);
     }
 
 
     template <OpCode OP, typename L, typename R>
     Node<L>& ExpressionNodeFactory::BinaryImmediate(Node<L>& left, R right)
     {
-        return PlacementConstruct<BinaryImmediateNode<OP, L, R>>(*this, left, right);
+        return InternedConstruct<BinaryImmediateNode<OP, L, R>>(left, right);
+    }
+
+
+    template <typename NODE, typename... ARGS>
+    NODE& ExpressionNodeFactory::InternedConstruct(ARGS&&... args)
+    {
+        StructuralKeyBuilder key(GetAllocator());
+
+        return InternedConstruct<NODE>(key, std::forward<ARGS>(args)...);
+    }
+
+
+    template <typename NODE, typename... ARGS>
+    NODE& ExpressionNodeFactory::InternedConstruct(StructuralKeyBuilder& key, ARGS&&... args)
+    {
+        if (!m_isNodeInterningEnabled)
+        {
+            return PlacementConstruct<NODE>(*this, std::forward<ARGS>(args)...);
+        }
+
+        // The elements of the braced list are evaluated in order.
+        key.AddType(typeid(NODE));
+        int expansion[] = { 0, (DescribeArgument(key, args), 0)... };
+        static_cast<void>(expansion);
+
+        auto it = m_internedNodes.find(key.GetKey());
+
+        if (it != m_internedNodes.end())
+        {
+            ++m_internedNodeCount;
+
+            // The key includes the type of the node.
+            return static_cast<NODE&>(*it->second);
+        }
+
+        NODE& node = PlacementConstruct<NODE>(*this, std::forward<ARGS>(args)...);
+        m_internedNodes.emplace(key.TakeKey(), &node);
+
+        return node;
+    }
+
+
+    template <typename NODE, typename F, typename... ARGS>
+    NODE& ExpressionNodeFactory::CallConstruct(Node<F>& function, ARGS&... args)
+    {
+        if (m_pureFunctions.find(function.GetId()) != m_pureFunctions.end())
+        {
+            return InternedConstruct<NODE>(function, args...);
+        }
+
+        ++m_impureCallCount;
+
+        return PlacementConstruct<NODE>(*this, function, args...);
+    }
+
+
+    template <typename T>
+    typename std::enable_if<!std::is_base_of<NodeBase, T>::value>::type
+    ExpressionNodeFactory::DescribeArgument(StructuralKeyBuilder& key, T const & value)
+    {
+        key.AddValue(value);
+    }
+
+
+    template <typename T>
+    void ExpressionNodeFactory::DescribeArgument(StructuralKeyBuilder& key, std::vector<T> const & values)
+    {
+        key.AddValue(values.size());
+
+        for (auto const & value : values)
+        {
+            DescribeArgument(key, value);
+        }
     }
 }
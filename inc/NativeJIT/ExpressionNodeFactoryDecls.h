@@ -24,18 +24,31 @@
 #pragma once
 
 #include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-#include "NativeJIT/CodeGen/X64CodeGenerator.h" // JccType.
+#include "NativeJIT/CodeGen/X64CodeGenerator.h" // JccType, InverseJcc.
 #include "NativeJIT/ExpressionTreeDecls.h"      // Base class.
 #include "NativeJIT/Model.h"                    // Parameter.
 #include "NativeJIT/Nodes/ImmediateNodeDecls.h" // Parameter too cumbersome to forward declare.
+#include "NativeJIT/StructuralKey.h"            // Embedded member.
 
 
 namespace NativeJIT
 {
+    enum class BitBinaryOperation;
+
+    enum class BitUnaryOperation;
+
     template <JccType JCC>
     class FlagExpressionNode;
 
+    enum class FloatUnaryOperation;
+
+    enum class MulDivOperation;
+
     template <typename T>
     class Node;
 
@@ -46,11 +59,42 @@ namespace NativeJIT
     template <typename T>
     class ParameterNode;
 
+    template <typename E>
+    class ReduceElementNode;
+
     class ExpressionNodeFactory : public ExpressionTree
     {
     public:
         ExpressionNodeFactory(Allocators::IAllocator& allocator, FunctionBuffer& code);
 
+        // Returns the factory to the state right after construction, see
+        // ExpressionTree::Reset().
+        void Reset();
+
+        //
+        // Node interning
+        //
+
+        // When node interning (hash-consing) is enabled, requesting a node
+        // with the same kind, children and values as an existing node returns
+        // the existing node instead of constructing a new one, so duplicate
+        // subexpressions are evaluated only once. Parameters, stack variables,
+        // dependent and return nodes are never interned, and neither are the
+        // calls unless the function is marked pure. Interning is enabled by
+        // default and the setting only affects the nodes created afterwards.
+        void EnableNodeInterning();
+        void DisableNodeInterning();
+
+        // Marks the function as free of side effects, so that the calls to it
+        // with the same arguments are interned. The calls to the other
+        // functions are assumed to modify memory: the memory loads created
+        // after such call are not merged with the loads created before it.
+        void MarkPure(NodeBase& function);
+
+        // Returns the number of requested nodes that were satisfied by an
+        // existing node.
+        unsigned GetInternedNodeCount() const;
+
         //
         // Leaf nodes
         //
@@ -104,6 +148,14 @@ namespace NativeJIT
 
         template <typename T> NodeBase& Return(Node<T>& value);
 
+        // Floating point absolute value, rounding toward negative and positive
+        // infinity and square root. Floor and Ceil call std::floor() and
+        // std::ceil() on processors without SSE4.1.
+        template <typename T> Node<T>& Abs(Node<T>& value);
+        template <typename T> Node<T>& Ceil(Node<T>& value);
+        template <typename T> Node<T>& Floor(Node<T>& value);
+        template <typename T> Node<T>& Sqrt(Node<T>& value);
+
 
         //
         // Binary arithmetic operators
@@ -114,10 +166,31 @@ namespace NativeJIT
         template <typename L, typename R> Node<L>& MulImmediate(Node<L>& left, R right);
         template <typename L, typename R> Node<L>& Or(Node<L>& left, Node<R>& right);
         template <typename L, typename R> Node<L>& Rol(Node<L>& left, R right);
+        template <typename L, typename R> Node<L>& Sar(Node<L>& left, R right);
         template <typename L, typename R> Node<L>& Shl(Node<L>& left, R right);
         template <typename L, typename R> Node<L>& Shr(Node<L>& left, R right);
         template <typename L, typename R> Node<L>& Sub(Node<L>& left, Node<R>& right);
 
+        // Floating point minimum and maximum. As MinSS/SD and MaxSS/SD, they
+        // return the right operand if either operand is NaN.
+        template <typename T> Node<T>& Max(Node<T>& left, Node<T>& right);
+        template <typename T> Node<T>& Min(Node<T>& left, Node<T>& right);
+
+        // Floating point division, or integer division and remainder, signed
+        // or unsigned according to T. As in C++, the integer quotient is
+        // rounded toward zero and the remainder has the sign of the dividend.
+        // Constant integer divisors are replaced by a multiplication by their
+        // reciprocal and shifts, the others use div/idiv. Integer operands
+        // narrower than 32 bits are divided as 32-bit ones.
+        template <typename T> Node<T>& Div(Node<T>& left, Node<T>& right);
+        template <typename T> Node<T>& DivImmediate(Node<T>& left, T right);
+        template <typename T> Node<T>& Mod(Node<T>& left, Node<T>& right);
+        template <typename T> Node<T>& ModImmediate(Node<T>& left, T right);
+
+        // Returns the upper half of the double-width product of two 32 or
+        // 64-bit integers.
+        template <typename T> Node<T>& MulHigh(Node<T>& left, Node<T>& right);
+
         template <typename T, size_t SIZE, typename INDEX>
         Node<T*>& Add(Node<T(*)[SIZE]>& array, Node<INDEX>& index);
 
@@ -128,6 +201,39 @@ namespace NativeJIT
         template <typename T>
         Node<T>& Shld(Node<T>& shiftee, Node<T>& filler, uint8_t bitCount);
 
+        // Returns base + index * scale computed by a single lea. The scale
+        // must be 1, 2, 4 or 8.
+        template <typename T, typename INDEX>
+        Node<T>& Lea(Node<T>& base, Node<INDEX>& index, uint8_t scale);
+
+        //
+        // Bit manipulation
+        //
+
+        // Return the number of set bits, leading zeros and trailing zeros of
+        // the integer, the counts of zeros being its width for zero, and the
+        // integer with the order of its bytes reversed. They use popcnt,
+        // lzcnt and tzcnt when the code generator supports the instructions
+        // (see X64CodeGenerator::IsSupported()) and equivalent shifts and
+        // masks otherwise. The values narrower than 32 bits are zero extended.
+        template <typename T> Node<T>& PopCount(Node<T>& value);
+        template <typename T> Node<T>& LeadingZeroCount(Node<T>& value);
+        template <typename T> Node<T>& TrailingZeroCount(Node<T>& value);
+        template <typename T> Node<T>& ByteSwap(Node<T>& value);
+
+        // Return ~left & right (andn), the bits of the value selected by the
+        // mask packed into the low bits (pext), the low bits of the value
+        // scattered to the positions of the bits set in the mask (pdep) and
+        // the value with the bits from the index up cleared (bzhi), where the
+        // index is the lowest byte of bitIndex and values at or above the
+        // width of T leave the value unchanged. Without BMI1, AndNot() is
+        // computed by a subtraction and an and. Without BMI2, the others call
+        // the portable implementations from the Interpretation namespace.
+        template <typename T> Node<T>& AndNot(Node<T>& left, Node<T>& right);
+        template <typename T> Node<T>& ExtractBits(Node<T>& value, Node<T>& mask);
+        template <typename T> Node<T>& DepositBits(Node<T>& value, Node<T>& mask);
+        template <typename T> Node<T>& ZeroHighBits(Node<T>& value, Node<T>& bitIndex);
+
         //
         // Model related.
         //
@@ -141,28 +247,124 @@ namespace NativeJIT
         FlagExpressionNode<JCC>& Compare(Node<T>& left, Node<T>& right);
 
 
+        //
+        // Logical operators
+        //
+
+        // The right condition is evaluated only if the left one doesn't
+        // decide the result, together with the nodes which are used only by
+        // it, so it may rely on the left condition, f. ex. on a pointer not
+        // being null. The nodes shared with the rest of the tree are still
+        // evaluated up front.
+        template <JccType LEFTJCC, JccType RIGHTJCC>
+        FlagExpressionNode<JccType::JNE>& LogicalAnd(FlagExpressionNode<LEFTJCC>& left,
+                                                     FlagExpressionNode<RIGHTJCC>& right);
+
+        template <JccType LEFTJCC, JccType RIGHTJCC>
+        FlagExpressionNode<JccType::JNE>& LogicalOr(FlagExpressionNode<LEFTJCC>& left,
+                                                    FlagExpressionNode<RIGHTJCC>& right);
+
+        template <JccType JCC>
+        FlagExpressionNode<InverseJcc<JCC>::value>& LogicalNot(FlagExpressionNode<JCC>& condition);
+
+
         //
         // Conditional operators
         //
 
         // WARNING: Both trueValue and falseValue are evaluated before testing the
         // condition so both must be legal to evaluate regardless of the result
-        // of the condition. See the TODO note in ConditionalNode::CodeGenValue.
+        // of the condition. Use LazyConditional() and related methods otherwise.
         template <typename T, JccType JCC>
         Node<T>& Conditional(FlagExpressionNode<JCC>& condition, Node<T>& trueValue, Node<T>& falseValue);
 
         // WARNING: Both trueValue and falseValue are evaluated before testing the
         // condition so both must be legal to evaluate regardless of the result
-        // of the condition. See the TODO note in ConditionalNode::CodeGenValue.
+        // of the condition. Use LazyConditional() and related methods otherwise.
         template <typename CONDT, typename T>
         Node<T>& IfNotZero(Node<CONDT>& conditionValue, Node<T>& trueValue, Node<T>& falseValue);
 
         // WARNING: Both thenValue and elseValue are evaluated before testing the
         // condition so both must be legal to evaluate regardless of the result
-        // of the condition. See the TODO note in ConditionalNode::CodeGenValue.
+        // of the condition. Use LazyConditional() and related methods otherwise.
         template <typename T>
         Node<T>& If(Node<bool>& conditionValue, Node<T>& thenValue, Node<T>& elseValue);
 
+        // Lazily evaluated counterparts of the methods above: only the value
+        // selected by the condition is evaluated, together with the nodes
+        // which are used only by it. The values may therefore rely on the
+        // condition, f. ex. dereference a pointer only if it's not null.
+        // The nodes shared with the other value or with the rest of the tree
+        // are still evaluated up front. The eager methods generate shorter
+        // code for cheap values.
+        template <typename T, JccType JCC>
+        Node<T>& LazyConditional(FlagExpressionNode<JCC>& condition, Node<T>& trueValue, Node<T>& falseValue);
+
+        template <typename CONDT, typename T>
+        Node<T>& LazyIfNotZero(Node<CONDT>& conditionValue, Node<T>& trueValue, Node<T>& falseValue);
+
+        template <typename T>
+        Node<T>& LazyIf(Node<bool>& conditionValue, Node<T>& thenValue, Node<T>& elseValue);
+
+
+        //
+        // Loops
+        //
+
+        // Returns the pointer to the current element of the array for use in
+        // the body of a single Reduce() node.
+        template <typename E>
+        ReduceElementNode<E>& ReduceElement();
+
+        // Combines the initial value with the values of the body evaluated
+        // for each of the count elements of the array in a loop. OP is Add,
+        // Min or Max. The body refers to the element through the node returned
+        // by ReduceElement(). The nodes used only by the body are evaluated
+        // once per element, the nodes shared with the rest of the tree once,
+        // before the loop. If unrollCount is greater than one, the body is
+        // copied that many times to process the elements in groups, which
+        // changes the order in which floating point values are added.
+        template <OpCode OP, typename T, typename E>
+        Node<T>& Reduce(Node<E*>& array,
+                        Node<uint32_t>& count,
+                        ReduceElementNode<E>& element,
+                        Node<T>& body,
+                        Node<T>& initial,
+                        unsigned unrollCount = 1);
+
+        // Returns the number of elements for which the predicate holds.
+        template <typename E, JccType JCC>
+        Node<uint32_t>& ReduceCount(Node<E*>& array,
+                                    Node<uint32_t>& count,
+                                    ReduceElementNode<E>& element,
+                                    FlagExpressionNode<JCC>& predicate,
+                                    unsigned unrollCount = 1);
+
+
+        //
+        // Switch
+        //
+
+        // Evaluates the case at the position of the key which equals the
+        // selector or the default case if no key does. Like
+        // LazyConditional(), evaluates only the selected case. Several keys
+        // may map to the same case. The keys which are close to each other
+        // are dispatched through a jump table, the sparse ones by a binary
+        // search.
+        template <typename T, typename S>
+        Node<T>& Switch(Node<S>& selector,
+                        std::vector<S> const & keys,
+                        std::vector<Node<T>*> const & cases,
+                        Node<T>& defaultCase);
+
+        // Evaluates the case at the index equal to the selector, f. ex. for
+        // the enumerations whose values start at zero, or the default case
+        // if the selector is out of range.
+        template <typename T, typename S>
+        Node<T>& Switch(Node<S>& selector,
+                        std::vector<Node<T>*> const & cases,
+                        Node<T>& defaultCase);
+
 
         //
         // Call node
@@ -202,5 +404,140 @@ namespace NativeJIT
     private:
         template <OpCode OP, typename L, typename R> Node<L>& Binary(Node<L>& left, Node<R>& right);
         template <OpCode OP, typename L, typename R> Node<L>& BinaryImmediate(Node<L>& left, R right);
+
+        // Returns the product of the node and the odd factor if the factor is
+        // 1, 3, 5, 9 or a product of two of the latter, which one or two lea
+        // instructions can compute, or nullptr otherwise.
+        template <typename L> Node<L>* MulByLeaFactors(Node<L>& left, uint64_t factor);
+
+        // The 32-bit type in which the operands narrower than 32 bits are
+        // divided, or T itself.
+        template <typename T>
+        using DivisionType = typename std::conditional<
+            (sizeof(T) < 4),
+            typename std::conditional<std::is_signed<T>::value, int32_t, uint32_t>::type,
+            T>::type;
+
+        template <typename T>
+        using IsNarrowDivision = std::integral_constant<bool, (sizeof(T) < 4)>;
+
+        template <typename T> Node<T>& Div(Node<T>& left, Node<T>& right, std::true_type /* isFloat */);
+        template <typename T> Node<T>& Div(Node<T>& left, Node<T>& right, std::false_type /* isFloat */);
+
+        template <FloatUnaryOperation OP, typename T>
+        Node<T>& FloatUnary(Node<T>& value);
+
+        // The 32-bit unsigned type to which the operands of the bit
+        // manipulation narrower than 32 bits are zero extended, or T itself.
+        template <typename T>
+        using BitOperationType = typename std::conditional<(sizeof(T) < 4), uint32_t, T>::type;
+
+        template <typename T>
+        using IsNarrowBitOperation = std::integral_constant<bool, (sizeof(T) < 4)>;
+
+        template <BitUnaryOperation OP, typename T>
+        Node<T>& BitUnary(Node<T>& value, std::true_type /* isNarrow */);
+
+        template <BitUnaryOperation OP, typename T>
+        Node<T>& BitUnary(Node<T>& value, std::false_type /* isNarrow */);
+
+        template <BitBinaryOperation OP, typename T>
+        Node<T>& BitBinary(Node<T>& left, Node<T>& right, std::true_type /* isNarrow */);
+
+        template <BitBinaryOperation OP, typename T>
+        Node<T>& BitBinary(Node<T>& left, Node<T>& right, std::false_type /* isNarrow */);
+
+        // Returns the value of type T zero extended to BitOperationType<T>.
+        template <typename T>
+        Node<BitOperationType<T>>& ZeroExtendBits(Node<T>& value);
+
+        // Returns the number of bits set in the 32 or 64-bit value, computed
+        // by adding up the counts of adjacent bit fields and summing the byte
+        // counts with a multiplication as described in chapter 5 of Hacker's
+        // Delight by H. S. Warren. Used on processors without popcnt.
+        template <typename T>
+        Node<T>& PopCountWithoutPopCnt(Node<T>& value);
+
+        template <MulDivOperation OP, typename T>
+        Node<T>& MulDiv(Node<T>& left, Node<T>& right, std::true_type /* isNarrow */);
+
+        template <MulDivOperation OP, typename T>
+        Node<T>& MulDiv(Node<T>& left, Node<T>& right, std::false_type /* isNarrow */);
+
+        template <typename T> Node<T>& DivImmediate(Node<T>& left, T right, std::true_type /* isNarrow */);
+        template <typename T> Node<T>& DivImmediate(Node<T>& left, T right, std::false_type /* isNarrow */);
+        template <typename T> Node<T>& ModImmediate(Node<T>& left, T right, std::true_type /* isNarrow */);
+        template <typename T> Node<T>& ModImmediate(Node<T>& left, T right, std::false_type /* isNarrow */);
+
+        // Return the quotient of the division of 32 or 64-bit values by a
+        // constant computed by the multiplication by the reciprocal.
+        template <typename T> Node<T>& DivByConstant(Node<T>& left, T right, std::true_type /* isSigned */);
+        template <typename T> Node<T>& DivByConstant(Node<T>& left, T right, std::false_type /* isSigned */);
+
+        // The multiplier and the shift which replace the division of bitCount
+        // wide integers by a constant which is not a power of two, computed
+        // as described in chapter 10 of Hacker's Delight by H. S. Warren.
+        // The quotient is the upper half of the product of the dividend and
+        // the multiplier shifted right by m_shift bits. The unsigned
+        // multipliers that need bitCount + 1 bits have the highest bit
+        // dropped and m_isAddNeeded set, the code then adds the dividend to
+        // the product.
+        struct DivisionMagic
+        {
+            uint64_t m_multiplier;
+            unsigned m_shift;
+            bool m_isAddNeeded;
+        };
+
+        static DivisionMagic GetUnsignedDivisionMagic(uint64_t divisor, unsigned bitCount);
+        static DivisionMagic GetSignedDivisionMagic(int64_t divisor, unsigned bitCount);
+
+        // Constructs the node unless an equal node has already been constructed
+        // and interning is enabled. The node is described by its type and the
+        // constructor arguments, with the nodes among them described by their
+        // identity.
+        template <typename NODE, typename... ARGS>
+        NODE& InternedConstruct(ARGS&&... args);
+
+        // Like InternedConstruct(), but also adds the values already described
+        // by the key to the description.
+        template <typename NODE, typename... ARGS>
+        NODE& InternedConstruct(StructuralKeyBuilder& key, ARGS&&... args);
+
+        // Constructs the call node, which is interned only if the function
+        // is pure.
+        template <typename NODE, typename F, typename... ARGS>
+        NODE& CallConstruct(Node<F>& function, ARGS&... args);
+
+        static void DescribeArgument(StructuralKeyBuilder& key, NodeBase const & node);
+
+        template <typename T>
+        static typename std::enable_if<!std::is_base_of<NodeBase, T>::value>::type
+        DescribeArgument(StructuralKeyBuilder& key, T const & value);
+
+        template <typename T>
+        static void DescribeArgument(StructuralKeyBuilder& key, std::vector<T> const & values);
+
+        typedef std::unordered_map<StructuralKey,
+                                   NodeBase*,
+                                   StructuralKey::Hasher,
+                                   std::equal_to<StructuralKey>,
+                                   Allocators::StlAllocator<std::pair<StructuralKey const, NodeBase*>>>
+            InternedNodeMap;
+
+        typedef std::unordered_set<unsigned,
+                                   std::hash<unsigned>,
+                                   std::equal_to<unsigned>,
+                                   Allocators::StlAllocator<unsigned>>
+            FunctionIdSet;
+
+        bool m_isNodeInterningEnabled;
+        unsigned m_internedNodeCount;
+        InternedNodeMap m_internedNodes;
+
+        // IDs of the function nodes marked by MarkPure() and the number of
+        // calls made to the other functions so far.
+        FunctionIdSet m_pureFunctions;
+        unsigned m_impureCallCount;
     };
 }
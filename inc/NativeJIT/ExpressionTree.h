@@ -33,6 +33,7 @@
 //
 #include <algorithm>    // For std::find.
 #include <iostream>     // Debugging output.
+#include <new>          // For placement new.
 
 #include "NativeJIT/BitOperations.h"
 #include "NativeJIT/CodeGen/CallingConvention.h"
@@ -105,7 +106,12 @@ namespace NativeJIT
         }
         else
         {
-            const unsigned id = freeList.GetAllocatedSpillable();
+            const unsigned id = m_registerAllocation == RegisterAllocation::NextUseSpilling
+                ? freeList.GetAllocatedSpillable([this](Data const * data)
+                  {
+                      return GetNextUse(data->GetDefiningNode());
+                  })
+                : freeList.GetAllocatedSpillable();
             direct = Direct<T>(typename Storage<T>::DirectRegister(id));
         }
 
@@ -195,20 +201,20 @@ namespace NativeJIT
         static_assert(sizeof(T) <= sizeof(void*),
                       "The size of the variable is too large.");
 
-        int32_t slot;
+        // Note: FunctionSpecification will throw if too much stack gets allocated.
+        const int32_t offset = AllocateTemporary(1, false);
 
-        if (m_temporaries.size() > 0)
-        {
-            slot = m_temporaries.back();
-            m_temporaries.pop_back();
-        }
-        else
-        {
-            // Note: FunctionSpecification will throw if too much stack gets allocated.
-            slot = m_temporaryCount++;
-        }
+        return Storage<T>::ForSharedBaseRegister(*this, GetBasePointer(), offset);
+    }
+
+
+    template <typename T>
+    ExpressionTree::Storage<T> ExpressionTree::XmmTemporary()
+    {
+        static_assert(RegisterStorage<T>::c_isFloat,
+                      "XMM temporaries are meant for floating point values.");
 
-        const int32_t offset = TemporarySlotToOffset(slot);
+        const int32_t offset = AllocateTemporary(2, true);
 
         return Storage<T>::ForSharedBaseRegister(*this, GetBasePointer(), offset);
     }
@@ -260,6 +266,38 @@ namespace NativeJIT
     }
 
 
+    template <typename FULLTYPE>
+    void ExpressionTree::MoveToRegister(Data* data, unsigned registerId)
+    {
+        typedef typename Storage<FULLTYPE>::DirectRegister DirectRegister;
+
+        Storage<FULLTYPE> value(data);
+
+        if (value.GetStorageClass() == StorageClass::Direct
+            && value.GetDirectRegister().GetId() == registerId)
+        {
+            return;
+        }
+
+        // Bump whatever the code on the path left in the register, then move
+        // the value there. After the swap, target refers to the location the
+        // value was moved to on the path and releases it.
+        auto target = Direct<FULLTYPE>(DirectRegister(registerId));
+        CodeGenHelpers::Emit<OpCode::Mov>(GetCodeGenerator(),
+                                          target.GetDirectRegister(),
+                                          value);
+        value.Swap(target, Storage<FULLTYPE>::SwapType::AllReferences);
+    }
+
+
+    template <typename T>
+    void ExpressionTree::RecreateVector(AllocatorVector<T>& vector,
+                                        Allocators::IAllocator& allocator)
+    {
+        new (&vector) AllocatorVector<T>(Allocators::StlAllocator<T>(allocator));
+    }
+
+
     //*************************************************************************
     //
     // Template definitions for ExpressionTree::Data
@@ -273,7 +311,13 @@ namespace NativeJIT
           m_isFloat(ISFLOAT),
           m_registerId(r.GetId()),
           m_offset(0),
-          m_refCount(0)
+          m_refCount(0),
+          m_definingNode(c_unknownNode),
+          m_creationIndex(tree.m_dataCount++),
+          m_hasFloatTarget(false),
+          m_rematerializeFrom(StorageClass::Direct),
+          m_rematerializeImmediate(0),
+          m_rematerializeOffset(0)
     {
         NotifyDataRegisterChange(RegisterChangeType::Initialize);
     }
@@ -287,7 +331,13 @@ namespace NativeJIT
           m_isFloat(false),
           m_registerId(0),
           m_offset(0),
-          m_refCount(0)
+          m_refCount(0),
+          m_definingNode(c_unknownNode),
+          m_creationIndex(tree.m_dataCount++),
+          m_hasFloatTarget(false),
+          m_rematerializeFrom(StorageClass::Direct),
+          m_rematerializeImmediate(0),
+          m_rematerializeOffset(0)
     {
         static_assert(CanBeInImmediateStorage<T>::value, "Invalid immediate type");
         static_assert(sizeof(T) <= sizeof(m_immediate), "Unsupported type.");
@@ -381,7 +431,7 @@ namespace NativeJIT
         base.ConvertToDirect(true);
 
         // Dereference it.
-        base.m_data->ConvertDirectToIndirect(byteOffset);
+        base.m_data->ConvertDirectToIndirect(byteOffset, RegisterStorage<T>::c_isFloat);
 
         // Transfer ownership of datablock to this Storage.
         SetData(base.m_data);
@@ -407,7 +457,7 @@ namespace NativeJIT
     Storage<T> ExpressionTree::Storage<T>::ForAnyFreeRegister(ExpressionTree& tree)
     {
         auto & freeList = FreeListForType<T>::Get(tree);
-        Storage<T>::DirectRegister r(freeList.Allocate());
+        Storage<T>::DirectRegister r(freeList.Allocate(tree.IsCurrentNodeLiveAcrossCall()));
 
         Data* data = &tree.PlacementConstruct<Data>(tree, r);
 
@@ -649,12 +699,20 @@ namespace NativeJIT
 
                     code.Emit<OpCode::Mov>(dest.GetDirectRegister(), base, GetOffset());
 
+                    const bool isShared = !forModification
+                                          && !m_data->PredatesJoinPoint();
+
+                    if (isShared)
+                    {
+                        m_data->RecordRematerialization();
+                    }
+
                     // Let every owner benefit from moving to direct storage if
                     // possible. This is also necessary for the register to be
                     // fully released during spilling.
-                    Swap(dest, forModification
-                               ? Storage<T>::SwapType::Single
-                               : Storage<T>::SwapType::AllReferences);
+                    Swap(dest, isShared
+                               ? Storage<T>::SwapType::AllReferences
+                               : Storage<T>::SwapType::Single);
                 }
             }
             break;
@@ -664,6 +722,13 @@ namespace NativeJIT
             break;
         }
 
+        // The caller is going to change the value, so it can no longer be
+        // recomputed from its original source.
+        if (forModification)
+        {
+            m_data->ClearRematerialization();
+        }
+
         return GetDirectRegister();
     }
 
@@ -680,10 +745,17 @@ namespace NativeJIT
         auto dest = tree.Direct<T>();
         code.EmitImmediate<OpCode::Mov>(dest.GetDirectRegister(), m_data->GetImmediate<T>());
 
+        const bool isShared = !forModification && !m_data->PredatesJoinPoint();
+
+        if (isShared)
+        {
+            m_data->RecordRematerialization();
+        }
+
         // Let every owner benefit from moving to direct storage if possible.
-        Swap(dest, forModification
-                   ? Storage<T>::SwapType::Single
-                   : Storage<T>::SwapType::AllReferences);
+        Swap(dest, isShared
+                   ? Storage<T>::SwapType::AllReferences
+                   : Storage<T>::SwapType::Single);
     }
 
 
@@ -738,16 +810,28 @@ namespace NativeJIT
             auto & code = tree.GetCodeGenerator();
             typedef typename CanonicalRegisterType<FullRegister>::Type FullType;
 
-            // Use another register if available or a temporary otherwise to
-            // bump the full contents of the register.
-            Storage<FullType> destStorage
-                = freeList.GetFreeCount() > 0
-                  ? Storage<FullType>::ForAnyFreeRegister(tree)
-                  : tree.Temporary<FullType>();
+            // Use another register if available to bump the full contents of
+            // the register. Otherwise, if the value is an immediate or a
+            // RIP-relative constant, let the other owners recompute it when
+            // needed rather than store it to a temporary.
+            const bool rematerialize = freeList.GetFreeCount() == 0
+                                       && m_data->IsRematerializable();
+            Storage<FullType> destStorage;
 
-            CodeGenHelpers::Emit<OpCode::Mov>(code,
-                                              destStorage,
-                                              FullRegister(GetDirectRegister().GetId()));
+            if (rematerialize)
+            {
+                destStorage = Storage<FullType>(m_data->Rematerialize());
+            }
+            else
+            {
+                destStorage = freeList.GetFreeCount() > 0
+                              ? Storage<FullType>::ForAnyFreeRegister(tree)
+                              : tree.Temporary<FullType>();
+
+                CodeGenHelpers::Emit<OpCode::Mov>(code,
+                                                  destStorage,
+                                                  FullRegister(GetDirectRegister().GetId()));
+            }
 
             // After the swap, the destStorage variable will be the only one
             // still referring to the original register.
@@ -760,6 +844,16 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    void ExpressionTree::Storage<T>::SetDefiningNode(unsigned nodeId)
+    {
+        if (!IsNull())
+        {
+            m_data->SetDefiningNode(nodeId);
+        }
+    }
+
+
     template <typename T>
     ReferenceCounter ExpressionTree::Storage<T>::GetPin()
     {
@@ -982,24 +1076,30 @@ namespace NativeJIT
 
 
     template <unsigned REGISTER_COUNT, bool ISFLOAT>
-    unsigned ExpressionTree::FreeList<REGISTER_COUNT, ISFLOAT>::Allocate()
-    {
+    unsigned ExpressionTree::FreeList<REGISTER_COUNT, ISFLOAT>::Allocate(bool preferNonVolatile)
+    {
+        const unsigned preferredMask = preferNonVolatile
+            ? m_nonVolatileRegisterMask
+            : m_volatileRegisterMask;
+        const unsigned otherMask = preferNonVolatile
+            ? m_volatileRegisterMask
+            : m_nonVolatileRegisterMask;
         unsigned id;
 
-        const bool volatileRegisterFound =
-            BitOp::GetHighestBitSet(~m_usedMask & m_volatileRegisterMask, &id);
+        const bool preferredRegisterFound =
+            BitOp::GetHighestBitSet(~m_usedMask & preferredMask, &id);
 
-        if (volatileRegisterFound)
+        if (preferredRegisterFound)
         {
             Allocate(id);
             return id;
         }
         else
         {
-            const bool nonVolatileRegisterFound =
-                BitOp::GetHighestBitSet(~m_usedMask & m_nonVolatileRegisterMask, &id);
+            const bool otherRegisterFound =
+                BitOp::GetHighestBitSet(~m_usedMask & otherMask, &id);
 
-            LogThrowAssert(nonVolatileRegisterFound, "No free registers available");
+            LogThrowAssert(otherRegisterFound, "No free registers available");
 
             Allocate(id);
             return id;
@@ -1126,6 +1226,59 @@ namespace NativeJIT
     }
 
 
+    template <unsigned REGISTER_COUNT, bool ISFLOAT>
+    template <typename PRIORITY>
+    unsigned ExpressionTree::FreeList<REGISTER_COUNT, ISFLOAT>::GetAllocatedSpillable(PRIORITY priority) const
+    {
+        unsigned pinnedCount = 0;
+        bool found = false;
+        unsigned foundId = 0;
+        unsigned foundPriority = 0;
+
+        // Only a strictly higher priority replaces the candidate, so the
+        // oldest register wins the ties as in GetAllocatedSpillable().
+        for (unsigned id : m_allocatedRegisters)
+        {
+            if (IsPinned(id))
+            {
+                pinnedCount++;
+            }
+            else
+            {
+                const unsigned idPriority = priority(GetData(id));
+
+                if (!found || idPriority > foundPriority)
+                {
+                    found = true;
+                    foundId = id;
+                    foundPriority = idPriority;
+                }
+            }
+        }
+
+        LogThrowAssert(found,
+                       "Couldn't find any registers for spilling: %u registers "
+                       "allocated, %u of those are pinned",
+                       static_cast<unsigned>(m_allocatedRegisters.size()),
+                       pinnedCount);
+
+        return foundId;
+    }
+
+
+    template <unsigned REGISTER_COUNT, bool ISFLOAT>
+    void ExpressionTree::FreeList<REGISTER_COUNT, ISFLOAT>::Reset(Allocators::IAllocator& allocator)
+    {
+        m_usedMask = 0;
+        m_lifetimeUsedMask = 0;
+        m_data.fill(nullptr);
+        m_pinCount.fill(0);
+
+        RecreateVector(m_allocatedRegisters, allocator);
+        m_allocatedRegisters.reserve(REGISTER_COUNT);
+    }
+
+
     template <unsigned REGISTER_COUNT, bool ISFLOAT>
     ReferenceCounter
     ExpressionTree::FreeList<REGISTER_COUNT, ISFLOAT>::GetPin(unsigned id)
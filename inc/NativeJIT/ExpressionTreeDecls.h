@@ -26,6 +26,8 @@
 #include <array>                // For arrays in FreeList.
 #include <cstdint>
 #include <iosfwd>               // For debugging output.
+#include <memory>               // For std::shared_ptr.
+#include <utility>              // For std::pair.
 
 #include "NativeJIT/AllocatorVector.h"                  // Embedded member.
 #include "NativeJIT/CodeGen/JumpTable.h"                // ExpressionTree embeds Label.
@@ -42,10 +44,26 @@ namespace Allocators
 
 namespace NativeJIT
 {
+    class BranchProfile;
+    class CompileCache;
+    class CompiledCode;
     class ExecutionPreconditionTest;
     class FunctionBuffer;
+    class Interpreter;
     class NodeBase;
     class RIPRelativeImmediate;
+    class X64CodeGenerator;
+
+
+    // Rarely executed code which is emitted behind the epilog of the function,
+    // out of the way of the code on the hot path. The cold code is entered
+    // and left by jumps to labels placed by Emit(), see
+    // ExpressionTree::AddColdBlock().
+    class ColdBlock
+    {
+    public:
+        virtual void Emit(X64CodeGenerator& code) = 0;
+    };
 
 
     // A class which increases reference counter on construction and decreases
@@ -88,6 +106,33 @@ namespace NativeJIT
 
     enum class StorageClass {Direct, Indirect, Immediate};
 
+
+    // Strategies for assigning registers to the values computed by the nodes.
+    //
+    // Greedy: registers are taken from the free list on demand and the oldest
+    // unpinned register is spilled when none are left.
+    //
+    // NextUseSpilling: before the code generation, the positions in the
+    // topological order where each node's value is used are computed.
+    // Registers are still taken on demand as with Greedy, but values that are
+    // live across a function call prefer callee-saved registers when
+    // available and spilling evicts the register whose value is needed the
+    // furthest in the future (Belady's heuristic).
+    enum class RegisterAllocation {Greedy, NextUseSpilling};
+
+
+    // Strategies for ordering the loads from memory.
+    //
+    // InOrder: each load is issued when its parent is evaluated.
+    //
+    // Hoisted: after the preconditions, the loads whose address is already
+    // available in a register (f. ex. the fields of a parameter) are issued
+    // ahead of the rest of the code in topological order, so that the latency
+    // of the cache misses they cause overlaps. Loads are hoisted only while
+    // enough registers remain free for the rest of the evaluation and never
+    // past a function call, which may modify the memory.
+    enum class LoadScheduling {InOrder, Hoisted};
+
     class ExpressionTree : public NonCopyable
     {
     private:
@@ -95,6 +140,10 @@ namespace NativeJIT
 
     public:
         template <typename T> class Storage;
+        class JoinPoint;
+        class LoopHead;
+        class RegionCopies;
+        class RegionEvaluation;
 
         // Returns the function return register for the specified type.
         template <typename T>
@@ -102,12 +151,47 @@ namespace NativeJIT
 
         ExpressionTree(Allocators::IAllocator& allocator, FunctionBuffer& code);
 
+        // Returns the tree to the state right after construction so that it
+        // can be reused for another function without constructing it again.
+        // The allocator is reset, which releases all the nodes and temporary
+        // state, so the allocator must not be shared with anything that
+        // outlives the tree's nodes. The FunctionBuffer is reset by the next
+        // Compile(). Classes deriving from the tree add their own state on
+        // top of it, so the tree must be reset through the most derived
+        // class, f. ex. Function<>::Reset().
+        void Reset();
+
         Allocators::IAllocator& GetAllocator() const;
         FunctionBuffer& GetCodeGenerator() const;
 
         void EnableDiagnostics(std::ostream& out);
         void DisableDiagnostics();
 
+        // Selects the register allocation strategy for subsequent Compile()
+        // calls. The default is RegisterAllocation::Greedy.
+        void SetRegisterAllocation(RegisterAllocation allocation);
+        RegisterAllocation GetRegisterAllocation() const;
+
+        // Selects the load scheduling strategy for subsequent Compile() calls.
+        // The default is LoadScheduling::InOrder.
+        void SetLoadScheduling(LoadScheduling scheduling);
+        LoadScheduling GetLoadScheduling() const;
+
+        // Makes subsequent Compile() calls generate the code which counts the
+        // calls to the function and the outcomes of the conditions in the
+        // profile. The profile must outlive the compiled code. Compiling
+        // through a CompileCache doesn't share the instrumented code.
+        void SetInstrumentationProfile(BranchProfile& profile);
+        BranchProfile* GetInstrumentationProfile() const;
+
+        // Makes subsequent Compile() calls lay out the conditional code so
+        // that the more frequent outcome observed in the profile falls through
+        // and the code for the other one is moved behind the epilog. The
+        // profile must have been collected from the code compiled from the
+        // same tree, see BranchProfile.
+        void SetLayoutProfile(BranchProfile const & profile);
+        BranchProfile const * GetLayoutProfile() const;
+
         // In-place constructs an object using the class allocator. The object's
         // lifetime cannot be longer than that of the ExpressionTree.
         template <typename T, typename... ConstructorArgs>
@@ -128,8 +212,78 @@ namespace NativeJIT
 
         void AddRIPRelative(RIPRelativeImmediate& node);
         void ReportFunctionCallNode(unsigned parameterCount);
+
+        // Declares that the parent evaluates the child only on some of the
+        // paths through the generated code, f. ex. as an arm of
+        // LazyConditionalNode. The nodes which are used only within the
+        // child's subtree are then evaluated on that path rather than up
+        // front. Returns the ID of the region of code formed by the subtree,
+        // which the parent passes to CodeGenSharedNodes() or RegionEvaluation
+        // at the start of the path. Region 0 is the code which is executed
+        // unconditionally.
+        unsigned AddConditionalRegion(NodeBase& parent, NodeBase& child);
+
+        // Evaluates the nodes with multiple parents which have not been
+        // evaluated yet and whose uses all lie within the region, so that
+        // their values are available on all paths through the region.
+        void CodeGenSharedNodes(unsigned region);
+
+        // Returns whether all the children of the child which formed the
+        // region are constant or already evaluated. Evaluating the child then
+        // costs about as much as the child's own code and cannot access
+        // anything guarded by the condition of the region, so the parent may
+        // evaluate the child unconditionally.
+        bool IsTrivialRegion(unsigned region) const;
+
+        // Declares that the memory range will not be modified for as long as
+        // the compiled code is in use. Loads from constant addresses inside
+        // such ranges, f. ex. fields of a model reached through a parameter
+        // bound with ParameterNode<T>::Bind(), are replaced by their values
+        // in Simplify(). The cache key of Compile(CompileCache&) includes the
+        // address and size of the ranges but not their contents, so the memory
+        // must not be reused while the cache may return code compiled for it.
+        void AddConstantMemory(void const * start, size_t size);
+
+        // Returns whether the memory range lies entirely within a range
+        // declared through AddConstantMemory().
+        bool IsConstantMemory(void const * start, size_t size) const;
+
         void Compile();
 
+        // Looks up the structure of the expression in the cache and, if it is
+        // not found there, compiles it and adds it to the cache. On a cache hit,
+        // no code is generated into the FunctionBuffer and the entry point
+        // refers to the cached code instead. The cached code is kept alive at
+        // least as long as the ExpressionTree, use GetCompiledCode() to extend
+        // its lifetime further.
+        void Compile(CompileCache& cache);
+
+        // Returns the number of nodes that the last Compile() call removed
+        // from the generated code by constant folding and algebraic
+        // simplification, see NodeBase::Simplify(). A node is counted if it
+        // was replaced by another node or if it is no longer used because
+        // its parents were simplified.
+        unsigned GetEliminatedNodeCount() const;
+
+        // Returns the cached code used by the last Compile(CompileCache&) call
+        // or an empty pointer if the code is used from the FunctionBuffer.
+        std::shared_ptr<CompiledCode const> GetCompiledCode() const;
+
+        // Returns whether all the nodes in the tree can be evaluated by the
+        // Interpreter.
+        bool IsInterpretable() const;
+
+        // Evaluates the expression with the interpreter as a cheaper
+        // alternative to compiling it. The parameters must be set in the
+        // interpreter beforehand and the result is stored in it. Only the
+        // nodes needed to compute the result are evaluated, in contrast to
+        // the compiled code which evaluates all the nodes with multiple
+        // parents up front unless they are used only within a conditional
+        // region, see AddConditionalRegion().
+        // The method doesn't modify the tree, so it can be used on one thread
+        // while the tree is being compiled on another.
+        void Interpret(Interpreter& interpreter) const;
+
         //
         // Storage allocation.
         //
@@ -149,6 +303,11 @@ namespace NativeJIT
         template <typename T>
         Storage<T> Temporary();
 
+        // Returns indirect storage relative to the base pointer for a 16-byte
+        // aligned, 16-byte slot that can hold all 128 bits of an XMM register.
+        template <typename T>
+        Storage<T> XmmTemporary();
+
         template <typename T>
         Storage<T> Immediate(T value);
 
@@ -165,6 +324,10 @@ namespace NativeJIT
         // referring to compiled function's parameters.
         void ReleaseIfTemporary(int32_t offset);
 
+        // Returns the number of bytes below the base pointer used by the
+        // temporaries so far, i.e. the size of the local area of the frame.
+        unsigned GetTemporaryAreaSize() const;
+
         // Returns whether a register is pinned.
         template <unsigned SIZE, bool ISFLOAT>
         bool IsPinned(Register<SIZE, ISFLOAT> reg);
@@ -172,8 +335,25 @@ namespace NativeJIT
         unsigned GetRXXUsedMask() const;
         unsigned GetXMMUsedMask() const;
 
+        // Sets the ID of the node whose code is being generated and returns
+        // the ID that was set previously so that it can be restored once the
+        // node is done. Used by RegisterAllocation::NextUseSpilling to determine
+        // how soon the values held in registers are needed.
+        unsigned SetCurrentNode(unsigned nodeId);
+
+        // Returns whether the uses of the cached values are recorded for the
+        // innermost RegionEvaluation and records one of them, which the
+        // current node made. Called by Node<T>::CodeGen().
+        bool IsRecordingCacheUses() const;
+        void RecordCacheUse(NodeBase& node, Storage<void*> const & value);
+
         Label GetStartOfEpilogue() const;
 
+        // Adds the code to be emitted behind the epilog once the code for the
+        // body of the function has been generated. The block is allocated
+        // with the tree's allocator, see PlacementConstruct().
+        void AddColdBlock(ColdBlock& block);
+
     protected:
         bool IsDiagnosticsStreamAvailable() const;
 
@@ -215,7 +395,9 @@ namespace NativeJIT
 
             bool IsAvailable(unsigned id) const;
 
-            unsigned Allocate();
+            // Allocates a free register, preferring volatile registers unless
+            // preferNonVolatile is set. Throws if there are no free registers.
+            unsigned Allocate(bool preferNonVolatile = false);
 
             void Allocate(unsigned id);
 
@@ -254,6 +436,18 @@ namespace NativeJIT
             // can be spilled. Throws if there are no such registers available.
             unsigned GetAllocatedSpillable() const;
 
+            // Returns the ID of an allocated register that is not pinned and
+            // whose Data* has the highest spill priority as returned by the
+            // functor. Ties go to the oldest register. Throws if there are no
+            // such registers available.
+            template <typename PRIORITY>
+            unsigned GetAllocatedSpillable(PRIORITY priority) const;
+
+            // Returns the free list to the state right after construction.
+            // The allocator has been reset by the caller, so the memory held
+            // by the free list is dropped rather than released.
+            void Reset(Allocators::IAllocator& allocator);
+
         private:
             // Helper methods to perform sanity check on arguments and data contents.
             void AssertValidID(unsigned id) const;
@@ -297,18 +491,78 @@ namespace NativeJIT
         template <unsigned SIZE>
         bool IsAnySharedBaseRegister(Register<SIZE, true> r) const;
 
-        // Converts a valid temporary slot index into an offset off base register.
-        int32_t TemporarySlotToOffset(unsigned temporarySlot);
-
-        // If the temporary offset off base register describes a valid allocated
-        // temporary slot, returns true and fills in the temporary slot out
-        // parameter. Returns false otherwise.
-        bool TemporaryOffsetToSlot(int32_t temporaryOffset, unsigned& temporarySlot);
+        // Allocates a temporary of unitCount 8-byte units, 16-byte aligned if
+        // requested, and returns its offset off the base register. The free
+        // space closest to the base pointer is used first, so the slots
+        // released by temporaries whose lifetime has ended are packed before
+        // the frame grows and the offsets stay short.
+        int32_t AllocateTemporary(unsigned unitCount, bool isAligned16);
+
+        // Releases the references held by the nodes which are not used by the
+        // tree, which makes their exclusive children unused as well.
+        void PruneUnusedNodes();
+
+        // Simplifies the nodes before the code generation and releases the
+        // nodes which are no longer used as a result.
+        void Simplify();
+
+        // Records the positions in m_topologicalSort where the value of each
+        // node is used, see RegisterAllocation::NextUseSpilling.
+        void ComputeLiveRanges();
+
+        // Returns the position of the first use of the node's value that is
+        // not before the node currently being generated. Returns the current
+        // position if the node is unknown or has no remaining uses, as the
+        // value is then held by the code being generated.
+        unsigned GetNextUse(unsigned nodeId) const;
+
+        // Returns whether the value of the node currently being generated is
+        // used after one of the function calls in the tree.
+        bool IsCurrentNodeLiveAcrossCall() const;
+
+        // Assigns each node to the innermost region declared through
+        // AddConditionalRegion() that contains all of its uses.
+        void ComputeEvaluationRegions();
+
+        // Returns whether the node region is the region or one of the
+        // regions nested in it.
+        bool IsWithinRegion(unsigned nodeRegion, unsigned region) const;
+
+        // Returns the region computed by ComputeEvaluationRegions() for the
+        // node or for its replacement if the node was replaced.
+        unsigned GetEvaluationRegion(NodeBase const & node) const;
+
+        // Helpers for JoinPoint. The first one loads the value which the
+        // indirect data refers to into a register. The second one moves the
+        // value held by the data into the register with the specified ID,
+        // bumping the current contents of the register if needed. Both
+        // affect all owners of the data.
+        void ConvertIndirectToDirect(Data* data);
+
+        template <typename FULLTYPE>
+        void MoveToRegister(Data* data, unsigned registerId);
+
+        // Reserves the registers which must not be allocated to the nodes,
+        // i.e. the shared base registers and the registers which cannot be
+        // written to. The reservation is released at the end of Compile().
+        void ReserveRegisters();
+
+        // Constructs an empty vector in place of one whose memory was
+        // released by resetting the allocator. The old vector is not
+        // destroyed since its destructor would return the memory to the
+        // allocator, which no longer owns it, see Reset().
+        template <typename T>
+        static void RecreateVector(AllocatorVector<T>& vector,
+                                   Allocators::IAllocator& allocator);
 
         void Pass0();
         void Pass1();
         void Pass2();
         void Pass3();
+
+        // Evaluates the loads which can be issued early into registers, see
+        // LoadScheduling::Hoisted.
+        void HoistLoads();
         void Print() const;
 
         // The following template and the alias template provide a way to access
@@ -333,6 +587,9 @@ namespace NativeJIT
         AllocatorVector<NodeBase*> m_parameters;
         AllocatorVector<RIPRelativeImmediate*> m_ripRelatives;
 
+        // Start and size of the ranges declared by AddConstantMemory().
+        AllocatorVector<std::pair<char const *, size_t>> m_constantMemory;
+
         // Preconditions for evaluating the whole expression. The preconditions
         // are evaluated right after the parameters and will cause the function
         // to return early if any of them is not met.
@@ -345,8 +602,14 @@ namespace NativeJIT
         AllocatorVector<Storage<double>> m_reservedXmmRegisterStorages;
         AllocatorVector<ReferenceCounter> m_reservedRegistersPins;
 
-        unsigned m_temporaryCount;
-        AllocatorVector<int32_t> m_temporaries;
+        // The 8-byte units of the temporary area, unit i being at offset
+        // -8 * (i + 1) off the base pointer. Each entry is 0 for a free unit
+        // or the number of units of the temporary whose offset points to the
+        // unit, or c_temporaryUnitContinued for the other units of larger
+        // temporaries. The size of the vector never shrinks and determines
+        // the size of the frame.
+        static const uint8_t c_temporaryUnitContinued = 0xff;
+        AllocatorVector<uint8_t> m_temporaryUnits;
 
         // Maximum number of parameters used in function calls done by the tree.
         // Negative value signifies no function calls made.
@@ -355,6 +618,66 @@ namespace NativeJIT
         PointerRegister m_basePointer;
 
         Label m_startOfEpilogue;
+
+        // The code obtained from the compile cache, see Compile(CompileCache&).
+        std::shared_ptr<CompiledCode const> m_compiledCode;
+
+        // See GetEliminatedNodeCount().
+        unsigned m_eliminatedNodeCount;
+
+        RegisterAllocation m_registerAllocation;
+        LoadScheduling m_loadScheduling;
+
+        // See SetInstrumentationProfile() and SetLayoutProfile().
+        BranchProfile* m_instrumentationProfile;
+        BranchProfile const * m_layoutProfile;
+
+        // See AddColdBlock().
+        AllocatorVector<ColdBlock*> m_coldBlocks;
+
+        // See SetCurrentNode().
+        unsigned m_currentNodeId;
+
+        // Live ranges computed by ComputeLiveRanges(). The positions where
+        // the value of node i is used are stored in ascending order in
+        // m_usePositions between indices m_useStart[i] and m_useStart[i + 1].
+        AllocatorVector<unsigned> m_useStart;
+        AllocatorVector<unsigned> m_usePositions;
+
+        // Positions of the function call nodes in m_topologicalSort.
+        AllocatorVector<unsigned> m_callPositions;
+
+        // The regions declared through AddConditionalRegion(), region i + 1
+        // being at index i. The enclosing region and the depth are filled in
+        // by ComputeEvaluationRegions().
+        struct ConditionalRegion
+        {
+            NodeBase* m_parent;
+            NodeBase* m_child;
+            unsigned m_enclosingRegion;
+            unsigned m_depth;
+        };
+
+        AllocatorVector<ConditionalRegion> m_conditionalRegions;
+
+        // The region of each node, indexed by node ID.
+        AllocatorVector<unsigned> m_nodeRegions;
+
+        // The number of Data objects created so far and the number of those
+        // created before the innermost JoinPoint which currently exists.
+        unsigned m_dataCount;
+        unsigned m_joinPointDataCount;
+
+        // The innermost LoopHead which currently exists or nullptr.
+        LoopHead* m_innermostLoop;
+
+        // Whether Pass1() is evaluating the preconditions, which happens
+        // before Pass2() evaluates the shared nodes of region 0.
+        bool m_isEvaluatingPreconditions;
+
+        // The innermost RegionEvaluation which records the uses of the cached
+        // values or nullptr.
+        RegionEvaluation* m_innermostRegionEvaluation;
     };
 
 
@@ -386,13 +709,52 @@ namespace NativeJIT
         template <typename T>
         T GetImmediate() const;
 
-        void ConvertDirectToIndirect(int32_t offset);
+        // The isFloatTarget parameter specifies whether the value at the
+        // address is a floating point one, see HasFloatTarget().
+        void ConvertDirectToIndirect(int32_t offset, bool isFloatTarget);
         void ConvertIndirectToDirect();
 
+        // Returns whether the indirect data refers to a floating point value,
+        // which needs to be loaded into an XMM register.
+        bool HasFloatTarget() const;
+
+        // Returns whether the data was created before the innermost JoinPoint
+        // which currently exists. The conversions which would move such data
+        // for all of its owners give the converting Storage a copy instead,
+        // so that the data is only moved by spilling and register bumping,
+        // which JoinPoint::Restore() undoes.
+        bool PredatesJoinPoint() const;
+
         unsigned GetRefCount() const;
         unsigned Decrement();
         void Increment();
 
+        // The ID of the node that computed the value held by the data or
+        // c_unknownNode if not known. The ID is not affected by the changes
+        // of the register or by SwapContents() since it describes the value
+        // that the clients of the data refer to.
+        static const unsigned c_unknownNode = ~0u;
+
+        unsigned GetDefiningNode() const;
+        void SetDefiningNode(unsigned nodeId);
+
+        // Records that the direct register holds a copy of the data's current
+        // immediate or RIP-relative contents, which are about to be replaced
+        // with the register. Like the defining node, the record describes the
+        // value and is not affected by SwapContents(). It is cleared when the
+        // storage is converted for modification.
+        void RecordRematerialization();
+        void ClearRematerialization();
+
+        // Returns whether the value held in the direct register can be
+        // recomputed from an immediate or a RIP-relative constant instead of
+        // being spilled to a temporary.
+        bool IsRematerializable() const;
+
+        // Creates a new immediate or RIP-relative indirect Data holding the
+        // value recorded by RecordRematerialization(). Emits no code.
+        Data* Rematerialize() const;
+
         // Swaps the targets between two Data objects keeping the reference
         // count unchanged and notifies the free list of the register change.
         // Used when all clients of both data objects need to have the contents
@@ -405,6 +767,13 @@ namespace NativeJIT
         // resources other than memory from the arena allocator.
         ~Data();
 
+        // Selects the constructor which creates an immediate from the word
+        // held by m_immediate regardless of the type of the value, see
+        // Rematerialize().
+        struct ImmediateWord {};
+
+        Data(ExpressionTree& tree, ImmediateWord, size_t immediate);
+
         // The type of the register change that the free list gets notified about.
         enum class RegisterChangeType { Initialize, Update };
 
@@ -436,6 +805,25 @@ namespace NativeJIT
 
         // Who is using it.
         unsigned m_refCount;
+
+        // See GetDefiningNode().
+        unsigned m_definingNode;
+
+        // The order in which the value held by the data was created, see
+        // PredatesJoinPoint().
+        unsigned m_creationIndex;
+
+        // See HasFloatTarget(). Like the defining node, describes the value
+        // and is not affected by SwapContents().
+        bool m_hasFloatTarget;
+
+        // The source of the value for RecordRematerialization(): the storage
+        // class is either Immediate or Indirect (off RIP) and the immediate
+        // or the offset holds the contents. StorageClass::Direct marks data
+        // whose value cannot be rematerialized.
+        StorageClass m_rematerializeFrom;
+        size_t m_rematerializeImmediate;
+        int32_t m_rematerializeOffset;
     };
 
 
@@ -449,6 +837,10 @@ namespace NativeJIT
         // the template parameter.
         template <typename U> friend class Storage;
 
+        // ExpressionTree creates Storages around existing Data when it moves
+        // the values for JoinPoint.
+        friend class ExpressionTree;
+
         typedef typename RegisterStorage<T>::RegisterType DirectRegister;
         typedef PointerRegister BaseRegister;
         typedef typename DirectRegister::FullRegister FullRegister;
@@ -549,6 +941,11 @@ namespace NativeJIT
         // one of the shared base registers.
         void TakeSoleOwnershipOfDirect();
 
+        // Records the ID of the node that computed the value held by the
+        // storage. Used by RegisterAllocation::NextUseSpilling to choose the
+        // registers to spill. Does nothing for null storages.
+        void SetDefiningNode(unsigned nodeId);
+
         // Returns a pin for the storage's register. While the pin is held,
         // the register cannot be spilled. Can only be called if Storage is
         // either direct or if it's indirect and refers to non-shared base
@@ -594,6 +991,170 @@ namespace NativeJIT
     };
 
 
+    // Makes the paths through conditionally executed code, f. ex. through the
+    // arms of LazyConditionalNode, join with the same register allocation.
+    // The constructor records which values the registers hold before the
+    // conditional jump and Restore() moves the values which the code on a
+    // path spilled or bumped to other registers back at the end of the path.
+    // The values which are not in registers at that point stay in place, see
+    // Data::PredatesJoinPoint(). The values which die on a path are not
+    // restored since no code after the join point uses them.
+    class ExpressionTree::JoinPoint : public NonCopyable
+    {
+    public:
+        // Loads the values which indirect data held in registers refers to
+        // since spilling would lose their base registers. The code emitted
+        // by the constructor consists of MOV instructions only, so it can be
+        // placed between setting the flags and the conditional jump.
+        JoinPoint(ExpressionTree& tree);
+        ~JoinPoint();
+
+        // Moves the values back to the registers they were held in when the
+        // instance was constructed. Must be called at the end of each path
+        // once the values computed on the path that are still needed have
+        // been stored in Storages.
+        void Restore();
+
+    private:
+        ExpressionTree& m_tree;
+
+        // The value of ExpressionTree::m_joinPointDataCount to restore in
+        // the destructor, which allows nesting the instances.
+        const unsigned m_outerDataCount;
+
+        std::array<Data*, RegisterBase::c_maxIntegerRegisterID + 1> m_rxxData;
+        std::array<Data*, RegisterBase::c_maxFloatRegisterID + 1> m_xmmData;
+    };
+
+
+    // Makes the code of a loop body start each iteration with the same
+    // register allocation, f. ex. for ReduceNode. The instance is constructed
+    // before the loop is entered and Restore() is called at the end of the
+    // body, before the jump back to its start, like for a JoinPoint. Unlike
+    // on a path through conditional code, the values computed before the
+    // loop must survive the body since the next iteration uses them again.
+    // The instance therefore holds a reference to the values held in
+    // registers, which prevents the body from modifying them in place or
+    // releasing their registers, and releases the temporaries allocated
+    // before the loop only once the instance is destroyed.
+    class ExpressionTree::LoopHead : public NonCopyable
+    {
+    public:
+        // See JoinPoint::JoinPoint().
+        LoopHead(ExpressionTree& tree);
+        ~LoopHead();
+
+        // See JoinPoint::Restore().
+        void Restore();
+
+    private:
+        friend class ExpressionTree;
+
+        // Returns whether the temporary starting at the unit was allocated
+        // before the loop and, if so, records its offset to release it once
+        // the instance is destroyed. Called by ReleaseIfTemporary().
+        bool DefersRelease(unsigned unit, int32_t offset);
+
+        ExpressionTree& m_tree;
+        JoinPoint m_joinPoint;
+
+        // The value of ExpressionTree::m_innermostLoop to restore in the
+        // destructor, which allows nesting the loops.
+        LoopHead* const m_outerLoop;
+
+        std::array<Storage<uint64_t>, RegisterBase::c_maxIntegerRegisterID + 1> m_rxxValues;
+        std::array<Storage<double>, RegisterBase::c_maxFloatRegisterID + 1> m_xmmValues;
+
+        // A copy of ExpressionTree::m_temporaryUnits made by the constructor
+        // and the offsets of the temporaries whose release was deferred.
+        AllocatorVector<uint8_t> m_outerTemporaryUnits;
+        AllocatorVector<int32_t> m_deferredTemporaries;
+    };
+
+
+    // Allows generating the code of a conditional region several times, f. ex.
+    // for the copies of an unrolled loop body. Each copy evaluates the nodes
+    // within the region anew and uses the values cached by the nodes which
+    // have already been evaluated, which hold the references for only one
+    // copy. The constructor adds the references for the other copies to those
+    // values.
+    class ExpressionTree::RegionCopies : public NonCopyable
+    {
+    public:
+        // Must be constructed before any code of the region is generated.
+        RegionCopies(ExpressionTree& tree, unsigned region, unsigned copyCount);
+
+        // Makes the nodes within the region not evaluated again. Must be
+        // called before generating each copy but the first one.
+        void BeginNextCopy();
+
+        // Releases the references added by the constructor which the copies
+        // did not use. Must be called after generating the last copy.
+        void End();
+
+    private:
+        ExpressionTree& m_tree;
+        const unsigned m_region;
+        const unsigned m_copyCount;
+        unsigned m_copy;
+
+        // Whether each node had been evaluated when the instance was
+        // constructed and the number of references held by the value it
+        // cached, in the topological order.
+        AllocatorVector<bool> m_isInitiallyEvaluated;
+        AllocatorVector<unsigned> m_initialReferenceCounts;
+    };
+
+
+    // Generates the code of a conditional region on one of the paths through
+    // its parent, f. ex. an arm of LazyConditionalNode. The nodes of the
+    // enclosing regions are normally evaluated before the region, except for
+    // the nodes of region 0 which the preconditions reach before Pass2(). A
+    // value the region computes for such a node exists only on the paths
+    // through the region, so End() discards the evaluation of the node and
+    // gives back the cached values it used. The parents which have not used
+    // the node yet then evaluate it again.
+    class ExpressionTree::RegionEvaluation : public NonCopyable
+    {
+    public:
+        // Evaluates the shared nodes of the region, see CodeGenSharedNodes().
+        // Must be constructed before any node of the region is evaluated.
+        RegionEvaluation(ExpressionTree& tree, unsigned region);
+        ~RegionEvaluation();
+
+        // Must be called at the end of the path, before the JoinPoint is
+        // restored.
+        void End();
+
+    private:
+        friend class ExpressionTree;
+
+        // A use of the value cached by a node, see RecordCacheUse().
+        struct CacheUse
+        {
+            // The node which was being evaluated, see SetCurrentNode().
+            unsigned m_parentId;
+            NodeBase* m_node;
+
+            // Keeps the value alive so that it can be given back to the node.
+            Storage<void*> m_value;
+        };
+
+        ExpressionTree& m_tree;
+        const unsigned m_region;
+
+        // The value of ExpressionTree::m_innermostRegionEvaluation to restore
+        // in the destructor, which allows nesting the regions.
+        RegionEvaluation* const m_outerEvaluation;
+
+        // Whether each node had been evaluated when the instance was
+        // constructed, indexed by node ID, and the uses of the cached values
+        // since then. Left empty unless the preconditions are being evaluated.
+        AllocatorVector<bool> m_isInitiallyEvaluated;
+        AllocatorVector<CacheUse> m_cacheUses;
+    };
+
+
     template <typename T>
     using Storage = typename ExpressionTree::Storage<T>;
 }
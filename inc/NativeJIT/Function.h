@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include "NativeJIT/CompileCache.h"
 #include "NativeJIT/ExecutionPreconditionTest.h"
 #include "NativeJIT/ExpressionNodeFactory.h"
 #include "NativeJIT/TypePredicates.h"
@@ -51,6 +52,11 @@ namespace NativeJIT
     public:
         Function(Allocators::IAllocator& allocator, FunctionBuffer& code);
 
+        // Returns the function to the state right after construction so that
+        // it can be reused for another expression with the same signature,
+        // see ExpressionTree::Reset(). The parameter nodes are recreated.
+        void Reset();
+
         ParameterNode<P1>& GetP1() const;
         ParameterNode<P2>& GetP2() const;
         ParameterNode<P3>& GetP3() const;
@@ -60,9 +66,15 @@ namespace NativeJIT
 
         FunctionType Compile(Node<R>& expression);
 
+        // Compiles the expression through the cache, see
+        // ExpressionTree::Compile(CompileCache&) for details.
+        FunctionType Compile(Node<R>& expression, CompileCache& cache);
+
         FunctionType GetEntryPoint() const;
 
     private:
+        void CreateParameters();
+
         ParameterNode<P1>* m_p1;
         ParameterNode<P2>* m_p2;
         ParameterNode<P3>* m_p3;
@@ -76,6 +88,11 @@ namespace NativeJIT
     public:
         Function(Allocators::IAllocator& allocator, FunctionBuffer& code);
 
+        // Returns the function to the state right after construction so that
+        // it can be reused for another expression with the same signature,
+        // see ExpressionTree::Reset(). The parameter nodes are recreated.
+        void Reset();
+
         ParameterNode<P1>& GetP1() const;
         ParameterNode<P2>& GetP2() const;
         ParameterNode<P3>& GetP3() const;
@@ -84,9 +101,15 @@ namespace NativeJIT
 
         FunctionType Compile(Node<R>& expression);
 
+        // Compiles the expression through the cache, see
+        // ExpressionTree::Compile(CompileCache&) for details.
+        FunctionType Compile(Node<R>& expression, CompileCache& cache);
+
         FunctionType GetEntryPoint() const;
 
     private:
+        void CreateParameters();
+
         ParameterNode<P1>* m_p1;
         ParameterNode<P2>* m_p2;
         ParameterNode<P3>* m_p3;
@@ -99,6 +122,11 @@ namespace NativeJIT
     public:
         Function(Allocators::IAllocator& allocator, FunctionBuffer& code);
 
+        // Returns the function to the state right after construction so that
+        // it can be reused for another expression with the same signature,
+        // see ExpressionTree::Reset(). The parameter nodes are recreated.
+        void Reset();
+
         ParameterNode<P1>& GetP1() const;
         ParameterNode<P2>& GetP2() const;
 
@@ -106,9 +134,15 @@ namespace NativeJIT
 
         FunctionType Compile(Node<R>& expression);
 
+        // Compiles the expression through the cache, see
+        // ExpressionTree::Compile(CompileCache&) for details.
+        FunctionType Compile(Node<R>& expression, CompileCache& cache);
+
         FunctionType GetEntryPoint() const;
 
     private:
+        void CreateParameters();
+
         ParameterNode<P1>* m_p1;
         ParameterNode<P2>* m_p2;
     };
@@ -120,15 +154,26 @@ namespace NativeJIT
     public:
         Function(Allocators::IAllocator& allocator, FunctionBuffer& code);
 
+        // Returns the function to the state right after construction so that
+        // it can be reused for another expression with the same signature,
+        // see ExpressionTree::Reset(). The parameter nodes are recreated.
+        void Reset();
+
         ParameterNode<P1>& GetP1() const;
 
         typedef R (*FunctionType)(P1);
 
         FunctionType Compile(Node<R>& expression);
 
+        // Compiles the expression through the cache, see
+        // ExpressionTree::Compile(CompileCache&) for details.
+        FunctionType Compile(Node<R>& expression, CompileCache& cache);
+
         FunctionType GetEntryPoint() const;
 
     private:
+        void CreateParameters();
+
         ParameterNode<P1>* m_p1;
     };
 
@@ -139,10 +184,19 @@ namespace NativeJIT
     public:
         Function(Allocators::IAllocator& allocator, FunctionBuffer& code);
 
+        // Returns the function to the state right after construction so that
+        // it can be reused for another expression with the same signature,
+        // see ExpressionTree::Reset(). The parameter nodes are recreated.
+        void Reset();
+
         typedef R (*FunctionType)();
 
         FunctionType Compile(Node<R>& expression);
 
+        // Compiles the expression through the cache, see
+        // ExpressionTree::Compile(CompileCache&) for details.
+        FunctionType Compile(Node<R>& expression, CompileCache& cache);
+
         FunctionType GetEntryPoint() const;
     };
 
@@ -188,6 +242,21 @@ namespace NativeJIT
         static_assert(IsValidParameter<P3>::c_value, "P3 is an invalid type.");
         static_assert(IsValidParameter<P4>::c_value, "P4 is an invalid type.");
 
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    void Function<R, P1, P2, P3, P4>::Reset()
+    {
+        ExpressionNodeFactory::Reset();
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    void Function<R, P1, P2, P3, P4>::CreateParameters()
+    {
         ParameterSlotAllocator slotAllocator;
         m_p1 = &this->template Parameter<P1>(slotAllocator);
         m_p2 = &this->template Parameter<P2>(slotAllocator);
@@ -234,6 +303,16 @@ namespace NativeJIT
     }
 
 
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    typename Function<R, P1, P2, P3, P4>::FunctionType
+    Function<R, P1, P2, P3, P4>::Compile(Node<R>& value, CompileCache& cache)
+    {
+        this->template Return<R>(value);
+        ExpressionTree::Compile(cache);
+        return GetEntryPoint();
+    }
+
+
     template <typename R, typename P1, typename P2, typename P3, typename P4>
     typename Function<R, P1, P2, P3, P4>::FunctionType
     Function<R, P1, P2, P3, P4>::GetEntryPoint() const
@@ -256,6 +335,21 @@ namespace NativeJIT
         static_assert(IsValidParameter<P2>::c_value, "P2 is an invalid type.");
         static_assert(IsValidParameter<P3>::c_value, "P3 is an invalid type.");
 
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3>
+    void Function<R, P1, P2, P3>::Reset()
+    {
+        ExpressionNodeFactory::Reset();
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3>
+    void Function<R, P1, P2, P3>::CreateParameters()
+    {
         ParameterSlotAllocator slotAllocator;
         m_p1 = &this->template Parameter<P1>(slotAllocator);
         m_p2 = &this->template Parameter<P2>(slotAllocator);
@@ -294,6 +388,16 @@ namespace NativeJIT
     }
 
 
+    template <typename R, typename P1, typename P2, typename P3>
+    typename Function<R, P1, P2, P3>::FunctionType
+    Function<R, P1, P2, P3>::Compile(Node<R>& value, CompileCache& cache)
+    {
+        this->template Return<R>(value);
+        ExpressionTree::Compile(cache);
+        return GetEntryPoint();
+    }
+
+
     template <typename R, typename P1, typename P2, typename P3>
     typename Function<R, P1, P2, P3>::FunctionType
     Function<R, P1, P2, P3>::GetEntryPoint() const
@@ -315,6 +419,21 @@ namespace NativeJIT
         static_assert(IsValidParameter<P1>::c_value, "P1 is an invalid type.");
         static_assert(IsValidParameter<P2>::c_value, "P2 is an invalid type.");
 
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1, typename P2>
+    void Function<R, P1, P2>::Reset()
+    {
+        ExpressionNodeFactory::Reset();
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1, typename P2>
+    void Function<R, P1, P2>::CreateParameters()
+    {
         ParameterSlotAllocator slotAllocator;
         m_p1 = &this->template Parameter<P1>(slotAllocator);
         m_p2 = &this->template Parameter<P2>(slotAllocator);
@@ -345,6 +464,16 @@ namespace NativeJIT
     }
 
 
+    template <typename R, typename P1, typename P2>
+    typename Function<R, P1, P2>::FunctionType
+    Function<R, P1, P2>::Compile(Node<R>& value, CompileCache& cache)
+    {
+        this->template Return<R>(value);
+        ExpressionTree::Compile(cache);
+        return GetEntryPoint();
+    }
+
+
     template <typename R, typename P1, typename P2>
     typename Function<R, P1, P2>::FunctionType
     Function<R, P1, P2>::GetEntryPoint() const
@@ -365,6 +494,21 @@ namespace NativeJIT
     {
         static_assert(IsValidParameter<P1>::c_value, "P1 is an invalid type.");
 
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1>
+    void Function<R, P1>::Reset()
+    {
+        ExpressionNodeFactory::Reset();
+        CreateParameters();
+    }
+
+
+    template <typename R, typename P1>
+    void Function<R, P1>::CreateParameters()
+    {
         ParameterSlotAllocator slotAllocator;
         m_p1 = &this->template Parameter<P1>(slotAllocator);
     }
@@ -387,6 +531,16 @@ namespace NativeJIT
     }
 
 
+    template <typename R, typename P1>
+    typename Function<R, P1>::FunctionType
+    Function<R, P1>::Compile(Node<R>& value, CompileCache& cache)
+    {
+        this->template Return<R>(value);
+        ExpressionTree::Compile(cache);
+        return GetEntryPoint();
+    }
+
+
     template <typename R, typename P1>
     typename Function<R, P1>::FunctionType
     Function<R, P1>::GetEntryPoint() const
@@ -408,6 +562,13 @@ namespace NativeJIT
     }
 
 
+    template <typename R>
+    void Function<R>::Reset()
+    {
+        ExpressionNodeFactory::Reset();
+    }
+
+
     template <typename R>
     typename Function<R>::FunctionType  Function<R>::Compile(Node<R>& value)
     {
@@ -417,6 +578,15 @@ namespace NativeJIT
     }
 
 
+    template <typename R>
+    typename Function<R>::FunctionType  Function<R>::Compile(Node<R>& value, CompileCache& cache)
+    {
+        this->template Return<R>(value);
+        ExpressionTree::Compile(cache);
+        return GetEntryPoint();
+    }
+
+
     template <typename R>
     typename Function<R>::FunctionType Function<R>::GetEntryPoint() const
     {
@@ -0,0 +1,805 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>                                  // For std::memcpy.
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"     // OpCode and JccType types.
+#include "Temporary/Assert.h"
+#include "Temporary/NonCopyable.h"
+
+
+namespace NativeJIT
+{
+    // Holds the state of a single evaluation of an ExpressionTree by the
+    // interpreter: the values of the parameters, the value computed by each
+    // node, the storage for stack variables and the result.
+    //
+    // All values are kept as 64-bit words, see InterpreterValue<T> for the
+    // conversions. The interpreter only reads the nodes, so an expression can
+    // be interpreted while it is being compiled on another thread. However, a
+    // single Interpreter cannot be used for concurrent evaluations.
+    class Interpreter : public NonCopyable
+    {
+    public:
+        static const unsigned c_maxParameterCount = 4;
+
+        Interpreter();
+
+        // Prepares the interpreter for a new evaluation of an expression with
+        // the specified number of nodes. Forgets all the node values.
+        void Reset(unsigned nodeCount);
+
+        template <typename... PARAMETERS>
+        void SetParameters(PARAMETERS... parameters);
+
+        uint64_t GetParameter(unsigned position) const;
+
+        bool IsEvaluated(unsigned nodeId) const;
+        uint64_t GetValue(unsigned nodeId) const;
+        void SetValue(unsigned nodeId, uint64_t value);
+
+        // Returns the storage backing the stack variable with the specified
+        // node ID. The contents of the storage are undefined at the start of
+        // the evaluation, just as for the temporaries in compiled code.
+        uint64_t* GetVariable(unsigned nodeId);
+
+        uint64_t GetResult() const;
+        void SetResult(uint64_t value);
+
+    private:
+        unsigned m_nodeCount;
+
+        std::vector<uint64_t> m_values;
+        std::vector<uint64_t> m_variables;
+        std::vector<uint8_t> m_isEvaluated;
+
+        uint64_t m_parameters[c_maxParameterCount];
+        uint64_t m_result;
+    };
+
+
+    // Converts values of type T to and from the 64-bit words used by the
+    // Interpreter. Values are stored in the low bytes of the word with the
+    // rest of the word set to zero, references are stored as addresses.
+    template <typename T>
+    struct InterpreterValue
+    {
+        static_assert(sizeof(T) <= sizeof(uint64_t), "Type is too large for the interpreter.");
+
+        static uint64_t ToWord(T value)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, &value, sizeof(T));
+
+            return word;
+        }
+
+
+        static T FromWord(uint64_t word)
+        {
+            typename std::remove_const<T>::type value;
+            std::memcpy(&value, &word, sizeof(T));
+
+            return value;
+        }
+    };
+
+
+    template <typename T>
+    struct InterpreterValue<T&>
+    {
+        static uint64_t ToWord(T& value)
+        {
+            return reinterpret_cast<uint64_t>(&value);
+        }
+
+
+        static T& FromWord(uint64_t word)
+        {
+            return *reinterpret_cast<T*>(word);
+        }
+    };
+
+
+    // Helpers which evaluate the operations emitted by the nodes with the
+    // same results as the X64 instructions would produce.
+    namespace Interpretation
+    {
+        // Returns whether the operation is implemented by ApplyBinary() for
+        // integer or floating point operands.
+        bool IsSupported(OpCode op, bool isFloat);
+
+        // Returns the result of applying the operation to the operands.
+        template <typename L, typename R>
+        L ApplyBinary(OpCode op, L left, R right);
+
+        // Returns whether applying the integer operation with the right
+        // operand leaves any left operand of type L unchanged (f. ex. x + 0).
+        template <typename L, typename R>
+        bool IsRightIdentity(OpCode op, R right);
+
+        // Returns whether the result of the integer operation with the operand
+        // is zero for any other operand of type L (f. ex. x * 0).
+        template <typename L, typename R>
+        bool IsAnnihilator(OpCode op, R operand);
+
+        // Returns whether the operands of the operation can be swapped.
+        bool IsCommutative(OpCode op);
+
+        // Returns the result of shifting the left value by the specified
+        // number of bits and filling the vacated bits with the upper bits of
+        // the right value, as the SHLD instruction does.
+        template <typename T>
+        T ApplyShld(T left, T right, uint8_t bitCount);
+
+        // Return the results of the bit manipulation instructions for an
+        // integral T: popcnt, lzcnt and tzcnt, which return the width of T
+        // for zero, bswap, andn (~left & right), pext, pdep and bzhi, which
+        // uses the lowest byte of the index and leaves the value unchanged if
+        // it is at least the width of T. They are computed bit by bit without
+        // the instructions, so the compiled code also calls ApplyExtractBits(),
+        // ApplyDepositBits() and ApplyZeroHighBits() on processors without BMI2.
+        template <typename T>
+        T ApplyPopCount(T value);
+
+        template <typename T>
+        T ApplyLeadingZeroCount(T value);
+
+        template <typename T>
+        T ApplyTrailingZeroCount(T value);
+
+        template <typename T>
+        T ApplyByteSwap(T value);
+
+        template <typename T>
+        T ApplyAndNot(T left, T right);
+
+        template <typename T>
+        T ApplyExtractBits(T value, T mask);
+
+        template <typename T>
+        T ApplyDepositBits(T value, T mask);
+
+        template <typename T>
+        T ApplyZeroHighBits(T value, T index);
+
+        // Return the quotient rounded toward zero, the remainder with the
+        // sign of the dividend and the upper half of the double-width product,
+        // as the div/idiv and the single operand mul/imul instructions compute
+        // them for the signedness of T. The division by zero and the overflow
+        // of the signed division, which raise a divide error in the compiled
+        // code, throw.
+        template <typename T>
+        T ApplyDiv(T left, T right);
+
+        template <typename T>
+        T ApplyMod(T left, T right);
+
+        template <typename T>
+        T ApplyMulHigh(T left, T right);
+
+        // Returns the base plus the index multiplied by the scale, as the LEA
+        // instruction with a scaled index computes it.
+        template <typename T, typename INDEX>
+        T ApplyScaledIndex(T base, INDEX index, uint8_t scale);
+
+        // Returns the result of the conditional jump which follows the
+        // comparison of the two values.
+        template <typename T>
+        bool Compare(JccType jcc, T left, T right);
+
+        // Returns the value converted as by the one-step CastNode.
+        template <typename TO, typename FROM>
+        TO Cast(FROM value);
+
+
+        //
+        // Implementation details.
+        //
+
+        // CPU flags set by the comparison instructions.
+        struct Flags
+        {
+            bool m_zero;
+            bool m_carry;
+            bool m_sign;
+            bool m_overflow;
+            bool m_parity;
+        };
+
+        bool IsConditionMet(JccType jcc, Flags const & flags);
+
+        // Returns the word in which the value of type T stored in the low
+        // bytes is sign extended to the full word.
+        template <typename T>
+        uint64_t SignExtend(uint64_t word);
+
+        // Returns the mask for the bits of the word used by a value of type T.
+        template <typename T>
+        uint64_t ValueMask();
+
+        // Returns the word for the right operand of a binary operation, which
+        // is sign extended like the immediates are.
+        template <typename T>
+        uint64_t OperandWord(T value);
+
+        template <typename L, typename R>
+        L ApplyBinary(OpCode op, L left, R right, std::false_type /* isFloat */);
+
+        template <typename L, typename R>
+        L ApplyBinary(OpCode op, L left, R right, std::true_type /* isFloat */);
+
+        template <typename T>
+        void AssertDivisionIsDefined(T left, T right);
+
+        template <typename T>
+        bool Compare(JccType jcc, T left, T right, std::false_type /* isFloat */);
+
+        template <typename T>
+        bool Compare(JccType jcc, T left, T right, std::true_type /* isFloat */);
+
+        template <typename TO, typename FROM>
+        TO Cast(FROM value, std::false_type /* isArithmetic */);
+
+        template <typename TO, typename FROM>
+        TO Cast(FROM value, std::true_type /* isArithmetic */);
+    }
+
+
+    //*************************************************************************
+    //
+    // Template definitions for Interpreter.
+    //
+    //*************************************************************************
+
+    template <typename... PARAMETERS>
+    void Interpreter::SetParameters(PARAMETERS... parameters)
+    {
+        static_assert(sizeof...(PARAMETERS) <= c_maxParameterCount,
+                      "Too many parameters.");
+
+        // The elements of the braced list are evaluated in order.
+        unsigned position = 0;
+        int expansion[] = { 0, (m_parameters[position++] = InterpreterValue<PARAMETERS>::ToWord(parameters), 0)... };
+        static_cast<void>(expansion);
+        static_cast<void>(position);
+    }
+
+
+    //*************************************************************************
+    //
+    // Template definitions for Interpretation.
+    //
+    //*************************************************************************
+
+    namespace Interpretation
+    {
+        template <typename T>
+        uint64_t SignExtend(uint64_t word)
+        {
+            const unsigned shift = 64 - 8 * sizeof(T);
+
+            return static_cast<uint64_t>(static_cast<int64_t>(word << shift) >> shift);
+        }
+
+
+        template <typename T>
+        uint64_t ValueMask()
+        {
+            return sizeof(T) == sizeof(uint64_t)
+                ? ~0ull
+                : (1ull << (8 * sizeof(T))) - 1;
+        }
+
+
+        template <typename T>
+        uint64_t OperandWord(T value)
+        {
+            return std::is_signed<T>::value
+                ? SignExtend<T>(InterpreterValue<T>::ToWord(value))
+                : InterpreterValue<T>::ToWord(value);
+        }
+
+
+        template <typename L, typename R>
+        bool IsRightIdentity(OpCode op, R right)
+        {
+            const uint64_t r = OperandWord(right);
+            const uint64_t mask = ValueMask<L>();
+            const unsigned bitCount = 8 * sizeof(L);
+            const unsigned shiftMask = bitCount == 64 ? 0x3f : 0x1f;
+
+            switch (op)
+            {
+            case OpCode::Add:
+            case OpCode::Or:
+            case OpCode::Sub:
+            case OpCode::Xor:
+                return (r & mask) == 0;
+
+            case OpCode::And:
+                return (r & mask) == mask;
+
+            case OpCode::IMul:
+                return (r & mask) == 1;
+
+            case OpCode::Sar:
+            case OpCode::Shl:
+            case OpCode::Shr:
+                return (r & shiftMask) == 0;
+
+            case OpCode::Rol:
+                return (r & shiftMask) % bitCount == 0;
+
+            default:
+                return false;
+            }
+        }
+
+
+        template <typename L, typename R>
+        bool IsAnnihilator(OpCode op, R operand)
+        {
+            return (op == OpCode::And || op == OpCode::IMul)
+                && (OperandWord(operand) & ValueMask<L>()) == 0;
+        }
+
+
+        template <typename L, typename R>
+        L ApplyBinary(OpCode op, L left, R right)
+        {
+            return ApplyBinary(op, left, right, std::is_floating_point<L>());
+        }
+
+
+        template <typename L, typename R>
+        L ApplyBinary(OpCode op, L left, R right, std::false_type /* isFloat */)
+        {
+            // Lower bits of the results of all supported operations other
+            // than the right shift don't depend on the upper bits of the
+            // operands, so the left operand is zero extended to make the
+            // right shift a logical one. The right operand is sign extended
+            // like the immediates are.
+            const uint64_t l = InterpreterValue<L>::ToWord(left);
+            const uint64_t r = OperandWord(right);
+
+            const unsigned bitCount = 8 * sizeof(L);
+            const unsigned shiftMask = bitCount == 64 ? 0x3f : 0x1f;
+            uint64_t result = 0;
+
+            switch (op)
+            {
+            case OpCode::Add:
+                result = l + r;
+                break;
+
+            case OpCode::And:
+                result = l & r;
+                break;
+
+            case OpCode::IMul:
+                result = l * r;
+                break;
+
+            case OpCode::Or:
+                result = l | r;
+                break;
+
+            case OpCode::Sub:
+                result = l - r;
+                break;
+
+            case OpCode::Xor:
+                result = l ^ r;
+                break;
+
+            case OpCode::Shl:
+                result = l << (r & shiftMask);
+                break;
+
+            case OpCode::Shr:
+                result = l >> (r & shiftMask);
+                break;
+
+            case OpCode::Sar:
+                result = static_cast<uint64_t>(
+                    static_cast<int64_t>(SignExtend<L>(l)) >> (r & shiftMask));
+                break;
+
+            case OpCode::Rol:
+                {
+                    const unsigned count = (r & shiftMask) % bitCount;
+
+                    result = count == 0
+                        ? l
+                        : (l << count) | (l >> (bitCount - count));
+                }
+                break;
+
+            default:
+                LogThrowAbort("Operation %s is not supported by the interpreter",
+                              X64CodeGenerator::OpCodeName(op));
+                break;
+            }
+
+            return InterpreterValue<L>::FromWord(result & ValueMask<L>());
+        }
+
+
+        template <typename L, typename R>
+        L ApplyBinary(OpCode op, L left, R right, std::true_type /* isFloat */)
+        {
+            switch (op)
+            {
+            case OpCode::Add:
+                return left + static_cast<L>(right);
+
+            case OpCode::IMul:
+                return left * static_cast<L>(right);
+
+            case OpCode::Sub:
+                return left - static_cast<L>(right);
+
+            case OpCode::Div:
+                return left / static_cast<L>(right);
+
+            // MinSS/SD and MaxSS/SD return the right operand unless the
+            // comparison holds, i.e. also if either operand is NaN.
+            case OpCode::Max:
+                return left > static_cast<L>(right) ? left : static_cast<L>(right);
+
+            case OpCode::Min:
+                return left < static_cast<L>(right) ? left : static_cast<L>(right);
+
+            case OpCode::And:
+            case OpCode::Or:
+            case OpCode::Xor:
+                {
+                    const uint64_t l = InterpreterValue<L>::ToWord(left);
+                    const uint64_t r = InterpreterValue<R>::ToWord(right);
+                    const uint64_t result = op == OpCode::And
+                        ? l & r
+                        : (op == OpCode::Or ? l | r : l ^ r);
+
+                    return InterpreterValue<L>::FromWord(result);
+                }
+
+            default:
+                LogThrowAbort("Operation %s is not supported by the interpreter",
+                              X64CodeGenerator::OpCodeName(op));
+                return left;
+            }
+        }
+
+
+        template <typename T>
+        T ApplyShld(T left, T right, uint8_t bitCount)
+        {
+            const unsigned valueBitCount = 8 * sizeof(T);
+            const unsigned count = bitCount & (valueBitCount == 64 ? 0x3f : 0x1f);
+
+            const uint64_t l = InterpreterValue<T>::ToWord(left);
+            const uint64_t r = InterpreterValue<T>::ToWord(right);
+
+            const uint64_t result = count == 0
+                ? l
+                : (l << count) | (r >> (valueBitCount - count));
+
+            return InterpreterValue<T>::FromWord(result & ValueMask<T>());
+        }
+
+
+        template <typename T>
+        T ApplyPopCount(T value)
+        {
+            uint64_t bits = InterpreterValue<T>::ToWord(value) & ValueMask<T>();
+            uint64_t count = 0;
+
+            // Clear the lowest set bit until none is left.
+            for (; bits != 0; bits &= bits - 1)
+            {
+                ++count;
+            }
+
+            return InterpreterValue<T>::FromWord(count);
+        }
+
+
+        template <typename T>
+        T ApplyLeadingZeroCount(T value)
+        {
+            uint64_t bits = InterpreterValue<T>::ToWord(value) & ValueMask<T>();
+            uint64_t count = 8 * sizeof(T);
+
+            for (; bits != 0; bits >>= 1)
+            {
+                --count;
+            }
+
+            return InterpreterValue<T>::FromWord(count);
+        }
+
+
+        template <typename T>
+        T ApplyTrailingZeroCount(T value)
+        {
+            const uint64_t bits = InterpreterValue<T>::ToWord(value) & ValueMask<T>();
+            uint64_t count = 0;
+
+            while (count < 8 * sizeof(T) && ((bits >> count) & 1) == 0)
+            {
+                ++count;
+            }
+
+            return InterpreterValue<T>::FromWord(count);
+        }
+
+
+        template <typename T>
+        T ApplyByteSwap(T value)
+        {
+            const uint64_t bits = InterpreterValue<T>::ToWord(value);
+            uint64_t result = 0;
+
+            for (unsigned i = 0; i < sizeof(T); ++i)
+            {
+                result = (result << 8) | ((bits >> (8 * i)) & 0xff);
+            }
+
+            return InterpreterValue<T>::FromWord(result);
+        }
+
+
+        template <typename T>
+        T ApplyAndNot(T left, T right)
+        {
+            const uint64_t l = InterpreterValue<T>::ToWord(left);
+            const uint64_t r = InterpreterValue<T>::ToWord(right);
+
+            return InterpreterValue<T>::FromWord(~l & r & ValueMask<T>());
+        }
+
+
+        template <typename T>
+        T ApplyExtractBits(T value, T mask)
+        {
+            const uint64_t v = InterpreterValue<T>::ToWord(value);
+            uint64_t m = InterpreterValue<T>::ToWord(mask) & ValueMask<T>();
+            uint64_t result = 0;
+
+            // Copy the bits selected by the mask, from the lowest one up, into
+            // the consecutive low bits of the result.
+            for (uint64_t bit = 1; m != 0; m &= m - 1, bit <<= 1)
+            {
+                if ((v & m & (~m + 1)) != 0)
+                {
+                    result |= bit;
+                }
+            }
+
+            return InterpreterValue<T>::FromWord(result);
+        }
+
+
+        template <typename T>
+        T ApplyDepositBits(T value, T mask)
+        {
+            const uint64_t v = InterpreterValue<T>::ToWord(value);
+            uint64_t m = InterpreterValue<T>::ToWord(mask) & ValueMask<T>();
+            uint64_t result = 0;
+
+            // Copy the consecutive low bits of the value into the positions
+            // selected by the mask, from the lowest one up.
+            for (uint64_t bit = 1; m != 0; m &= m - 1, bit <<= 1)
+            {
+                if ((v & bit) != 0)
+                {
+                    result |= m & (~m + 1);
+                }
+            }
+
+            return InterpreterValue<T>::FromWord(result);
+        }
+
+
+        template <typename T>
+        T ApplyZeroHighBits(T value, T index)
+        {
+            const uint64_t v = InterpreterValue<T>::ToWord(value);
+            const unsigned bitIndex = static_cast<unsigned>(InterpreterValue<T>::ToWord(index) & 0xff);
+
+            const uint64_t result = bitIndex < 8 * sizeof(T)
+                ? v & ((1ull << bitIndex) - 1)
+                : v;
+
+            return InterpreterValue<T>::FromWord(result & ValueMask<T>());
+        }
+
+
+        template <typename T>
+        T ApplyDiv(T left, T right)
+        {
+            AssertDivisionIsDefined(left, right);
+
+            return static_cast<T>(left / right);
+        }
+
+
+        template <typename T>
+        T ApplyMod(T left, T right)
+        {
+            AssertDivisionIsDefined(left, right);
+
+            return static_cast<T>(left % right);
+        }
+
+
+        template <typename T>
+        T ApplyMulHigh(T left, T right)
+        {
+            static_assert(std::is_integral<T>::value, "Invalid type for ApplyMulHigh().");
+
+            const unsigned bitCount = 8 * sizeof(T);
+            const uint64_t l = OperandWord(left);
+            const uint64_t r = OperandWord(right);
+            uint64_t high;
+
+            if (bitCount < 64)
+            {
+                // The double-width product fits into the word.
+                high = (l * r) >> bitCount;
+            }
+            else
+            {
+                // Add up the products of the 32-bit halves.
+                const uint64_t lowMask = 0xffffffff;
+                const uint64_t lowLow = (l & lowMask) * (r & lowMask);
+                const uint64_t highLow = (l >> 32) * (r & lowMask);
+                const uint64_t lowHigh = (l & lowMask) * (r >> 32);
+                const uint64_t middle = (lowLow >> 32) + (highLow & lowMask) + lowHigh;
+
+                high = (l >> 32) * (r >> 32) + (highLow >> 32) + (middle >> 32);
+
+                // The signed product subtracts the other operand from the
+                // upper half for each negative operand.
+                if (std::is_signed<T>::value)
+                {
+                    high -= (static_cast<int64_t>(l) < 0 ? r : 0)
+                            + (static_cast<int64_t>(r) < 0 ? l : 0);
+                }
+            }
+
+            return InterpreterValue<T>::FromWord(high & ValueMask<T>());
+        }
+
+
+        template <typename T>
+        void AssertDivisionIsDefined(T left, T right)
+        {
+            static_assert(std::is_integral<T>::value, "Division requires integer operands.");
+
+            LogThrowAssert(right != 0, "Division by zero");
+            LogThrowAssert(!std::is_signed<T>::value
+                           || left != (std::numeric_limits<T>::min)()
+                           || right != static_cast<T>(-1),
+                           "Overflow in signed division");
+        }
+
+
+        template <typename T, typename INDEX>
+        T ApplyScaledIndex(T base, INDEX index, uint8_t scale)
+        {
+            // Lower bits of the result don't depend on the upper bits of the
+            // operands, so both are zero extended.
+            const uint64_t result = InterpreterValue<T>::ToWord(base)
+                                    + InterpreterValue<INDEX>::ToWord(index) * scale;
+
+            return InterpreterValue<T>::FromWord(result & ValueMask<T>());
+        }
+
+
+        template <typename T>
+        bool Compare(JccType jcc, T left, T right)
+        {
+            return Compare(jcc, left, right, std::is_floating_point<T>());
+        }
+
+
+        template <typename T>
+        bool Compare(JccType jcc, T left, T right, std::false_type /* isFloat */)
+        {
+            // Emulates the flags set by CMP.
+            const uint64_t l = InterpreterValue<T>::ToWord(left);
+            const uint64_t r = InterpreterValue<T>::ToWord(right);
+            const uint64_t difference = (l - r) & ValueMask<T>();
+
+            const bool isSignedLess = static_cast<int64_t>(SignExtend<T>(l))
+                                      < static_cast<int64_t>(SignExtend<T>(r));
+
+            Flags flags;
+            flags.m_zero = l == r;
+            flags.m_carry = l < r;
+            flags.m_sign = (difference >> (8 * sizeof(T) - 1)) != 0;
+            flags.m_overflow = flags.m_sign != isSignedLess;
+
+            // Parity flag is set if the lowest byte has an even number of bits set.
+            uint8_t lowByte = static_cast<uint8_t>(difference);
+            lowByte ^= lowByte >> 4;
+            lowByte ^= lowByte >> 2;
+            lowByte ^= lowByte >> 1;
+            flags.m_parity = (lowByte & 1) == 0;
+
+            return IsConditionMet(jcc, flags);
+        }
+
+
+        template <typename T>
+        bool Compare(JccType jcc, T left, T right, std::true_type /* isFloat */)
+        {
+            // Emulates the flags set by COMISS/COMISD, which set all of ZF,
+            // PF and CF if either value is NaN.
+            const bool isUnordered = left != left || right != right;
+
+            Flags flags;
+            flags.m_zero = isUnordered || left == right;
+            flags.m_carry = isUnordered || left < right;
+            flags.m_sign = false;
+            flags.m_overflow = false;
+            flags.m_parity = isUnordered;
+
+            return IsConditionMet(jcc, flags);
+        }
+
+
+        template <typename TO, typename FROM>
+        TO Cast(FROM value)
+        {
+            return Cast<TO, FROM>(value,
+                                  std::integral_constant<bool,
+                                                         std::is_arithmetic<FROM>::value
+                                                         && std::is_arithmetic<TO>::value>());
+        }
+
+
+        template <typename TO, typename FROM>
+        TO Cast(FROM value, std::false_type /* isArithmetic */)
+        {
+            // Casts between pointers, references and integers of the same size
+            // reinterpret the value.
+            return InterpreterValue<TO>::FromWord(InterpreterValue<FROM>::ToWord(value));
+        }
+
+
+        template <typename TO, typename FROM>
+        TO Cast(FROM value, std::true_type /* isArithmetic */)
+        {
+            return static_cast<TO>(value);
+        }
+    }
+}
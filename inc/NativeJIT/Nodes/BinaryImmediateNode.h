@@ -46,6 +46,12 @@ namespace NativeJIT
         virtual Storage<L> CodeGenValue(ExpressionTree& tree) override;
 
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual L InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -98,4 +104,76 @@ namespace NativeJIT
         out << ", left = " << m_left.GetId()
             << ", right = " << m_right;
     }
+
+
+    template <OpCode OP, typename L, typename R>
+    void BinaryImmediateNode<OP, L, R>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_left);
+        builder.AddValue(m_right);
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    void BinaryImmediateNode<OP, L, R>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_left);
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    bool BinaryImmediateNode<OP, L, R>::IsInterpretable() const
+    {
+        return Interpretation::IsSupported(OP, std::is_floating_point<L>::value);
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    L BinaryImmediateNode<OP, L, R>::InterpretValue(Interpreter& interpreter)
+    {
+        return Interpretation::ApplyBinary(OP, m_left.Interpret(interpreter), m_right);
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    void BinaryImmediateNode<OP, L, R>::ReleaseReferencesToChildren()
+    {
+        m_left.DecrementParentCount();
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    bool BinaryImmediateNode<OP, L, R>::Simplify()
+    {
+        if (!IsInterpretable())
+        {
+            return false;
+        }
+
+        if (m_left.IsConstant())
+        {
+            this->FoldToConstant(Interpretation::ApplyBinary(OP, m_left.GetConstantValue(), m_right));
+            return true;
+        }
+
+        // See BinaryNode::SimplifyIdentities() for why floats are excluded.
+        if (std::is_floating_point<L>::value)
+        {
+            return false;
+        }
+
+        if (Interpretation::IsRightIdentity<L>(OP, m_right))
+        {
+            this->FoldToNode(m_left);
+            return true;
+        }
+
+        if (Interpretation::IsAnnihilator<L>(OP, m_right))
+        {
+            this->FoldToConstant(InterpreterValue<L>::FromWord(0));
+            return true;
+        }
+
+        return false;
+    }
 }
@@ -23,6 +23,8 @@
 
 #pragma once
 
+#include <type_traits>
+
 #include "NativeJIT/CodeGen/X64CodeGenerator.h"     // OpCode type.
 #include "NativeJIT/CodeGenHelpers.h"
 #include "NativeJIT/Nodes/Node.h"
@@ -39,6 +41,12 @@ namespace NativeJIT
         virtual ExpressionTree::Storage<L> CodeGenValue(ExpressionTree& tree) override;
 
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual L InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -46,6 +54,15 @@ namespace NativeJIT
         // resources other than memory from the arena allocator.
         ~BinaryNode();
 
+        // Applies the algebraic identities which hold only for integers.
+        bool SimplifyIdentities(std::false_type /* isFloat */);
+        bool SimplifyIdentities(std::true_type /* isFloat */);
+
+        // Returns the right node if it can replace the node, i.e. if its
+        // type matches, or nullptr.
+        Node<L>* GetRightAsLeftType(std::true_type /* isSameType */);
+        Node<L>* GetRightAsLeftType(std::false_type /* isSameType */);
+
         Node<L>& m_left;
         Node<R>& m_right;
     };
@@ -108,4 +125,127 @@ namespace NativeJIT
         out << ", left = " << m_left.GetId();
         out << ", right = " << m_right.GetId();
     }
+
+
+    template <OpCode OP, typename L, typename R>
+    void BinaryNode<OP, L, R>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_left);
+        builder.AddNode(m_right);
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    void BinaryNode<OP, L, R>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_left);
+        children.push_back(&m_right);
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    bool BinaryNode<OP, L, R>::IsInterpretable() const
+    {
+        return Interpretation::IsSupported(OP, std::is_floating_point<L>::value);
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    L BinaryNode<OP, L, R>::InterpretValue(Interpreter& interpreter)
+    {
+        return Interpretation::ApplyBinary(OP,
+                                           m_left.Interpret(interpreter),
+                                           m_right.Interpret(interpreter));
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    void BinaryNode<OP, L, R>::ReleaseReferencesToChildren()
+    {
+        m_left.DecrementParentCount();
+        m_right.DecrementParentCount();
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    bool BinaryNode<OP, L, R>::Simplify()
+    {
+        if (!IsInterpretable())
+        {
+            return false;
+        }
+
+        if (m_left.IsConstant() && m_right.IsConstant())
+        {
+            this->FoldToConstant(Interpretation::ApplyBinary(OP,
+                                                             m_left.GetConstantValue(),
+                                                             m_right.GetConstantValue()));
+            return true;
+        }
+
+        return SimplifyIdentities(std::is_floating_point<L>());
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    bool BinaryNode<OP, L, R>::SimplifyIdentities(std::false_type /* isFloat */)
+    {
+        if (m_right.IsConstant())
+        {
+            if (Interpretation::IsRightIdentity<L>(OP, m_right.GetConstantValue()))
+            {
+                this->FoldToNode(m_left);
+                return true;
+            }
+
+            if (Interpretation::IsAnnihilator<L>(OP, m_right.GetConstantValue()))
+            {
+                this->FoldToConstant(InterpreterValue<L>::FromWord(0));
+                return true;
+            }
+        }
+
+        Node<L>* right = GetRightAsLeftType(std::is_same<L, R>());
+
+        if (m_left.IsConstant() && right != nullptr)
+        {
+            if (Interpretation::IsCommutative(OP)
+                && Interpretation::IsRightIdentity<L>(OP, m_left.GetConstantValue()))
+            {
+                this->FoldToNode(*right);
+                return true;
+            }
+
+            if (Interpretation::IsAnnihilator<L>(OP, m_left.GetConstantValue()))
+            {
+                this->FoldToConstant(InterpreterValue<L>::FromWord(0));
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    bool BinaryNode<OP, L, R>::SimplifyIdentities(std::true_type /* isFloat */)
+    {
+        // The identities don't hold for floating point values, f. ex. x + 0.0
+        // is 0.0 rather than -0.0 for x = -0.0 and x * 0.0 is NaN for x = NaN.
+        return false;
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    Node<L>* BinaryNode<OP, L, R>::GetRightAsLeftType(std::true_type /* isSameType */)
+    {
+        return &m_right;
+    }
+
+
+    template <OpCode OP, typename L, typename R>
+    Node<L>* BinaryNode<OP, L, R>::GetRightAsLeftType(std::false_type /* isSameType */)
+    {
+        return nullptr;
+    }
 }
@@ -0,0 +1,222 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#pragma once
+
+#include <type_traits>
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"     // OpCode type.
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    enum class BitBinaryOperation
+    {
+        AndNot,         // ~left & right.
+        DepositBits,    // pdep value, mask.
+        ExtractBits,    // pext value, mask.
+        ZeroHighBits    // bzhi value, index.
+    };
+
+
+    // Implements the BMI operations on 32 and 64-bit integers with andn
+    // (BMI1), pdep, pext and bzhi (BMI2). The factory uses the node only if
+    // the code generator supports the instruction set and zero extends
+    // narrower operands to 32 bits. Since the VEX encoded instructions don't
+    // overwrite their sources, the result is written into the register of
+    // the left operand without moving it first.
+    template <typename T, BitBinaryOperation OP>
+    class BitBinaryNode : public Node<T>
+    {
+    public:
+        BitBinaryNode(ExpressionTree& tree, Node<T>& left, Node<T>& right);
+
+        virtual Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+    private:
+        static_assert(std::is_integral<T>::value && (sizeof(T) == 4 || sizeof(T) == 8),
+                      "BitBinaryNode requires 32 or 64-bit integer operands.");
+
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~BitBinaryNode();
+
+        static T Apply(T left, T right);
+
+        Node<T>& m_left;
+        Node<T>& m_right;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for BitBinaryNode
+    //
+    //*************************************************************************
+    template <typename T, BitBinaryOperation OP>
+    BitBinaryNode<T, OP>::BitBinaryNode(ExpressionTree& tree,
+                                        Node<T>& left,
+                                        Node<T>& right)
+        : Node<T>(tree),
+          m_left(left),
+          m_right(right)
+    {
+        m_left.IncrementParentCount();
+        m_right.IncrementParentCount();
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    Storage<T> BitBinaryNode<T, OP>::CodeGenValue(ExpressionTree& tree)
+    {
+        auto & code = tree.GetCodeGenerator();
+
+        Storage<T> left;
+        Storage<T> right;
+
+        this->CodeGenInOrder(tree,
+                             m_left, left,
+                             m_right, right);
+
+        {
+            auto dest = left.ConvertToDirect(true);
+            ReferenceCounter leftPin = left.GetPin();
+            auto src = right.ConvertToDirect(false);
+
+            switch (OP)
+            {
+            case BitBinaryOperation::AndNot:
+                code.EmitVex<OpCode::AndN>(dest, dest, src);
+                break;
+
+            case BitBinaryOperation::DepositBits:
+                code.EmitVex<OpCode::Pdep>(dest, dest, src);
+                break;
+
+            case BitBinaryOperation::ExtractBits:
+                code.EmitVex<OpCode::Pext>(dest, dest, src);
+                break;
+
+            default:
+                code.EmitVex<OpCode::Bzhi>(dest, dest, src);
+                break;
+            }
+        }
+
+        return left;
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    void BitBinaryNode<T, OP>::Print(std::ostream& out) const
+    {
+        static char const * const c_names[] = { "AndNot", "DepositBits", "ExtractBits", "ZeroHighBits" };
+
+        this->PrintCoreProperties(out, c_names[static_cast<unsigned>(OP)]);
+
+        out << ", left = " << m_left.GetId()
+            << ", right = " << m_right.GetId();
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    void BitBinaryNode<T, OP>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_left);
+        builder.AddNode(m_right);
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    void BitBinaryNode<T, OP>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_left);
+        children.push_back(&m_right);
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    bool BitBinaryNode<T, OP>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    T BitBinaryNode<T, OP>::InterpretValue(Interpreter& interpreter)
+    {
+        return Apply(m_left.Interpret(interpreter), m_right.Interpret(interpreter));
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    void BitBinaryNode<T, OP>::ReleaseReferencesToChildren()
+    {
+        m_left.DecrementParentCount();
+        m_right.DecrementParentCount();
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    bool BitBinaryNode<T, OP>::Simplify()
+    {
+        if (!m_left.IsConstant() || !m_right.IsConstant())
+        {
+            return false;
+        }
+
+        this->FoldToConstant(Apply(m_left.GetConstantValue(), m_right.GetConstantValue()));
+        return true;
+    }
+
+
+    template <typename T, BitBinaryOperation OP>
+    T BitBinaryNode<T, OP>::Apply(T left, T right)
+    {
+        switch (OP)
+        {
+        case BitBinaryOperation::AndNot:
+            return Interpretation::ApplyAndNot(left, right);
+
+        case BitBinaryOperation::DepositBits:
+            return Interpretation::ApplyDepositBits(left, right);
+
+        case BitBinaryOperation::ExtractBits:
+            return Interpretation::ApplyExtractBits(left, right);
+
+        default:
+            return Interpretation::ApplyZeroHighBits(left, right);
+        }
+    }
+}
@@ -0,0 +1,203 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#pragma once
+
+#include <type_traits>
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"     // OpCode type.
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    enum class BitUnaryOperation
+    {
+        ByteSwap,
+        LeadingZeroCount,
+        PopCount,
+        TrailingZeroCount
+    };
+
+
+    // Implements the bit counts and the byte swap of 32 and 64-bit integers
+    // with popcnt, lzcnt, tzcnt and bswap. The factory uses the node only if
+    // the code generator supports the instruction and zero extends narrower
+    // operands to 32 bits. The counts write the result into the register of
+    // the operand, which avoids the false dependency on the destination
+    // register some processors have for these instructions.
+    template <typename T, BitUnaryOperation OP>
+    class BitUnaryNode : public Node<T>
+    {
+    public:
+        BitUnaryNode(ExpressionTree& tree, Node<T>& operand);
+
+        virtual Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+    private:
+        static_assert(std::is_integral<T>::value && (sizeof(T) == 4 || sizeof(T) == 8),
+                      "BitUnaryNode requires a 32 or 64-bit integer operand.");
+
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~BitUnaryNode();
+
+        static T Apply(T value);
+
+        Node<T>& m_operand;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for BitUnaryNode
+    //
+    //*************************************************************************
+    template <typename T, BitUnaryOperation OP>
+    BitUnaryNode<T, OP>::BitUnaryNode(ExpressionTree& tree, Node<T>& operand)
+        : Node<T>(tree),
+          m_operand(operand)
+    {
+        m_operand.IncrementParentCount();
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    Storage<T> BitUnaryNode<T, OP>::CodeGenValue(ExpressionTree& tree)
+    {
+        auto & code = tree.GetCodeGenerator();
+        Storage<T> value = m_operand.CodeGen(tree);
+
+        auto dest = value.ConvertToDirect(true);
+
+        switch (OP)
+        {
+        case BitUnaryOperation::ByteSwap:
+            code.Emit<OpCode::BSwap>(dest);
+            break;
+
+        case BitUnaryOperation::LeadingZeroCount:
+            code.Emit<OpCode::LZCnt>(dest, dest);
+            break;
+
+        case BitUnaryOperation::PopCount:
+            code.Emit<OpCode::PopCnt>(dest, dest);
+            break;
+
+        default:
+            code.Emit<OpCode::TZCnt>(dest, dest);
+            break;
+        }
+
+        return value;
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    void BitUnaryNode<T, OP>::Print(std::ostream& out) const
+    {
+        static char const * const c_names[] = { "ByteSwap", "LeadingZeroCount", "PopCount", "TrailingZeroCount" };
+
+        this->PrintCoreProperties(out, c_names[static_cast<unsigned>(OP)]);
+
+        out << ", operand = " << m_operand.GetId();
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    void BitUnaryNode<T, OP>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_operand);
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    void BitUnaryNode<T, OP>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_operand);
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    bool BitUnaryNode<T, OP>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    T BitUnaryNode<T, OP>::InterpretValue(Interpreter& interpreter)
+    {
+        return Apply(m_operand.Interpret(interpreter));
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    void BitUnaryNode<T, OP>::ReleaseReferencesToChildren()
+    {
+        m_operand.DecrementParentCount();
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    bool BitUnaryNode<T, OP>::Simplify()
+    {
+        if (!m_operand.IsConstant())
+        {
+            return false;
+        }
+
+        this->FoldToConstant(Apply(m_operand.GetConstantValue()));
+        return true;
+    }
+
+
+    template <typename T, BitUnaryOperation OP>
+    T BitUnaryNode<T, OP>::Apply(T value)
+    {
+        switch (OP)
+        {
+        case BitUnaryOperation::ByteSwap:
+            return Interpretation::ApplyByteSwap(value);
+
+        case BitUnaryOperation::LeadingZeroCount:
+            return Interpretation::ApplyLeadingZeroCount(value);
+
+        case BitUnaryOperation::PopCount:
+            return Interpretation::ApplyPopCount(value);
+
+        default:
+            return Interpretation::ApplyTrailingZeroCount(value);
+        }
+    }
+}
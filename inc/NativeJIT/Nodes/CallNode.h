@@ -88,6 +88,10 @@ namespace NativeJIT
         //
         virtual ExpressionTree::Storage<R> CodeGenValue(ExpressionTree& tree) override;
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual void ReleaseReferencesToChildren() override;
 
     protected:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -119,6 +123,16 @@ namespace NativeJIT
 
             // Prints the contents of the child to standard output for debugging.
             virtual void Print(std::ostream& out) const = 0;
+
+            // Describes the child's expression to the builder.
+            virtual void DescribeStructure(StructuralKeyBuilder& builder) const = 0;
+
+            // Appends the child's expression to the vector.
+            virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const = 0;
+
+            // Releases the reference to the child's expression when the call
+            // is optimized away.
+            virtual void ReleaseReference() = 0;
         };
 
 
@@ -128,10 +142,17 @@ namespace NativeJIT
         public:
             TypedChild(Node<T>& expression);
 
+            // Returns the value of the child's expression when the call is
+            // evaluated by the interpreter.
+            T Interpret(Interpreter& interpreter);
+
             //
             // Overrides of Child methods.
             //
             virtual void Release();
+            virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+            virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+            virtual void ReleaseReference() override;
 
         protected:
             // Pins the storage register so that it cannot be spilled until
@@ -219,6 +240,8 @@ namespace NativeJIT
         CallNode(ExpressionTree& tree,
                  Node<FunctionPointer>& function);
 
+        virtual R InterpretValue(Interpreter& interpreter) override;
+
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
         // so its destructor will never be called. Therefore, it should hold no
@@ -239,6 +262,8 @@ namespace NativeJIT
                  Node<FunctionPointer>& function,
                  Node<P1>& p1);
 
+        virtual R InterpretValue(Interpreter& interpreter) override;
+
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
         // so its destructor will never be called. Therefore, it should hold no
@@ -261,6 +286,8 @@ namespace NativeJIT
                  Node<P1>& p1,
                  Node<P2>& p2);
 
+        virtual R InterpretValue(Interpreter& interpreter) override;
+
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
         // so its destructor will never be called. Therefore, it should hold no
@@ -285,6 +312,8 @@ namespace NativeJIT
                  Node<P2>& p2,
                  Node<P3>& p3);
 
+        virtual R InterpretValue(Interpreter& interpreter) override;
+
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
         // so its destructor will never be called. Therefore, it should hold no
@@ -311,6 +340,8 @@ namespace NativeJIT
                  Node<P3>& p3,
                  Node<P4>& p4);
 
+        virtual R InterpretValue(Interpreter& interpreter) override;
+
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
         // so its destructor will never be called. Therefore, it should hold no
@@ -422,6 +453,44 @@ namespace NativeJIT
     }
 
 
+    template <typename R, unsigned PARAMETERCOUNT>
+    void CallNodeBase<R, PARAMETERCOUNT>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        // The function pointer child describes the call target.
+        for (unsigned i = 0 ; i < c_childCount; ++i)
+        {
+            m_children[i]->DescribeStructure(builder);
+        }
+    }
+
+
+    template <typename R, unsigned PARAMETERCOUNT>
+    void CallNodeBase<R, PARAMETERCOUNT>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        for (unsigned i = 0 ; i < c_childCount; ++i)
+        {
+            m_children[i]->GetChildren(children);
+        }
+    }
+
+
+    template <typename R, unsigned PARAMETERCOUNT>
+    bool CallNodeBase<R, PARAMETERCOUNT>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename R, unsigned PARAMETERCOUNT>
+    void CallNodeBase<R, PARAMETERCOUNT>::ReleaseReferencesToChildren()
+    {
+        for (Child* child : m_children)
+        {
+            child->ReleaseReference();
+        }
+    }
+
+
     //*************************************************************************
     //
     // Template definitions for
@@ -437,6 +506,14 @@ namespace NativeJIT
     }
 
 
+    template <typename R, unsigned PARAMETERCOUNT>
+    template <typename T>
+    void CallNodeBase<R, PARAMETERCOUNT>::TypedChild<T>::ReleaseReference()
+    {
+        m_expression.DecrementParentCount();
+    }
+
+
     template <typename R, unsigned PARAMETERCOUNT>
     template <typename T>
     void CallNodeBase<R, PARAMETERCOUNT>::TypedChild<T>::Release()
@@ -447,6 +524,30 @@ namespace NativeJIT
     }
 
 
+    template <typename R, unsigned PARAMETERCOUNT>
+    template <typename T>
+    void CallNodeBase<R, PARAMETERCOUNT>::TypedChild<T>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_expression);
+    }
+
+
+    template <typename R, unsigned PARAMETERCOUNT>
+    template <typename T>
+    void CallNodeBase<R, PARAMETERCOUNT>::TypedChild<T>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_expression);
+    }
+
+
+    template <typename R, unsigned PARAMETERCOUNT>
+    template <typename T>
+    T CallNodeBase<R, PARAMETERCOUNT>::TypedChild<T>::Interpret(Interpreter& interpreter)
+    {
+        return m_expression.Interpret(interpreter);
+    }
+
+
     template <typename R, unsigned PARAMETERCOUNT>
     template <typename T>
     void CallNodeBase<R, PARAMETERCOUNT>::TypedChild<T>::PinStorageRegister()
@@ -572,6 +673,17 @@ namespace NativeJIT
             this->m_storage = regStorage;
         }
 
+        // As for the function pointer, other owners of a parameter staged in
+        // the result register must be spilled out of it, or restoring the
+        // register after the call would overwrite the returned result. This
+        // happens with floating point calls, where the first parameter and
+        // the result share XMM0.
+        if (!this->m_storage.IsSoleDataOwner()
+            && m_destination.IsSameHardwareRegister(tree.GetResultRegister<R>()))
+        {
+            this->m_storage.TakeSoleOwnershipOfDirect();
+        }
+
         // DESIGN NOTE: There's room for optimization if the data was already in the
         // correct register and shared. If there are some free non-volatile
         // registers, it would be better to enforce sole ownership of m_storage
@@ -708,4 +820,45 @@ namespace NativeJIT
         this->m_children[3] = &m_p3;
         this->m_children[4] = &m_p4;
     }
+
+
+    template <typename R>
+    R CallNode<R>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_f.Interpret(interpreter)();
+    }
+
+
+    template <typename R, typename P1>
+    R CallNode<R, P1>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_f.Interpret(interpreter)(m_p1.Interpret(interpreter));
+    }
+
+
+    template <typename R, typename P1, typename P2>
+    R CallNode<R, P1, P2>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_f.Interpret(interpreter)(m_p1.Interpret(interpreter),
+                                          m_p2.Interpret(interpreter));
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3>
+    R CallNode<R, P1, P2, P3>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_f.Interpret(interpreter)(m_p1.Interpret(interpreter),
+                                          m_p2.Interpret(interpreter),
+                                          m_p3.Interpret(interpreter));
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    R CallNode<R, P1, P2, P3, P4>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_f.Interpret(interpreter)(m_p1.Interpret(interpreter),
+                                          m_p2.Interpret(interpreter),
+                                          m_p3.Interpret(interpreter),
+                                          m_p4.Interpret(interpreter));
+    }
 }
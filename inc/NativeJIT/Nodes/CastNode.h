@@ -24,6 +24,7 @@
 #pragma once
 
 #include <algorithm>    // For std::max
+#include <limits>       // For std::numeric_limits
 #include <type_traits>
 
 #include "NativeJIT/ExpressionNodeFactory.h"
@@ -194,6 +195,12 @@ namespace NativeJIT
 
         virtual Storage<TO> CodeGenValue(ExpressionTree& tree) override;
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual TO InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -203,6 +210,13 @@ namespace NativeJIT
 
         typedef Casting::Traits<TO, FROM> Traits;
 
+        // Returns whether the cast of the constant can be computed at compile
+        // time with the same result as the generated code. Conversion of
+        // floats out of the range of the integer type is undefined in C++
+        // while the x64 instructions return the "integer indefinite" value.
+        static bool CanFold(FROM value, std::true_type /* isFloatToInt */);
+        static bool CanFold(FROM value, std::false_type /* isFloatToInt */);
+
         Node<FROM>& m_from;
     };
 
@@ -220,6 +234,12 @@ namespace NativeJIT
 
         virtual Storage<TO> CodeGenValue(ExpressionTree& tree) override;
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual TO InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -269,6 +289,76 @@ namespace NativeJIT
     }
 
 
+    template <typename TO, typename FROM>
+    void CastNode<TO, FROM, true>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_from);
+    }
+
+
+    template <typename TO, typename FROM>
+    void CastNode<TO, FROM, true>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_from);
+    }
+
+
+    template <typename TO, typename FROM>
+    bool CastNode<TO, FROM, true>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename TO, typename FROM>
+    TO CastNode<TO, FROM, true>::InterpretValue(Interpreter& interpreter)
+    {
+        return Interpretation::Cast<TO, FROM>(m_from.Interpret(interpreter));
+    }
+
+
+    template <typename TO, typename FROM>
+    void CastNode<TO, FROM, true>::ReleaseReferencesToChildren()
+    {
+        m_from.DecrementParentCount();
+    }
+
+
+    template <typename TO, typename FROM>
+    bool CastNode<TO, FROM, true>::Simplify()
+    {
+        if (std::is_reference<TO>::value
+            || !m_from.IsConstant()
+            || !CanFold(m_from.GetConstantValue(),
+                        std::integral_constant<bool, Traits::c_castType == Casting::Cast::FloatToInt>()))
+        {
+            return false;
+        }
+
+        this->FoldToConstant(Interpretation::Cast<TO, FROM>(m_from.GetConstantValue()));
+        return true;
+    }
+
+
+    template <typename TO, typename FROM>
+    bool CastNode<TO, FROM, true>::CanFold(FROM value, std::true_type /* isFloatToInt */)
+    {
+        // The bounds of the integer types are powers of two and thus exactly
+        // representable as floats. NaN fails both comparisons.
+        typedef typename std::remove_cv<TO>::type Integer;
+
+        return value >= static_cast<FROM>(std::numeric_limits<Integer>::min())
+            && value < -static_cast<FROM>(std::numeric_limits<Integer>::min());
+    }
+
+
+    template <typename TO, typename FROM>
+    bool CastNode<TO, FROM, true>::CanFold(FROM /* value */, std::false_type /* isFloatToInt */)
+    {
+        return true;
+    }
+
+
     //*************************************************************************
     //
     // Template definitions for composite CastNode.
@@ -303,6 +393,56 @@ namespace NativeJIT
     }
 
 
+    template <typename TO, typename FROM>
+    void CastNode<TO, FROM, false>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_conversionNode);
+    }
+
+
+    template <typename TO, typename FROM>
+    void CastNode<TO, FROM, false>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_conversionNode);
+    }
+
+
+    template <typename TO, typename FROM>
+    bool CastNode<TO, FROM, false>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename TO, typename FROM>
+    TO CastNode<TO, FROM, false>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_conversionNode.Interpret(interpreter);
+    }
+
+
+    template <typename TO, typename FROM>
+    void CastNode<TO, FROM, false>::ReleaseReferencesToChildren()
+    {
+        m_conversionNode.DecrementParentCount();
+    }
+
+
+    template <typename TO, typename FROM>
+    bool CastNode<TO, FROM, false>::Simplify()
+    {
+        // The composite node has already been simplified, so only the node
+        // itself is left to be removed if the conversion was folded.
+        if (!m_conversionNode.IsConstant())
+        {
+            return false;
+        }
+
+        this->FoldToNode(m_conversionNode);
+        return true;
+    }
+
+
     namespace Casting
     {
         //
@@ -25,6 +25,7 @@
 
 #include <algorithm>    // For std::max
 
+#include "NativeJIT/BranchProfile.h"
 #include "NativeJIT/CodeGen/X64CodeGenerator.h"
 #include "NativeJIT/CodeGenHelpers.h"
 #include "NativeJIT/ExpressionTree.h"
@@ -51,11 +52,23 @@ namespace NativeJIT
         //
         virtual void CodeGenFlags(ExpressionTree& tree) = 0;
 
+        // Evaluates the condition and jumps to the target if its value is
+        // jumpIfTrue, falls through otherwise. The register allocation is the
+        // same at the target and on the fall through path. By default, tests
+        // the flags set by CodeGenFlags() with a single conditional jump.
+        virtual void CodeGenBranch(ExpressionTree& tree, Label target, bool jumpIfTrue);
+
 
         // Increments the number of parents that use the node's CodeGenFlags()
         // method rather than the usual CodeGen() method.
         void IncrementFlagsParentCount();
 
+        // Decrements the number of parents as set through
+        // IncrementFlagsParentCount(). Used only when nodes are optimized away.
+        void DecrementFlagsParentCount();
+
+        unsigned GetFlagsParentCount() const;
+
     protected:
         // WARNING: This class is designed to be allocated by an arena allocator,
         // so its destructor will never be called. Therefore, it should hold no
@@ -64,6 +77,13 @@ namespace NativeJIT
         // called implicitly by child class constructors if they throw.
         ~FlagExpressionNode() {}
 
+        // Each parent that uses CodeGenFlags() evaluates the children which
+        // CodeGenFlags() uses anew, so every such parent beyond the first one
+        // needs its own reference to them. These methods add and release one
+        // such reference to each of the children.
+        virtual void AddFlagsChildReferences() = 0;
+        virtual void ReleaseFlagsChildReferences() = 0;
+
     private:
         unsigned m_flagsParentCount;
     };
@@ -83,6 +103,12 @@ namespace NativeJIT
         // Overrides of Node methods.
         //
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
         //
         // Overrides of Node<T> methods.
@@ -95,6 +121,13 @@ namespace NativeJIT
         // resources other than memory from the arena allocator.
         ~ConditionalNode();
 
+        // Generates the code for the layout in which the code for the less
+        // frequent outcome of the condition is moved out of line.
+        ExpressionTree::Storage<T> CodeGenWithColdBranch(ExpressionTree& tree,
+                                                         Storage<T>& trueValue,
+                                                         Storage<T>& falseValue,
+                                                         bool isTrueHot);
+
         FlagExpressionNode<JCC>& m_condition;
         Node<T>& m_trueExpression;
         Node<T>& m_falseExpression;
@@ -114,6 +147,12 @@ namespace NativeJIT
         // Overrides of Node methods.
         //
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual bool InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
 
         //
@@ -127,6 +166,10 @@ namespace NativeJIT
         //
         virtual void CodeGenFlags(ExpressionTree& tree) override;
 
+    protected:
+        virtual void AddFlagsChildReferences() override;
+        virtual void ReleaseFlagsChildReferences() override;
+
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
         // so its destructor will never be called. Therefore, it should hold no
@@ -160,14 +203,61 @@ namespace NativeJIT
     }
 
 
+    template <JccType JCC>
+    void FlagExpressionNode<JCC>::CodeGenBranch(ExpressionTree& tree,
+                                                Label target,
+                                                bool jumpIfTrue)
+    {
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        CodeGenFlags(tree);
+
+        if (jumpIfTrue)
+        {
+            code.EmitConditionalJump<JCC>(target);
+        }
+        else
+        {
+            code.EmitConditionalJump<InverseJcc<JCC>::value>(target);
+        }
+    }
+
+
     template <JccType JCC>
     void FlagExpressionNode<JCC>::IncrementFlagsParentCount()
     {
+        if (m_flagsParentCount > 0)
+        {
+            AddFlagsChildReferences();
+        }
+
         ++m_flagsParentCount;
         MarkReferenced();
     }
 
 
+    template <JccType JCC>
+    void FlagExpressionNode<JCC>::DecrementFlagsParentCount()
+    {
+        LogThrowAssert(m_flagsParentCount > 0,
+                       "Cannot decrement flags parent count of node %u with zero flags parents",
+                       GetId());
+        --m_flagsParentCount;
+
+        if (m_flagsParentCount > 0)
+        {
+            ReleaseFlagsChildReferences();
+        }
+    }
+
+
+    template <JccType JCC>
+    unsigned FlagExpressionNode<JCC>::GetFlagsParentCount() const
+    {
+        return m_flagsParentCount;
+    }
+
+
     //*************************************************************************
     //
     // Template definitions for ConditionalNode
@@ -206,33 +296,35 @@ namespace NativeJIT
 
 
     template <typename T, JccType JCC>
-    typename ExpressionTree::Storage<T> ConditionalNode<T, JCC>::CodeGenValue(ExpressionTree& tree)
+    void ConditionalNode<T, JCC>::DescribeStructure(StructuralKeyBuilder& builder) const
     {
-        X64CodeGenerator& code = tree.GetCodeGenerator();
+        builder.AddNode(m_condition);
+        builder.AddNode(m_trueExpression);
+        builder.AddNode(m_falseExpression);
+    }
 
-        Label conditionIsTrue = code.AllocateLabel();
-        Label testCompleted = code.AllocateLabel();
 
-        // TODO: Evaluating both expressions in advance of the test is
-        // sub-optimal, but it is currently required to guarantee consistent
-        // state: the execution in NativeJIT has a continuous flow regardless
-        // of the outcome of the (runtime) condition whereas the generated x64
-        // code has two branches and each of them can have independent impact on
-        // allocated and spilled registers. To have each expression evaluated
-        // only if its branch is hit, the NativeJIT code would have to ensure
-        // that the state of the allocated/spilled registers (i.e. all Storages)
-        // is consistent once those two x64 branches converge back.
-        //
-        // A related note: if this is addressed, then it may be possible to
-        // also address the fact that common subexpression (CSE) code is
-        // inefficient in some cases because some CSEs may not need to be
-        // evaluated. For example:
-        //   (v == 1)? a : ((v == 2) ? a + b : b + c)
-        //
-        // Depending on the value of v, either a or c may not need to be
-        // evaluated. One possibility is to lazily evaluate CSEs *at runtime*
-        // as they are needed.
-        // See bug#27
+    template <typename T, JccType JCC>
+    void ConditionalNode<T, JCC>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_condition);
+        children.push_back(&m_trueExpression);
+        children.push_back(&m_falseExpression);
+    }
+
+
+    template <typename T, JccType JCC>
+    typename ExpressionTree::Storage<T> ConditionalNode<T, JCC>::CodeGenValue(ExpressionTree& tree)
+    {
+        // Both expressions are evaluated in advance of the test. This keeps
+        // the state consistent: the execution in NativeJIT has a continuous
+        // flow regardless of the outcome of the (runtime) condition whereas
+        // the generated x64 code has two branches and each of them could
+        // otherwise have independent impact on allocated and spilled
+        // registers. It is also the shortest code for cheap expressions.
+        // LazyConditionalNode evaluates only the selected expression and
+        // uses ExpressionTree::JoinPoint to make the state of the allocated
+        // and spilled registers consistent once the two branches converge.
 
         Storage<T> trueValue;
         Storage<T> falseValue;
@@ -241,6 +333,42 @@ namespace NativeJIT
                              m_trueExpression, trueValue,
                              m_falseExpression, falseValue);
 
+        const BranchProfile::HotBranch hotBranch
+            = tree.GetLayoutProfile() != nullptr
+              ? tree.GetLayoutProfile()->GetConditionalHotBranch(this->GetId())
+              : BranchProfile::HotBranch::Unknown;
+
+        if (hotBranch != BranchProfile::HotBranch::Unknown)
+        {
+            return CodeGenWithColdBranch(tree,
+                                         trueValue,
+                                         falseValue,
+                                         hotBranch == BranchProfile::HotBranch::True);
+        }
+
+        // Unless the outcomes are counted, the values are selected without a
+        // branch since both of them are already computed. A conditional move
+        // cannot be mispredicted, which makes it cheaper than a branch on
+        // conditions that are not known to be predictable.
+        if (tree.GetInstrumentationProfile() == nullptr)
+        {
+            m_condition.CodeGenFlags(tree);
+
+            return CodeGenHelpers::Select<JCC>(tree, trueValue, falseValue);
+        }
+
+        // The registers used to count the outcomes in the instrumented code
+        // are allocated before the condition is evaluated so that allocating
+        // them cannot spill the result register.
+        BranchProfile::Counters* counters
+            = &tree.GetInstrumentationProfile()->GetConditionalCounters(this->GetId());
+        ProfileCounterEmitter counter(tree, true);
+
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        Label conditionIsTrue = code.AllocateLabel();
+        Label testCompleted = code.AllocateLabel();
+
         // Enum that specifies whether the result storage currently holds the
         // true value, false value or neither of them.
         enum class ResultContents { NeitherValue, TrueValue, FalseValue };
@@ -248,26 +376,26 @@ namespace NativeJIT
         Storage<T> result;
 
         {
-            // Evaluate the condition to update the CPU flags. No code in this
-            // block is allowed to modify the flags up until the
-            // EmitConditionalJump() call at the end. Spilling (i.e. the MOV
-            // instructions used used to copy the spilled value from register
-            // to stack) does not affect any flags.
-            m_condition.CodeGenFlags(tree);
-
             // Try to re-use a direct register from true/false expressions if
             // possible, otherwise allocate a register. The allocation must be
             // done before the conditional jump so that any register spills
-            // apply to both branches.
+            // apply to both branches. It is done before the condition is
+            // evaluated, which jumps on its own, and the result is pinned so
+            // that evaluating the condition cannot spill it.
+            // ConvertToDirect() emits no code for the sole owner of a
+            // direct register, it only notes that the register is going to
+            // be overwritten.
             if (trueValue.GetStorageClass() == StorageClass::Direct
                 && trueValue.IsSoleDataOwner())
             {
+                trueValue.ConvertToDirect(true);
                 result = trueValue;
                 resultContents = ResultContents::TrueValue;
             }
             else if (falseValue.GetStorageClass() == StorageClass::Direct
                      && falseValue.IsSoleDataOwner())
             {
+                falseValue.ConvertToDirect(true);
                 result = falseValue;
                 resultContents = ResultContents::FalseValue;
             }
@@ -277,28 +405,30 @@ namespace NativeJIT
                 resultContents = ResultContents::NeitherValue;
             }
 
-            code.EmitConditionalJump<JCC>(conditionIsTrue);
+            ReferenceCounter resultPin = result.GetPin();
+            m_condition.CodeGenBranch(tree, conditionIsTrue, true);
         }
 
         // Emit the code for the "condition is false" branch.
 
+        counter.EmitIncrement(counters->m_falseCount);
+
         // Move the false value to the result register unless it's already there.
         if (resultContents != ResultContents::FalseValue)
         {
             CodeGenHelpers::Emit<OpCode::Mov>(code, result.GetDirectRegister(), falseValue);
         }
 
-        // Jump behind the true branch, unless the true branch is empty. The true
-        // branch is empty only if the true value is already in the result storage.
-        if (!(resultContents == ResultContents::TrueValue))
-        {
-            code.Jmp(testCompleted);
-        }
+        // Jump behind the true branch, which is never empty since it counts
+        // the outcome.
+        code.Jmp(testCompleted);
 
         // Emit the code for the "condition is true" branch.
 
         code.PlaceLabel(conditionIsTrue);
 
+        counter.EmitIncrement(counters->m_trueCount);
+
         // Move the true value in the result register unless it's already there.
         if (resultContents != ResultContents::TrueValue)
         {
@@ -311,6 +441,70 @@ namespace NativeJIT
     }
 
 
+    template <typename T, JccType JCC>
+    typename ExpressionTree::Storage<T>
+    ConditionalNode<T, JCC>::CodeGenWithColdBranch(ExpressionTree& tree,
+                                                   Storage<T>& trueValue,
+                                                   Storage<T>& falseValue,
+                                                   bool isTrueHot)
+    {
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        Storage<T>& hotValue = isTrueHot ? trueValue : falseValue;
+        Storage<T>& coldValue = isTrueHot ? falseValue : trueValue;
+
+        Label coldBranch = code.AllocateLabel();
+        Label testCompleted = code.AllocateLabel();
+
+        // See CodeGenValue() for why the result is chosen and pinned before
+        // the condition is evaluated. Reusing the register of the hot value
+        // leaves no code at all on the hot path.
+        bool isHotValueInResult = false;
+        Storage<T> result;
+
+        if (hotValue.GetStorageClass() == StorageClass::Direct
+            && hotValue.IsSoleDataOwner())
+        {
+            hotValue.ConvertToDirect(true);
+            result = hotValue;
+            isHotValueInResult = true;
+        }
+        else if (coldValue.GetStorageClass() == StorageClass::Direct
+                 && coldValue.IsSoleDataOwner())
+        {
+            coldValue.ConvertToDirect(true);
+            result = coldValue;
+        }
+        else
+        {
+            result = tree.Direct<T>();
+        }
+
+        {
+            ReferenceCounter resultPin = result.GetPin();
+            m_condition.CodeGenBranch(tree, coldBranch, !isTrueHot);
+        }
+
+        // The cold branch moves the cold value into the result behind the
+        // epilog and jumps back. It captures where the cold value is right
+        // after the jump, which is where it was at the jump.
+        tree.AddColdBlock(tree.PlacementConstruct<CodeGenHelpers::ColdMove<T>>(
+            coldBranch,
+            testCompleted,
+            result.GetDirectRegister(),
+            coldValue));
+
+        if (!isHotValueInResult)
+        {
+            CodeGenHelpers::Emit<OpCode::Mov>(code, result.GetDirectRegister(), hotValue);
+        }
+
+        code.PlaceLabel(testCompleted);
+
+        return result;
+    }
+
+
     //*************************************************************************
     //
     // Template definitions for RelationalOperator
@@ -343,29 +537,32 @@ namespace NativeJIT
 
 
     template <typename T, JccType JCC>
-    typename ExpressionTree::Storage<bool> RelationalOperatorNode<T, JCC>::CodeGenValue(ExpressionTree& tree)
+    void RelationalOperatorNode<T, JCC>::DescribeStructure(StructuralKeyBuilder& builder) const
     {
-        X64CodeGenerator& code = tree.GetCodeGenerator();
+        builder.AddNode(m_left);
+        builder.AddNode(m_right);
+    }
 
-        Label conditionIsTrue = code.AllocateLabel();
-        Label testCompleted = code.AllocateLabel();
 
-        // Evaluate the condition and react based on it.
-        CodeGenFlags(tree);
-        // Allocate the result register before the conditional jump so that
-        // if any register gets spilled, the spill applies to both branches.
-        // The spilling (i.e. the MOV instruction that is used to copy the
-        // spilled value from the register onto stack) does not affect any flags.
-        auto result = tree.Direct<bool>();
-        code.EmitConditionalJump<JCC>(conditionIsTrue);
+    template <typename T, JccType JCC>
+    void RelationalOperatorNode<T, JCC>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_left);
+        children.push_back(&m_right);
+    }
 
-        code.EmitImmediate<OpCode::Mov>(result.GetDirectRegister(), false);
-        code.Jmp(testCompleted);
 
-        code.PlaceLabel(conditionIsTrue);
-        code.EmitImmediate<OpCode::Mov>(result.GetDirectRegister(), true);
+    template <typename T, JccType JCC>
+    typename ExpressionTree::Storage<bool> RelationalOperatorNode<T, JCC>::CodeGenValue(ExpressionTree& tree)
+    {
+        // Evaluate the condition and store it with setcc. The spilling
+        // possibly caused by the allocation of the result register (i.e. the
+        // MOV instruction that is used to copy the spilled value from the
+        // register onto stack) does not affect any flags.
+        CodeGenFlags(tree);
 
-        code.PlaceLabel(testCompleted);
+        auto result = tree.Direct<bool>();
+        tree.GetCodeGenerator().EmitConditionalSet<JCC>(result.GetDirectRegister());
 
         return result;
     }
@@ -383,4 +580,118 @@ namespace NativeJIT
 
         CodeGenHelpers::Emit<OpCode::Cmp>(tree.GetCodeGenerator(), sLeft.ConvertToDirect(false), sRight);
     }
+
+
+    template <typename T, JccType JCC>
+    bool ConditionalNode<T, JCC>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, JccType JCC>
+    T ConditionalNode<T, JCC>::InterpretValue(Interpreter& interpreter)
+    {
+        // Unlike the compiled code, only the selected expression is evaluated.
+        return m_condition.Interpret(interpreter)
+            ? m_trueExpression.Interpret(interpreter)
+            : m_falseExpression.Interpret(interpreter);
+    }
+
+
+    template <typename T, JccType JCC>
+    bool RelationalOperatorNode<T, JCC>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, JccType JCC>
+    bool RelationalOperatorNode<T, JCC>::InterpretValue(Interpreter& interpreter)
+    {
+        return Interpretation::Compare(JCC,
+                                       m_left.Interpret(interpreter),
+                                       m_right.Interpret(interpreter));
+    }
+
+
+    template <typename T, JccType JCC>
+    void ConditionalNode<T, JCC>::ReleaseReferencesToChildren()
+    {
+        m_trueExpression.DecrementParentCount();
+        m_falseExpression.DecrementParentCount();
+        m_condition.DecrementFlagsParentCount();
+    }
+
+
+    template <typename T, JccType JCC>
+    bool ConditionalNode<T, JCC>::Simplify()
+    {
+        // Like in the interpreter, only the selected expression is kept.
+        if (m_condition.IsConstant())
+        {
+            this->FoldToNode(m_condition.GetConstantValue()
+                             ? m_trueExpression
+                             : m_falseExpression);
+            return true;
+        }
+
+        if (&m_trueExpression == &m_falseExpression)
+        {
+            this->FoldToNode(m_trueExpression);
+            return true;
+        }
+
+        return false;
+    }
+
+
+    template <typename T, JccType JCC>
+    void RelationalOperatorNode<T, JCC>::ReleaseReferencesToChildren()
+    {
+        m_left.DecrementParentCount();
+        m_right.DecrementParentCount();
+    }
+
+
+    template <typename T, JccType JCC>
+    void RelationalOperatorNode<T, JCC>::AddFlagsChildReferences()
+    {
+        m_left.IncrementParentCount();
+        m_right.IncrementParentCount();
+    }
+
+
+    template <typename T, JccType JCC>
+    void RelationalOperatorNode<T, JCC>::ReleaseFlagsChildReferences()
+    {
+        m_left.DecrementParentCount();
+        m_right.DecrementParentCount();
+    }
+
+
+    template <typename T, JccType JCC>
+    bool RelationalOperatorNode<T, JCC>::Simplify()
+    {
+        if (!m_left.IsConstant() || !m_right.IsConstant())
+        {
+            return false;
+        }
+
+        const bool value = Interpretation::Compare(JCC,
+                                                   m_left.GetConstantValue(),
+                                                   m_right.GetConstantValue());
+
+        // The flags cannot be produced without the comparison, so the node
+        // can only be folded if no parent uses CodeGenFlags(). Otherwise, the
+        // value is still exposed so that such parents can fold themselves.
+        if (this->GetFlagsParentCount() > 0)
+        {
+            this->SetConstantValue(value);
+            return false;
+        }
+
+        this->FoldToConstant(value);
+        return true;
+    }
 }
@@ -47,6 +47,11 @@ namespace NativeJIT
 
         virtual Storage<T> CodeGenValue(ExpressionTree& tree) override;
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -83,7 +88,10 @@ namespace NativeJIT
     Storage<T>
     DependentNode<T>::CodeGenValue(ExpressionTree& tree)
     {
-        if (!m_prerequisiteNode.HasBeenEvaluated())
+        // The prerequisite has no parents if they were all simplified away,
+        // in which case nothing needs its value.
+        if (!m_prerequisiteNode.HasBeenEvaluated()
+            && m_prerequisiteNode.GetParentCount() > 0)
         {
             m_prerequisiteNode.CodeGenCache(tree);
         }
@@ -100,4 +108,46 @@ namespace NativeJIT
         out << ", dependent = " << m_dependentNode.GetId();
         out << ", prerequisite = " << m_prerequisiteNode.GetId();
     }
+
+
+    template <typename T>
+    void DependentNode<T>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_dependentNode);
+        builder.AddNode(m_prerequisiteNode);
+    }
+
+
+    template <typename T>
+    void DependentNode<T>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_dependentNode);
+        children.push_back(&m_prerequisiteNode);
+    }
+
+
+    template <typename T>
+    bool DependentNode<T>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T DependentNode<T>::InterpretValue(Interpreter& interpreter)
+    {
+        if (!interpreter.IsEvaluated(m_prerequisiteNode.GetId()))
+        {
+            m_prerequisiteNode.InterpretCache(interpreter);
+        }
+
+        return m_dependentNode.Interpret(interpreter);
+    }
+
+
+    template <typename T>
+    void DependentNode<T>::ReleaseReferencesToChildren()
+    {
+        m_dependentNode.DecrementParentCount();
+    }
 }
@@ -40,9 +40,17 @@ namespace NativeJIT
 
         virtual ExpressionTree::Storage<FIELD*> CodeGenValue(ExpressionTree& tree) override;
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual FIELD* InterpretValue(Interpreter& interpreter) override;
 
         virtual void ReleaseReferencesToChildren() override;
 
+        // A field of an object at an address known at compile time has
+        // a known address as well.
+        virtual bool Simplify() override;
+
     protected:
         virtual bool GetBaseAndOffset(NodeBase*& base, int32_t& offset) const override;
 
@@ -156,4 +164,51 @@ namespace NativeJIT
                << ", collapsed offset = " << m_collapsedOffset;
         }
     }
+
+
+    template <typename OBJECT, typename FIELD>
+    void FieldPointerNode<OBJECT, FIELD>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        // Only the collapsed base and offset are used to generate the code.
+        builder.AddNode(*m_collapsedBase);
+        builder.AddValue(m_collapsedOffset);
+    }
+
+
+    template <typename OBJECT, typename FIELD>
+    void FieldPointerNode<OBJECT, FIELD>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(m_collapsedBase);
+    }
+
+
+    template <typename OBJECT, typename FIELD>
+    bool FieldPointerNode<OBJECT, FIELD>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename OBJECT, typename FIELD>
+    FIELD* FieldPointerNode<OBJECT, FIELD>::InterpretValue(Interpreter& interpreter)
+    {
+        auto base = static_cast<char*>(m_collapsedBase->InterpretAsBase(interpreter));
+
+        return reinterpret_cast<FIELD*>(base + m_collapsedOffset);
+    }
+
+
+    template <typename OBJECT, typename FIELD>
+    bool FieldPointerNode<OBJECT, FIELD>::Simplify()
+    {
+        if (!m_collapsedBase->IsConstant())
+        {
+            return false;
+        }
+
+        auto base = reinterpret_cast<char*>(m_collapsedBase->GetConstantWord());
+        this->FoldToConstant(reinterpret_cast<FIELD*>(base + m_collapsedOffset));
+
+        return true;
+    }
 }
@@ -0,0 +1,226 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"     // OpCode type.
+#include "NativeJIT/CodeGenHelpers.h"
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    enum class FloatUnaryOperation
+    {
+        Abs,        // Clears the sign bit, including the one of NaN.
+        Ceil,
+        Floor,
+        Sqrt
+    };
+
+
+    // Implements the unary operations on float and double with the scalar
+    // SSE instructions. Abs ands the value with the sign mask, which is moved
+    // into a floating point register through an integer one rather than read
+    // from memory since AndPS/AndPD require a 16-byte aligned operand. Ceil
+    // and Floor use RoundSS/RoundSD and thus require SSE4.1; the factory
+    // calls Apply() instead on processors without it.
+    template <typename T, FloatUnaryOperation OP>
+    class FloatUnaryNode : public Node<T>
+    {
+    public:
+        FloatUnaryNode(ExpressionTree& tree, Node<T>& operand);
+
+        virtual Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+        // Returns the result of the operation on the value.
+        static T Apply(T value);
+
+    private:
+        static_assert(std::is_floating_point<T>::value,
+                      "FloatUnaryNode requires a floating point operand.");
+
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~FloatUnaryNode();
+
+        Node<T>& m_operand;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for FloatUnaryNode
+    //
+    //*************************************************************************
+    template <typename T, FloatUnaryOperation OP>
+    FloatUnaryNode<T, OP>::FloatUnaryNode(ExpressionTree& tree, Node<T>& operand)
+        : Node<T>(tree),
+          m_operand(operand)
+    {
+        m_operand.IncrementParentCount();
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    Storage<T> FloatUnaryNode<T, OP>::CodeGenValue(ExpressionTree& tree)
+    {
+        // Round to the direction with the precision exception suppressed.
+        const uint8_t c_floorMode = 0x9;
+        const uint8_t c_ceilMode = 0xa;
+
+        auto & code = tree.GetCodeGenerator();
+        Storage<T> value = m_operand.CodeGen(tree);
+
+        auto dest = value.ConvertToDirect(true);
+
+        switch (OP)
+        {
+        case FloatUnaryOperation::Abs:
+            {
+                typedef typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type Word;
+
+                const Word signMask = ~(static_cast<Word>(1) << (8 * sizeof(T) - 1));
+
+                // Pin the value so that allocating the register for the mask
+                // doesn't spill it.
+                ReferenceCounter pin = value.GetPin();
+                Storage<T> mask = tree.Direct<T>();
+
+                CodeGenHelpers::MovThroughTemporary(tree,
+                                                    mask.GetDirectRegister(),
+                                                    InterpreterValue<T>::FromWord(signMask));
+                code.Emit<OpCode::And>(dest, mask.GetDirectRegister());
+            }
+            break;
+
+        case FloatUnaryOperation::Ceil:
+            code.EmitImmediate<OpCode::Round>(dest, dest, c_ceilMode);
+            break;
+
+        case FloatUnaryOperation::Floor:
+            code.EmitImmediate<OpCode::Round>(dest, dest, c_floorMode);
+            break;
+
+        default:
+            code.Emit<OpCode::Sqrt>(dest, dest);
+            break;
+        }
+
+        return value;
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    void FloatUnaryNode<T, OP>::Print(std::ostream& out) const
+    {
+        static char const * const c_names[] = { "Abs", "Ceil", "Floor", "Sqrt" };
+
+        this->PrintCoreProperties(out, c_names[static_cast<unsigned>(OP)]);
+
+        out << ", operand = " << m_operand.GetId();
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    void FloatUnaryNode<T, OP>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_operand);
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    void FloatUnaryNode<T, OP>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_operand);
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    bool FloatUnaryNode<T, OP>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    T FloatUnaryNode<T, OP>::InterpretValue(Interpreter& interpreter)
+    {
+        return Apply(m_operand.Interpret(interpreter));
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    void FloatUnaryNode<T, OP>::ReleaseReferencesToChildren()
+    {
+        m_operand.DecrementParentCount();
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    bool FloatUnaryNode<T, OP>::Simplify()
+    {
+        if (!m_operand.IsConstant())
+        {
+            return false;
+        }
+
+        this->FoldToConstant(Apply(m_operand.GetConstantValue()));
+        return true;
+    }
+
+
+    template <typename T, FloatUnaryOperation OP>
+    T FloatUnaryNode<T, OP>::Apply(T value)
+    {
+        // The C++ functions give the same results as the instructions, which
+        // are exact for all of these operations.
+        switch (OP)
+        {
+        case FloatUnaryOperation::Abs:
+            return std::fabs(value);
+
+        case FloatUnaryOperation::Ceil:
+            return std::ceil(value);
+
+        case FloatUnaryOperation::Floor:
+            return std::floor(value);
+
+        default:
+            return std::sqrt(value);
+        }
+    }
+}
@@ -41,6 +41,7 @@ namespace NativeJIT
         : Node<T>(tree),
           m_value(value)
     {
+        this->SetConstantValue(value);
     }
 
 
@@ -53,6 +54,19 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    void ImmediateNode<T, ImmediateCategory::InlineImmediate>::ReleaseReferencesToChildren()
+    {
+    }
+
+
+    template <typename T>
+    void ImmediateNode<T, ImmediateCategory::InlineImmediate>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddValue(m_value);
+    }
+
+
     template <typename T>
     Storage<T>
     ImmediateNode<T, ImmediateCategory::InlineImmediate>::CodeGenValue(ExpressionTree& tree)
@@ -72,6 +86,8 @@ namespace NativeJIT
         : Node<T>(tree),
           m_value(value)
     {
+        this->SetConstantValue(value);
+
         tree.AddRIPRelative(*this);
 
         // m_offset will be initialized with the correct value during pass0
@@ -89,6 +105,21 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    void ImmediateNode<T, ImmediateCategory::RIPRelativeImmediate>::ReleaseReferencesToChildren()
+    {
+    }
+
+
+    template <typename T>
+    void ImmediateNode<T, ImmediateCategory::RIPRelativeImmediate>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        // Note: m_offset is assigned during compilation and does not describe
+        // the structure.
+        builder.AddValue(m_value);
+    }
+
+
     template <typename T>
     Storage<T>
     ImmediateNode<T, ImmediateCategory::RIPRelativeImmediate>::CodeGenValue(ExpressionTree& tree)
@@ -100,6 +131,12 @@ namespace NativeJIT
     template <typename T>
     void ImmediateNode<T, ImmediateCategory::RIPRelativeImmediate>::EmitStaticData(ExpressionTree& tree)
     {
+        // The constant is not needed if all its parents were simplified.
+        if (this->GetParentCount() == 0)
+        {
+            return;
+        }
+
         auto & code = tree.GetCodeGenerator();
         code.AdvanceToAlignment<T>();
         m_offset = code.CurrentPosition();
@@ -110,4 +147,32 @@ namespace NativeJIT
         // emitted as uint64_t.
         code.EmitBytes(ForcedCast<typename CanonicalRegisterStorageType<T>::Type>(m_value));
     }
+
+
+    template <typename T>
+    bool ImmediateNode<T, ImmediateCategory::InlineImmediate>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T ImmediateNode<T, ImmediateCategory::InlineImmediate>::InterpretValue(Interpreter& /* interpreter */)
+    {
+        return m_value;
+    }
+
+
+    template <typename T>
+    bool ImmediateNode<T, ImmediateCategory::RIPRelativeImmediate>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T ImmediateNode<T, ImmediateCategory::RIPRelativeImmediate>::InterpretValue(Interpreter& /* interpreter */)
+    {
+        return m_value;
+    }
 }
@@ -48,6 +48,10 @@ namespace NativeJIT
         // Overrides of Node methods
         //
         virtual void Print(std::ostream& out) const override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
         virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
 
     private:
@@ -85,6 +89,10 @@ namespace NativeJIT
         // Overrides of Node methods
         //
         virtual void Print(std::ostream& out) const override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
         virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
 
 
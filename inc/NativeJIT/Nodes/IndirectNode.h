@@ -42,6 +42,20 @@ namespace NativeJIT
 
         virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+
+        // Replaces the load with the loaded value if the address is known at
+        // compile time and points into the memory declared constant through
+        // ExpressionTree::AddConstantMemory().
+        virtual bool Simplify() override;
+
+        // Accepts the hoisting when the base object has already been evaluated.
+        virtual bool PrepareForHoisting() override;
+        virtual void ResetHoisting() override;
 
         // Note: IndirectNode doesn't implement GetBaseAndOffset() method which
         // allows for base object/offset collapsing optimization because it
@@ -53,6 +67,7 @@ namespace NativeJIT
         // resources other than memory from the arena allocator.
         ~IndirectNode();
 
+        ExpressionTree& m_tree;
         NodeBase& m_base;
         const int32_t m_index;
 
@@ -64,6 +79,10 @@ namespace NativeJIT
         // listed after the original base/offset.
         NodeBase* m_collapsedBase;
         int32_t m_collapsedOffset;
+
+        // Whether CodeGenValue() loads the value into a register rather than
+        // returning the indirect storage, see PrepareForHoisting().
+        bool m_isHoisted;
     };
 
 
@@ -75,11 +94,13 @@ namespace NativeJIT
     template <typename T>
     IndirectNode<T>::IndirectNode(ExpressionTree& tree, Node<T*>& base, int32_t index)
         : Node<T>(tree),
+          m_tree(tree),
           m_base(base),
           m_index(index),
           // Note: there is constructor order dependency for these two.
           m_collapsedBase(&m_base),
-          m_collapsedOffset(sizeof(T) * m_index)
+          m_collapsedOffset(sizeof(T) * m_index),
+          m_isHoisted(false)
     {
         NodeBase* grandparent;
         int32_t parentOffset;
@@ -104,8 +125,15 @@ namespace NativeJIT
         // than the void* returned by CodeGenAsBase(). The local offset calculated
         // from the index skips the required number of T's, so it still represents
         // a T*. Dereference the calculated T* to get to T.
-        return ExpressionTree::Storage<T>(m_collapsedBase->CodeGenAsBase(tree),
-                                          m_collapsedOffset);
+        ExpressionTree::Storage<T> value(m_collapsedBase->CodeGenAsBase(tree),
+                                         m_collapsedOffset);
+
+        if (m_isHoisted)
+        {
+            value.ConvertToDirect(false);
+        }
+
+        return value;
     }
 
 
@@ -124,4 +152,80 @@ namespace NativeJIT
                 << ", collapsed offset = " << m_collapsedOffset;
         }
     }
+
+
+    template <typename T>
+    void IndirectNode<T>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        // Only the collapsed base and offset are used to generate the code.
+        builder.AddNode(*m_collapsedBase);
+        builder.AddValue(m_collapsedOffset);
+    }
+
+
+    template <typename T>
+    void IndirectNode<T>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(m_collapsedBase);
+    }
+
+
+    template <typename T>
+    bool IndirectNode<T>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T IndirectNode<T>::InterpretValue(Interpreter& interpreter)
+    {
+        auto base = static_cast<char*>(m_collapsedBase->InterpretAsBase(interpreter));
+
+        return *reinterpret_cast<T*>(base + m_collapsedOffset);
+    }
+
+
+    template <typename T>
+    void IndirectNode<T>::ReleaseReferencesToChildren()
+    {
+        m_collapsedBase->DecrementParentCount();
+    }
+
+
+    template <typename T>
+    bool IndirectNode<T>::PrepareForHoisting()
+    {
+        m_isHoisted = m_collapsedBase->GetEvaluatedNode().IsCached();
+
+        return m_isHoisted;
+    }
+
+
+    template <typename T>
+    void IndirectNode<T>::ResetHoisting()
+    {
+        m_isHoisted = false;
+    }
+
+
+    template <typename T>
+    bool IndirectNode<T>::Simplify()
+    {
+        if (!m_collapsedBase->IsConstant())
+        {
+            return false;
+        }
+
+        auto address = reinterpret_cast<char const *>(m_collapsedBase->GetConstantWord())
+                       + m_collapsedOffset;
+
+        if (!m_tree.IsConstantMemory(address, sizeof(T)))
+        {
+            return false;
+        }
+
+        this->FoldToConstant(*reinterpret_cast<T const *>(address));
+        return true;
+    }
 }
@@ -0,0 +1,357 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include "NativeJIT/BranchProfile.h"
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"
+#include "NativeJIT/CodeGenHelpers.h"
+#include "NativeJIT/ExpressionTree.h"
+#include "NativeJIT/Nodes/ConditionalNode.h"
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    class ExpressionTree;
+
+    // Unlike ConditionalNode, evaluates only the expression selected by the
+    // condition. Each expression forms a conditional region of the tree (see
+    // ExpressionTree::AddConditionalRegion()), so the nodes which are used
+    // only within it, including the ones with multiple parents, are
+    // evaluated only when the expression is. This makes it possible to guard
+    // loads and calls by the condition, f. ex. to dereference a pointer only
+    // if it's not null. The nodes used by both expressions or also outside
+    // of them are evaluated before the condition is tested. If both
+    // expressions are cheap, i.e. constant or already evaluated, they are
+    // both evaluated and selected without a branch like in ConditionalNode.
+    template <typename T, JccType JCC>
+    class LazyConditionalNode : public Node<T>
+    {
+    public:
+        LazyConditionalNode(ExpressionTree& tree,
+                            FlagExpressionNode<JCC>& condition,
+                            Node<T>& trueExpression,
+                            Node<T>& falseExpression);
+
+
+        //
+        // Overrides of Node methods.
+        //
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+        //
+        // Overrides of Node<T> methods.
+        //
+        virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+    private:
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~LazyConditionalNode();
+
+        // Returns whether evaluating the expression emits no code other than
+        // possibly materializing a constant.
+        static bool IsCheap(Node<T>& expression);
+
+        // Generates the code for one of the expressions, leaving its value in
+        // the result register and all the other values where they were before
+        // the conditional jump.
+        ExpressionTree::Storage<T> CodeGenExpression(ExpressionTree& tree,
+                                                     ExpressionTree::JoinPoint& join,
+                                                     Node<T>& expression,
+                                                     unsigned region,
+                                                     uint64_t* counter,
+                                                     typename Storage<T>::DirectRegister resultRegister);
+
+        FlagExpressionNode<JCC>& m_condition;
+        Node<T>& m_trueExpression;
+        Node<T>& m_falseExpression;
+
+        // The conditional regions formed by the expressions.
+        const unsigned m_trueRegion;
+        const unsigned m_falseRegion;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for LazyConditionalNode
+    //
+    //*************************************************************************
+    template <typename T, JccType JCC>
+    LazyConditionalNode<T, JCC>::LazyConditionalNode(ExpressionTree& tree,
+                                                     FlagExpressionNode<JCC>& condition,
+                                                     Node<T>& trueExpression,
+                                                     Node<T>& falseExpression)
+        : Node<T>(tree),
+          m_condition(condition),
+          m_trueExpression(trueExpression),
+          m_falseExpression(falseExpression),
+          m_trueRegion(tree.AddConditionalRegion(*this, trueExpression)),
+          m_falseRegion(tree.AddConditionalRegion(*this, falseExpression))
+    {
+        m_trueExpression.IncrementParentCount();
+        m_falseExpression.IncrementParentCount();
+
+        // Use the CodeGenFlags()-related call.
+        m_condition.IncrementFlagsParentCount();
+    }
+
+
+    template <typename T, JccType JCC>
+    void LazyConditionalNode<T, JCC>::Print(std::ostream& out) const
+    {
+        const std::string name = std::string("LazyConditional(")
+            + X64CodeGenerator::JccName(JCC)
+            + ") ";
+        this->PrintCoreProperties(out, name.c_str());
+
+        out << ", condition = " << m_condition.GetId();
+        out << ", trueExpression = " << m_trueExpression.GetId();
+        out << ", falseExpression = " << m_falseExpression.GetId();
+    }
+
+
+    template <typename T, JccType JCC>
+    void LazyConditionalNode<T, JCC>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_condition);
+        builder.AddNode(m_trueExpression);
+        builder.AddNode(m_falseExpression);
+    }
+
+
+    template <typename T, JccType JCC>
+    void LazyConditionalNode<T, JCC>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_condition);
+        children.push_back(&m_trueExpression);
+        children.push_back(&m_falseExpression);
+    }
+
+
+    template <typename T, JccType JCC>
+    typename ExpressionTree::Storage<T> LazyConditionalNode<T, JCC>::CodeGenValue(ExpressionTree& tree)
+    {
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        const BranchProfile::HotBranch hotBranch
+            = tree.GetLayoutProfile() != nullptr
+              ? tree.GetLayoutProfile()->GetConditionalHotBranch(this->GetId())
+              : BranchProfile::HotBranch::Unknown;
+
+        // See ConditionalNode::CodeGenValue() for when the branch is kept.
+        if (IsCheap(m_trueExpression)
+            && IsCheap(m_falseExpression)
+            && hotBranch == BranchProfile::HotBranch::Unknown
+            && tree.GetInstrumentationProfile() == nullptr)
+        {
+            Storage<T> trueValue;
+            Storage<T> falseValue;
+
+            tree.CodeGenSharedNodes(m_trueRegion);
+            tree.CodeGenSharedNodes(m_falseRegion);
+
+            this->CodeGenInOrder(tree,
+                                 m_trueExpression, trueValue,
+                                 m_falseExpression, falseValue);
+
+            m_condition.CodeGenFlags(tree);
+
+            return CodeGenHelpers::Select<JCC>(tree, trueValue, falseValue);
+        }
+
+        Label secondExpressionStart = code.AllocateLabel();
+        Label testCompleted = code.AllocateLabel();
+
+        // The expression which is more frequently selected falls through.
+        // The true expression falls through unless the layout profile says
+        // otherwise. Unlike ConditionalNode, the less frequent expression is
+        // not moved out of line since it may contain arbitrary code.
+        const bool isTrueFirst = hotBranch != BranchProfile::HotBranch::False;
+
+        BranchProfile::Counters* counters
+            = tree.GetInstrumentationProfile() != nullptr
+              ? &tree.GetInstrumentationProfile()->GetConditionalCounters(this->GetId())
+              : nullptr;
+
+        // The result register is allocated before the join point captures the
+        // register allocation so that it is free on both paths and neither of
+        // them needs to bump anything out of it at the end.
+        Storage<T> reserved = tree.Direct<T>();
+        const auto resultRegister = reserved.GetDirectRegister();
+        ExpressionTree::JoinPoint join(tree);
+        reserved.Reset();
+
+        // The condition emits its own jumps, so it is evaluated after the
+        // join point is captured. The shared nodes it uses were evaluated
+        // before, so it only leaves behind the values it spilled, which both
+        // paths restore.
+        m_condition.CodeGenBranch(tree, secondExpressionStart, !isTrueFirst);
+
+        {
+            Storage<T> firstResult
+                = isTrueFirst
+                  ? CodeGenExpression(tree,
+                                      join,
+                                      m_trueExpression,
+                                      m_trueRegion,
+                                      counters != nullptr ? &counters->m_trueCount : nullptr,
+                                      resultRegister)
+                  : CodeGenExpression(tree,
+                                      join,
+                                      m_falseExpression,
+                                      m_falseRegion,
+                                      counters != nullptr ? &counters->m_falseCount : nullptr,
+                                      resultRegister);
+        }
+
+        code.Jmp(testCompleted);
+        code.PlaceLabel(secondExpressionStart);
+
+        Storage<T> result
+            = isTrueFirst
+              ? CodeGenExpression(tree,
+                                  join,
+                                  m_falseExpression,
+                                  m_falseRegion,
+                                  counters != nullptr ? &counters->m_falseCount : nullptr,
+                                  resultRegister)
+              : CodeGenExpression(tree,
+                                  join,
+                                  m_trueExpression,
+                                  m_trueRegion,
+                                  counters != nullptr ? &counters->m_trueCount : nullptr,
+                                  resultRegister);
+
+        code.PlaceLabel(testCompleted);
+
+        return result;
+    }
+
+
+    template <typename T, JccType JCC>
+    typename ExpressionTree::Storage<T>
+    LazyConditionalNode<T, JCC>::CodeGenExpression(ExpressionTree& tree,
+                                                   ExpressionTree::JoinPoint& join,
+                                                   Node<T>& expression,
+                                                   unsigned region,
+                                                   uint64_t* counter,
+                                                   typename Storage<T>::DirectRegister resultRegister)
+    {
+        if (counter != nullptr)
+        {
+            ProfileCounterEmitter emitter(tree, true);
+            emitter.EmitIncrement(*counter);
+        }
+
+        ExpressionTree::RegionEvaluation evaluation(tree, region);
+
+        Storage<T> value = expression.CodeGen(tree);
+        Storage<T> result;
+
+        // Reuse the value's register if it happens to be the result register.
+        // Restoring the register allocation below never bumps the result
+        // register since it was free when the allocation was captured.
+        if (value.GetStorageClass() == StorageClass::Direct
+            && value.GetDirectRegister() == resultRegister
+            && value.IsSoleDataOwner())
+        {
+            result = value;
+        }
+        else
+        {
+            result = tree.Direct<T>(resultRegister);
+            CodeGenHelpers::Emit<OpCode::Mov>(tree.GetCodeGenerator(),
+                                              resultRegister,
+                                              value);
+        }
+
+        value.Reset();
+        evaluation.End();
+        join.Restore();
+
+        return result;
+    }
+
+
+    template <typename T, JccType JCC>
+    bool LazyConditionalNode<T, JCC>::IsCheap(Node<T>& expression)
+    {
+        return expression.IsConstant() || expression.HasBeenEvaluated();
+    }
+
+
+    template <typename T, JccType JCC>
+    bool LazyConditionalNode<T, JCC>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, JccType JCC>
+    T LazyConditionalNode<T, JCC>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_condition.Interpret(interpreter)
+            ? m_trueExpression.Interpret(interpreter)
+            : m_falseExpression.Interpret(interpreter);
+    }
+
+
+    template <typename T, JccType JCC>
+    void LazyConditionalNode<T, JCC>::ReleaseReferencesToChildren()
+    {
+        m_trueExpression.DecrementParentCount();
+        m_falseExpression.DecrementParentCount();
+        m_condition.DecrementFlagsParentCount();
+    }
+
+
+    template <typename T, JccType JCC>
+    bool LazyConditionalNode<T, JCC>::Simplify()
+    {
+        if (m_condition.IsConstant())
+        {
+            this->FoldToNode(m_condition.GetConstantValue()
+                             ? m_trueExpression
+                             : m_falseExpression);
+            return true;
+        }
+
+        if (&m_trueExpression == &m_falseExpression)
+        {
+            this->FoldToNode(m_trueExpression);
+            return true;
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,217 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"     // OpCode type.
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    // Implements a node for the LEA instruction with a scaled index, which
+    // computes base + index * scale without modifying either operand. The
+    // scale must be 1, 2, 4 or 8 and the index must be as wide as the base.
+    template <typename T, typename INDEX>
+    class LeaNode : public Node<T>
+    {
+    public:
+        LeaNode(ExpressionTree& tree, Node<T>& base, Node<INDEX>& index, uint8_t scale);
+
+        virtual Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+    private:
+        static_assert(sizeof(T) == sizeof(INDEX),
+                      "The index must have the same size as the base.");
+        static_assert(!RegisterStorage<T>::c_isFloat && !RegisterStorage<INDEX>::c_isFloat,
+                      "Lea requires general purpose operands.");
+
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~LeaNode();
+
+        Node<T>& m_base;
+        Node<INDEX>& m_index;
+        const uint8_t m_scale;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for LeaNode
+    //
+    //*************************************************************************
+    template <typename T, typename INDEX>
+    LeaNode<T, INDEX>::LeaNode(ExpressionTree& tree,
+                               Node<T>& base,
+                               Node<INDEX>& index,
+                               uint8_t scale)
+        : Node<T>(tree),
+          m_base(base),
+          m_index(index),
+          m_scale(scale)
+    {
+        LogThrowAssert(scale == 1 || scale == 2 || scale == 4 || scale == 8,
+                       "Invalid scale %u",
+                       scale);
+
+        m_base.IncrementParentCount();
+        m_index.IncrementParentCount();
+    }
+
+
+    template <typename T, typename INDEX>
+    Storage<T> LeaNode<T, INDEX>::CodeGenValue(ExpressionTree& tree)
+    {
+        Storage<T> base;
+        Storage<INDEX> index;
+
+        this->CodeGenInOrder(tree,
+                             m_base, base,
+                             m_index, index);
+
+        // Lea neither reads nor modifies its destination, so the base register
+        // is reused only if no one else references it. Otherwise, the result
+        // goes to a new register and the operands are left untouched.
+        const PointerRegister baseReg(base.ConvertToDirect(false));
+        ReferenceCounter basePin = base.GetPin();
+
+        PointerRegister indexReg = baseReg;
+        ReferenceCounter indexPin;
+
+        if (base == index)
+        {
+            index.Reset();
+        }
+        else
+        {
+            indexReg = PointerRegister(index.ConvertToDirect(false));
+            indexPin = index.GetPin();
+        }
+
+        Storage<T> result;
+
+        if (base.IsSoleDataOwner())
+        {
+            // Emits no code for the sole owner of a direct register but notes
+            // that the register is about to be overwritten.
+            base.ConvertToDirect(true);
+            result = base;
+        }
+        else
+        {
+            result = tree.Direct<T>();
+        }
+
+        tree.GetCodeGenerator().EmitScaledIndex<OpCode::Lea>(result.GetDirectRegister(),
+                                                             baseReg,
+                                                             indexReg,
+                                                             m_scale,
+                                                             0);
+
+        return result;
+    }
+
+
+    template <typename T, typename INDEX>
+    void LeaNode<T, INDEX>::Print(std::ostream& out) const
+    {
+        this->PrintCoreProperties(out, "Lea");
+
+        out << ", base = " << m_base.GetId()
+            << ", index = " << m_index.GetId()
+            << ", scale = " << static_cast<unsigned>(m_scale);
+    }
+
+
+    template <typename T, typename INDEX>
+    void LeaNode<T, INDEX>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_base);
+        builder.AddNode(m_index);
+        builder.AddValue(m_scale);
+    }
+
+
+    template <typename T, typename INDEX>
+    void LeaNode<T, INDEX>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_base);
+        children.push_back(&m_index);
+    }
+
+
+    template <typename T, typename INDEX>
+    bool LeaNode<T, INDEX>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, typename INDEX>
+    T LeaNode<T, INDEX>::InterpretValue(Interpreter& interpreter)
+    {
+        return Interpretation::ApplyScaledIndex(m_base.Interpret(interpreter),
+                                                m_index.Interpret(interpreter),
+                                                m_scale);
+    }
+
+
+    template <typename T, typename INDEX>
+    void LeaNode<T, INDEX>::ReleaseReferencesToChildren()
+    {
+        m_base.DecrementParentCount();
+        m_index.DecrementParentCount();
+    }
+
+
+    template <typename T, typename INDEX>
+    bool LeaNode<T, INDEX>::Simplify()
+    {
+        if (m_base.IsConstant() && m_index.IsConstant())
+        {
+            this->FoldToConstant(Interpretation::ApplyScaledIndex(m_base.GetConstantValue(),
+                                                                  m_index.GetConstantValue(),
+                                                                  m_scale));
+            return true;
+        }
+
+        if (m_index.IsConstant()
+            && InterpreterValue<INDEX>::ToWord(m_index.GetConstantValue()) == 0)
+        {
+            this->FoldToNode(m_base);
+            return true;
+        }
+
+        return false;
+    }
+}
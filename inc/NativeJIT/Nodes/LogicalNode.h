@@ -0,0 +1,533 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"
+#include "NativeJIT/ExpressionTree.h"
+#include "NativeJIT/Nodes/ConditionalNode.h"
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    class ExpressionTree;
+
+    // Combines two conditions with the logical and (OP is OpCode::And) or or
+    // (OP is OpCode::Or). The right condition is evaluated only if the left
+    // one doesn't decide the result, together with the nodes which are used
+    // only by it (see ExpressionTree::AddConditionalRegion()), so it may rely
+    // on the left condition, f. ex. compare a value loaded through a pointer
+    // that the left condition checks for null. If the right condition is
+    // cheap, both conditions are evaluated and combined without branching.
+    // Either way, CodeGenValue() and CodeGenFlags() leave the combined value
+    // in a byte register and set the flags so that JNE holds if the combined
+    // condition does. CodeGenBranch() instead jumps on the outcomes of the
+    // two conditions directly unless the right condition is cheap.
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    class LogicalNode : public FlagExpressionNode<JccType::JNE>
+    {
+    public:
+        static_assert(OP == OpCode::And || OP == OpCode::Or,
+                      "Only the logical and and or are supported.");
+
+        LogicalNode(ExpressionTree& tree,
+                    FlagExpressionNode<LEFTJCC>& left,
+                    FlagExpressionNode<RIGHTJCC>& right);
+
+
+        //
+        // Overrides of Node methods.
+        //
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual bool InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+
+        //
+        // Overrides of Node<T> methods.
+        //
+        virtual ExpressionTree::Storage<bool> CodeGenValue(ExpressionTree& tree) override;
+
+
+        //
+        // Overrides of FlagExpression methods.
+        //
+        virtual void CodeGenFlags(ExpressionTree& tree) override;
+        virtual void CodeGenBranch(ExpressionTree& tree, Label target, bool jumpIfTrue) override;
+
+    protected:
+        virtual void AddFlagsChildReferences() override;
+        virtual void ReleaseFlagsChildReferences() override;
+
+    private:
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~LogicalNode();
+
+        // Generates the code which both sets the flags and stores the value.
+        ExpressionTree::Storage<bool> CodeGenCombination(ExpressionTree& tree);
+
+        FlagExpressionNode<LEFTJCC>& m_left;
+        FlagExpressionNode<RIGHTJCC>& m_right;
+
+        // The conditional region formed by the right condition.
+        const unsigned m_rightRegion;
+    };
+
+
+    // Negates a condition. Emits no code of its own: the parents test the
+    // flags set by the condition for the inverse condition code.
+    template <JccType JCC>
+    class LogicalNotNode : public FlagExpressionNode<InverseJcc<JCC>::value>
+    {
+    public:
+        LogicalNotNode(ExpressionTree& tree, FlagExpressionNode<JCC>& condition);
+
+
+        //
+        // Overrides of Node methods.
+        //
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual bool InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+
+        //
+        // Overrides of Node<T> methods.
+        //
+        virtual ExpressionTree::Storage<bool> CodeGenValue(ExpressionTree& tree) override;
+
+
+        //
+        // Overrides of FlagExpression methods.
+        //
+        virtual void CodeGenFlags(ExpressionTree& tree) override;
+        virtual void CodeGenBranch(ExpressionTree& tree, Label target, bool jumpIfTrue) override;
+
+    protected:
+        virtual void AddFlagsChildReferences() override;
+        virtual void ReleaseFlagsChildReferences() override;
+
+    private:
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~LogicalNotNode();
+
+        FlagExpressionNode<JCC>& m_condition;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for LogicalNode
+    //
+    //*************************************************************************
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    LogicalNode<OP, LEFTJCC, RIGHTJCC>::LogicalNode(ExpressionTree& tree,
+                                                    FlagExpressionNode<LEFTJCC>& left,
+                                                    FlagExpressionNode<RIGHTJCC>& right)
+        : FlagExpressionNode<JccType::JNE>(tree),
+          m_left(left),
+          m_right(right),
+          m_rightRegion(tree.AddConditionalRegion(*this, right))
+    {
+        // Use the CodeGenFlags()-related call.
+        m_left.IncrementFlagsParentCount();
+        m_right.IncrementFlagsParentCount();
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::Print(std::ostream& out) const
+    {
+        const std::string name = std::string("Logical(")
+            + X64CodeGenerator::OpCodeName(OP)
+            + ") ";
+        this->PrintCoreProperties(out, name.c_str());
+
+        out << ", left = " << m_left.GetId();
+        out << ", right = " << m_right.GetId();
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_left);
+        builder.AddNode(m_right);
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_left);
+        children.push_back(&m_right);
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    typename ExpressionTree::Storage<bool>
+    LogicalNode<OP, LEFTJCC, RIGHTJCC>::CodeGenValue(ExpressionTree& tree)
+    {
+        return CodeGenCombination(tree);
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::CodeGenFlags(ExpressionTree& tree)
+    {
+        // Releasing the value's register emits no code and keeps the flags.
+        CodeGenCombination(tree);
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::CodeGenBranch(ExpressionTree& tree,
+                                                           Label target,
+                                                           bool jumpIfTrue)
+    {
+        // A cheap right condition is still combined without branching, which
+        // leaves a single conditional jump.
+        if (tree.IsTrivialRegion(m_rightRegion))
+        {
+            FlagExpressionNode<JccType::JNE>::CodeGenBranch(tree, target, jumpIfTrue);
+            return;
+        }
+
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        // The value which decides the result on its own: false for and,
+        // true for or. If it is also the value the caller jumps on, the left
+        // condition jumps straight to the target, otherwise it skips the
+        // right condition.
+        const bool decisiveValue = OP == OpCode::Or;
+        Label rightSkipped = code.AllocateLabel();
+        const Label leftTarget = jumpIfTrue == decisiveValue ? target : rightSkipped;
+
+        m_left.CodeGenFlags(tree);
+
+        // Capturing the register allocation emits only moves, which keep the
+        // flags.
+        ExpressionTree::JoinPoint join(tree);
+
+        if (decisiveValue)
+        {
+            code.EmitConditionalJump<LEFTJCC>(leftTarget);
+        }
+        else
+        {
+            code.EmitConditionalJump<InverseJcc<LEFTJCC>::value>(leftTarget);
+        }
+
+        ExpressionTree::RegionEvaluation right(tree, m_rightRegion);
+        m_right.CodeGenFlags(tree);
+        right.End();
+
+        // Restoring the register allocation before the jump makes it the same
+        // on all the paths which leave the node. It also emits only moves.
+        join.Restore();
+
+        if (jumpIfTrue)
+        {
+            code.EmitConditionalJump<RIGHTJCC>(target);
+        }
+        else
+        {
+            code.EmitConditionalJump<InverseJcc<RIGHTJCC>::value>(target);
+        }
+
+        code.PlaceLabel(rightSkipped);
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    typename ExpressionTree::Storage<bool>
+    LogicalNode<OP, LEFTJCC, RIGHTJCC>::CodeGenCombination(ExpressionTree& tree)
+    {
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        // The spilling possibly caused by the allocation of the result
+        // register does not affect the flags set by the left condition.
+        m_left.CodeGenFlags(tree);
+
+        Storage<bool> result = tree.Direct<bool>();
+        const auto resultRegister = result.GetDirectRegister();
+        ReferenceCounter resultPin = result.GetPin();
+
+        if (tree.IsTrivialRegion(m_rightRegion))
+        {
+            code.EmitConditionalSet<LEFTJCC>(resultRegister);
+
+            tree.CodeGenSharedNodes(m_rightRegion);
+            m_right.CodeGenFlags(tree);
+
+            Storage<bool> right = tree.Direct<bool>();
+            code.EmitConditionalSet<RIGHTJCC>(right.GetDirectRegister());
+            code.Emit<OP>(resultRegister, right.GetDirectRegister());
+        }
+        else
+        {
+            Label rightSkipped = code.AllocateLabel();
+
+            // The result holds the value decided by the left condition
+            // unless the right condition is evaluated. The result register
+            // is pinned, so the join point never moves it.
+            code.EmitImmediate<OpCode::Mov>(resultRegister, OP == OpCode::Or);
+            ExpressionTree::JoinPoint join(tree);
+
+            if (OP == OpCode::And)
+            {
+                code.EmitConditionalJump<InverseJcc<LEFTJCC>::value>(rightSkipped);
+            }
+            else
+            {
+                code.EmitConditionalJump<LEFTJCC>(rightSkipped);
+            }
+
+            ExpressionTree::RegionEvaluation right(tree, m_rightRegion);
+            m_right.CodeGenFlags(tree);
+            code.EmitConditionalSet<RIGHTJCC>(resultRegister);
+            right.End();
+
+            join.Restore();
+            code.PlaceLabel(rightSkipped);
+
+            code.Emit<OpCode::Or>(resultRegister, resultRegister);
+        }
+
+        return result;
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    bool LogicalNode<OP, LEFTJCC, RIGHTJCC>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    bool LogicalNode<OP, LEFTJCC, RIGHTJCC>::InterpretValue(Interpreter& interpreter)
+    {
+        return OP == OpCode::And
+            ? m_left.Interpret(interpreter) && m_right.Interpret(interpreter)
+            : m_left.Interpret(interpreter) || m_right.Interpret(interpreter);
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::ReleaseReferencesToChildren()
+    {
+        m_left.DecrementFlagsParentCount();
+        m_right.DecrementFlagsParentCount();
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::AddFlagsChildReferences()
+    {
+        m_left.IncrementFlagsParentCount();
+        m_right.IncrementFlagsParentCount();
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    void LogicalNode<OP, LEFTJCC, RIGHTJCC>::ReleaseFlagsChildReferences()
+    {
+        m_left.DecrementFlagsParentCount();
+        m_right.DecrementFlagsParentCount();
+    }
+
+
+    template <OpCode OP, JccType LEFTJCC, JccType RIGHTJCC>
+    bool LogicalNode<OP, LEFTJCC, RIGHTJCC>::Simplify()
+    {
+        // The value which decides the result on its own: false for and,
+        // true for or.
+        const bool decisiveValue = OP == OpCode::Or;
+        bool value;
+
+        if (m_left.IsConstant() && m_left.GetConstantValue() == decisiveValue)
+        {
+            value = decisiveValue;
+        }
+        else if (m_right.IsConstant() && m_right.GetConstantValue() == decisiveValue)
+        {
+            value = decisiveValue;
+        }
+        else if (m_left.IsConstant() && m_right.IsConstant())
+        {
+            value = !decisiveValue;
+        }
+        else
+        {
+            return false;
+        }
+
+        // See RelationalOperatorNode::Simplify().
+        if (this->GetFlagsParentCount() > 0)
+        {
+            this->SetConstantValue(value);
+            return false;
+        }
+
+        this->FoldToConstant(value);
+        return true;
+    }
+
+
+    //*************************************************************************
+    //
+    // Template definitions for LogicalNotNode
+    //
+    //*************************************************************************
+    template <JccType JCC>
+    LogicalNotNode<JCC>::LogicalNotNode(ExpressionTree& tree,
+                                        FlagExpressionNode<JCC>& condition)
+        : FlagExpressionNode<InverseJcc<JCC>::value>(tree),
+          m_condition(condition)
+    {
+        // Use the CodeGenFlags()-related call.
+        m_condition.IncrementFlagsParentCount();
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::Print(std::ostream& out) const
+    {
+        this->PrintCoreProperties(out, "LogicalNot");
+
+        out << ", condition = " << m_condition.GetId();
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_condition);
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_condition);
+    }
+
+
+    template <JccType JCC>
+    typename ExpressionTree::Storage<bool> LogicalNotNode<JCC>::CodeGenValue(ExpressionTree& tree)
+    {
+        CodeGenFlags(tree);
+
+        auto result = tree.Direct<bool>();
+        tree.GetCodeGenerator().EmitConditionalSet<InverseJcc<JCC>::value>(result.GetDirectRegister());
+
+        return result;
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::CodeGenFlags(ExpressionTree& tree)
+    {
+        m_condition.CodeGenFlags(tree);
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::CodeGenBranch(ExpressionTree& tree,
+                                            Label target,
+                                            bool jumpIfTrue)
+    {
+        m_condition.CodeGenBranch(tree, target, !jumpIfTrue);
+    }
+
+
+    template <JccType JCC>
+    bool LogicalNotNode<JCC>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <JccType JCC>
+    bool LogicalNotNode<JCC>::InterpretValue(Interpreter& interpreter)
+    {
+        return !m_condition.Interpret(interpreter);
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::ReleaseReferencesToChildren()
+    {
+        m_condition.DecrementFlagsParentCount();
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::AddFlagsChildReferences()
+    {
+        m_condition.IncrementFlagsParentCount();
+    }
+
+
+    template <JccType JCC>
+    void LogicalNotNode<JCC>::ReleaseFlagsChildReferences()
+    {
+        m_condition.DecrementFlagsParentCount();
+    }
+
+
+    template <JccType JCC>
+    bool LogicalNotNode<JCC>::Simplify()
+    {
+        if (!m_condition.IsConstant())
+        {
+            return false;
+        }
+
+        const bool value = !m_condition.GetConstantValue();
+
+        // See RelationalOperatorNode::Simplify().
+        if (this->GetFlagsParentCount() > 0)
+        {
+            this->SetConstantValue(value);
+            return false;
+        }
+
+        this->FoldToConstant(value);
+        return true;
+    }
+}
@@ -0,0 +1,245 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <limits>
+#include <type_traits>
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"     // OpCode type.
+#include "NativeJIT/CodeGenHelpers.h"
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    // The operations which take the left operand in rax and produce their
+    // result in the rdx:rax register pair.
+    enum class MulDivOperation
+    {
+        Div,        // The quotient, rounded toward zero.
+        Mod,        // The remainder, with the sign of the dividend.
+        MulHigh     // The upper half of the double-width product.
+    };
+
+
+    // Implements the division and the remainder through the div/idiv
+    // instructions and the upper half of the product through the single
+    // operand mul/imul instructions, signed or unsigned according to T. Only
+    // 32 and 64-bit operands are supported, ExpressionNodeFactory widens the
+    // narrower ones.
+    // As in C++, the division by zero and the overflow of the signed division
+    // are undefined. The generated code raises a divide error for them.
+    template <typename T, MulDivOperation OP>
+    class MulDivNode : public Node<T>
+    {
+    public:
+        MulDivNode(ExpressionTree& tree, Node<T>& left, Node<T>& right);
+
+        virtual Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+
+        // Folds the operation on two constants unless it is a division
+        // which would raise a divide error, which is left to the runtime.
+        virtual bool Simplify() override;
+
+    private:
+        static_assert(std::is_integral<T>::value && sizeof(T) >= 4,
+                      "MulDivNode requires 32 or 64-bit integer operands.");
+
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~MulDivNode();
+
+        static T Apply(T left, T right);
+
+        Node<T>& m_left;
+        Node<T>& m_right;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for MulDivNode
+    //
+    //*************************************************************************
+    template <typename T, MulDivOperation OP>
+    MulDivNode<T, OP>::MulDivNode(ExpressionTree& tree,
+                                  Node<T>& left,
+                                  Node<T>& right)
+        : Node<T>(tree),
+          m_left(left),
+          m_right(right)
+    {
+        m_left.IncrementParentCount();
+        m_right.IncrementParentCount();
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    Storage<T> MulDivNode<T, OP>::CodeGenValue(ExpressionTree& tree)
+    {
+        typedef typename Storage<T>::DirectRegister DirectRegister;
+
+        const bool c_isSigned = std::is_signed<T>::value;
+        auto & code = tree.GetCodeGenerator();
+
+        Storage<T> left;
+        Storage<T> right;
+
+        this->CodeGenInOrder(tree,
+                             m_left, left,
+                             m_right, right);
+
+        // Take over rax and rdx. The values which occupy them, including the
+        // operands, are moved elsewhere and the pins keep the registers from
+        // being picked for the right operand.
+        Storage<T> low = tree.Direct<T>(DirectRegister(rax));
+        ReferenceCounter lowPin = low.GetPin();
+        Storage<T> high = tree.Direct<T>(DirectRegister(rdx));
+        ReferenceCounter highPin = high.GetPin();
+
+        const DirectRegister rightRegister = right.ConvertToDirect(false);
+        CodeGenHelpers::Emit<OpCode::Mov>(code, low.GetDirectRegister(), left);
+
+        if (OP == MulDivOperation::MulHigh)
+        {
+            code.Emit<c_isSigned ? OpCode::IMul : OpCode::Mul>(rightRegister);
+
+            return high;
+        }
+
+        // Extend the dividend into rdx.
+        if (c_isSigned)
+        {
+            code.Emit<OpCode::Cqo>(low.GetDirectRegister());
+        }
+        else
+        {
+            code.Emit<OpCode::Xor>(high.GetDirectRegister(), high.GetDirectRegister());
+        }
+
+        code.Emit<c_isSigned ? OpCode::IDiv : OpCode::Div>(rightRegister);
+
+        return OP == MulDivOperation::Div ? low : high;
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    void MulDivNode<T, OP>::Print(std::ostream& out) const
+    {
+        static char const * const c_names[] = { "Div", "Mod", "MulHigh" };
+
+        this->PrintCoreProperties(out, c_names[static_cast<unsigned>(OP)]);
+
+        out << ", left = " << m_left.GetId()
+            << ", right = " << m_right.GetId();
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    void MulDivNode<T, OP>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_left);
+        builder.AddNode(m_right);
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    void MulDivNode<T, OP>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_left);
+        children.push_back(&m_right);
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    bool MulDivNode<T, OP>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    T MulDivNode<T, OP>::InterpretValue(Interpreter& interpreter)
+    {
+        return Apply(m_left.Interpret(interpreter), m_right.Interpret(interpreter));
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    void MulDivNode<T, OP>::ReleaseReferencesToChildren()
+    {
+        m_left.DecrementParentCount();
+        m_right.DecrementParentCount();
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    bool MulDivNode<T, OP>::Simplify()
+    {
+        if (!m_left.IsConstant() || !m_right.IsConstant())
+        {
+            return false;
+        }
+
+        const T left = m_left.GetConstantValue();
+        const T right = m_right.GetConstantValue();
+
+        if (OP != MulDivOperation::MulHigh
+            && (right == 0
+                || (std::is_signed<T>::value
+                    && left == (std::numeric_limits<T>::min)()
+                    && right == static_cast<T>(-1))))
+        {
+            return false;
+        }
+
+        this->FoldToConstant(Apply(left, right));
+        return true;
+    }
+
+
+    template <typename T, MulDivOperation OP>
+    T MulDivNode<T, OP>::Apply(T left, T right)
+    {
+        switch (OP)
+        {
+        case MulDivOperation::Div:
+            return Interpretation::ApplyDiv(left, right);
+
+        case MulDivOperation::Mod:
+            return Interpretation::ApplyMod(left, right);
+
+        default:
+            return Interpretation::ApplyMulHigh(left, right);
+        }
+    }
+}
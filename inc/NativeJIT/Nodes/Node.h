@@ -30,8 +30,14 @@
 
 #include <cstdint>
 #include <iosfwd>   // Debugging output.
+#include <type_traits>
 
+#include "NativeJIT/AllocatorVector.h"            // GetChildren() parameter.
+#include "NativeJIT/CodeGen/ValuePredicates.h"    // ForcedCast() in CodeGenConstant().
+#include "NativeJIT/CodeGenHelpers.h"             // MovThroughTemporary() in CodeGenConstant().
 #include "NativeJIT/ExpressionTree.h"             // ExpressionTree::Storage<T> return type.
+#include "NativeJIT/Interpreter.h"                // Interpreter parameter.
+#include "NativeJIT/StructuralKey.h"             // StructuralKeyBuilder parameter.
 #include "NativeJIT/TypePredicates.h"
 #include "Temporary/Assert.h"
 #include "Temporary/NonCopyable.h"
@@ -57,13 +63,14 @@ namespace NativeJIT
         // only once, but the result will also be stored in cache with a
         // matching number of references. The cache will be released once all
         // parents evaluate the node.
-        // IMPORTANT: Currently, there's an assumption that if a node is created,
-        // it must be placed inside the tree. Remove this assumption and
-        // allow for optimizing away unused nodes. See bug#29.
+        // Nodes that end up with no parents are not evaluated, so subtrees can
+        // be created speculatively and discarded.
         void IncrementParentCount();
 
         // Decrements the number of node's parents as set through
         // IncrementParentCount(). Used only when nodes are optimized away.
+        // If the node has been replaced by another node, the parent reference
+        // held by the replacement on node's behalf is released as well.
         void DecrementParentCount();
 
         unsigned GetParentCount() const;
@@ -73,15 +80,51 @@ namespace NativeJIT
         bool HasBeenEvaluated() const;
         void MarkEvaluated();
 
+        // Marks the node as not evaluated so that its code can be generated
+        // again, see ExpressionTree::RegionCopies. The node must not hold a
+        // cached value at that point.
+        void ResetEvaluation();
+
         // Returns whether the node is referenced. Node is considered to be
         // referenced if it has parents which will call its CodeGen() method
         // or through some alternate method. The IncrementParentCount() call
         // which implies the CodeGen() call will implicitly mark the node as
         // referenced. Parents that use the node through some other means
         // need to call MarkReferenced() explicitly.
+        // Nodes that are not referenced are pruned from the tree together
+        // with their exclusive children before the code generation.
         bool IsReferenced() const;
         void MarkReferenced();
 
+        // Returns whether the value of the node is known at compile time,
+        // either because the node is an immediate or because Simplify()
+        // computed it. See Node<T>::GetConstantValue().
+        bool IsConstant() const;
+
+        // Returns the constant value of the node in the interpreter's word
+        // representation, see InterpreterValue<T>. Allows the parents that
+        // only know the node as NodeBase, such as the users of the collapsed
+        // base objects, to read constant addresses.
+        uint64_t GetConstantWord() const;
+
+        // Returns whether the node was replaced by a constant or by another
+        // node by Simplify(). Folded nodes don't evaluate their children.
+        bool IsFolded() const;
+
+        // Returns whether the node was replaced by another node by Simplify().
+        // Replaced nodes forward their evaluation to the replacement.
+        bool IsReplaced() const;
+
+        // Returns the node whose code is generated on behalf of this node,
+        // i.e. the replacement if the node was replaced, otherwise the node
+        // itself.
+        NodeBase const & GetEvaluatedNode() const;
+
+        // Calls ReleaseReferencesToChildren() unless it has already been called
+        // for the node, f. ex. because the node was folded.
+        void ReleaseChildren();
+        bool HaveChildrenBeenReleased() const;
+
         //
         // Non-pure virtual methods.
         //
@@ -95,7 +138,8 @@ namespace NativeJIT
 
         // When the node is optimized away, instructs it to undo the
         // IncreaseParentCount() calls it made in its constructor. Default
-        // implementation throws.
+        // implementation throws, so every node type that can be left
+        // unused must override it.
         virtual void ReleaseReferencesToChildren();
 
         // For nodes that represent objects generated off of another base object
@@ -109,6 +153,45 @@ namespace NativeJIT
         // ReleaseReferencesToChildren().
         virtual bool GetBaseAndOffset(NodeBase*& base, int32_t& offset) const;
 
+        // Describes the values that influence the code generated for the node
+        // and its children to the builder. Nodes that are structurally equal
+        // must produce equal descriptions. The node's type and parent count
+        // are described by the builder itself. Default implementation marks
+        // the structure as impossible to describe, which prevents caching.
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const;
+
+        // Appends the children which the node evaluates to the vector, in the
+        // order in which DescribeStructure() adds them. Used by ExpressionTree
+        // to compute the live ranges and the conditional regions. Default
+        // implementation appends nothing.
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const;
+
+        // Returns whether the node can be evaluated by the Interpreter through
+        // the Node<T>::Interpret() method. Default implementation returns false.
+        virtual bool IsInterpretable() const;
+
+        // Called by ExpressionTree before the code generation, in topological
+        // order so that the children of the node have already been simplified.
+        // Nodes that can compute their value at compile time or that reduce
+        // to one of their children (f. ex. x + 0) replace themselves through
+        // Node<T>::FoldToConstant() or Node<T>::FoldToNode() and return true.
+        // Default implementation leaves the node unchanged and returns false.
+        virtual bool Simplify();
+
+        // Called by ExpressionTree for the nodes that have not been evaluated
+        // yet when it issues the loads early, see LoadScheduling::Hoisted.
+        // Nodes that load their value from an address which is available
+        // without evaluating any other node make their subsequent evaluation
+        // load the value into a register and return true. Default
+        // implementation returns false.
+        virtual bool PrepareForHoisting();
+
+        // Called by ExpressionTree for every node at the start of each
+        // compile, before the loads are hoisted, so that the decisions made
+        // by PrepareForHoisting() during the previous compile don't carry
+        // over. Default implementation does nothing.
+        virtual void ResetHoisting();
+
         //
         // Pure virtual methods.
         //
@@ -116,10 +199,35 @@ namespace NativeJIT
         virtual void CodeGenCache(ExpressionTree& tree) = 0;
         virtual bool IsCached() const = 0;
 
+        // Returns the number of evaluations through Node<T>::CodeGen() which
+        // the cached value is still held for. The other two methods add the
+        // references for additional evaluations, f. ex. by the copies of an
+        // unrolled loop body, and release the ones which were not used.
+        virtual unsigned GetCacheReferenceCount() const = 0;
+        virtual void AddCacheReferences(unsigned count) = 0;
+        virtual void ReleaseCacheReferences(unsigned count) = 0;
+
+        // Releases the cached value, which exists only on some of the paths
+        // through the generated code, and marks the node as not evaluated,
+        // see ExpressionTree::RegionEvaluation. Evaluating the node again
+        // caches the value for all parents but the usedCount ones which have
+        // already used it.
+        virtual void DiscardEvaluation(unsigned usedCount) = 0;
+
+        // Gives back the reference to the cached value which a parent used
+        // before its own evaluation was discarded. The value is the one the
+        // parent got from the cache.
+        virtual void RestoreCacheReference(Storage<void*> const & value) = 0;
+
         // Evaluates the node and regardless of its type returns a void* Storage.
         // This method is equivalent to Node<T>::CodeGen() with type erasure.
         virtual Storage<void*> CodeGenAsBase(ExpressionTree& tree) = 0;
 
+        // Interpreter counterparts of CodeGenCache() and CodeGenAsBase(). The
+        // former evaluates the node and stores its value in the interpreter.
+        virtual void InterpretCache(Interpreter& interpreter) = 0;
+        virtual void* InterpretAsBase(Interpreter& interpreter) = 0;
+
         virtual void Print(std::ostream& out) const = 0;
 
     protected:
@@ -143,6 +251,16 @@ namespace NativeJIT
                                    Node<T1>& n1, Storage<T1>& s1,
                                    Node<T2>& n2, Storage<T2>& s2);
 
+        // Sets the constant value of the node in the interpreter's word
+        // representation, see GetConstantWord().
+        void SetConstantWord(uint64_t value);
+
+        // Marks the node as folded and releases its children. If the
+        // replacement is specified, the parents of this node become the
+        // parents of the replacement.
+        void Fold(NodeBase* replacement);
+        NodeBase* GetReplacementBase() const;
+
     private:
         unsigned m_id;
 
@@ -150,6 +268,12 @@ namespace NativeJIT
         unsigned m_parentCount;
         bool m_isReferenced;
         bool m_hasBeenEvaluated;
+
+        bool m_isConstant;
+        uint64_t m_constantWord;
+        bool m_haveChildrenBeenReleased;
+        bool m_isFolded;
+        NodeBase* m_replacement;
     };
 
 
@@ -163,12 +287,28 @@ namespace NativeJIT
 
         ExpressionTree::Storage<T> CodeGen(ExpressionTree& tree);
 
+        // Returns the value of the node for the current evaluation by the
+        // interpreter. The node is evaluated only once per evaluation, the
+        // subsequent calls return the cached value.
+        T Interpret(Interpreter& interpreter);
+
         //
         // Overrides of NodeBase methods.
         //
 
         virtual void CodeGenCache(ExpressionTree& tree) override;
         virtual bool IsCached() const override;
+        virtual unsigned GetCacheReferenceCount() const override;
+        virtual void AddCacheReferences(unsigned count) override;
+        virtual void ReleaseCacheReferences(unsigned count) override;
+        virtual void DiscardEvaluation(unsigned usedCount) override;
+        virtual void RestoreCacheReference(Storage<void*> const & value) override;
+
+        virtual void InterpretCache(Interpreter& interpreter) override;
+        virtual void* InterpretAsBase(Interpreter& interpreter) override;
+
+        // Returns the value of a node for which IsConstant() returns true.
+        T GetConstantValue() const;
 
     protected:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -182,13 +322,58 @@ namespace NativeJIT
         void SetRegisterCount(unsigned count);
         void PrintCoreProperties(std::ostream& out, char const *nodeName) const;
 
+        // Marks the node as having a value known at compile time. Used by the
+        // nodes that hold constants.
+        void SetConstantValue(T value);
+
+        // Replaces the node with a constant. The node releases its children
+        // and generates the constant instead of calling CodeGenValue().
+        void FoldToConstant(T value);
+
+        // Replaces the node with another node that computes the same value.
+        // The node releases its children and forwards the code generation
+        // to the replacement.
+        void FoldToNode(Node<T>& replacement);
+
     private:
+        // Tags for CodeGenConstant() dispatch.
+        typedef std::integral_constant<unsigned, 0> ReferenceConstant;
+        typedef std::integral_constant<unsigned, 1> InlineConstant;
+        typedef std::integral_constant<unsigned, 2> FloatConstant;
+        typedef std::integral_constant<unsigned, 3> IntegerConstant;
+
+        typedef std::integral_constant<
+            unsigned,
+            std::is_reference<T>::value
+                ? 0
+                : ImmediateCategoryOf<T>::value == ImmediateCategory::InlineImmediate
+                    ? 1
+                    : RegisterStorage<T>::c_isFloat ? 2 : 3> ConstantKind;
+
         unsigned m_cacheReferenceCount;
         ExpressionTree::Storage<T> m_cache;
 
+        // The number of parents which used the value before the evaluation
+        // was discarded, see DiscardEvaluation().
+        unsigned m_usedReferenceCount;
+
+        // Returns the storage holding the constant value of a folded node.
+        Storage<T> CodeGenConstant(ExpressionTree& tree, ReferenceConstant);
+        Storage<T> CodeGenConstant(ExpressionTree& tree, InlineConstant);
+        Storage<T> CodeGenConstant(ExpressionTree& tree, FloatConstant);
+        Storage<T> CodeGenConstant(ExpressionTree& tree, IntegerConstant);
+
+        // Returns the node which replaced this one in FoldToNode() or nullptr.
+        Node<T>* GetReplacement() const;
+
         virtual Storage<T> CodeGenValue(ExpressionTree& tree) = 0;
         virtual Storage<void*> CodeGenAsBase(ExpressionTree& tree) override;
 
+        // Computes the value of the node with the interpreter. Only called
+        // for nodes which override IsInterpretable() to return true, default
+        // implementation throws.
+        virtual T InterpretValue(Interpreter& interpreter);
+
         void SetCache(ExpressionTree::Storage<T> s);
         Storage<T> GetAndReleaseCache();
     };
@@ -218,7 +403,8 @@ namespace NativeJIT
     template <typename T>
     Node<T>::Node(ExpressionTree& tree)
         : NodeBase(tree),
-          m_cacheReferenceCount(0)
+          m_cacheReferenceCount(0),
+          m_usedReferenceCount(0)
     {
     }
 
@@ -229,7 +415,12 @@ namespace NativeJIT
         LogThrowAssert(!IsCached(), "Cache is already set for node with ID %u", GetId());
         LogThrowAssert(GetParentCount() > 0, "Cannot set cache for node %u with zero parents", GetId());
 
-        m_cacheReferenceCount = GetParentCount();
+        LogThrowAssert(m_usedReferenceCount < GetParentCount(),
+                       "All parents of node %u have already used its value",
+                       GetId());
+
+        m_cacheReferenceCount = GetParentCount() - m_usedReferenceCount;
+        m_usedReferenceCount = 0;
         m_cache = s;
     }
 
@@ -266,6 +457,71 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    unsigned Node<T>::GetCacheReferenceCount() const
+    {
+        return m_cacheReferenceCount;
+    }
+
+
+    template <typename T>
+    void Node<T>::AddCacheReferences(unsigned count)
+    {
+        LogThrowAssert(IsCached(), "Cache has not been set for node ID %u", GetId());
+
+        m_cacheReferenceCount += count;
+    }
+
+
+    template <typename T>
+    void Node<T>::ReleaseCacheReferences(unsigned count)
+    {
+        LogThrowAssert(count <= m_cacheReferenceCount,
+                       "Cannot release %u references to the cache of node ID %u which has %u",
+                       count,
+                       GetId(),
+                       m_cacheReferenceCount);
+
+        m_cacheReferenceCount -= count;
+
+        if (m_cacheReferenceCount == 0)
+        {
+            m_cache.Reset();
+        }
+    }
+
+
+    template <typename T>
+    void Node<T>::DiscardEvaluation(unsigned usedCount)
+    {
+        LogThrowAssert(usedCount <= GetParentCount(),
+                       "Node %u has %u parents, fewer than the %u which used its value",
+                       GetId(),
+                       GetParentCount(),
+                       usedCount);
+
+        m_cacheReferenceCount = 0;
+        m_cache.Reset();
+        m_usedReferenceCount = usedCount;
+        ResetEvaluation();
+    }
+
+
+    template <typename T>
+    void Node<T>::RestoreCacheReference(Storage<void*> const & value)
+    {
+        if (IsCached())
+        {
+            ++m_cacheReferenceCount;
+        }
+        else
+        {
+            m_cache = Storage<T>(value);
+            m_cacheReferenceCount = 1;
+        }
+    }
+
+
     template <typename T>
     void Node<T>::PrintCoreProperties(std::ostream& out, char const* nodeName) const
     {
@@ -274,6 +530,15 @@ namespace NativeJIT
             << ", parents = " << GetParentCount()
             << ", ";
 
+        if (GetReplacement() != nullptr)
+        {
+            out << "replaced by " << GetReplacement()->GetId() << ", ";
+        }
+        else if (IsFolded())
+        {
+            out << "folded to constant, ";
+        }
+
         if (IsCached())
         {
             out << "cached in ";
@@ -291,6 +556,16 @@ namespace NativeJIT
     template <typename T>
     void Node<T>::CodeGenCache(ExpressionTree& tree)
     {
+        // The parents of the replaced node are the parents of the replacement.
+        if (GetReplacement() != nullptr)
+        {
+            if (!GetReplacement()->HasBeenEvaluated())
+            {
+                GetReplacement()->CodeGenCache(tree);
+            }
+            return;
+        }
+
         LogThrowAssert(GetParentCount() > 0,
                        "Cannot evaluate node %u with no parents",
                        GetId());
@@ -299,19 +574,42 @@ namespace NativeJIT
                        GetId());
         MarkEvaluated();
 
-        SetCache(CodeGenValue(tree));
+        // Let the register allocator know which node is being evaluated and
+        // which node the resulting value belongs to.
+        const unsigned outerNodeId = tree.SetCurrentNode(GetId());
+
+        Storage<T> value = IsFolded()
+            ? CodeGenConstant(tree, ConstantKind())
+            : CodeGenValue(tree);
+
+        value.SetDefiningNode(GetId());
+        SetCache(value);
+
+        tree.SetCurrentNode(outerNodeId);
     }
 
 
     template <typename T>
     typename ExpressionTree::Storage<T> Node<T>::CodeGen(ExpressionTree& tree)
     {
+        if (GetReplacement() != nullptr)
+        {
+            return GetReplacement()->CodeGen(tree);
+        }
+
         if (!IsCached())
         {
             CodeGenCache(tree);
         }
 
-        return GetAndReleaseCache();
+        Storage<T> result = GetAndReleaseCache();
+
+        if (tree.IsRecordingCacheUses())
+        {
+            tree.RecordCacheUse(*this, Storage<void*>(result));
+        }
+
+        return result;
     }
 
 
@@ -344,4 +642,141 @@ namespace NativeJIT
 
         return ExpressionTree::Storage<void*>(CodeGen(tree));
     }
+
+
+    template <typename T>
+    T Node<T>::Interpret(Interpreter& interpreter)
+    {
+        if (!interpreter.IsEvaluated(GetId()))
+        {
+            InterpretCache(interpreter);
+        }
+
+        return InterpreterValue<T>::FromWord(interpreter.GetValue(GetId()));
+    }
+
+
+    template <typename T>
+    void Node<T>::InterpretCache(Interpreter& interpreter)
+    {
+        interpreter.SetValue(GetId(), InterpreterValue<T>::ToWord(InterpretValue(interpreter)));
+    }
+
+
+    template <typename T>
+    void* Node<T>::InterpretAsBase(Interpreter& interpreter)
+    {
+        AssertAtRuntime<!RegisterStorage<T>::c_isFloat
+                        && RegisterStorage<T>::c_size == sizeof(void*)>(
+            "Invalid call to InterpretAsBase");
+
+        if (!interpreter.IsEvaluated(GetId()))
+        {
+            InterpretCache(interpreter);
+        }
+
+        return reinterpret_cast<void*>(interpreter.GetValue(GetId()));
+    }
+
+
+    template <typename T>
+    T Node<T>::GetConstantValue() const
+    {
+        LogThrowAssert(IsConstant(), "Node %u is not a constant", GetId());
+
+        return InterpreterValue<T>::FromWord(GetConstantWord());
+    }
+
+
+    template <typename T>
+    void Node<T>::SetConstantValue(T value)
+    {
+        SetConstantWord(InterpreterValue<T>::ToWord(value));
+    }
+
+
+    template <typename T>
+    void Node<T>::FoldToConstant(T value)
+    {
+        SetConstantValue(value);
+        Fold(nullptr);
+    }
+
+
+    template <typename T>
+    void Node<T>::FoldToNode(Node<T>& replacement)
+    {
+        // The children are simplified before their parents, so the
+        // replacement is already final if it has been replaced itself.
+        Node<T>& target = replacement.GetReplacement() != nullptr
+            ? *replacement.GetReplacement()
+            : replacement;
+
+        if (target.IsConstant())
+        {
+            SetConstantWord(target.GetConstantWord());
+        }
+
+        Fold(&target);
+    }
+
+
+    template <typename T>
+    Node<T>* Node<T>::GetReplacement() const
+    {
+        // Fold() only receives a replacement from FoldToNode(), which
+        // guarantees that its type is Node<T>.
+        return static_cast<Node<T>*>(GetReplacementBase());
+    }
+
+
+    template <typename T>
+    Storage<T> Node<T>::CodeGenConstant(ExpressionTree& /* tree */, ReferenceConstant)
+    {
+        LogThrowAbort("References cannot be folded, node %u", GetId());
+
+        // Not reached, LogThrowAbort() throws.
+        return Storage<T>();
+    }
+
+
+    template <typename T>
+    Storage<T> Node<T>::CodeGenConstant(ExpressionTree& tree, InlineConstant)
+    {
+        return tree.Immediate<T>(GetConstantValue());
+    }
+
+
+    template <typename T>
+    Storage<T> Node<T>::CodeGenConstant(ExpressionTree& tree, FloatConstant)
+    {
+        auto result = tree.Direct<T>();
+        CodeGenHelpers::MovThroughTemporary(tree,
+                                            result.GetDirectRegister(),
+                                            static_cast<typename std::remove_cv<T>::type>(GetConstantValue()));
+
+        return result;
+    }
+
+
+    template <typename T>
+    Storage<T> Node<T>::CodeGenConstant(ExpressionTree& tree, IntegerConstant)
+    {
+        auto result = tree.Direct<T>();
+        tree.GetCodeGenerator().EmitImmediate<OpCode::Mov>(
+            result.GetDirectRegister(),
+            ForcedCast<typename CanonicalRegisterStorageType<T>::Type>(GetConstantValue()));
+
+        return result;
+    }
+
+
+    template <typename T>
+    T Node<T>::InterpretValue(Interpreter& /* interpreter */)
+    {
+        LogThrowAbort("Node %u cannot be interpreted", GetId());
+
+        // Not reached, LogThrowAbort() throws.
+        return InterpreterValue<T>::FromWord(0);
+    }
 }
@@ -42,6 +42,9 @@ namespace NativeJIT
         virtual ExpressionTree::Storage<PACKED> CodeGenValue(ExpressionTree& tree) override;
 
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual void ReleaseReferencesToChildren() override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -199,4 +202,28 @@ namespace NativeJIT
             << ", left = " << m_left.GetId()
             << ", right = " << m_right.GetId();
     }
+
+
+    template <typename PACKED, bool ISMAX>
+    void PackedMinMaxNode<PACKED, ISMAX>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_left);
+        builder.AddNode(m_right);
+    }
+
+
+    template <typename PACKED, bool ISMAX>
+    void PackedMinMaxNode<PACKED, ISMAX>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_left);
+        children.push_back(&m_right);
+    }
+
+
+    template <typename PACKED, bool ISMAX>
+    void PackedMinMaxNode<PACKED, ISMAX>::ReleaseReferencesToChildren()
+    {
+        m_left.DecrementParentCount();
+        m_right.DecrementParentCount();
+    }
 }
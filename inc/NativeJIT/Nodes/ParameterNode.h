@@ -40,10 +40,20 @@ namespace NativeJIT
 
         unsigned GetPosition() const;
 
+        // Specializes the compiled code for the value of the parameter, which
+        // is then treated as a constant by Simplify(). The caller must still
+        // pass the parameter to the compiled function, but its value is
+        // ignored. Combined with ExpressionTree::AddConstantMemory(), the
+        // loads through a pointer bound to f. ex. a model which doesn't change
+        // for the lifetime of the function are replaced by the loaded values.
+        void Bind(T value);
+        bool IsBound() const;
+
         //
         // Overrides of NodeBase methods.
         //
         virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
         //
         // Overrides of Node methods.
@@ -51,6 +61,9 @@ namespace NativeJIT
         virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
 
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -60,6 +73,10 @@ namespace NativeJIT
 
         unsigned m_position;
         unsigned m_logicalRegister;
+
+        // The value set by Bind() in interpreter's word representation.
+        bool m_isBound;
+        uint64_t m_boundWord;
     };
 
 
@@ -170,7 +187,9 @@ namespace NativeJIT
 
     template <typename T>
     ParameterNode<T>::ParameterNode(ExpressionTree& tree, ParameterSlotAllocator& slotAllocator)
-        : Node<T>(tree)
+        : Node<T>(tree),
+          m_isBound(false),
+          m_boundWord(0)
     {
         slotAllocator.Allocate<T>();
         m_position = slotAllocator.GetPosition();
@@ -191,6 +210,26 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    void ParameterNode<T>::Bind(T value)
+    {
+        static_assert(!std::is_reference<T>::value, "Reference parameters cannot be bound");
+        LogThrowAssert(!this->HasBeenEvaluated(),
+                       "Cannot bind parameter %u after it was evaluated",
+                       m_position);
+
+        m_isBound = true;
+        m_boundWord = InterpreterValue<T>::ToWord(value);
+    }
+
+
+    template <typename T>
+    bool ParameterNode<T>::IsBound() const
+    {
+        return m_isBound;
+    }
+
+
     template <typename T>
     void ParameterNode<T>::ReleaseReferencesToChildren()
     {
@@ -198,6 +237,19 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    bool ParameterNode<T>::Simplify()
+    {
+        if (!m_isBound)
+        {
+            return false;
+        }
+
+        this->FoldToConstant(InterpreterValue<T>::FromWord(m_boundWord));
+        return true;
+    }
+
+
     template <typename T>
     typename ExpressionTree::Storage<T> ParameterNode<T>::CodeGenValue(ExpressionTree& tree)
     {
@@ -214,5 +266,36 @@ namespace NativeJIT
         this->PrintCoreProperties(out, "ParameterNode");
 
         out << ", position = " << m_position;
+
+        if (m_isBound)
+        {
+            out << ", bound";
+        }
+    }
+
+
+    template <typename T>
+    void ParameterNode<T>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddValue(m_position);
+        builder.AddValue(m_logicalRegister);
+        builder.AddValue(m_isBound);
+        builder.AddValue(m_boundWord);
+    }
+
+
+    template <typename T>
+    bool ParameterNode<T>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T ParameterNode<T>::InterpretValue(Interpreter& interpreter)
+    {
+        return InterpreterValue<T>::FromWord(m_isBound
+                                             ? m_boundWord
+                                             : interpreter.GetParameter(m_position));
     }
 }
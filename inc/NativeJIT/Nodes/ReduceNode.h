@@ -0,0 +1,515 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <type_traits>
+
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"
+#include "NativeJIT/CodeGenHelpers.h"
+#include "NativeJIT/ExpressionTree.h"
+#include "NativeJIT/Nodes/Node.h"
+
+
+namespace NativeJIT
+{
+    class ExpressionTree;
+
+    // The pointer to the element of the array the body of a ReduceNode is
+    // evaluated for. The node is bound to a single ReduceNode when that node
+    // is constructed and can only be used within its body.
+    template <typename E>
+    class ReduceElementNode : public Node<E*>
+    {
+    public:
+        ReduceElementNode(ExpressionTree& tree);
+
+        // Called by the constructor of the ReduceNode which iterates over the
+        // elements.
+        void BindToLoop(NodeBase const & loop);
+
+        // Called by the ReduceNode while it generates the code of its body.
+        // The node evaluates to the cursor, which points to the first element
+        // processed by the iteration, plus the offset. Passing nullptr marks
+        // the node as used outside of the body.
+        void SetCursor(Storage<E*> const * cursor, int32_t offset);
+
+        //
+        // Overrides of Node methods
+        //
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual Storage<E*> CodeGenValue(ExpressionTree& tree) override;
+
+    private:
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~ReduceElementNode();
+
+        NodeBase const * m_loop;
+        Storage<E*> const * m_cursor;
+        int32_t m_offset;
+    };
+
+
+    // Combines the values of the body evaluated for each of the count elements
+    // of the array with the initial value by addition, minimum or maximum.
+    // The body refers to the current element through the ReduceElementNode
+    // and forms a conditional region of the tree (see
+    // ExpressionTree::AddConditionalRegion()), so the nodes used only within
+    // it are evaluated once per element while the nodes shared with the rest
+    // of the tree are evaluated once, before the loop. If the unroll count is
+    // greater than one, each iteration of the main loop processes that many
+    // elements and a second loop processes the remaining ones.
+    template <OpCode OP, typename T, typename E>
+    class ReduceNode : public Node<T>
+    {
+    public:
+        ReduceNode(ExpressionTree& tree,
+                   Node<E*>& array,
+                   Node<uint32_t>& count,
+                   ReduceElementNode<E>& element,
+                   Node<T>& body,
+                   Node<T>& initial,
+                   unsigned unrollCount);
+
+
+        //
+        // Overrides of Node methods.
+        //
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual void ReleaseReferencesToChildren() override;
+
+        //
+        // Overrides of Node<T> methods.
+        //
+        virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+    private:
+        typedef typename Storage<T>::DirectRegister DirectRegister;
+
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                      "The reduced values must be numbers.");
+        static_assert(OP == OpCode::Add || OP == OpCode::Min || OP == OpCode::Max,
+                      "Unsupported reduction.");
+
+        static const bool c_isIntegerMinMax = OP != OpCode::Add
+                                              && !std::is_floating_point<T>::value;
+
+        // The condition under which the integer minimum or maximum replaces
+        // the accumulated value with the new one after comparing them.
+        static const JccType c_replaceJcc
+            = OP == OpCode::Min
+              ? (std::is_signed<T>::value ? JccType::JG : JccType::JA)
+              : (std::is_signed<T>::value ? JccType::JL : JccType::JB);
+
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~ReduceNode();
+
+        // Generates the code of the body for the element at the offset from
+        // the cursor. The returned value is ready to be passed to Accumulate().
+        Storage<T> CodeGenBody(ExpressionTree& tree,
+                               Storage<E*> const & cursor,
+                               int32_t offset);
+
+        // Combines the value into the accumulator register.
+        static void Accumulate(X64CodeGenerator& code,
+                               DirectRegister accumulator,
+                               Storage<T> const & value);
+        static void Accumulate(X64CodeGenerator& code,
+                               DirectRegister accumulator,
+                               Storage<T> const & value,
+                               std::false_type /* isIntegerMinMax */);
+        static void Accumulate(X64CodeGenerator& code,
+                               DirectRegister accumulator,
+                               Storage<T> const & value,
+                               std::true_type /* isIntegerMinMax */);
+
+        Node<E*>& m_array;
+        Node<uint32_t>& m_count;
+        ReduceElementNode<E>& m_element;
+        Node<T>& m_body;
+        Node<T>& m_initial;
+        const unsigned m_unrollCount;
+
+        // The conditional region formed by the body.
+        const unsigned m_bodyRegion;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for ReduceElementNode
+    //
+    //*************************************************************************
+    template <typename E>
+    ReduceElementNode<E>::ReduceElementNode(ExpressionTree& tree)
+        : Node<E*>(tree),
+          m_loop(nullptr),
+          m_cursor(nullptr),
+          m_offset(0)
+    {
+    }
+
+
+    template <typename E>
+    void ReduceElementNode<E>::BindToLoop(NodeBase const & loop)
+    {
+        LogThrowAssert(m_loop == nullptr,
+                       "ReduceElement node %u is already bound to node %u",
+                       this->GetId(),
+                       m_loop != nullptr ? m_loop->GetId() : 0);
+        m_loop = &loop;
+    }
+
+
+    template <typename E>
+    void ReduceElementNode<E>::SetCursor(Storage<E*> const * cursor, int32_t offset)
+    {
+        m_cursor = cursor;
+        m_offset = offset;
+    }
+
+
+    template <typename E>
+    void ReduceElementNode<E>::Print(std::ostream& out) const
+    {
+        this->PrintCoreProperties(out, "ReduceElementNode");
+
+        if (m_loop != nullptr)
+        {
+            out << ", loop = " << m_loop->GetId();
+        }
+        else
+        {
+            out << ", not bound to a loop";
+        }
+    }
+
+
+    template <typename E>
+    void ReduceElementNode<E>::DescribeStructure(StructuralKeyBuilder& /* builder */) const
+    {
+        // The node has no children or values. The loop it is bound to is not
+        // its child, and the nodes using the element are distinguished by
+        // its ID.
+    }
+
+
+    template <typename E>
+    void ReduceElementNode<E>::ReleaseReferencesToChildren()
+    {
+    }
+
+
+    template <typename E>
+    ExpressionTree::Storage<E*> ReduceElementNode<E>::CodeGenValue(ExpressionTree& tree)
+    {
+        LogThrowAssert(m_cursor != nullptr,
+                       "ReduceElement node %u is used outside of the body of its loop",
+                       this->GetId());
+
+        Storage<E*> cursor = *m_cursor;
+
+        if (m_offset == 0)
+        {
+            return cursor;
+        }
+
+        // The body may have moved the cursor out of its register.
+        cursor.ConvertToDirect(false);
+        ReferenceCounter pin = cursor.GetPin();
+
+        auto element = tree.Direct<E*>();
+        tree.GetCodeGenerator().Emit<OpCode::Lea>(element.GetDirectRegister(),
+                                                  cursor.GetDirectRegister(),
+                                                  m_offset);
+
+        return element;
+    }
+
+
+    //*************************************************************************
+    //
+    // Template definitions for ReduceNode
+    //
+    //*************************************************************************
+    template <OpCode OP, typename T, typename E>
+    ReduceNode<OP, T, E>::ReduceNode(ExpressionTree& tree,
+                                     Node<E*>& array,
+                                     Node<uint32_t>& count,
+                                     ReduceElementNode<E>& element,
+                                     Node<T>& body,
+                                     Node<T>& initial,
+                                     unsigned unrollCount)
+        : Node<T>(tree),
+          m_array(array),
+          m_count(count),
+          m_element(element),
+          m_body(body),
+          m_initial(initial),
+          m_unrollCount(unrollCount),
+          m_bodyRegion(tree.AddConditionalRegion(*this, body))
+    {
+        LogThrowAssert(unrollCount > 0, "The unroll count must be positive");
+        LogThrowAssert(static_cast<uint64_t>(unrollCount) * sizeof(E) <= INT32_MAX,
+                       "Unroll count %u is too large",
+                       unrollCount);
+
+        m_element.BindToLoop(*this);
+
+        m_array.IncrementParentCount();
+        m_count.IncrementParentCount();
+        m_body.IncrementParentCount();
+        m_initial.IncrementParentCount();
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    void ReduceNode<OP, T, E>::Print(std::ostream& out) const
+    {
+        const std::string name = std::string("Reduce(") + X64CodeGenerator::OpCodeName(OP) + ") ";
+        this->PrintCoreProperties(out, name.c_str());
+
+        out << ", array = " << m_array.GetId();
+        out << ", count = " << m_count.GetId();
+        out << ", element = " << m_element.GetId();
+        out << ", body = " << m_body.GetId();
+        out << ", initial = " << m_initial.GetId();
+        out << ", unroll = " << m_unrollCount;
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    void ReduceNode<OP, T, E>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_array);
+        builder.AddNode(m_count);
+        builder.AddNode(m_initial);
+        builder.AddNode(m_body);
+        builder.AddValue(m_unrollCount);
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    void ReduceNode<OP, T, E>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_array);
+        children.push_back(&m_count);
+        children.push_back(&m_initial);
+        children.push_back(&m_body);
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    void ReduceNode<OP, T, E>::ReleaseReferencesToChildren()
+    {
+        m_array.DecrementParentCount();
+        m_count.DecrementParentCount();
+        m_body.DecrementParentCount();
+        m_initial.DecrementParentCount();
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    typename ExpressionTree::Storage<T> ReduceNode<OP, T, E>::CodeGenValue(ExpressionTree& tree)
+    {
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        Storage<E*> cursor;
+        Storage<uint32_t> remaining;
+
+        this->CodeGenInOrder(tree, m_array, cursor, m_count, remaining);
+
+        Storage<T> result = m_initial.CodeGen(tree);
+
+        // The loop advances the cursor, counts down the remaining elements and
+        // accumulates the result in registers it owns.
+        {
+            cursor.ConvertToDirect(true);
+            ReferenceCounter cursorPin = cursor.GetPin();
+
+            remaining.ConvertToDirect(true);
+            ReferenceCounter remainingPin = remaining.GetPin();
+
+            result.ConvertToDirect(true);
+        }
+
+        // Captures the register allocation for the back edges. All the values
+        // computed before the loop, including the three above, are back in
+        // their registers at the end of each iteration.
+        ExpressionTree::LoopHead head(tree);
+
+        // The unrolled loop makes m_unrollCount copies of the body and the
+        // remainder loop one more.
+        const unsigned copyCount = m_unrollCount > 1 ? m_unrollCount + 1 : 1;
+        ExpressionTree::RegionCopies copies(tree, m_bodyRegion, copyCount);
+
+        Label loopEnd = code.AllocateLabel();
+
+        if (m_unrollCount > 1)
+        {
+            Label unrolledStart = code.AllocateLabel();
+            Label remainderStart = code.AllocateLabel();
+
+            code.EmitImmediate<OpCode::Cmp>(remaining.GetDirectRegister(), m_unrollCount);
+            code.EmitConditionalJump<JccType::JB>(remainderStart);
+            code.PlaceLabel(unrolledStart);
+
+            // The values of the copies are combined with each other before the
+            // accumulator so that they don't wait for each other.
+            Storage<T> partial = CodeGenBody(tree, cursor, 0);
+
+            for (unsigned i = 1; i < m_unrollCount; ++i)
+            {
+                copies.BeginNextCopy();
+
+                Storage<T> value = CodeGenBody(tree,
+                                               cursor,
+                                               static_cast<int32_t>(i * sizeof(E)));
+                ReferenceCounter pin;
+
+                if (value.GetStorageClass() != StorageClass::Immediate)
+                {
+                    pin = value.GetPin();
+                }
+
+                Accumulate(code, partial.ConvertToDirect(true), value);
+            }
+
+            head.Restore();
+            Accumulate(code, result.GetDirectRegister(), partial);
+            partial.Reset();
+
+            code.EmitImmediate<OpCode::Add>(cursor.GetDirectRegister(),
+                                            static_cast<int32_t>(m_unrollCount * sizeof(E)));
+            code.EmitImmediate<OpCode::Sub>(remaining.GetDirectRegister(), m_unrollCount);
+            code.EmitImmediate<OpCode::Cmp>(remaining.GetDirectRegister(), m_unrollCount);
+            code.EmitConditionalJump<JccType::JAE>(unrolledStart);
+
+            code.PlaceLabel(remainderStart);
+            copies.BeginNextCopy();
+        }
+
+        Label loopStart = code.AllocateLabel();
+
+        code.Emit<OpCode::Or>(remaining.GetDirectRegister(), remaining.GetDirectRegister());
+        code.EmitConditionalJump<JccType::JE>(loopEnd);
+        code.PlaceLabel(loopStart);
+
+        {
+            Storage<T> value = CodeGenBody(tree, cursor, 0);
+
+            head.Restore();
+            Accumulate(code, result.GetDirectRegister(), value);
+        }
+
+        code.EmitImmediate<OpCode::Add>(cursor.GetDirectRegister(), static_cast<int32_t>(sizeof(E)));
+        code.EmitImmediate<OpCode::Sub>(remaining.GetDirectRegister(), 1);
+        code.EmitConditionalJump<JccType::JNE>(loopStart);
+        code.PlaceLabel(loopEnd);
+
+        copies.End();
+
+        return result;
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    typename ExpressionTree::Storage<T>
+    ReduceNode<OP, T, E>::CodeGenBody(ExpressionTree& tree,
+                                      Storage<E*> const & cursor,
+                                      int32_t offset)
+    {
+        m_element.SetCursor(&cursor, offset);
+
+        tree.CodeGenSharedNodes(m_bodyRegion);
+        Storage<T> value = m_body.CodeGen(tree);
+
+        m_element.SetCursor(nullptr, 0);
+
+        // The conditional move reads either a register or the memory. The
+        // memory operand of a byte value would be read as four bytes. Once
+        // converted, the value is no longer rematerialized as an immediate.
+        if (c_isIntegerMinMax
+            && (value.GetStorageClass() != StorageClass::Indirect || sizeof(T) == 1))
+        {
+            value.ConvertToDirect(true);
+        }
+
+        return value;
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    void ReduceNode<OP, T, E>::Accumulate(X64CodeGenerator& code,
+                                          DirectRegister accumulator,
+                                          Storage<T> const & value)
+    {
+        Accumulate(code,
+                   accumulator,
+                   value,
+                   std::integral_constant<bool, c_isIntegerMinMax>());
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    void ReduceNode<OP, T, E>::Accumulate(X64CodeGenerator& code,
+                                          DirectRegister accumulator,
+                                          Storage<T> const & value,
+                                          std::false_type /* isIntegerMinMax */)
+    {
+        CodeGenHelpers::Emit<OP>(code, accumulator, value);
+    }
+
+
+    template <OpCode OP, typename T, typename E>
+    void ReduceNode<OP, T, E>::Accumulate(X64CodeGenerator& code,
+                                          DirectRegister accumulator,
+                                          Storage<T> const & value,
+                                          std::true_type /* isIntegerMinMax */)
+    {
+        typedef typename CodeGenHelpers::ConditionalMoveRegister<DirectRegister::c_size>::Type
+            MoveRegisterType;
+
+        CodeGenHelpers::Emit<OpCode::Cmp>(code, accumulator, value);
+
+        if (value.GetStorageClass() == StorageClass::Direct)
+        {
+            code.EmitConditionalMove<c_replaceJcc>(MoveRegisterType(accumulator),
+                                                   MoveRegisterType(value.GetDirectRegister()));
+        }
+        else
+        {
+            code.EmitConditionalMove<c_replaceJcc>(MoveRegisterType(accumulator),
+                                                   value.GetBaseRegister(),
+                                                   value.GetOffset());
+        }
+    }
+}
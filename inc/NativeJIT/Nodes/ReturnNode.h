@@ -41,6 +41,10 @@ namespace NativeJIT
         virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
         virtual void CompileAsRoot(ExpressionTree& tree) override;
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -101,4 +105,32 @@ namespace NativeJIT
     {
         this->PrintCoreProperties(out, "ReturnNode");
     }
+
+
+    template <typename T>
+    void ReturnNode<T>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_child);
+    }
+
+
+    template <typename T>
+    void ReturnNode<T>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_child);
+    }
+
+
+    template <typename T>
+    bool ReturnNode<T>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T ReturnNode<T>::InterpretValue(Interpreter& interpreter)
+    {
+        return m_child.Interpret(interpreter);
+    }
 }
@@ -39,6 +39,12 @@ namespace NativeJIT
         virtual Storage<T> CodeGenValue(ExpressionTree& tree) override;
 
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
 
     private:
         // WARNING: This class is designed to be allocated by an arena allocator,
@@ -107,4 +113,67 @@ namespace NativeJIT
             << ", filler = " << m_filler.GetId()
             << ", bitCount = " << m_bitCount;
     }
+
+
+    template <typename T>
+    void ShldNode<T>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_shiftee);
+        builder.AddNode(m_filler);
+        builder.AddValue(m_bitCount);
+    }
+
+
+    template <typename T>
+    void ShldNode<T>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        children.push_back(&m_shiftee);
+        children.push_back(&m_filler);
+    }
+
+
+    template <typename T>
+    bool ShldNode<T>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T ShldNode<T>::InterpretValue(Interpreter& interpreter)
+    {
+        return Interpretation::ApplyShld(m_shiftee.Interpret(interpreter),
+                                         m_filler.Interpret(interpreter),
+                                         m_bitCount);
+    }
+
+
+    template <typename T>
+    void ShldNode<T>::ReleaseReferencesToChildren()
+    {
+        m_shiftee.DecrementParentCount();
+        m_filler.DecrementParentCount();
+    }
+
+
+    template <typename T>
+    bool ShldNode<T>::Simplify()
+    {
+        if (m_shiftee.IsConstant() && m_filler.IsConstant())
+        {
+            this->FoldToConstant(Interpretation::ApplyShld(m_shiftee.GetConstantValue(),
+                                                           m_filler.GetConstantValue(),
+                                                           m_bitCount));
+            return true;
+        }
+
+        // Shifting by zero bits leaves the shiftee unchanged.
+        if ((m_bitCount & (sizeof(T) == 8 ? 0x3f : 0x1f)) == 0)
+        {
+            this->FoldToNode(m_shiftee);
+            return true;
+        }
+
+        return false;
+    }
 }
@@ -44,6 +44,10 @@ namespace NativeJIT
         //
 
         virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T& InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
         virtual Storage<T&> CodeGenValue(ExpressionTree& tree) override;
 
     private:
@@ -80,6 +84,13 @@ namespace NativeJIT
     }
 
 
+    template <typename T>
+    void StackVariableNode<T>::DescribeStructure(StructuralKeyBuilder& /* builder */) const
+    {
+        // The node has no children or values, its type describes it fully.
+    }
+
+
     template <typename T>
     ExpressionTree::Storage<T&> StackVariableNode<T>::CodeGenValue(ExpressionTree& tree)
     {
@@ -102,4 +113,26 @@ namespace NativeJIT
         // Convert the pointer to a reference and return it.
         return Storage<T&>(addressOfStorage);
     }
+
+
+    template <typename T>
+    bool StackVariableNode<T>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T>
+    T& StackVariableNode<T>::InterpretValue(Interpreter& interpreter)
+    {
+        static_assert(sizeof(T) <= sizeof(uint64_t), "Invalid size of stack variable.");
+
+        return *reinterpret_cast<T*>(interpreter.GetVariable(this->GetId()));
+    }
+
+
+    template <typename T>
+    void StackVariableNode<T>::ReleaseReferencesToChildren()
+    {
+    }
 }
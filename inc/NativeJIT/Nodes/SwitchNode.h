@@ -0,0 +1,662 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "NativeJIT/AllocatorVector.h"              // Embedded member.
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"
+#include "NativeJIT/CodeGenHelpers.h"
+#include "NativeJIT/ExpressionTree.h"
+#include "NativeJIT/Nodes/ImmediateNode.h"          // RIPRelativeImmediate base class.
+#include "NativeJIT/Nodes/Node.h"
+#include "Temporary/Assert.h"
+
+
+namespace NativeJIT
+{
+    class ExpressionTree;
+
+    // Evaluates the case whose key equals the selector or the default case if
+    // there is none. Like the expressions of LazyConditionalNode, each case
+    // forms a conditional region of the tree (see
+    // ExpressionTree::AddConditionalRegion()), so only the selected case is
+    // evaluated. The keys that map to the same case share its code.
+    //
+    // If the keys are dense, the selector is bounds checked and the code jumps
+    // indirectly through a table of 32-bit offsets which is emitted together
+    // with the RIP-relative constants in Pass0. Otherwise, the code compares
+    // the selector with the sorted keys in a binary search. The selector is a
+    // 64-bit integer, see ExpressionNodeFactory::Switch() for the narrower
+    // ones.
+    template <typename T, typename S>
+    class SwitchNode : public Node<T>,
+                       public RIPRelativeImmediate
+    {
+    public:
+        SwitchNode(ExpressionTree& tree,
+                   Node<S>& selector,
+                   std::vector<S> const & keys,
+                   std::vector<Node<T>*> const & cases,
+                   Node<T>& defaultCase);
+
+
+        //
+        // Overrides of Node methods.
+        //
+        virtual void Print(std::ostream& out) const override;
+        virtual void DescribeStructure(StructuralKeyBuilder& builder) const override;
+        virtual void GetChildren(AllocatorVector<NodeBase const *>& children) const override;
+        virtual bool IsInterpretable() const override;
+        virtual T InterpretValue(Interpreter& interpreter) override;
+        virtual void ReleaseReferencesToChildren() override;
+        virtual bool Simplify() override;
+
+        //
+        // Overrides of Node<T> methods.
+        //
+        virtual ExpressionTree::Storage<T> CodeGenValue(ExpressionTree& tree) override;
+
+        //
+        // Overrides of RIPRelativeImmediate methods.
+        //
+        virtual void EmitStaticData(ExpressionTree& tree) override;
+
+    private:
+        typedef typename Storage<S>::DirectRegister SelectorRegister;
+
+        static_assert(std::is_integral<S>::value && sizeof(S) == 8,
+                      "The selector must be a 64-bit integer.");
+
+        // The jump table is used for at least this many keys spanning a range
+        // at most c_maxTableDensity times larger than their count.
+        static const unsigned c_minTableKeyCount = 4;
+        static const unsigned c_maxTableDensity = 3;
+
+        // Ranges of at most this many keys are searched linearly.
+        static const unsigned c_maxLinearSearchLength = 3;
+
+        // The condition under which the selector is greater than the key.
+        static const JccType c_greaterJcc = std::is_signed<S>::value
+                                            ? JccType::JG
+                                            : JccType::JA;
+
+        // WARNING: This class is designed to be allocated by an arena allocator,
+        // so its destructor will never be called. Therefore, it should hold no
+        // resources other than memory from the arena allocator.
+        ~SwitchNode();
+
+        // Returns the number of cases, including the default case, which is
+        // the last one.
+        unsigned GetCaseCount() const;
+
+        Node<T>& GetCase(unsigned index) const;
+
+        // Returns whether cmp can encode the key as a sign extended immediate.
+        static bool IsImmediateKey(S key);
+
+        // Emits the code which jumps to the label of the case selected by the
+        // value of the index register through the jump table.
+        void EmitTableJump(X64CodeGenerator& code,
+                           SelectorRegister index,
+                           SelectorRegister table,
+                           Storage<S> const & scratch);
+
+        // Emits the code which jumps to the label of the case selected by the
+        // value of the register if one of the keys in [first, last) matches it
+        // and to the label of the default case otherwise.
+        void EmitSearch(X64CodeGenerator& code,
+                        SelectorRegister value,
+                        Storage<S> const & scratch,
+                        unsigned first,
+                        unsigned last);
+
+        // Compares the register with the key, through the scratch register if
+        // the key does not fit into an immediate.
+        void EmitCompare(X64CodeGenerator& code,
+                         SelectorRegister value,
+                         S key,
+                         Storage<S> const & scratch);
+
+        // Generates the code for one of the cases, leaving its value in the
+        // result register and all the other values where they were before
+        // the indirect or the conditional jumps.
+        Storage<T> CodeGenCase(ExpressionTree& tree,
+                               ExpressionTree::JoinPoint& join,
+                               Node<T>& expression,
+                               unsigned region,
+                               typename Storage<T>::DirectRegister resultRegister);
+
+        Node<S>& m_selector;
+        Node<T>& m_defaultCase;
+
+        // The keys in increasing order and the index of the case for each of
+        // them. The keys that map to the default case are dropped.
+        AllocatorVector<S> m_keys;
+        AllocatorVector<unsigned> m_caseIndices;
+
+        // The distinct cases other than the default case.
+        AllocatorVector<Node<T>*> m_cases;
+
+        // The conditional regions formed by the cases, the default case last.
+        AllocatorVector<unsigned> m_regions;
+
+        // The label of each case, the default case last.
+        AllocatorVector<Label> m_labels;
+
+        bool m_isDense;
+
+        // Set in Pass0 when the jump table is emitted at m_tableOffset. Only
+        // the first evaluation of the node can use the table since the labels
+        // it refers to can be placed only once. The nodes in the body of an
+        // unrolled loop, for example, are evaluated more than once and the
+        // remaining copies use the binary search.
+        bool m_isTableEmitted;
+        int32_t m_tableOffset;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for SwitchNode
+    //
+    //*************************************************************************
+    template <typename T, typename S>
+    SwitchNode<T, S>::SwitchNode(ExpressionTree& tree,
+                                 Node<S>& selector,
+                                 std::vector<S> const & keys,
+                                 std::vector<Node<T>*> const & cases,
+                                 Node<T>& defaultCase)
+        : Node<T>(tree),
+          m_selector(selector),
+          m_defaultCase(defaultCase),
+          m_keys(Allocators::StlAllocator<S>(tree.GetAllocator())),
+          m_caseIndices(Allocators::StlAllocator<unsigned>(tree.GetAllocator())),
+          m_cases(Allocators::StlAllocator<Node<T>*>(tree.GetAllocator())),
+          m_regions(Allocators::StlAllocator<unsigned>(tree.GetAllocator())),
+          m_labels(Allocators::StlAllocator<Label>(tree.GetAllocator())),
+          m_isDense(false),
+          m_isTableEmitted(false),
+          m_tableOffset(0)
+    {
+        LogThrowAssert(keys.size() == cases.size(),
+                       "Switch has %u keys but %u cases",
+                       static_cast<unsigned>(keys.size()),
+                       static_cast<unsigned>(cases.size()));
+
+        std::vector<unsigned> order(keys.size());
+
+        for (unsigned i = 0; i < order.size(); ++i)
+        {
+            LogThrowAssert(cases[i] != nullptr, "Case %u of the switch is null", i);
+            order[i] = i;
+        }
+
+        std::sort(order.begin(),
+                  order.end(),
+                  [&keys](unsigned a, unsigned b) { return keys[a] < keys[b]; });
+
+        for (unsigned i = 0; i < order.size(); ++i)
+        {
+            const S key = keys[order[i]];
+            Node<T>* expression = cases[order[i]];
+
+            LogThrowAssert(i == 0 || keys[order[i - 1]] != key,
+                           "Duplicate switch key %lld",
+                           static_cast<long long>(key));
+
+            if (expression == &m_defaultCase)
+            {
+                continue;
+            }
+
+            const auto it = std::find(m_cases.begin(), m_cases.end(), expression);
+
+            m_keys.push_back(key);
+            m_caseIndices.push_back(static_cast<unsigned>(it - m_cases.begin()));
+
+            if (it == m_cases.end())
+            {
+                m_cases.push_back(expression);
+            }
+        }
+
+        // The unsigned difference is exact for both signed and unsigned keys.
+        m_isDense = m_keys.size() >= c_minTableKeyCount
+            && static_cast<uint64_t>(m_keys.back()) - static_cast<uint64_t>(m_keys.front())
+               < static_cast<uint64_t>(c_maxTableDensity) * m_keys.size();
+
+        for (unsigned i = 0; i < GetCaseCount(); ++i)
+        {
+            m_regions.push_back(tree.AddConditionalRegion(*this, GetCase(i)));
+            GetCase(i).IncrementParentCount();
+        }
+
+        m_selector.IncrementParentCount();
+
+        tree.AddRIPRelative(*this);
+    }
+
+
+    template <typename T, typename S>
+    unsigned SwitchNode<T, S>::GetCaseCount() const
+    {
+        return static_cast<unsigned>(m_cases.size()) + 1;
+    }
+
+
+    template <typename T, typename S>
+    Node<T>& SwitchNode<T, S>::GetCase(unsigned index) const
+    {
+        return index < m_cases.size() ? *m_cases[index] : m_defaultCase;
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::Print(std::ostream& out) const
+    {
+        this->PrintCoreProperties(out, m_isDense ? "Switch (table) " : "Switch (search) ");
+
+        out << ", selector = " << m_selector.GetId();
+
+        for (unsigned i = 0; i < m_keys.size(); ++i)
+        {
+            out << ", " << m_keys[i] << " => " << GetCase(m_caseIndices[i]).GetId();
+        }
+
+        out << ", default = " << m_defaultCase.GetId();
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.AddNode(m_selector);
+
+        for (unsigned i = 0; i < GetCaseCount(); ++i)
+        {
+            builder.AddNode(GetCase(i));
+        }
+
+        for (unsigned i = 0; i < m_keys.size(); ++i)
+        {
+            builder.AddValue(m_keys[i]);
+            builder.AddValue(m_caseIndices[i]);
+        }
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::GetChildren(AllocatorVector<NodeBase const *>& children) const
+    {
+        // Each case is added once regardless of how many keys map to it so
+        // that its only occurrence belongs to its conditional region.
+        children.push_back(&m_selector);
+
+        for (unsigned i = 0; i < GetCaseCount(); ++i)
+        {
+            children.push_back(&GetCase(i));
+        }
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::EmitStaticData(ExpressionTree& tree)
+    {
+        // The table is not needed if the node was simplified or pruned.
+        if (!m_isDense || this->HaveChildrenBeenReleased())
+        {
+            return;
+        }
+
+        auto & code = tree.GetCodeGenerator();
+
+        // The labels are allocated here since the code buffer is reset at
+        // the beginning of the compilation.
+        m_labels.clear();
+
+        for (unsigned i = 0; i < GetCaseCount(); ++i)
+        {
+            m_labels.push_back(code.AllocateLabel());
+        }
+
+        code.AdvanceToAlignment<int32_t>();
+        m_tableOffset = static_cast<int32_t>(code.CurrentPosition());
+
+        // The keys missing from the range select the default case.
+        const uint64_t first = static_cast<uint64_t>(m_keys.front());
+        const uint64_t span = static_cast<uint64_t>(m_keys.back()) - first;
+        unsigned next = 0;
+
+        for (uint64_t offset = 0; offset <= span; ++offset)
+        {
+            if (static_cast<uint64_t>(m_keys[next]) - first == offset)
+            {
+                code.EmitJumpTableEntry(m_labels[m_caseIndices[next]]);
+                ++next;
+            }
+            else
+            {
+                code.EmitJumpTableEntry(m_labels.back());
+            }
+        }
+
+        m_isTableEmitted = true;
+    }
+
+
+    template <typename T, typename S>
+    typename ExpressionTree::Storage<T> SwitchNode<T, S>::CodeGenValue(ExpressionTree& tree)
+    {
+        X64CodeGenerator& code = tree.GetCodeGenerator();
+
+        const bool useTable = m_isTableEmitted;
+        m_isTableEmitted = false;
+
+        if (!useTable)
+        {
+            m_labels.clear();
+
+            for (unsigned i = 0; i < GetCaseCount(); ++i)
+            {
+                m_labels.push_back(code.AllocateLabel());
+            }
+        }
+
+        Label switchCompleted = code.AllocateLabel();
+
+        Storage<S> selector = m_selector.CodeGen(tree);
+
+        // The result register and all the registers used by the dispatch are
+        // allocated before the join point captures the register allocation.
+        // The registers used by the dispatch are free again in each case.
+        // See LazyConditionalNode::CodeGenValue() for the result register.
+        Storage<T> reserved = tree.Direct<T>();
+        const auto resultRegister = reserved.GetDirectRegister();
+
+        Storage<S> index;
+        Storage<S> table;
+        Storage<S> scratch;
+
+        if (useTable)
+        {
+            // The index is modified, so the selector is copied unless no
+            // other storage refers to its register.
+            selector.ConvertToDirect(true);
+            index = selector;
+            selector.Reset();
+
+            table = tree.Direct<S>();
+        }
+        else
+        {
+            selector.ConvertToDirect(false);
+        }
+
+        const bool needsScratch = useTable
+            ? !IsImmediateKey(m_keys.front())
+            : std::any_of(m_keys.begin(),
+                          m_keys.end(),
+                          [](S key) { return !IsImmediateKey(key); });
+
+        if (needsScratch)
+        {
+            scratch = tree.Direct<S>();
+        }
+
+        ExpressionTree::JoinPoint join(tree);
+        reserved.Reset();
+
+        if (useTable)
+        {
+            EmitTableJump(code, index.GetDirectRegister(), table.GetDirectRegister(), scratch);
+        }
+        else
+        {
+            EmitSearch(code,
+                       selector.GetDirectRegister(),
+                       scratch,
+                       0,
+                       static_cast<unsigned>(m_keys.size()));
+        }
+
+        selector.Reset();
+        index.Reset();
+        table.Reset();
+        scratch.Reset();
+
+        // The default case is generated last and falls through.
+        Storage<T> result;
+
+        for (unsigned i = 0; i < GetCaseCount(); ++i)
+        {
+            result.Reset();
+
+            code.PlaceLabel(m_labels[i]);
+            result = CodeGenCase(tree, join, GetCase(i), m_regions[i], resultRegister);
+
+            if (i + 1 < GetCaseCount())
+            {
+                code.Jmp(switchCompleted);
+            }
+        }
+
+        code.PlaceLabel(switchCompleted);
+
+        return result;
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::EmitTableJump(X64CodeGenerator& code,
+                                         SelectorRegister index,
+                                         SelectorRegister table,
+                                         Storage<S> const & scratch)
+    {
+        const S first = m_keys.front();
+
+        // Rebase the index so that the unsigned comparison with the span
+        // rejects the values both below and above the range.
+        if (first != 0)
+        {
+            if (IsImmediateKey(first))
+            {
+                code.EmitImmediate<OpCode::Sub>(index, static_cast<int32_t>(first));
+            }
+            else
+            {
+                code.EmitImmediate<OpCode::Mov>(scratch.GetDirectRegister(), first);
+                code.Emit<OpCode::Sub>(index, scratch.GetDirectRegister());
+            }
+        }
+
+        // The span is less than c_maxTableDensity times the key count.
+        const uint64_t span = static_cast<uint64_t>(m_keys.back()) - static_cast<uint64_t>(first);
+        LogThrowAssert(span <= INT32_MAX, "Switch table is too large");
+
+        code.EmitImmediate<OpCode::Cmp>(index, static_cast<int32_t>(span));
+        code.EmitConditionalJump<JccType::JA>(m_labels.back());
+
+        // Each entry holds the offset of the label from the end of the entry.
+        code.Emit<OpCode::Lea>(table, rip, m_tableOffset);
+        code.EmitScaledIndex<OpCode::Lea>(index, table, index, 4, 4);
+        code.Emit<OpCode::MovSX, 8, false, 4, false>(table, index, -4);
+        code.Emit<OpCode::Add>(table, index);
+        code.Jmp(table);
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::EmitSearch(X64CodeGenerator& code,
+                                      SelectorRegister value,
+                                      Storage<S> const & scratch,
+                                      unsigned first,
+                                      unsigned last)
+    {
+        if (last - first <= c_maxLinearSearchLength)
+        {
+            for (unsigned i = first; i < last; ++i)
+            {
+                EmitCompare(code, value, m_keys[i], scratch);
+                code.EmitConditionalJump<JccType::JE>(m_labels[m_caseIndices[i]]);
+            }
+
+            code.Jmp(m_labels.back());
+            return;
+        }
+
+        const unsigned middle = first + (last - first) / 2;
+        Label upperHalf = code.AllocateLabel();
+
+        EmitCompare(code, value, m_keys[middle], scratch);
+        code.EmitConditionalJump<JccType::JE>(m_labels[m_caseIndices[middle]]);
+        code.EmitConditionalJump<c_greaterJcc>(upperHalf);
+
+        EmitSearch(code, value, scratch, first, middle);
+
+        code.PlaceLabel(upperHalf);
+        EmitSearch(code, value, scratch, middle + 1, last);
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::EmitCompare(X64CodeGenerator& code,
+                                       SelectorRegister value,
+                                       S key,
+                                       Storage<S> const & scratch)
+    {
+        if (IsImmediateKey(key))
+        {
+            code.EmitImmediate<OpCode::Cmp>(value, static_cast<int32_t>(key));
+        }
+        else
+        {
+            code.EmitImmediate<OpCode::Mov>(scratch.GetDirectRegister(), key);
+            code.Emit<OpCode::Cmp>(value, scratch.GetDirectRegister());
+        }
+    }
+
+
+    template <typename T, typename S>
+    bool SwitchNode<T, S>::IsImmediateKey(S key)
+    {
+        // The immediate is sign extended to 64 bits.
+        const int64_t value = static_cast<int64_t>(key);
+
+        return value >= INT32_MIN && value <= INT32_MAX;
+    }
+
+
+    template <typename T, typename S>
+    typename ExpressionTree::Storage<T>
+    SwitchNode<T, S>::CodeGenCase(ExpressionTree& tree,
+                                  ExpressionTree::JoinPoint& join,
+                                  Node<T>& expression,
+                                  unsigned region,
+                                  typename Storage<T>::DirectRegister resultRegister)
+    {
+        ExpressionTree::RegionEvaluation evaluation(tree, region);
+
+        Storage<T> value = expression.CodeGen(tree);
+        Storage<T> result;
+
+        // See LazyConditionalNode::CodeGenExpression().
+        if (value.GetStorageClass() == StorageClass::Direct
+            && value.GetDirectRegister() == resultRegister
+            && value.IsSoleDataOwner())
+        {
+            result = value;
+        }
+        else
+        {
+            result = tree.Direct<T>(resultRegister);
+            CodeGenHelpers::Emit<OpCode::Mov>(tree.GetCodeGenerator(),
+                                              resultRegister,
+                                              value);
+        }
+
+        value.Reset();
+        evaluation.End();
+        join.Restore();
+
+        return result;
+    }
+
+
+    template <typename T, typename S>
+    bool SwitchNode<T, S>::IsInterpretable() const
+    {
+        return true;
+    }
+
+
+    template <typename T, typename S>
+    T SwitchNode<T, S>::InterpretValue(Interpreter& interpreter)
+    {
+        const S selector = m_selector.Interpret(interpreter);
+        const auto it = std::lower_bound(m_keys.begin(), m_keys.end(), selector);
+
+        return it != m_keys.end() && *it == selector
+            ? GetCase(m_caseIndices[it - m_keys.begin()]).Interpret(interpreter)
+            : m_defaultCase.Interpret(interpreter);
+    }
+
+
+    template <typename T, typename S>
+    void SwitchNode<T, S>::ReleaseReferencesToChildren()
+    {
+        m_selector.DecrementParentCount();
+
+        for (unsigned i = 0; i < GetCaseCount(); ++i)
+        {
+            GetCase(i).DecrementParentCount();
+        }
+    }
+
+
+    template <typename T, typename S>
+    bool SwitchNode<T, S>::Simplify()
+    {
+        if (m_selector.IsConstant())
+        {
+            const S selector = m_selector.GetConstantValue();
+            const auto it = std::lower_bound(m_keys.begin(), m_keys.end(), selector);
+
+            this->FoldToNode(it != m_keys.end() && *it == selector
+                             ? GetCase(m_caseIndices[it - m_keys.begin()])
+                             : m_defaultCase);
+            return true;
+        }
+
+        if (m_cases.empty())
+        {
+            this->FoldToNode(m_defaultCase);
+            return true;
+        }
+
+        return false;
+    }
+}
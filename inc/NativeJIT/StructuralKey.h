@@ -0,0 +1,157 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>                  // For memcpy().
+#include <stddef.h>                 // For ::size_t
+#include <type_traits>
+#include <typeinfo>
+
+#include "NativeJIT/AllocatorVector.h"     // Embedded member.
+
+
+namespace NativeJIT
+{
+    class NodeBase;
+
+
+    // A canonical description of the structure of an expression: the kinds
+    // and types of its nodes, the values embedded in them (immediates, field
+    // offsets, parameter positions, call targets) and the shape of the DAG
+    // connecting them. Two expressions with equal keys generate equivalent
+    // code, which makes the key suitable for caching compiled functions.
+    //
+    // Keys are compared word by word, the hash is only used to speed up the
+    // lookups. The words are allocated from the allocator passed to the
+    // constructor, which is usually the allocator of the expression tree, so
+    // the copies which must outlive it (see CompileCache) copy the words.
+    class StructuralKey
+    {
+    public:
+        explicit StructuralKey(Allocators::IAllocator& allocator);
+
+        // Returns whether the key describes the whole expression. A key is
+        // invalid if any of the nodes could not describe its structure.
+        bool IsValid() const;
+
+        size_t GetHash() const;
+
+        // Returns the number of bytes used by the description.
+        size_t GetByteSize() const;
+
+        // Returns the words of the description.
+        uint64_t const * GetWords() const;
+        size_t GetWordCount() const;
+
+        bool operator==(StructuralKey const & other) const;
+        bool operator!=(StructuralKey const & other) const;
+
+        // A hash functor for the unordered containers.
+        struct Hasher
+        {
+            size_t operator()(StructuralKey const & key) const;
+        };
+
+    private:
+        friend class StructuralKeyBuilder;
+
+        AllocatorVector<uint64_t> m_words;
+        size_t m_hash;
+        bool m_isValid;
+    };
+
+
+    // Builds the StructuralKey for an expression. The builder walks the node
+    // DAG depth first starting from the nodes passed to AddNode(). Each node
+    // is described by its dynamic type, its parent count and whatever it
+    // reports in NodeBase::DescribeStructure(), where it adds its children
+    // through AddNode() and its other properties through AddValue(). Nodes
+    // that have already been described are referred to by their visit index,
+    // so shared subexpressions produce a different key than duplicated ones.
+    class StructuralKeyBuilder
+    {
+    public:
+        explicit StructuralKeyBuilder(Allocators::IAllocator& allocator);
+
+        // Describes the node and, recursively, its children.
+        void AddNode(NodeBase const & node);
+
+        // Adds a value embedded in the node to the description. The value
+        // is compared bitwise.
+        template <typename T>
+        void AddValue(T const & value);
+
+        // Adds the identity of a type to the description.
+        void AddType(std::type_info const & type);
+
+        // Marks the structure as impossible to describe. The resulting key
+        // will never compare equal to any other key.
+        void MarkInvalid();
+
+        // Returns the key that has been built so far.
+        StructuralKey const & GetKey() const;
+
+        // Moves the key out of the builder, which must not be used afterwards.
+        StructuralKey TakeKey();
+
+    private:
+        // The words reserved up front. Most of the keys built for the
+        // interning of the nodes fit, so their words are allocated from the
+        // arena only once.
+        static const size_t c_initialWordCount = 8;
+
+        void AddWord(uint64_t word);
+
+        StructuralKey m_key;
+
+        // For each node ID, one plus the order in which the node was visited
+        // or zero if the node has not been visited yet.
+        AllocatorVector<unsigned> m_visitOrder;
+        unsigned m_visitedCount;
+    };
+
+
+    //*************************************************************************
+    //
+    // Template definitions for StructuralKeyBuilder
+    //
+    //*************************************************************************
+    template <typename T>
+    void StructuralKeyBuilder::AddValue(T const & value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "Only trivially copyable values can be described");
+
+        const size_t wordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        uint64_t words[wordCount] = {};
+
+        memcpy(words, &value, sizeof(T));
+
+        for (size_t i = 0; i < wordCount; ++i)
+        {
+            AddWord(words[i]);
+        }
+    }
+}
@@ -0,0 +1,239 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <exception>                        // For std::exception_ptr.
+#include <thread>
+
+#include "NativeJIT/Function.h"             // Base class.
+#include "NativeJIT/Interpreter.h"          // Embedded member.
+
+
+namespace NativeJIT
+{
+    // A Function which starts out by evaluating its expression with the
+    // Interpreter and compiles it to native code only once it has been called
+    // a specified number of times. The compilation runs on a background thread
+    // while the calls continue to be interpreted, and the native code replaces
+    // the interpreter as soon as it is ready. This avoids paying the compile
+    // latency for expressions which end up being evaluated only a few times.
+    //
+    // If the expression contains nodes which cannot be interpreted, it is
+    // compiled right away when it is set.
+    //
+    // Calls that are interpreted share a single Interpreter, so Call() must
+    // not be invoked concurrently from multiple threads.
+    template <typename R, typename P1 = void, typename P2 = void, typename P3 = void, typename P4 = void>
+    class TieredFunction : public Function<R, P1, P2, P3, P4>
+    {
+    public:
+        typedef typename Function<R, P1, P2, P3, P4>::FunctionType FunctionType;
+
+        // Compilation starts on the compileThreshold-th call, or as soon as
+        // the expression is set if the threshold is zero.
+        TieredFunction(Allocators::IAllocator& allocator,
+                       FunctionBuffer& code,
+                       unsigned compileThreshold);
+
+        // Waits for the background compilation to complete.
+        ~TieredFunction();
+
+        // Sets the expression to evaluate. Must be called exactly once, before
+        // the first Call(). Takes the place of Function::Compile().
+        void SetExpression(Node<R>& expression);
+
+        // Evaluates the expression, either with the native code if it is
+        // available or with the interpreter otherwise.
+        template <typename... ARGS>
+        R Call(ARGS... args);
+
+        // Returns the native entry point or nullptr if the native code is not
+        // available yet.
+        FunctionType GetNativeEntryPoint() const;
+
+        // Returns the number of calls that were evaluated by the interpreter.
+        unsigned GetInterpretedCallCount() const;
+
+        // Waits for the background compilation, if it was started, to complete.
+        // Rethrows the exception thrown by the compilation, if any. In that
+        // case, the calls remain interpreted.
+        void WaitForCompilation();
+
+    private:
+        template <typename... PARAMETERS, typename... ARGS>
+        R CallInterpreted(R (*)(PARAMETERS...), ARGS... args);
+
+        void StartCompilation();
+        void CompileNative();
+
+        const unsigned m_compileThreshold;
+        bool m_isInterpretable;
+
+        Interpreter m_interpreter;
+        std::atomic<unsigned> m_interpretedCallCount;
+
+        // Set by the compile thread once the code is ready.
+        std::atomic<FunctionType> m_entryPoint;
+
+        std::thread m_compileThread;
+        std::exception_ptr m_compileError;
+    };
+
+
+    //*************************************************************************
+    //
+    // TieredFunction template definitions.
+    //
+    //*************************************************************************
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    TieredFunction<R, P1, P2, P3, P4>::TieredFunction(Allocators::IAllocator& allocator,
+                                                      FunctionBuffer& code,
+                                                      unsigned compileThreshold)
+        : Function<R, P1, P2, P3, P4>(allocator, code),
+          m_compileThreshold(compileThreshold),
+          m_isInterpretable(false),
+          m_interpretedCallCount(0),
+          m_entryPoint(nullptr)
+    {
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    TieredFunction<R, P1, P2, P3, P4>::~TieredFunction()
+    {
+        if (m_compileThread.joinable())
+        {
+            m_compileThread.join();
+        }
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    void TieredFunction<R, P1, P2, P3, P4>::SetExpression(Node<R>& expression)
+    {
+        this->template Return<R>(expression);
+        m_isInterpretable = this->IsInterpretable();
+
+        if (!m_isInterpretable)
+        {
+            CompileNative();
+            WaitForCompilation();
+        }
+        else if (m_compileThreshold == 0)
+        {
+            StartCompilation();
+        }
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    template <typename... ARGS>
+    R TieredFunction<R, P1, P2, P3, P4>::Call(ARGS... args)
+    {
+        const FunctionType entryPoint = m_entryPoint.load(std::memory_order_acquire);
+
+        if (entryPoint != nullptr)
+        {
+            return entryPoint(args...);
+        }
+
+        LogThrowAssert(m_isInterpretable, "The expression has not been set");
+
+        if (++m_interpretedCallCount == m_compileThreshold)
+        {
+            StartCompilation();
+        }
+
+        return CallInterpreted(static_cast<FunctionType>(nullptr), args...);
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    typename TieredFunction<R, P1, P2, P3, P4>::FunctionType
+    TieredFunction<R, P1, P2, P3, P4>::GetNativeEntryPoint() const
+    {
+        return m_entryPoint.load(std::memory_order_acquire);
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    unsigned TieredFunction<R, P1, P2, P3, P4>::GetInterpretedCallCount() const
+    {
+        return m_interpretedCallCount.load();
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    void TieredFunction<R, P1, P2, P3, P4>::WaitForCompilation()
+    {
+        if (m_compileThread.joinable())
+        {
+            m_compileThread.join();
+        }
+
+        if (m_compileError)
+        {
+            std::rethrow_exception(m_compileError);
+        }
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    template <typename... PARAMETERS, typename... ARGS>
+    R TieredFunction<R, P1, P2, P3, P4>::CallInterpreted(R (*)(PARAMETERS...), ARGS... args)
+    {
+        // The function pointer type only provides the parameter types so
+        // that the arguments are converted as for a native call.
+        m_interpreter.SetParameters(static_cast<PARAMETERS>(args)...);
+        ExpressionTree::Interpret(m_interpreter);
+
+        return InterpreterValue<R>::FromWord(m_interpreter.GetResult());
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    void TieredFunction<R, P1, P2, P3, P4>::StartCompilation()
+    {
+        m_compileThread = std::thread(&TieredFunction::CompileNative, this);
+    }
+
+
+    template <typename R, typename P1, typename P2, typename P3, typename P4>
+    void TieredFunction<R, P1, P2, P3, P4>::CompileNative()
+    {
+        // Interpreted calls may run concurrently with the compilation since
+        // the interpreter only reads the parts of the nodes which are not
+        // modified after the tree is constructed.
+        try
+        {
+            ExpressionTree::Compile();
+            m_entryPoint.store(this->GetEntryPoint(), std::memory_order_release);
+        }
+        catch (...)
+        {
+            m_compileError = std::current_exception();
+        }
+    }
+}
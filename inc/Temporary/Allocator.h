@@ -53,7 +53,8 @@ namespace NativeJIT
         virtual void Reset() override;
 
     private:
-        void DebugInitialize();
+        // Fills the first byteCount bytes of the buffer with a pattern.
+        void DebugInitialize(size_t byteCount);
 
         size_t m_bufferSize;
         size_t m_bytesAllocated;
@@ -39,7 +39,7 @@ namespace NativeJIT
           m_bytesAllocated(0),
           m_buffer(new char[bufferSize])
     {
-        DebugInitialize();
+        DebugInitialize(m_bufferSize);
     }
 
 
@@ -77,13 +77,15 @@ namespace NativeJIT
 
     void Allocator::Reset()
     {
+        // Only the allocated bytes can differ from the initial pattern, which
+        // keeps resets cheap for large, mostly unused buffers.
+        DebugInitialize(m_bytesAllocated);
         m_bytesAllocated = 0;
-        DebugInitialize();
     }
 
 
-    void Allocator::DebugInitialize()
+    void Allocator::DebugInitialize(size_t byteCount)
     {
-        memset(m_buffer.get(), 0xcc, m_bufferSize);
+        memset(m_buffer.get(), 0xcc, byteCount);
     }
 }
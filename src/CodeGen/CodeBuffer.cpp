@@ -25,6 +25,7 @@
 #include <stdexcept>
 
 #include "NativeJIT/CodeGen/CodeBuffer.h"
+#include "NativeJIT/CodeGen/IExecutableAllocator.h"
 #include "NativeJIT/CodeGen/JumpTable.h"
 #include "Temporary/Assert.h"
 #include "Temporary/IAllocator.h"
@@ -35,11 +36,20 @@ namespace NativeJIT
     CodeBuffer::CodeBuffer(Allocators::IAllocator& codeAllocator, unsigned capacity)
         : m_codeAllocator(codeAllocator),
           m_capacity(capacity),
-          m_bufferStart(nullptr)
+          m_bufferStart(nullptr),
+          m_executableAliasOffset(0)
     {
         m_bufferStart = static_cast<uint8_t*>(codeAllocator.Allocate(capacity));
         m_bufferEnd = m_bufferStart + capacity;
         m_current = m_bufferStart;
+
+        auto executableAllocator = dynamic_cast<IExecutableAllocator*>(&codeAllocator);
+
+        if (executableAllocator != nullptr)
+        {
+            m_executableAliasOffset
+                = executableAllocator->GetExecutableAliasOffset(m_bufferStart);
+        }
     }
 
 
@@ -121,6 +131,12 @@ namespace NativeJIT
     }
 
 
+    uint8_t const * CodeBuffer::ExecutableBufferStart() const
+    {
+        return m_bufferStart + m_executableAliasOffset;
+    }
+
+
     unsigned CodeBuffer::CurrentPosition() const
     {
         return static_cast<unsigned>(m_current - m_bufferStart);
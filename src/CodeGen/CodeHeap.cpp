@@ -0,0 +1,531 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>    // For std::min and std::max.
+#include <cstring>
+#include <stdexcept>
+
+#ifdef NATIVEJIT_PLATFORM_WINDOWS
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "NativeJIT/BitOperations.h"
+#include "NativeJIT/CodeGen/CodeHeap.h"
+#include "Temporary/Assert.h"
+
+
+namespace NativeJIT
+{
+    //*************************************************************************
+    //
+    // CodeHeap
+    //
+    //*************************************************************************
+
+    // Precedes every block handed out by the heap. The next pointer is only
+    // meaningful while the block is on a free list.
+    struct CodeHeap::BlockHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_sizeClass;
+        BlockHeader* m_next;
+    };
+
+
+    namespace
+    {
+        const uint32_t c_blockMagic = 0xC0DE4EA9;
+
+        size_t GetPageSize()
+        {
+#ifdef NATIVEJIT_PLATFORM_WINDOWS
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+
+            return systemInfo.dwPageSize;
+#else
+            return static_cast<size_t>(getpagesize());
+#endif
+        }
+
+
+        size_t RoundUpToPage(size_t x, size_t pageSize)
+        {
+            return (x + pageSize - 1) & ~(pageSize - 1);
+        }
+
+
+        // Rounds x up to the next power of two. Page sizes are powers of two
+        // so the result is also a whole number of pages whenever x is at
+        // least one page.
+        size_t RoundUpToPowerOfTwo(size_t x)
+        {
+            unsigned highestBit;
+
+            if (x <= 1 || !BitOp::GetHighestBitSet(x - 1, &highestBit))
+            {
+                return 1;
+            }
+
+            LogThrowAssert(highestBit + 1 < sizeof(size_t) * 8,
+                           "Size too large to round up to a power of two: %Iu",
+                           x);
+
+            return static_cast<size_t>(1) << (highestBit + 1);
+        }
+    }
+
+
+    const size_t CodeHeap::c_defaultSegmentSize;
+    const size_t CodeHeap::c_hugePageSize;
+    const size_t CodeHeap::c_blockAlignment;
+
+
+    CodeHeap::CodeHeap(size_t segmentSize, size_t maxReservedSize, PageType pageType)
+        : m_pageType(pageType),
+          m_pageSize(pageType == PageType::Huge ? c_hugePageSize : GetPageSize()),
+          m_segmentSize(RoundUpToPowerOfTwo((std::max)(segmentSize, m_pageSize))),
+          m_maxReservedSize(maxReservedSize),
+          m_segmentSizeClass(GetSizeClass(m_segmentSize)),
+          m_bytesReserved(0),
+          m_bytesInUse(0)
+    {
+        static_assert(sizeof(BlockHeader) == c_blockAlignment,
+                      "Block header must preserve the block alignment");
+
+        for (auto & head : m_freeLists)
+        {
+            head = nullptr;
+        }
+    }
+
+
+    CodeHeap::~CodeHeap()
+    {
+        for (auto const & segment : m_segments)
+        {
+            FreeSegment(segment);
+        }
+
+        for (auto const & segment : m_dedicatedSegments)
+        {
+            FreeSegment(segment);
+        }
+    }
+
+
+    //
+    // IAllocator methods
+    //
+
+    // Allocates a block of a specified byte size.
+    void* CodeHeap::Allocate(size_t size)
+    {
+        LogThrowAssert(size <= MaxSize(), "Allocation of %Iu bytes is too large", size);
+
+        const size_t blockSize = size + sizeof(BlockHeader);
+
+        if (blockSize > m_segmentSize)
+        {
+            return AllocateDedicated(blockSize);
+        }
+
+        const unsigned sizeClass = GetSizeClass(blockSize);
+        const size_t classSize = static_cast<size_t>(1) << sizeClass;
+        BlockHeader* header = m_freeLists[sizeClass];
+
+        if (header != nullptr)
+        {
+            m_freeLists[sizeClass] = header->m_next;
+        }
+        else
+        {
+            if (m_segments.empty()
+                || m_segments.back().m_bytesAllocated + classSize > m_segments.back().m_size)
+            {
+                const Segment segment = AllocateSegment(m_segmentSize);
+
+                RetireCurrentSegmentTail();
+                m_segments.push_back(segment);
+            }
+
+            Segment& segment = m_segments.back();
+            header = reinterpret_cast<BlockHeader*>(segment.m_base + segment.m_bytesAllocated);
+            segment.m_bytesAllocated += classSize;
+        }
+
+        header->m_magic = c_blockMagic;
+        header->m_sizeClass = sizeClass;
+        header->m_next = nullptr;
+        m_bytesInUse += classSize;
+
+        return header + 1;
+    }
+
+
+    // Frees a block, making it available for reuse by a later Allocate()
+    // of the same size class.
+    void CodeHeap::Deallocate(void* block)
+    {
+        if (block == nullptr)
+        {
+            return;
+        }
+
+        BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+        LogThrowAssert(header->m_magic == c_blockMagic, "Invalid or already freed block");
+        header->m_magic = 0;
+
+        if (header->m_sizeClass == c_dedicatedSizeClass)
+        {
+            unsigned char* base = reinterpret_cast<unsigned char*>(header);
+
+            for (auto it = m_dedicatedSegments.begin(); it != m_dedicatedSegments.end(); ++it)
+            {
+                if (it->m_base == base)
+                {
+                    m_bytesInUse -= it->m_size;
+                    FreeSegment(*it);
+                    m_dedicatedSegments.erase(it);
+
+                    return;
+                }
+            }
+
+            LogThrowAbort("Dedicated segment not found");
+        }
+
+        const size_t classSize = static_cast<size_t>(1) << header->m_sizeClass;
+        m_bytesInUse -= classSize;
+
+#ifdef _DEBUG
+        // Fill the freed code with break code (i.e. INT 3 software breakpoint).
+        memset(header + 1, 0xcc, classSize - sizeof(BlockHeader));
+#endif
+
+        header->m_next = m_freeLists[header->m_sizeClass];
+        m_freeLists[header->m_sizeClass] = header;
+    }
+
+
+    // Returns the maximum legal allocation size in bytes.
+    size_t CodeHeap::MaxSize() const
+    {
+        const size_t maxBlockSize = (std::min)(m_maxReservedSize,
+                                               static_cast<size_t>(1) << c_maxSizeClass);
+
+        return maxBlockSize > sizeof(BlockHeader)
+               ? maxBlockSize - sizeof(BlockHeader)
+               : 0;
+    }
+
+
+    // Frees all blocks that have been allocated since construction or the
+    // last call to Reset(). Returns all segments except the first one to
+    // the OS.
+    void CodeHeap::Reset()
+    {
+        for (auto const & segment : m_dedicatedSegments)
+        {
+            FreeSegment(segment);
+        }
+        m_dedicatedSegments.clear();
+
+        while (m_segments.size() > 1)
+        {
+            FreeSegment(m_segments.back());
+            m_segments.pop_back();
+        }
+
+        if (!m_segments.empty())
+        {
+            m_segments.front().m_bytesAllocated = 0;
+
+#ifdef _DEBUG
+            memset(m_segments.front().m_base, 0xcc, m_segments.front().m_size);
+#endif
+        }
+
+        for (auto & head : m_freeLists)
+        {
+            head = nullptr;
+        }
+
+        m_bytesInUse = 0;
+    }
+
+
+    //
+    // Statistics
+    //
+
+    size_t CodeHeap::GetSegmentCount() const
+    {
+        return m_segments.size() + m_dedicatedSegments.size();
+    }
+
+
+    size_t CodeHeap::GetBytesReserved() const
+    {
+        return m_bytesReserved;
+    }
+
+
+    size_t CodeHeap::GetBytesInUse() const
+    {
+        return m_bytesInUse;
+    }
+
+
+    size_t CodeHeap::GetHugePageSegmentCount() const
+    {
+        size_t count = 0;
+
+        for (auto const & segment : m_segments)
+        {
+            count += segment.m_isHugePage ? 1 : 0;
+        }
+
+        for (auto const & segment : m_dedicatedSegments)
+        {
+            count += segment.m_isHugePage ? 1 : 0;
+        }
+
+        return count;
+    }
+
+
+    //
+    // Private methods
+    //
+
+    unsigned CodeHeap::GetSizeClass(size_t blockSize)
+    {
+        unsigned highestBit;
+
+        if (blockSize <= (static_cast<size_t>(1) << c_minSizeClass)
+            || !BitOp::GetHighestBitSet(blockSize - 1, &highestBit))
+        {
+            return c_minSizeClass;
+        }
+
+        return highestBit + 1;
+    }
+
+
+    void* CodeHeap::AllocateDedicated(size_t blockSize)
+    {
+        Segment segment = AllocateSegment(RoundUpToPage(blockSize, m_pageSize));
+        segment.m_bytesAllocated = segment.m_size;
+        m_dedicatedSegments.push_back(segment);
+        m_bytesInUse += segment.m_size;
+
+        BlockHeader* header = reinterpret_cast<BlockHeader*>(segment.m_base);
+        header->m_magic = c_blockMagic;
+        header->m_sizeClass = c_dedicatedSizeClass;
+        header->m_next = nullptr;
+
+        return header + 1;
+    }
+
+
+    void CodeHeap::RetireCurrentSegmentTail()
+    {
+        if (m_segments.empty())
+        {
+            return;
+        }
+
+        Segment& segment = m_segments.back();
+
+        // Bump offsets are always multiples of the smallest class size, so
+        // the tail splits into power-of-two blocks without leftovers.
+        while (segment.m_size - segment.m_bytesAllocated
+               >= (static_cast<size_t>(1) << c_minSizeClass))
+        {
+            unsigned sizeClass;
+            BitOp::GetHighestBitSet(segment.m_size - segment.m_bytesAllocated, &sizeClass);
+            sizeClass = (std::min)(sizeClass, m_segmentSizeClass);
+
+            PushFreeBlock(segment.m_base + segment.m_bytesAllocated, sizeClass);
+            segment.m_bytesAllocated += static_cast<size_t>(1) << sizeClass;
+        }
+    }
+
+
+    void CodeHeap::PushFreeBlock(unsigned char* start, unsigned sizeClass)
+    {
+        BlockHeader* header = reinterpret_cast<BlockHeader*>(start);
+        header->m_magic = 0;
+        header->m_sizeClass = sizeClass;
+        header->m_next = m_freeLists[sizeClass];
+        m_freeLists[sizeClass] = header;
+    }
+
+
+    CodeHeap::Segment CodeHeap::AllocateSegment(size_t size)
+    {
+        if (size > m_maxReservedSize - m_bytesReserved)
+        {
+            throw std::runtime_error("CodeHeap: reservation would exceed the maximum.");
+        }
+
+        Segment segment;
+        segment.m_isHugePage = false;
+        segment.m_base = m_pageType == PageType::Huge
+                         ? MapHugePageSegment(size, segment.m_isHugePage)
+                         : MapSegment(size);
+
+        if (segment.m_base == nullptr)
+        {
+            throw std::runtime_error("CodeHeap: out of memory.");
+        }
+
+        segment.m_size = size;
+        segment.m_bytesAllocated = 0;
+        m_bytesReserved += size;
+
+#ifdef _DEBUG
+        // Fill the segment with break code (i.e. INT 3 software breakpoint).
+        memset(segment.m_base, 0xcc, size);
+#endif
+
+        return segment;
+    }
+
+
+    // http://stackoverflow.com/questions/570257/jit-compilation-and-dep
+#ifdef NATIVEJIT_PLATFORM_WINDOWS
+    unsigned char* CodeHeap::MapSegment(size_t size)
+    {
+        return static_cast<unsigned char*>(
+                   VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+    }
+
+
+    unsigned char* CodeHeap::MapHugePageSegment(size_t size, bool& isHugePage)
+    {
+        // Large pages require the SeLockMemoryPrivilege and a size that is
+        // a multiple of the large page minimum.
+        const size_t largePageMinimum = GetLargePageMinimum();
+
+        if (largePageMinimum != 0 && size % largePageMinimum == 0)
+        {
+            void* base = VirtualAlloc(NULL,
+                                      size,
+                                      MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                      PAGE_EXECUTE_READWRITE);
+
+            if (base != NULL)
+            {
+                isHugePage = true;
+                return static_cast<unsigned char*>(base);
+            }
+        }
+
+        return MapSegment(size);
+    }
+
+
+    void CodeHeap::FreeSegment(Segment const & segment)
+    {
+        if (VirtualFree(segment.m_base, 0, MEM_RELEASE) != 0)
+        {
+            m_bytesReserved -= segment.m_size;
+        }
+    }
+#else
+    unsigned char* CodeHeap::MapSegment(size_t size)
+    {
+        void* base = mmap(nullptr,
+                          size,
+                          PROT_READ | PROT_WRITE | PROT_EXEC,
+                          MAP_PRIVATE | MAP_ANON,
+                          -1,
+                          0);
+
+        return base == MAP_FAILED ? nullptr : static_cast<unsigned char*>(base);
+    }
+
+
+    unsigned char* CodeHeap::MapHugePageSegment(size_t size, bool& isHugePage)
+    {
+#ifdef MAP_HUGETLB
+        void* base = mmap(nullptr,
+                          size,
+                          PROT_READ | PROT_WRITE | PROT_EXEC,
+                          MAP_PRIVATE | MAP_ANON | MAP_HUGETLB,
+                          -1,
+                          0);
+
+        if (base != MAP_FAILED)
+        {
+            isHugePage = true;
+            return static_cast<unsigned char*>(base);
+        }
+#endif
+
+        // The huge page pool is not configured or exhausted. Over-reserve to
+        // be able to align the segment to a huge page boundary, trim the
+        // excess and ask for transparent huge pages.
+        unsigned char* reserved = MapSegment(size + c_hugePageSize);
+
+        if (reserved == nullptr)
+        {
+            return nullptr;
+        }
+
+        const uintptr_t address = reinterpret_cast<uintptr_t>(reserved);
+        unsigned char* aligned = reserved + (RoundUpToPage(address, c_hugePageSize) - address);
+        unsigned char* reservedEnd = reserved + size + c_hugePageSize;
+
+        if (aligned != reserved)
+        {
+            munmap(reserved, aligned - reserved);
+        }
+
+        if (aligned + size != reservedEnd)
+        {
+            munmap(aligned + size, reservedEnd - (aligned + size));
+        }
+
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+        return aligned;
+    }
+
+
+    void CodeHeap::FreeSegment(Segment const & segment)
+    {
+        if (munmap(segment.m_base, segment.m_size) == 0)
+        {
+            m_bytesReserved -= segment.m_size;
+        }
+    }
+#endif
+}
@@ -51,10 +51,16 @@ namespace NativeJIT
 
     // http://stackoverflow.com/questions/570257/jit-compilation-and-dep
 #ifdef NATIVEJIT_PLATFORM_WINDOWS
-    ExecutionBuffer::ExecutionBuffer(size_t bufferSize)
+    ExecutionBuffer::ExecutionBuffer(size_t bufferSize, MappingType mappingType)
         : m_buffer(nullptr),
+          m_executableBuffer(nullptr),
           m_bytesAllocated(0)
     {
+        if (mappingType != MappingType::SingleReadWriteExecute)
+        {
+            throw std::runtime_error("CodeBuffer: dual mapping is not supported on this platform.");
+        }
+
         SYSTEM_INFO systemInfo;
         GetSystemInfo(&systemInfo);
 
@@ -80,14 +86,26 @@ namespace NativeJIT
             throw std::runtime_error("CodeBuffer: failed to set protection on guard page.");
         }
 
+        m_executableBuffer = m_buffer;
+
         DebugInitialize();
     }
 #else
-    ExecutionBuffer::ExecutionBuffer(size_t bufferSize)
+    ExecutionBuffer::ExecutionBuffer(size_t bufferSize, MappingType mappingType)
         : m_bytesAllocated(0),
-          m_buffer(nullptr)
+          m_buffer(nullptr),
+          m_executableBuffer(nullptr)
     {
         m_bufferSize = RoundUp(bufferSize, getpagesize());
+
+        if (mappingType == MappingType::DualReadWriteAndReadExecute)
+        {
+            MapDualViews();
+            DebugInitialize();
+
+            return;
+        }
+
         m_buffer = static_cast<unsigned char*>(
                        mmap(nullptr,
                             m_bufferSize,
@@ -101,6 +119,63 @@ namespace NativeJIT
             throw std::runtime_error("CodeBuffer: failed to set protection on guard page.");
         }
 
+        m_executableBuffer = m_buffer;
+    }
+
+
+    // Maps an anonymous memory file twice, once read-write for m_buffer and
+    // once read-execute for m_executableBuffer. The file descriptor is not
+    // needed after the mappings are established.
+    void ExecutionBuffer::MapDualViews()
+    {
+#ifdef __linux__
+        const int fd = memfd_create("NativeJIT", MFD_CLOEXEC);
+
+        if (fd == -1)
+        {
+            throw std::runtime_error("CodeBuffer: memfd_create failed.");
+        }
+
+        if (ftruncate(fd, static_cast<off_t>(m_bufferSize)) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("CodeBuffer: failed to size the memory file.");
+        }
+
+        void* writable = mmap(nullptr,
+                              m_bufferSize,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED,
+                              fd,
+                              0);
+        void* executable = mmap(nullptr,
+                                m_bufferSize,
+                                PROT_READ | PROT_EXEC,
+                                MAP_SHARED,
+                                fd,
+                                0);
+        close(fd);
+
+        if (writable == MAP_FAILED || executable == MAP_FAILED)
+        {
+            if (writable != MAP_FAILED)
+            {
+                munmap(writable, m_bufferSize);
+            }
+
+            if (executable != MAP_FAILED)
+            {
+                munmap(executable, m_bufferSize);
+            }
+
+            throw std::runtime_error("CodeBuffer: failed to map the memory file.");
+        }
+
+        m_buffer = static_cast<unsigned char*>(writable);
+        m_executableBuffer = static_cast<unsigned char*>(executable);
+#else
+        throw std::runtime_error("CodeBuffer: dual mapping is not supported on this platform.");
+#endif
     }
 #endif
 
@@ -128,6 +203,11 @@ namespace NativeJIT
                 // throw std::runtime_error("CodeBuffer: munmap failed.");
             }
         }
+
+        if (m_executableBuffer != nullptr && m_executableBuffer != m_buffer)
+        {
+            munmap(m_executableBuffer, m_bufferSize);
+        }
     }
 
 #endif
@@ -172,6 +252,18 @@ namespace NativeJIT
     }
 
 
+    //
+    // IExecutableAllocator methods
+    //
+
+    // Returns the distance between the executable and the writable view
+    // of the buffer. Zero unless the buffer is dual mapped.
+    ptrdiff_t ExecutionBuffer::GetExecutableAliasOffset(void const * /*block*/) const
+    {
+        return m_executableBuffer - m_buffer;
+    }
+
+
     void ExecutionBuffer::DebugInitialize()
     {
 #ifdef _DEBUG
@@ -56,8 +56,8 @@ namespace NativeJIT
         auto const runtime = &fb->m_runtimeFunction;
 
         // Check whether program counter is inside function's code.
-        return ((fb->BufferStart() + runtime->BeginAddress <= pc)
-                && (pc < fb->BufferStart() + runtime->EndAddress))
+        return ((fb->ExecutableBufferStart() + runtime->BeginAddress <= pc)
+                && (pc < fb->ExecutableBufferStart() + runtime->EndAddress))
                 ? runtime
                 : nullptr;
     }
@@ -72,6 +72,7 @@ namespace NativeJIT
           m_unwindInfoByteLength(0),
           m_prologStartOffset(0),
           m_prologLength(0),
+          m_isEpilogEmitted(false),
           m_isCodeGenerationCompleted(false)
     {
         LogThrowAssert(reinterpret_cast<size_t>(&m_runtimeFunction) % sizeof(DWORD) == 0,
@@ -82,7 +83,7 @@ namespace NativeJIT
         // Register a callback to return the RUNTIME_FUNCTION when Windows
         // asks for it during exception handling.
         if (!RtlInstallFunctionTableCallback(UnwindUtils::MakeFunctionTableIdentifier(this),
-                                             reinterpret_cast<DWORD64>(BufferStart()),
+                                             reinterpret_cast<DWORD64>(ExecutableBufferStart()),
                                              GetCapacity(),
                                              &FunctionBuffer::WindowsGetRuntimeFunctionCallback,
                                              this,
@@ -113,7 +114,7 @@ namespace NativeJIT
         LogThrowAssert(m_isCodeGenerationCompleted,
                        "Cannot get entry point until code generation is finalized");
 
-        return BufferStart() + m_runtimeFunction.BeginAddress;
+        return ExecutableBufferStart() + m_runtimeFunction.BeginAddress;
     }
 
     unsigned FunctionBuffer::GetFunctionCodeStartOffset() const
@@ -182,6 +183,27 @@ namespace NativeJIT
 
     void FunctionBuffer::EndFunctionBodyGeneration(FunctionSpecification const & spec)
     {
+        if (!m_isEpilogEmitted)
+        {
+            EmitEpilog(spec);
+        }
+
+        // Patch any references to labels.
+        PatchCallSites();
+
+        // Fill in information about the function.
+        m_runtimeFunction.BeginAddress = m_prologStartOffset;
+        m_runtimeFunction.EndAddress = CurrentPosition();
+        m_runtimeFunction.UnwindData = m_unwindInfoStartOffset;
+
+        m_isCodeGenerationCompleted = true;
+    }
+
+
+    void FunctionBuffer::EmitEpilog(FunctionSpecification const & spec)
+    {
+        LogThrowAssert(!m_isEpilogEmitted, "Epilog has already been emitted");
+
         LogThrowAssert(spec.GetUnwindInfoByteLength() <= m_unwindInfoByteLength,
                        "Unwind info length of %u bytes is larger than the reserved %u bytes",
                        spec.GetUnwindInfoByteLength(),
@@ -218,15 +240,7 @@ namespace NativeJIT
         // Emit the epilog at the current position.
         EmitBytes(spec.GetEpilog(), spec.GetEpilogLength());
 
-        // Patch any references to labels.
-        PatchCallSites();
-
-        // Fill in information about the function.
-        m_runtimeFunction.BeginAddress = m_prologStartOffset;
-        m_runtimeFunction.EndAddress = CurrentPosition();
-        m_runtimeFunction.UnwindData = m_unwindInfoStartOffset;
-
-        m_isCodeGenerationCompleted = true;
+        m_isEpilogEmitted = true;
     }
 
 
@@ -239,6 +253,7 @@ namespace NativeJIT
             = m_prologStartOffset
             = m_prologLength
             = 0;
+        m_isEpilogEmitted = false;
         m_isCodeGenerationCompleted = false;
         m_runtimeFunction = {0, 0, 0};
     }
@@ -22,6 +22,7 @@
 
 
 #include <algorithm>    // For std::min.
+#include <limits>       // For std::numeric_limits.
 #include <stdexcept>
 
 #include "NativeJIT/BitOperations.h"
@@ -209,8 +210,7 @@ namespace NativeJIT
         // Need to use UWOP_ALLOC_SMALL for stack sizes from 8 to 128 bytes and
         // UWOP_ALLOC_LARGE otherwise. If using UWOP_ALLOC_LARGE, currently only
         // the version which uses two unwind codes is supported. That version
-        // can allocate almost 512 kB, which is far more than the 4 kB limit
-        // which would require a chkstk call.
+        // can allocate almost 512 kB, see c_maxStackSize.
         const bool isSmallStackAlloc = totalStackBytes <= 128;
 
         // Compute number of unwind codes needed. Each RXX/XMM save takes two
@@ -253,7 +253,26 @@ namespace NativeJIT
         UnwindCode* currUnwindCode = &unwindCodes[actualUnwindCodeCount - 1];
 
         // Start emitting the unwind codes and the opcodes for prolog. First,
-        // adjust the stack pointer.
+        // touch every page of a frame larger than a page in order, moving
+        // towards lower addresses. The probe only uses RAX and R11 which are
+        // volatile and don't hold parameters in either calling convention.
+        // It doesn't modify RSP or the non-volatiles, so it needs no unwind
+        // codes of its own.
+        if (totalStackBytes >= c_stackProbePageSize)
+        {
+            Label probeLoop = prologCode.AllocateLabel();
+
+            prologCode.Emit<OpCode::Mov>(r11, rsp);
+            prologCode.EmitImmediate<OpCode::Mov>(eax, static_cast<int32_t>(totalStackBytes / c_stackProbePageSize));
+            prologCode.PlaceLabel(probeLoop);
+            prologCode.EmitImmediate<OpCode::Sub>(r11, static_cast<int32_t>(c_stackProbePageSize));
+            prologCode.Emit<OpCode::Cmp>(r11, r11, 0);
+            prologCode.EmitImmediate<OpCode::Sub>(eax, 1);
+            prologCode.EmitConditionalJump<JccType::JNZ>(probeLoop);
+            prologCode.PatchCallSites();
+        }
+
+        // Adjust the stack pointer.
         prologCode.EmitImmediate<OpCode::Sub>(rsp, offsetToOriginalRsp);
 
         // Emit the matching unwind codes.
@@ -24,12 +24,92 @@
 #include <iomanip>
 #include <iostream>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
 #include "NativeJIT/CodeGen/X64CodeGenerator.h"
 #include "Temporary/Assert.h"
 
 
 namespace NativeJIT
 {
+    namespace
+    {
+        // Executes cpuid for the leaf and subleaf and returns the requested
+        // register (0: eax, 1: ebx, 2: ecx, 3: edx). Returns 0 if the leaf
+        // is not supported by the processor.
+        uint32_t GetCpuIdRegister(uint32_t leaf, uint32_t subLeaf, unsigned index)
+        {
+            uint32_t registers[4] = { 0, 0, 0, 0 };
+
+#ifdef _MSC_VER
+            int maxLeaf[4];
+            __cpuid(maxLeaf, static_cast<int>(leaf & 0x80000000));
+
+            if (static_cast<uint32_t>(maxLeaf[0]) >= leaf)
+            {
+                __cpuidex(reinterpret_cast<int*>(registers), static_cast<int>(leaf), static_cast<int>(subLeaf));
+            }
+#else
+            __get_cpuid_count(leaf, subLeaf, &registers[0], &registers[1], &registers[2], &registers[3]);
+#endif
+
+            return registers[index];
+        }
+
+
+        unsigned FeatureBit(CpuFeature feature)
+        {
+            return 1u << static_cast<unsigned>(feature);
+        }
+
+
+        // Returns the mask of the CpuFeature bits supported by the processor.
+        unsigned GetProcessorFeatures()
+        {
+            unsigned features = 0;
+
+            const uint32_t basicFeatures = GetCpuIdRegister(1, 0, 2);
+
+            if ((basicFeatures & (1u << 19)) != 0)
+            {
+                features |= FeatureBit(CpuFeature::Sse41);
+            }
+
+            if ((basicFeatures & (1u << 23)) != 0)
+            {
+                features |= FeatureBit(CpuFeature::PopCnt);
+            }
+
+            if ((GetCpuIdRegister(0x80000001, 0, 2) & (1u << 5)) != 0)
+            {
+                features |= FeatureBit(CpuFeature::LZCnt);
+            }
+
+            const uint32_t extendedFeatures = GetCpuIdRegister(7, 0, 1);
+
+            if ((extendedFeatures & (1u << 3)) != 0)
+            {
+                features |= FeatureBit(CpuFeature::Bmi1);
+            }
+
+            if ((extendedFeatures & (1u << 8)) != 0)
+            {
+                features |= FeatureBit(CpuFeature::Bmi2);
+            }
+
+            return features;
+        }
+
+
+        static_assert(static_cast<unsigned>(CpuFeature::CpuFeatureCount) <= 32,
+                      "CpuFeature bits don't fit into the mask.");
+    }
+
+
     //*************************************************************************
     //
     // Label
@@ -63,6 +143,33 @@ namespace NativeJIT
         : CodeBuffer(codeAllocator, capacity),
           m_diagnosticsStream(nullptr)
     {
+        // The processor doesn't change during the lifetime of the process.
+        static const unsigned c_processorFeatures = GetProcessorFeatures();
+
+        m_cpuFeatures = c_processorFeatures;
+    }
+
+
+    bool X64CodeGenerator::IsSupported(CpuFeature feature) const
+    {
+        LogThrowAssert(feature < CpuFeature::CpuFeatureCount, "Invalid CpuFeature");
+
+        return (m_cpuFeatures & FeatureBit(feature)) != 0;
+    }
+
+
+    void X64CodeGenerator::SetSupported(CpuFeature feature, bool isSupported)
+    {
+        LogThrowAssert(feature < CpuFeature::CpuFeatureCount, "Invalid CpuFeature");
+
+        if (isSupported)
+        {
+            m_cpuFeatures |= FeatureBit(feature);
+        }
+        else
+        {
+            m_cpuFeatures &= ~FeatureBit(feature);
+        }
     }
 
 
@@ -109,32 +216,77 @@ namespace NativeJIT
     }
 
 
+    void X64CodeGenerator::Jmp(Register<8, false> target)
+    {
+        CodePrinter printer(*this);
+
+        // EmitRex() would set REX.W, but this instruction defaults to
+        // 64-bit operands in 64-bit mode and doesn't need it.
+        if (target.IsExtended())
+        {
+            Emit8(0x41);
+        }
+        Emit8(0xff);
+        Emit8(0xE0 | target.GetId8());
+
+        printer.PrintJump(target);
+    }
+
+
+    void X64CodeGenerator::EmitJumpTableEntry(Label label)
+    {
+        CodePrinter printer(*this);
+
+        EmitCallSite(label, 4);
+
+        printer.PrintJumpTableEntry(label);
+    }
+
+
     char const * X64CodeGenerator::OpCodeName(OpCode op)
     {
         static char const * names[] = {
             "add",
             "and",
+            "andn",
+            "bswap",
+            "bzhi",
             "call",
             "cmp",
+            "cqo",
             "cvtfp2fp",
             "cvtfp2si",
             "cvtsi2fp",
+            "div",
+            "idiv",
             "imul",
             "lea",
+            "lzcnt",
+            "max",
+            "min",
             "mov",
             "movsx",
             "movzx",
             "movap",
+            "mul",
+            "neg",
             "nop",
             "or",
+            "pdep",
+            "pext",
             "pop",
+            "popcnt",
             "push",
             "ret",
             "rol",
+            "round",
+            "sar",
             "shl",
             "shld",
             "shr",
+            "sqrt",
             "sub",
+            "tzcnt",
             "xor",
         };
 
@@ -377,6 +529,28 @@ namespace NativeJIT
     }
 
 
+    void X64CodeGenerator::CodePrinter::PrintJump(Register<8, false> target)
+    {
+        if (m_out != nullptr)
+        {
+            PrintBytes(m_startPosition, m_code.CurrentPosition());
+
+            *m_out << "jmp " << target.GetName() << std::endl;
+        }
+    }
+
+
+    void X64CodeGenerator::CodePrinter::PrintJumpTableEntry(Label label)
+    {
+        if (m_out != nullptr)
+        {
+            PrintBytes(m_startPosition, m_code.CurrentPosition());
+
+            *m_out << "dd L" << label.GetId() << " - $ - 4" << std::endl;
+        }
+    }
+
+
     void X64CodeGenerator::CodePrinter::PrintJump(void* function)
     {
         if (m_out != nullptr)
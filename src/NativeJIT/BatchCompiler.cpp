@@ -0,0 +1,306 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>        // For std::min.
+#include <atomic>
+#include <cstring>          // For memcpy().
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include "NativeJIT/BatchCompiler.h"
+#include "NativeJIT/CompileContextPool.h"
+#include "Temporary/Assert.h"
+
+
+namespace NativeJIT
+{
+    //*************************************************************************
+    //
+    // CompiledBatch
+    //
+    //*************************************************************************
+    CompiledBatch::CompiledBatch(size_t segmentSize, unsigned functionCount)
+        : m_codeHeap(segmentSize),
+          m_functions(functionCount, CompiledFunction { nullptr, { 0, 0, 0 } }),
+          m_isPublished(false)
+    {
+    }
+
+
+    CompiledBatch::~CompiledBatch()
+    {
+#ifdef NATIVEJIT_PLATFORM_WINDOWS
+        if (m_isPublished)
+        {
+            for (auto & function : m_functions)
+            {
+                RtlDeleteFunctionTable(&function.m_runtimeFunction);
+            }
+        }
+#endif
+    }
+
+
+    unsigned CompiledBatch::GetFunctionCount() const
+    {
+        return static_cast<unsigned>(m_functions.size());
+    }
+
+
+    void const * CompiledBatch::GetEntryPoint(unsigned index) const
+    {
+        LogThrowAssert(index < m_functions.size(),
+                       "Invalid function index %u (function count %u)",
+                       index,
+                       GetFunctionCount());
+
+        auto & function = m_functions[index];
+
+        return function.m_base + function.m_runtimeFunction.BeginAddress;
+    }
+
+
+    size_t CompiledBatch::GetBytesReserved() const
+    {
+        return m_codeHeap.GetBytesReserved();
+    }
+
+
+    void CompiledBatch::Publish()
+    {
+#ifdef NATIVEJIT_PLATFORM_WINDOWS
+        for (auto & function : m_functions)
+        {
+            if (!RtlAddFunctionTable(&function.m_runtimeFunction,
+                                     1,
+                                     reinterpret_cast<DWORD64>(function.m_base)))
+            {
+                throw std::runtime_error("Couldn't add function table");
+            }
+        }
+#endif
+        m_isPublished = true;
+    }
+
+
+    //*************************************************************************
+    //
+    // BatchCompiler::SubArena
+    //
+    //*************************************************************************
+
+    // A region owned by a single worker thread inside which the code is
+    // placed without synchronization. Only refilling the region from the
+    // shared CodeHeap requires taking the lock.
+    class BatchCompiler::SubArena : private NonCopyable
+    {
+    public:
+        SubArena(CodeHeap& codeHeap, std::mutex& codeHeapMutex, size_t size)
+            : m_codeHeap(codeHeap),
+              m_codeHeapMutex(codeHeapMutex),
+              m_size(size),
+              m_current(nullptr),
+              m_end(nullptr)
+        {
+        }
+
+
+        uint8_t* Allocate(size_t size)
+        {
+            const size_t alignment = CodeHeap::c_blockAlignment;
+            size = (size + alignment - 1) & ~(alignment - 1);
+
+            if (static_cast<size_t>(m_end - m_current) < size)
+            {
+                // Any remaining space in the current region is abandoned.
+                const size_t regionSize = (std::max)(m_size, size);
+
+                std::lock_guard<std::mutex> lock(m_codeHeapMutex);
+                m_current = static_cast<uint8_t*>(m_codeHeap.Allocate(regionSize));
+                m_end = m_current + regionSize;
+            }
+
+            uint8_t* block = m_current;
+            m_current += size;
+
+            return block;
+        }
+
+    private:
+        CodeHeap& m_codeHeap;
+        std::mutex& m_codeHeapMutex;
+        const size_t m_size;
+
+        uint8_t* m_current;
+        uint8_t* m_end;
+    };
+
+
+    //*************************************************************************
+    //
+    // ThreadJoiner
+    //
+    //*************************************************************************
+    namespace
+    {
+        // Joins the threads in the destructor. Destroying a std::thread which
+        // is still joinable terminates the process, so the worker threads
+        // must be joined even when the code which started them unwinds.
+        class ThreadJoiner : private NonCopyable
+        {
+        public:
+            ThreadJoiner(std::vector<std::thread>& threads)
+                : m_threads(threads)
+            {
+            }
+
+
+            ~ThreadJoiner()
+            {
+                for (auto & thread : m_threads)
+                {
+                    if (thread.joinable())
+                    {
+                        thread.join();
+                    }
+                }
+            }
+
+        private:
+            std::vector<std::thread>& m_threads;
+        };
+    }
+
+
+    //*************************************************************************
+    //
+    // BatchCompiler
+    //
+    //*************************************************************************
+    BatchCompiler::BatchCompiler(CompileContextPool& pool,
+                                 unsigned threadCount,
+                                 size_t subArenaSize,
+                                 size_t segmentSize)
+        : m_pool(pool),
+          m_threadCount(threadCount),
+          m_subArenaSize(subArenaSize),
+          m_segmentSize(segmentSize)
+    {
+        LogThrowAssert(threadCount > 0, "Batch compiler requires at least one thread");
+    }
+
+
+    std::unique_ptr<CompiledBatch>
+    BatchCompiler::Compile(std::vector<Builder> const & builders)
+    {
+        const unsigned builderCount = static_cast<unsigned>(builders.size());
+        std::unique_ptr<CompiledBatch> batch(new CompiledBatch(m_segmentSize, builderCount));
+
+        std::atomic<unsigned> nextBuilder(0);
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        // Records the first failure and makes the workers skip the remaining
+        // builders.
+        auto recordError = [&]()
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+
+            nextBuilder = builderCount;
+        };
+
+        // No exception may escape the worker: on a spawned thread it would
+        // terminate the process.
+        auto worker = [&]()
+        {
+            try
+            {
+                SubArena arena(batch->m_codeHeap, batch->m_codeHeapMutex, m_subArenaSize);
+                auto lease = m_pool.Acquire();
+
+                for (unsigned i = nextBuilder++; i < builderCount; i = nextBuilder++)
+                {
+                    auto & code = lease.GetCode();
+
+                    lease.GetContext().Reset();
+                    builders[i](lease.GetAllocator(), code);
+
+                    // Copy the code, which doesn't depend on its position,
+                    // out of the context.
+                    const unsigned byteCount = code.CurrentPosition();
+                    uint8_t* base = arena.Allocate(byteCount);
+                    memcpy(base, code.BufferStart(), byteCount);
+
+                    auto & function = batch->m_functions[i];
+                    function.m_base = base;
+                    function.m_runtimeFunction.BeginAddress = code.GetFunctionCodeStartOffset();
+                    function.m_runtimeFunction.EndAddress = code.GetFunctionCodeEndOffset();
+                    function.m_runtimeFunction.UnwindData = code.GetUnwindInfoStartOffset();
+                }
+            }
+            catch (...)
+            {
+                recordError();
+            }
+        };
+
+        // The calling thread acts as one of the workers.
+        const unsigned threadCount = (std::min)(m_threadCount, (std::max)(builderCount, 1u));
+        std::vector<std::thread> threads;
+
+        {
+            // Joins the started threads on every path out of this scope.
+            ThreadJoiner joiner(threads);
+
+            try
+            {
+                for (unsigned t = 1; t < threadCount; ++t)
+                {
+                    threads.emplace_back(worker);
+                }
+            }
+            catch (...)
+            {
+                // Fail the batch and let the started workers finish early.
+                recordError();
+            }
+
+            worker();
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+
+        batch->Publish();
+
+        return batch;
+    }
+}
@@ -0,0 +1,150 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/BranchProfile.h"
+#include "NativeJIT/ExpressionTree.h"
+
+
+namespace NativeJIT
+{
+    //*************************************************************************
+    //
+    // BranchProfile
+    //
+    //*************************************************************************
+    BranchProfile::BranchProfile()
+        : m_callCount(0)
+    {
+    }
+
+
+    uint64_t& BranchProfile::GetCallCounter()
+    {
+        return m_callCount;
+    }
+
+
+    uint64_t BranchProfile::GetCallCount() const
+    {
+        return m_callCount;
+    }
+
+
+    BranchProfile::Counters& BranchProfile::GetConditionalCounters(unsigned nodeId)
+    {
+        // Note: std::map value-initializes the inserted counters.
+        return m_conditionals[nodeId];
+    }
+
+
+    BranchProfile::Counters& BranchProfile::GetPreconditionCounters(unsigned conditionNodeId)
+    {
+        return m_preconditions[conditionNodeId];
+    }
+
+
+    BranchProfile::HotBranch BranchProfile::GetConditionalHotBranch(unsigned nodeId) const
+    {
+        return GetHotBranch(m_conditionals, nodeId);
+    }
+
+
+    BranchProfile::HotBranch BranchProfile::GetPreconditionHotBranch(unsigned conditionNodeId) const
+    {
+        return GetHotBranch(m_preconditions, conditionNodeId);
+    }
+
+
+    void BranchProfile::Reset()
+    {
+        // The counters are zeroed rather than erased to keep them valid
+        // for the code which refers to them.
+        m_callCount = 0;
+
+        for (auto & entry : m_conditionals)
+        {
+            entry.second = Counters();
+        }
+
+        for (auto & entry : m_preconditions)
+        {
+            entry.second = Counters();
+        }
+    }
+
+
+    BranchProfile::HotBranch
+    BranchProfile::GetHotBranch(std::map<unsigned, Counters> const & counters,
+                                unsigned id)
+    {
+        auto it = counters.find(id);
+
+        if (it == counters.end() || it->second.m_trueCount == it->second.m_falseCount)
+        {
+            return HotBranch::Unknown;
+        }
+
+        return it->second.m_trueCount > it->second.m_falseCount
+            ? HotBranch::True
+            : HotBranch::False;
+    }
+
+
+    //*************************************************************************
+    //
+    // ProfileCounterEmitter
+    //
+    //*************************************************************************
+    ProfileCounterEmitter::ProfileCounterEmitter(ExpressionTree& tree, bool isEnabled)
+        : m_tree(tree),
+          m_isEnabled(isEnabled)
+    {
+        if (m_isEnabled)
+        {
+            m_address = tree.Direct<uint64_t*>();
+            m_addressPin = m_address.GetPin();
+            m_value = tree.Direct<uint64_t>();
+            m_valuePin = m_value.GetPin();
+        }
+    }
+
+
+    void ProfileCounterEmitter::EmitIncrement(uint64_t& counter)
+    {
+        if (!m_isEnabled)
+        {
+            return;
+        }
+
+        auto & code = m_tree.GetCodeGenerator();
+        auto address = m_address.GetDirectRegister();
+        auto value = m_value.GetDirectRegister();
+
+        // There is no encoding of add with an immediate and a memory
+        // destination, so the counter goes through a register.
+        code.EmitImmediate<OpCode::Mov>(address, reinterpret_cast<uint64_t>(&counter));
+        code.Emit<OpCode::Mov>(value, address, 0);
+        code.EmitImmediate<OpCode::Add>(value, 1);
+        code.Emit<OpCode::Mov>(address, 0, value);
+    }
+}
@@ -91,20 +91,14 @@ namespace NativeJIT
 
         while (BitOp::GetLowestBitSet(xmmVolatiles, &r))
         {
-            // DESIGN NOTE: This preserves only the lower 64 bits of the XMM register.
-            // That is currently fine as NativeJIT only uses floats and doubles
-            // which don't overlap with the upper 64-bits. Also, the full 128
-            // bits of XMM nonvolatiles are preserved in the function prolog
-            // by FunctionBuffer. To be fully correct, this should preserve
-            // all 128 bits (f. ex. allow Temporary() to return 16-byte
-            // aligned 16-byte space and use movaps to save the whole register).
-            // RestoreVolatiles() needs to be modified accordingly as well.
-            m_preservationStorage.push_back(tree.Temporary<void*>());
+            // Preserve all 128 bits of the register in a 16-byte aligned slot,
+            // the same way as the prolog preserves the XMM nonvolatiles.
+            m_preservationStorage.push_back(Storage<void*>(tree.XmmTemporary<double>()));
             auto const & s = m_preservationStorage.back();
 
-            code.Emit<OpCode::Mov>(s.GetBaseRegister(),
-                                   s.GetOffset(),
-                                   Register<8, true>(r));
+            code.Emit<OpCode::MovAP>(s.GetBaseRegister(),
+                                     s.GetOffset(),
+                                     Register<4, true>(r));
 
 
             BitOp::ClearBit(&xmmVolatiles, r);
@@ -125,9 +119,9 @@ namespace NativeJIT
             LogThrowAssert(!m_preservationStorage.empty(), "Logic error");
             auto const & s = m_preservationStorage.back();
 
-            code.Emit<OpCode::Mov>(Register<8, true>(r),
-                                   s.GetBaseRegister(),
-                                   s.GetOffset());
+            code.Emit<OpCode::MovAP>(Register<4, true>(r),
+                                     s.GetBaseRegister(),
+                                     s.GetOffset());
 
             m_preservationStorage.pop_back();
             BitOp::ClearBit(&xmmVolatiles, r);
@@ -0,0 +1,231 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "NativeJIT/CompileCache.h"
+#include "Temporary/Assert.h"
+
+
+namespace NativeJIT
+{
+    //*************************************************************************
+    //
+    // CompiledCode
+    //
+    //*************************************************************************
+    CompiledCode::CompiledCode(Allocators::IAllocator& codeAllocator,
+                               FunctionBuffer const & code)
+        : m_code(codeAllocator, code.CurrentPosition()),
+          m_entryPointOffset(code.GetFunctionCodeStartOffset())
+    {
+        // The code only refers to its static data and to other functions
+        // through relative or absolute addresses that do not depend on
+        // the position of the buffer, so it can be copied verbatim.
+        m_code.EmitBytes(code.BufferStart(), code.CurrentPosition());
+
+        m_runtimeFunction.BeginAddress = code.GetFunctionCodeStartOffset();
+        m_runtimeFunction.EndAddress = code.GetFunctionCodeEndOffset();
+        m_runtimeFunction.UnwindData = code.GetUnwindInfoStartOffset();
+
+#ifdef NATIVEJIT_PLATFORM_WINDOWS
+        if (!RtlAddFunctionTable(&m_runtimeFunction,
+                                 1,
+                                 reinterpret_cast<DWORD64>(m_code.ExecutableBufferStart())))
+        {
+            throw std::runtime_error("Couldn't add function table");
+        }
+#endif
+    }
+
+
+    CompiledCode::~CompiledCode()
+    {
+#ifdef NATIVEJIT_PLATFORM_WINDOWS
+        RtlDeleteFunctionTable(&m_runtimeFunction);
+#endif
+    }
+
+
+    void const * CompiledCode::GetEntryPoint() const
+    {
+        return m_code.ExecutableBufferStart() + m_entryPointOffset;
+    }
+
+
+    unsigned CompiledCode::GetCodeByteSize() const
+    {
+        return m_code.CurrentPosition();
+    }
+
+
+    //*************************************************************************
+    //
+    // CompileCache
+    //
+    //*************************************************************************
+    CompileCache::CompileCache(Allocators::IAllocator& codeAllocator,
+                               unsigned maxEntryCount,
+                               size_t maxByteSize)
+        : m_codeAllocator(codeAllocator),
+          m_maxEntryCount(maxEntryCount),
+          m_maxByteSize(maxByteSize),
+          m_byteSize(0),
+          m_hitCount(0),
+          m_missCount(0),
+          m_evictionCount(0)
+    {
+        LogThrowAssert(maxEntryCount > 0, "Compile cache must allow at least one entry");
+    }
+
+
+    CompileCache::Entry CompileCache::Find(StructuralKey const & key)
+    {
+        auto it = key.IsValid() ? m_index.find(GetView(key)) : m_index.end();
+
+        if (it == m_index.end())
+        {
+            ++m_missCount;
+
+            return Entry();
+        }
+
+        ++m_hitCount;
+
+        // Move the entry to the front of the list. Splicing keeps the iterators
+        // and thus the index valid.
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+        return it->second->m_code;
+    }
+
+
+    CompileCache::Entry CompileCache::Add(StructuralKey const & key,
+                                          FunctionBuffer const & code)
+    {
+        const size_t byteSize = code.CurrentPosition() + key.GetByteSize();
+
+        if (!key.IsValid() || byteSize > m_maxByteSize)
+        {
+            return Entry();
+        }
+
+        LogThrowAssert(m_index.find(GetView(key)) == m_index.end(),
+                       "The key is already present in the compile cache");
+
+        while (!m_entries.empty()
+               && (m_entries.size() >= m_maxEntryCount
+                   || m_byteSize + byteSize > m_maxByteSize))
+        {
+            EvictLeastRecentlyUsed();
+        }
+
+        Entry compiledCode = std::make_shared<CompiledCode const>(m_codeAllocator, code);
+
+        std::vector<uint64_t> words(key.GetWords(), key.GetWords() + key.GetWordCount());
+
+        m_entries.push_front(CacheEntry { std::move(words), key.GetHash(), compiledCode, byteSize });
+        m_index.insert(std::make_pair(GetView(m_entries.front()), m_entries.begin()));
+        m_byteSize += byteSize;
+
+        return compiledCode;
+    }
+
+
+    void CompileCache::Clear()
+    {
+        m_index.clear();
+        m_entries.clear();
+        m_byteSize = 0;
+    }
+
+
+    unsigned CompileCache::GetEntryCount() const
+    {
+        return static_cast<unsigned>(m_entries.size());
+    }
+
+
+    size_t CompileCache::GetByteSize() const
+    {
+        return m_byteSize;
+    }
+
+
+    uint64_t CompileCache::GetHitCount() const
+    {
+        return m_hitCount;
+    }
+
+
+    uint64_t CompileCache::GetMissCount() const
+    {
+        return m_missCount;
+    }
+
+
+    uint64_t CompileCache::GetEvictionCount() const
+    {
+        return m_evictionCount;
+    }
+
+
+    void CompileCache::EvictLeastRecentlyUsed()
+    {
+        auto & entry = m_entries.back();
+
+        m_index.erase(GetView(entry));
+        m_byteSize -= entry.m_byteSize;
+        m_entries.pop_back();
+
+        ++m_evictionCount;
+    }
+
+
+    CompileCache::KeyView CompileCache::GetView(StructuralKey const & key)
+    {
+        return KeyView { key.GetWords(), key.GetWordCount(), key.GetHash() };
+    }
+
+
+    CompileCache::KeyView CompileCache::GetView(CacheEntry const & entry)
+    {
+        return KeyView { entry.m_words.data(), entry.m_words.size(), entry.m_hash };
+    }
+
+
+    size_t CompileCache::KeyViewHasher::operator()(KeyView const & key) const
+    {
+        return key.m_hash;
+    }
+
+
+    bool CompileCache::KeyViewEqual::operator()(KeyView const & left,
+                                                KeyView const & right) const
+    {
+        return left.m_hash == right.m_hash
+               && left.m_wordCount == right.m_wordCount
+               && std::equal(left.m_words, left.m_words + left.m_wordCount, right.m_words);
+    }
+}
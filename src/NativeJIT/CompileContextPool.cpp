@@ -0,0 +1,197 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/CompileContextPool.h"
+#include "Temporary/Assert.h"
+
+
+namespace NativeJIT
+{
+    //*************************************************************************
+    //
+    // CompileContext
+    //
+    //*************************************************************************
+    CompileContext::CompileContext(unsigned allocatorCapacity, unsigned codeCapacity)
+        : m_allocator(allocatorCapacity),
+          m_codeAllocator(codeCapacity),
+          m_code(m_codeAllocator, codeCapacity)
+    {
+    }
+
+
+    Allocators::IAllocator& CompileContext::GetAllocator()
+    {
+        return m_allocator;
+    }
+
+
+    FunctionBuffer& CompileContext::GetCode()
+    {
+        return m_code;
+    }
+
+
+    void CompileContext::Reset()
+    {
+        // Note: m_codeAllocator is not reset since it only holds m_code, whose
+        // buffer is reused for the next function.
+        if (m_function)
+        {
+            // Resets the allocator as well.
+            m_function->Reset();
+        }
+        else
+        {
+            m_allocator.Reset();
+        }
+
+        m_code.Reset();
+    }
+
+
+    CompileContext::FunctionHolderBase::~FunctionHolderBase()
+    {
+    }
+
+
+    //*************************************************************************
+    //
+    // CompileContextPool::Lease
+    //
+    //*************************************************************************
+    CompileContextPool::Lease::Lease(CompileContextPool& pool,
+                                     std::unique_ptr<CompileContext> context)
+        : m_pool(&pool),
+          m_context(std::move(context))
+    {
+    }
+
+
+    CompileContextPool::Lease::Lease(Lease&& other)
+        : m_pool(other.m_pool),
+          m_context(std::move(other.m_context))
+    {
+    }
+
+
+    CompileContextPool::Lease::~Lease()
+    {
+        if (m_context)
+        {
+            m_pool->Release(std::move(m_context));
+        }
+    }
+
+
+    CompileContext& CompileContextPool::Lease::GetContext() const
+    {
+        LogThrowAssert(m_context != nullptr, "The lease does not hold a context");
+
+        return *m_context;
+    }
+
+
+    Allocators::IAllocator& CompileContextPool::Lease::GetAllocator() const
+    {
+        return GetContext().GetAllocator();
+    }
+
+
+    FunctionBuffer& CompileContextPool::Lease::GetCode() const
+    {
+        return GetContext().GetCode();
+    }
+
+
+    //*************************************************************************
+    //
+    // CompileContextPool
+    //
+    //*************************************************************************
+    CompileContextPool::CompileContextPool(unsigned initialContextCount,
+                                           unsigned allocatorCapacity,
+                                           unsigned codeCapacity)
+        : m_allocatorCapacity(allocatorCapacity),
+          m_codeCapacity(codeCapacity),
+          m_contextCount(initialContextCount)
+    {
+        m_availableContexts.reserve(initialContextCount);
+
+        for (unsigned i = 0; i < initialContextCount; ++i)
+        {
+            m_availableContexts.emplace_back(
+                new CompileContext(m_allocatorCapacity, m_codeCapacity));
+        }
+    }
+
+
+    CompileContextPool::Lease CompileContextPool::Acquire()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (!m_availableContexts.empty())
+            {
+                std::unique_ptr<CompileContext> context(std::move(m_availableContexts.back()));
+                m_availableContexts.pop_back();
+
+                return Lease(*this, std::move(context));
+            }
+
+            ++m_contextCount;
+        }
+
+        // Create the new context outside of the lock since it's expensive.
+        std::unique_ptr<CompileContext> context(
+            new CompileContext(m_allocatorCapacity, m_codeCapacity));
+
+        return Lease(*this, std::move(context));
+    }
+
+
+    unsigned CompileContextPool::GetContextCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_contextCount;
+    }
+
+
+    unsigned CompileContextPool::GetAvailableContextCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return static_cast<unsigned>(m_availableContexts.size());
+    }
+
+
+    void CompileContextPool::Release(std::unique_ptr<CompileContext> context)
+    {
+        // Reset outside of the lock so that other threads are not blocked.
+        context->Reset();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_availableContexts.push_back(std::move(context));
+    }
+}
@@ -21,6 +21,8 @@
 // THE SOFTWARE.
 
 
+#include <new>          // For placement new.
+
 #include "NativeJIT/ExpressionNodeFactory.h"
 
 
@@ -28,7 +30,175 @@ namespace NativeJIT
 {
     ExpressionNodeFactory::ExpressionNodeFactory(Allocators::IAllocator& allocator,
                                                  FunctionBuffer& code)
-        : ExpressionTree(allocator, code)
+        : ExpressionTree(allocator, code),
+          m_isNodeInterningEnabled(true),
+          m_internedNodeCount(0),
+          m_internedNodes(0,
+                          StructuralKey::Hasher(),
+                          std::equal_to<StructuralKey>(),
+                          InternedNodeMap::allocator_type(allocator)),
+          m_pureFunctions(0,
+                          std::hash<unsigned>(),
+                          std::equal_to<unsigned>(),
+                          FunctionIdSet::allocator_type(allocator)),
+          m_impureCallCount(0)
+    {
+    }
+
+
+    void ExpressionNodeFactory::Reset()
+    {
+        ExpressionTree::Reset();
+
+        // The memory of the containers was released along with the nodes,
+        // see ExpressionTree::RecreateVector().
+        new (&m_internedNodes) InternedNodeMap(0,
+                                               StructuralKey::Hasher(),
+                                               std::equal_to<StructuralKey>(),
+                                               InternedNodeMap::allocator_type(GetAllocator()));
+        new (&m_pureFunctions) FunctionIdSet(0,
+                                             std::hash<unsigned>(),
+                                             std::equal_to<unsigned>(),
+                                             FunctionIdSet::allocator_type(GetAllocator()));
+
+        m_isNodeInterningEnabled = true;
+        m_internedNodeCount = 0;
+        m_impureCallCount = 0;
+    }
+
+
+    void ExpressionNodeFactory::EnableNodeInterning()
+    {
+        m_isNodeInterningEnabled = true;
+    }
+
+
+    void ExpressionNodeFactory::DisableNodeInterning()
+    {
+        m_isNodeInterningEnabled = false;
+    }
+
+
+    void ExpressionNodeFactory::MarkPure(NodeBase& function)
+    {
+        m_pureFunctions.insert(function.GetId());
+    }
+
+
+    unsigned ExpressionNodeFactory::GetInternedNodeCount() const
+    {
+        return m_internedNodeCount;
+    }
+
+
+    void ExpressionNodeFactory::DescribeArgument(StructuralKeyBuilder& key, NodeBase const & node)
     {
+        key.AddValue(node.GetId());
+    }
+
+
+    ExpressionNodeFactory::DivisionMagic
+    ExpressionNodeFactory::GetUnsignedDivisionMagic(uint64_t divisor, unsigned bitCount)
+    {
+        LogThrowAssert(divisor > 1, "Divisor must be greater than one");
+
+        // All the arithmetic is modulo 2^bitCount. The loop looks for the
+        // smallest power of two 2^p for which the multiplier ceil(2^p / d)
+        // is accurate enough, i.e. 2^(p - bitCount) >= d - 1 - (2^p - 1) % d.
+        const uint64_t mask = bitCount == 64 ? ~0ull : (1ull << bitCount) - 1;
+        const uint64_t maxSigned = mask >> 1;
+
+        DivisionMagic magic = { 0, 0, false };
+        unsigned p = bitCount - 1;
+        uint64_t quotient = maxSigned / divisor;
+        uint64_t remainder = maxSigned - quotient * divisor;
+        uint64_t power = 0;
+        uint64_t delta;
+
+        do
+        {
+            ++p;
+            power = p == bitCount ? 1 : (2 * power) & mask;
+
+            if (remainder + 1 >= divisor - remainder)
+            {
+                magic.m_isAddNeeded |= quotient >= maxSigned;
+                quotient = (2 * quotient + 1) & mask;
+                remainder = (2 * remainder + 1 - divisor) & mask;
+            }
+            else
+            {
+                magic.m_isAddNeeded |= quotient >= maxSigned + 1;
+                quotient = (2 * quotient) & mask;
+                remainder = (2 * remainder + 1) & mask;
+            }
+
+            delta = divisor - 1 - remainder;
+        }
+        while (p < 2 * bitCount && power < delta);
+
+        magic.m_multiplier = (quotient + 1) & mask;
+        magic.m_shift = p - bitCount;
+
+        return magic;
+    }
+
+
+    ExpressionNodeFactory::DivisionMagic
+    ExpressionNodeFactory::GetSignedDivisionMagic(int64_t divisor, unsigned bitCount)
+    {
+        // All the arithmetic is modulo 2^bitCount. The loop looks for the
+        // smallest power of two 2^p for which 2^p / |d| rounded up is accurate
+        // for all the dividends up to the largest multiple of |d| in range.
+        const uint64_t mask = bitCount == 64 ? ~0ull : (1ull << bitCount) - 1;
+        const uint64_t signBit = 1ull << (bitCount - 1);
+        const uint64_t word = static_cast<uint64_t>(divisor) & mask;
+        const uint64_t magnitude = (divisor < 0 ? 0 - word : word) & mask;
+
+        LogThrowAssert(magnitude > 1, "Divisor magnitude must be greater than one");
+
+        const uint64_t t = signBit + (word >> (bitCount - 1));
+        const uint64_t limit = t - 1 - t % magnitude;
+
+        unsigned p = bitCount - 1;
+        uint64_t limitQuotient = signBit / limit;
+        uint64_t limitRemainder = signBit - limitQuotient * limit;
+        uint64_t quotient = signBit / magnitude;
+        uint64_t remainder = signBit - quotient * magnitude;
+        uint64_t delta;
+
+        do
+        {
+            ++p;
+
+            limitQuotient = (2 * limitQuotient) & mask;
+            limitRemainder = (2 * limitRemainder) & mask;
+
+            if (limitRemainder >= limit)
+            {
+                limitQuotient = (limitQuotient + 1) & mask;
+                limitRemainder -= limit;
+            }
+
+            quotient = (2 * quotient) & mask;
+            remainder = (2 * remainder) & mask;
+
+            if (remainder >= magnitude)
+            {
+                quotient = (quotient + 1) & mask;
+                remainder -= magnitude;
+            }
+
+            delta = magnitude - remainder;
+        }
+        while (limitQuotient < delta || (limitQuotient == delta && limitRemainder == 0));
+
+        DivisionMagic magic;
+
+        magic.m_multiplier = (divisor < 0 ? 0 - (quotient + 1) : quotient + 1) & mask;
+        magic.m_shift = p - bitCount;
+        magic.m_isAddNeeded = false;
+
+        return magic;
     }
 }
@@ -21,13 +21,20 @@
 // THE SOFTWARE.
 
 
+#include <algorithm>    // For std::count_if, std::lower_bound, std::upper_bound
+#include <new>          // For placement new.
+
+#include "NativeJIT/BranchProfile.h"
 #include "NativeJIT/CodeGen/CallingConvention.h"
 #include "NativeJIT/CodeGen/FunctionBuffer.h"
 #include "NativeJIT/CodeGen/FunctionSpecification.h"
+#include "NativeJIT/CompileCache.h"
 #include "NativeJIT/ExecutionPreconditionTest.h"
 #include "NativeJIT/ExpressionTree.h"
+#include "NativeJIT/Interpreter.h"
 #include "NativeJIT/Nodes/ImmediateNode.h"
 #include "NativeJIT/Nodes/ParameterNode.h"
+#include "NativeJIT/StructuralKey.h"
 #include "Temporary/Assert.h"
 
 
@@ -48,17 +55,84 @@ namespace NativeJIT
           m_topologicalSort(m_stlAllocator),
           m_parameters(m_stlAllocator),
           m_ripRelatives(m_stlAllocator),
+          m_constantMemory(m_stlAllocator),
           m_preconditionTests(m_stlAllocator),
           m_rxxFreeList(allocator),
           m_xmmFreeList(allocator),
           m_reservedRxxRegisterStorages(m_stlAllocator),
           m_reservedXmmRegisterStorages(m_stlAllocator),
           m_reservedRegistersPins(m_stlAllocator),
-          m_temporaryCount(0),
-          m_temporaries(m_stlAllocator),
+          m_temporaryUnits(m_stlAllocator),
           m_maxFunctionCallParameters(-1),
-          m_basePointer(rbp)
+          m_basePointer(rbp),
+          m_eliminatedNodeCount(0),
+          m_registerAllocation(RegisterAllocation::Greedy),
+          m_loadScheduling(LoadScheduling::InOrder),
+          m_instrumentationProfile(nullptr),
+          m_layoutProfile(nullptr),
+          m_coldBlocks(m_stlAllocator),
+          m_currentNodeId(0),
+          m_useStart(m_stlAllocator),
+          m_usePositions(m_stlAllocator),
+          m_callPositions(m_stlAllocator),
+          m_conditionalRegions(m_stlAllocator),
+          m_nodeRegions(m_stlAllocator),
+          m_dataCount(0),
+          m_joinPointDataCount(0),
+          m_innermostLoop(nullptr),
+          m_isEvaluatingPreconditions(false),
+          m_innermostRegionEvaluation(nullptr)
           // m_startOfEpilogue intentionally left uninitialized, see Compile().
+    {
+        ReserveRegisters();
+    }
+
+
+    void ExpressionTree::Reset()
+    {
+        m_allocator.Reset();
+
+        // Everything allocated by the containers is gone with the reset, so
+        // they are recreated empty instead of being cleared.
+        RecreateVector(m_topologicalSort, m_allocator);
+        RecreateVector(m_parameters, m_allocator);
+        RecreateVector(m_ripRelatives, m_allocator);
+        RecreateVector(m_constantMemory, m_allocator);
+        RecreateVector(m_preconditionTests, m_allocator);
+        m_rxxFreeList.Reset(m_allocator);
+        m_xmmFreeList.Reset(m_allocator);
+        RecreateVector(m_reservedRxxRegisterStorages, m_allocator);
+        RecreateVector(m_reservedXmmRegisterStorages, m_allocator);
+        RecreateVector(m_reservedRegistersPins, m_allocator);
+        RecreateVector(m_temporaryUnits, m_allocator);
+        RecreateVector(m_coldBlocks, m_allocator);
+        RecreateVector(m_useStart, m_allocator);
+        RecreateVector(m_usePositions, m_allocator);
+        RecreateVector(m_callPositions, m_allocator);
+        RecreateVector(m_conditionalRegions, m_allocator);
+        RecreateVector(m_nodeRegions, m_allocator);
+
+        m_diagnosticsStream = nullptr;
+        m_maxFunctionCallParameters = -1;
+        m_basePointer = rbp;
+        m_compiledCode.reset();
+        m_eliminatedNodeCount = 0;
+        m_registerAllocation = RegisterAllocation::Greedy;
+        m_loadScheduling = LoadScheduling::InOrder;
+        m_instrumentationProfile = nullptr;
+        m_layoutProfile = nullptr;
+        m_currentNodeId = 0;
+        m_dataCount = 0;
+        m_joinPointDataCount = 0;
+        m_innermostLoop = nullptr;
+        m_isEvaluatingPreconditions = false;
+        m_innermostRegionEvaluation = nullptr;
+
+        ReserveRegisters();
+    }
+
+
+    void ExpressionTree::ReserveRegisters()
     {
         m_reservedRxxRegisterStorages.reserve(RegisterBase::c_maxIntegerRegisterID + 1);
         m_reservedXmmRegisterStorages.reserve(RegisterBase::c_maxFloatRegisterID + 1);
@@ -120,6 +194,54 @@ namespace NativeJIT
     }
 
 
+    void ExpressionTree::SetRegisterAllocation(RegisterAllocation allocation)
+    {
+        m_registerAllocation = allocation;
+    }
+
+
+    RegisterAllocation ExpressionTree::GetRegisterAllocation() const
+    {
+        return m_registerAllocation;
+    }
+
+
+    void ExpressionTree::SetLoadScheduling(LoadScheduling scheduling)
+    {
+        m_loadScheduling = scheduling;
+    }
+
+
+    LoadScheduling ExpressionTree::GetLoadScheduling() const
+    {
+        return m_loadScheduling;
+    }
+
+
+    void ExpressionTree::SetInstrumentationProfile(BranchProfile& profile)
+    {
+        m_instrumentationProfile = &profile;
+    }
+
+
+    BranchProfile* ExpressionTree::GetInstrumentationProfile() const
+    {
+        return m_instrumentationProfile;
+    }
+
+
+    void ExpressionTree::SetLayoutProfile(BranchProfile const & profile)
+    {
+        m_layoutProfile = &profile;
+    }
+
+
+    BranchProfile const * ExpressionTree::GetLayoutProfile() const
+    {
+        return m_layoutProfile;
+    }
+
+
     bool ExpressionTree::IsDiagnosticsStreamAvailable() const
     {
         return m_diagnosticsStream != nullptr;
@@ -136,15 +258,39 @@ namespace NativeJIT
 
     void ExpressionTree::ReleaseIfTemporary(int32_t offset)
     {
-        unsigned slot;
-
-        if (TemporaryOffsetToSlot(offset, slot))
+        if (offset < 0 && -offset % sizeof(void*) == 0)
         {
-            m_temporaries.push_back(slot);
+            const unsigned unit = -offset / sizeof(void*) - 1;
+
+            if (unit < m_temporaryUnits.size()
+                && m_temporaryUnits[unit] != 0
+                && m_temporaryUnits[unit] != c_temporaryUnitContinued)
+            {
+                if (m_innermostLoop != nullptr
+                    && m_innermostLoop->DefersRelease(unit, offset))
+                {
+                    return;
+                }
+
+                // The temporary extends from its offset towards the base
+                // pointer, i.e. over the units with lower indexes.
+                const unsigned unitCount = m_temporaryUnits[unit];
+
+                for (unsigned i = 0; i < unitCount; ++i)
+                {
+                    m_temporaryUnits[unit - i] = 0;
+                }
+            }
         }
     }
 
 
+    unsigned ExpressionTree::GetTemporaryAreaSize() const
+    {
+        return static_cast<unsigned>(m_temporaryUnits.size() * sizeof(void*));
+    }
+
+
     unsigned ExpressionTree::GetRXXUsedMask() const
     {
         return m_rxxFreeList.GetUsedMask();
@@ -157,6 +303,27 @@ namespace NativeJIT
     }
 
 
+    unsigned ExpressionTree::SetCurrentNode(unsigned nodeId)
+    {
+        const unsigned previousNodeId = m_currentNodeId;
+        m_currentNodeId = nodeId;
+
+        return previousNodeId;
+    }
+
+
+    bool ExpressionTree::IsRecordingCacheUses() const
+    {
+        return m_innermostRegionEvaluation != nullptr;
+    }
+
+
+    void ExpressionTree::RecordCacheUse(NodeBase& node, Storage<void*> const & value)
+    {
+        m_innermostRegionEvaluation->m_cacheUses.push_back({ m_currentNodeId, &node, value });
+    }
+
+
     bool ExpressionTree::IsBasePointer(PointerRegister r) const
     {
         return r.GetId() == m_basePointer.GetId();
@@ -174,6 +341,12 @@ namespace NativeJIT
     }
 
 
+    void ExpressionTree::AddColdBlock(ColdBlock& block)
+    {
+        m_coldBlocks.push_back(&block);
+    }
+
+
     unsigned ExpressionTree::AddNode(NodeBase& node)
     {
         m_topologicalSort.push_back(&node);
@@ -198,6 +371,32 @@ namespace NativeJIT
     }
 
 
+    void ExpressionTree::AddConstantMemory(void const * start, size_t size)
+    {
+        LogThrowAssert(start != nullptr, "Constant memory must have a valid address");
+
+        m_constantMemory.push_back(std::make_pair(static_cast<char const *>(start), size));
+    }
+
+
+    bool ExpressionTree::IsConstantMemory(void const * start, size_t size) const
+    {
+        auto const address = static_cast<char const *>(start);
+
+        for (auto const & range : m_constantMemory)
+        {
+            if (address >= range.first
+                && size <= range.second
+                && static_cast<size_t>(address - range.first) <= range.second - size)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
     void ExpressionTree::AddExecutionPreconditionTest(ExecutionPreconditionTest& test)
     {
         m_preconditionTests.push_back(&test);
@@ -210,15 +409,96 @@ namespace NativeJIT
         {
             m_maxFunctionCallParameters = parameterCount;
         }
+
+        // The call node reports itself from its constructor, after it has
+        // been added to the topological sort.
+        m_callPositions.push_back(static_cast<unsigned>(m_topologicalSort.size() - 1));
+    }
+
+
+    unsigned ExpressionTree::AddConditionalRegion(NodeBase& parent, NodeBase& child)
+    {
+        m_conditionalRegions.push_back({ &parent, &child, 0, 0 });
+
+        return static_cast<unsigned>(m_conditionalRegions.size());
+    }
+
+
+    void ExpressionTree::CodeGenSharedNodes(unsigned region)
+    {
+        for (unsigned i = 0 ; i < m_topologicalSort.size(); ++i)
+        {
+            NodeBase& node = *m_topologicalSort[i];
+
+            if (node.GetParentCount() > 1
+                && !node.HasBeenEvaluated()
+                && GetEvaluationRegion(node) == region)
+            {
+                node.CodeGenCache(*this);
+            }
+        }
+    }
+
+
+    bool ExpressionTree::IsTrivialRegion(unsigned region) const
+    {
+        LogThrowAssert(region > 0 && region <= m_conditionalRegions.size(),
+                       "Invalid conditional region %u",
+                       region);
+
+        NodeBase const & child = m_conditionalRegions[region - 1].m_child->GetEvaluatedNode();
+
+        // Evaluating the child evaluates every child of its own which is
+        // neither constant nor evaluated yet. These include the nodes of the
+        // region, the conditions guarding the regions nested in it and the
+        // nodes shared with the rest of the tree which the preconditions
+        // reach before Pass2() evaluates them.
+        AllocatorVector<NodeBase const *> children(m_stlAllocator);
+        child.GetChildren(children);
+
+        for (NodeBase const * childNode : children)
+        {
+            // The replaced nodes are evaluated through their replacements.
+            NodeBase const & node = childNode->GetEvaluatedNode();
+
+            if (!node.IsConstant() && !node.HasBeenEvaluated())
+            {
+                return false;
+            }
+        }
+
+        return true;
     }
 
 
     void ExpressionTree::Compile()
     {
+        m_compiledCode.reset();
+
         // Note: the call to Reset() clears all allocated labels, so start of
         // epilogue label must be allocated after that point.
         m_code.Reset();
         m_startOfEpilogue = m_code.AllocateLabel();
+        m_coldBlocks.clear();
+
+        LogThrowAssert(m_instrumentationProfile == nullptr || m_layoutProfile == nullptr,
+                       "The instrumented code cannot be laid out according to a profile");
+
+        PruneUnusedNodes();
+        Simplify();
+        ComputeEvaluationRegions();
+
+        if (m_registerAllocation == RegisterAllocation::NextUseSpilling)
+        {
+            ComputeLiveRanges();
+        }
+
+        // The preconditions evaluated by Pass1() may load values as well, so
+        // the loads hoisted by the previous compile are reset before it.
+        for (auto node : m_topologicalSort)
+        {
+            node->ResetHoisting();
+        }
 
         // Generate constants.
         Pass0();
@@ -227,13 +507,19 @@ namespace NativeJIT
         m_code.BeginFunctionBodyGeneration();
 
         Pass1();
+
+        if (m_loadScheduling == LoadScheduling::Hoisted)
+        {
+            HoistLoads();
+        }
+
         Pass2();
         Print();
         Pass3();
 
         const FunctionSpecification spec(m_allocator,
                                          m_maxFunctionCallParameters,
-                                         m_temporaryCount,
+                                         GetTemporaryAreaSize() / sizeof(void*),
                                          m_rxxFreeList.GetLifetimeUsedMask()
                                             & CallingConvention::c_rxxNonVolatileRegistersMask
                                             & CallingConvention::c_rxxWritableRegistersMask,
@@ -246,6 +532,13 @@ namespace NativeJIT
                                          : nullptr);
 
         m_code.PlaceLabel(m_startOfEpilogue);
+        m_code.EmitEpilog(spec);
+
+        for (auto block : m_coldBlocks)
+        {
+            block->Emit(m_code);
+        }
+
         m_code.EndFunctionBodyGeneration(spec);
 
         // Release the reserved registers.
@@ -264,173 +557,654 @@ namespace NativeJIT
     }
 
 
-    void const * ExpressionTree::GetUntypedEntryPoint() const
+    void ExpressionTree::Compile(CompileCache& cache)
     {
-        return m_code.GetEntryPoint();
+        LogThrowAssert(!m_topologicalSort.empty(), "Cannot compile an empty tree");
+
+        // Describe the root first, then the preconditions and finally all the
+        // nodes in the topological order. Most of the latter are already
+        // described and only add their visit index, which captures the order
+        // in which the shared nodes are evaluated in Pass2.
+        StructuralKeyBuilder builder(m_allocator);
+        builder.AddNode(*m_topologicalSort.back());
+
+        for (auto test : m_preconditionTests)
+        {
+            test->DescribeStructure(builder);
+        }
+
+        for (auto node : m_topologicalSort)
+        {
+            builder.AddNode(*node);
+        }
+
+        // The strategies change the generated code.
+        builder.AddValue(static_cast<unsigned>(m_registerAllocation));
+        builder.AddValue(static_cast<unsigned>(m_loadScheduling));
+
+        // The instrumented code refers to the counters of its profile and the
+        // layout depends on the counts at the time of the compilation.
+        if (m_instrumentationProfile != nullptr || m_layoutProfile != nullptr)
+        {
+            builder.MarkInvalid();
+        }
+
+        // The loads from constant memory are folded to the values stored
+        // there, see AddConstantMemory().
+        for (auto const & range : m_constantMemory)
+        {
+            builder.AddValue(range.first);
+            builder.AddValue(range.second);
+        }
+
+        // If the code cannot be cached, it is used directly from the
+        // FunctionBuffer as if the cache was not used.
+        StructuralKey const & key = builder.GetKey();
+        auto compiledCode = cache.Find(key);
+
+        if (!compiledCode)
+        {
+            Compile();
+            compiledCode = cache.Add(key, m_code);
+        }
+
+        m_compiledCode = compiledCode;
     }
 
 
-    int32_t ExpressionTree::TemporarySlotToOffset(unsigned temporarySlot)
+    unsigned ExpressionTree::GetEliminatedNodeCount() const
     {
-        LogThrowAssert(temporarySlot < m_temporaryCount,
-                       "Invalid temporary slot %u (total slots %u)",
-                       temporarySlot,
-                       m_temporaryCount);
-
-        // Expression tree asks for BaseRegisterType::SetRbpToOriginalRsp. That
-        // means that [rbp] holds return address, [rbp + 8] home for function's
-        // first argument etc, whereas [rbp - 8] holds the first temporary etc.
-        return -static_cast<int32_t>(temporarySlot + 1)
-               * sizeof(void*);
+        return m_eliminatedNodeCount;
     }
 
 
-    bool ExpressionTree::TemporaryOffsetToSlot(int32_t temporaryOffset, unsigned& temporarySlot)
+    std::shared_ptr<CompiledCode const> ExpressionTree::GetCompiledCode() const
     {
-        bool isTemporary = false;
+        return m_compiledCode;
+    }
 
-        if (temporaryOffset < 0
-            && -temporaryOffset % sizeof(void*) == 0)
-        {
-            const unsigned slot = -temporaryOffset / sizeof(void*) - 1;
 
-            if (slot < m_temporaryCount)
+    bool ExpressionTree::IsInterpretable() const
+    {
+        for (auto node : m_topologicalSort)
+        {
+            if (!node->IsInterpretable())
             {
-                temporarySlot = slot;
-                isTemporary = true;
+                return false;
             }
         }
 
-        return isTemporary;
+        return true;
     }
 
 
-    void ExpressionTree::Pass0()
+    void ExpressionTree::Interpret(Interpreter& interpreter) const
     {
-        if (IsDiagnosticsStreamAvailable())
-        {
-            GetDiagnosticsStream() << "=== Pass0 ===" << std::endl;
-        }
+        LogThrowAssert(!m_topologicalSort.empty(), "Cannot interpret an empty tree");
 
-        // Emit RIP-relative constants.
-        for (unsigned i = 0 ; i < m_ripRelatives.size(); ++i)
+        interpreter.Reset(static_cast<unsigned>(m_topologicalSort.size()));
+
+        for (auto test : m_preconditionTests)
         {
-            m_ripRelatives[i]->EmitStaticData(*this);
+            if (!test->Interpret(interpreter))
+            {
+                return;
+            }
         }
 
-        // Walk the nodes in reverse order of creation (i.e. in potential order
-        // of execution) to see whether they can be optimized away.
-        //
-        // Note: currently it is not important whether the optimize-away pass
-        // traverses the nodes in order or in reverse order. This is because the
-        // only existing optimization technique (base pointer collapsing) is
-        // performed when node is constructed and removing references from
-        // children in such case will not create an opportunity for additional
-        // optimizations.
-        for (auto nodeIt = m_topologicalSort.rbegin();
-             nodeIt != m_topologicalSort.rend();
-             ++nodeIt)
+        auto & root = *m_topologicalSort.back();
+        root.InterpretCache(interpreter);
+        interpreter.SetResult(interpreter.GetValue(root.GetId()));
+    }
+
+
+    void const * ExpressionTree::GetUntypedEntryPoint() const
+    {
+        return m_compiledCode
+               ? m_compiledCode->GetEntryPoint()
+               : m_code.GetEntryPoint();
+    }
+
+
+    int32_t ExpressionTree::AllocateTemporary(unsigned unitCount, bool isAligned16)
+    {
+        LogThrowAssert(unitCount > 0 && unitCount < c_temporaryUnitContinued,
+                       "Invalid temporary size of %u units",
+                       unitCount);
+
+        // Expression tree asks for BaseRegisterType::SetRbpToOriginalRsp. That
+        // means that [rbp] holds return address, [rbp + 8] home for function's
+        // first argument etc, whereas [rbp - 8] holds the first temporary etc.
+        // The original RSP is 8 bytes off a 16-byte boundary because of the
+        // return address, so the offsets -8, -24 etc. are 16-byte aligned,
+        // i.e. those of the even units.
+        unsigned unit = unitCount - 1;
+
+        for (;; ++unit)
         {
-            auto node = *nodeIt;
+            if (isAligned16 && (unit & 1) != 0)
+            {
+                continue;
+            }
 
-            if (!node->IsReferenced())
+            bool isFree = true;
+
+            for (unsigned i = 0; i < unitCount && isFree; ++i)
             {
-                Print();
-                LogThrowAssert(node->IsReferenced(),
-                               "Node with ID %u has been created but not referenced by nodes in the tree",
-                               node->GetId());
+                isFree = unit - i >= m_temporaryUnits.size()
+                         || m_temporaryUnits[unit - i] == 0;
             }
 
-            // If there's a way for node's children to be evaluated without
-            // evaluating this node first (f. ex. collapsing of pointers to the
-            // same base object), release the references that will be unused.
-            // Otherwise, the lifetime of the Storage returned by this node's
-            // CodeGenValue() will be too long.
-            if (node->CanBeOptimizedAway())
+            if (isFree)
             {
-                node->ReleaseReferencesToChildren();
+                break;
             }
         }
+
+        if (unit >= m_temporaryUnits.size())
+        {
+            m_temporaryUnits.resize(unit + 1, 0);
+        }
+
+        for (unsigned i = 1; i < unitCount; ++i)
+        {
+            m_temporaryUnits[unit - i] = c_temporaryUnitContinued;
+        }
+
+        m_temporaryUnits[unit] = static_cast<uint8_t>(unitCount);
+
+        return -static_cast<int32_t>((unit + 1) * sizeof(void*));
     }
 
 
-    void ExpressionTree::Pass1()
+    void ExpressionTree::PruneUnusedNodes()
     {
         if (IsDiagnosticsStreamAvailable())
         {
-            GetDiagnosticsStream() << "=== Pass1 ===" << std::endl;
+            GetDiagnosticsStream() << "=== PruneUnusedNodes ===" << std::endl;
         }
 
-        // Reserve registers used to pass in parameters.
-        for (auto param : m_parameters)
+        // Walk the nodes in reverse order of creation (i.e. in potential order
+        // of execution), so that releasing the children of a node which is not
+        // used makes its exclusive children unused before they are visited.
+        //
+        // The nodes are unused if they were never referenced by the tree (f.
+        // ex. speculatively constructed subexpressions which were discarded),
+        // if their children are evaluated through some other means (f. ex.
+        // collapsing of pointers to the same base object) or if they lost
+        // their parents in Simplify(). Releasing the references is needed to
+        // avoid evaluating the children and to keep the lifetime of their
+        // Storages from being too long.
+        unsigned prunedCount = 0;
+
+        for (auto nodeIt = m_topologicalSort.rbegin();
+             nodeIt != m_topologicalSort.rend();
+             ++nodeIt)
         {
-            if (param->GetParentCount() > 0)
+            auto node = *nodeIt;
+
+            if (node->CanBeOptimizedAway() && !node->HaveChildrenBeenReleased())
             {
-                param->CodeGenCache(*this);
+                node->ReleaseChildren();
+                ++prunedCount;
             }
         }
 
-        // Execute any return-early tests before compiling the expression further.
-        for (auto test : m_preconditionTests)
+        if (IsDiagnosticsStreamAvailable())
         {
-            test->Evaluate(*this);
+            GetDiagnosticsStream() << "Pruned " << prunedCount << " unused nodes" << std::endl;
         }
     }
 
 
-    void ExpressionTree::Pass2()
+    void ExpressionTree::Simplify()
     {
         if (IsDiagnosticsStreamAvailable())
         {
-            GetDiagnosticsStream() << "=== Pass2 ===" << std::endl;
+            GetDiagnosticsStream() << "=== Simplify ===" << std::endl;
         }
 
-        for (unsigned i = 0 ; i < m_topologicalSort.size(); ++i)
+        auto countGeneratedNodes = [this]()
         {
-            NodeBase& node = *m_topologicalSort[i];
+            unsigned count = 0;
 
-            if (node.GetParentCount() > 1 && !node.HasBeenEvaluated())
+            for (auto node : m_topologicalSort)
             {
-                node.CodeGenCache(*this);
+                if (!node->CanBeOptimizedAway() && !node->IsReplaced())
+                {
+                    ++count;
+                }
             }
-        }
-    }
 
+            return count;
+        };
 
-    void ExpressionTree::Pass3()
-    {
-        if (IsDiagnosticsStreamAvailable())
+        const unsigned initialCount = countGeneratedNodes();
+
+        // Children are simplified before their parents, so that the constants
+        // propagate up the tree. The unused nodes are left alone.
+        for (auto node : m_topologicalSort)
         {
-            GetDiagnosticsStream() << "=== Pass3 ===" << std::endl;
+            if (!node->IsFolded() && !node->CanBeOptimizedAway())
+            {
+                node->Simplify();
+            }
         }
 
-        NodeBase& root = *m_topologicalSort.back();
-
-        // LogThrowAssert(Root node is return, "Root must be a return node.");
+        PruneUnusedNodes();
+        m_eliminatedNodeCount = initialCount - countGeneratedNodes();
 
-        root.CompileAsRoot(*this);
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "Eliminated " << m_eliminatedNodeCount << " nodes" << std::endl;
+        }
     }
 
 
-    void ExpressionTree::Print() const
+    void ExpressionTree::ComputeLiveRanges()
     {
-        if (!IsDiagnosticsStreamAvailable())
+        if (IsDiagnosticsStreamAvailable())
         {
-            return;
+            GetDiagnosticsStream() << "=== ComputeLiveRanges ===" << std::endl;
         }
 
-        std::ostream& out = GetDiagnosticsStream();
+        const unsigned nodeCount = static_cast<unsigned>(m_topologicalSort.size());
 
-        out << "Parameters:" << std::endl;
-        for (unsigned i = 0 ; i < m_parameters.size(); ++i)
-        {
-            m_parameters[i]->Print(out);
-            out << std::endl;
-        }
-        out << std::endl;
+        // The uses are first collected as (child, position) pairs and then
+        // bucketed by the child. The parents are visited in the topological
+        // order, so the positions end up sorted within each bucket.
+        AllocatorVector<NodeBase const *> children(m_stlAllocator);
+        AllocatorVector<unsigned> usedNodes(m_stlAllocator);
+        AllocatorVector<unsigned> positions(m_stlAllocator);
 
-        out << "Topological sort:" << std::endl;
-        for (unsigned i = 0 ; i < m_topologicalSort.size(); ++i)
+        for (unsigned position = 0; position < nodeCount; ++position)
+        {
+            NodeBase const & node = *m_topologicalSort[position];
+
+            // Folded and pruned nodes don't evaluate their children.
+            if (node.HaveChildrenBeenReleased())
+            {
+                continue;
+            }
+
+            children.clear();
+            node.GetChildren(children);
+
+            for (NodeBase const * child : children)
+            {
+                usedNodes.push_back(child->GetEvaluatedNode().GetId());
+                positions.push_back(position);
+            }
+        }
+
+        m_useStart.assign(nodeCount + 1, 0);
+
+        for (unsigned child : usedNodes)
+        {
+            ++m_useStart[child + 1];
+        }
+
+        for (unsigned i = 0; i < nodeCount; ++i)
+        {
+            m_useStart[i + 1] += m_useStart[i];
+        }
+
+        AllocatorVector<unsigned> nextSlot(m_useStart.begin(),
+                                           m_useStart.end() - 1,
+                                           m_stlAllocator);
+        m_usePositions.assign(usedNodes.size(), 0);
+
+        for (unsigned i = 0; i < usedNodes.size(); ++i)
+        {
+            m_usePositions[nextSlot[usedNodes[i]]++] = positions[i];
+        }
+
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "Recorded " << m_usePositions.size()
+                                   << " uses of " << nodeCount << " nodes" << std::endl;
+        }
+    }
+
+
+    unsigned ExpressionTree::GetNextUse(unsigned nodeId) const
+    {
+        if (nodeId == Data::c_unknownNode || nodeId + 1 >= m_useStart.size())
+        {
+            return m_currentNodeId;
+        }
+
+        const auto begin = m_usePositions.begin() + m_useStart[nodeId];
+        const auto end = m_usePositions.begin() + m_useStart[nodeId + 1];
+        const auto it = std::lower_bound(begin, end, m_currentNodeId);
+
+        return it != end ? *it : m_currentNodeId;
+    }
+
+
+    bool ExpressionTree::IsCurrentNodeLiveAcrossCall() const
+    {
+        if (m_registerAllocation != RegisterAllocation::NextUseSpilling
+            || m_currentNodeId + 1 >= m_useStart.size()
+            || m_useStart[m_currentNodeId] == m_useStart[m_currentNodeId + 1])
+        {
+            return false;
+        }
+
+        const unsigned lastUse = m_usePositions[m_useStart[m_currentNodeId + 1] - 1];
+        const auto call = std::upper_bound(m_callPositions.begin(),
+                                           m_callPositions.end(),
+                                           m_currentNodeId);
+
+        return call != m_callPositions.end() && *call < lastUse;
+    }
+
+
+    void ExpressionTree::ComputeEvaluationRegions()
+    {
+        const unsigned nodeCount = static_cast<unsigned>(m_topologicalSort.size());
+
+        m_nodeRegions.assign(nodeCount, 0);
+
+        if (m_conditionalRegions.empty())
+        {
+            return;
+        }
+
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "=== ComputeEvaluationRegions ===" << std::endl;
+        }
+
+        const unsigned c_unused = ~0u;
+        std::fill(m_nodeRegions.begin(), m_nodeRegions.end(), c_unused);
+
+        // Returns the innermost region which contains both regions.
+        auto getCommonRegion = [this](unsigned a, unsigned b)
+        {
+            auto getDepth = [this](unsigned region)
+            {
+                return region == 0 ? 0 : m_conditionalRegions[region - 1].m_depth;
+            };
+
+            auto getEnclosing = [this](unsigned region)
+            {
+                return m_conditionalRegions[region - 1].m_enclosingRegion;
+            };
+
+            while (a != b)
+            {
+                if (getDepth(a) >= getDepth(b))
+                {
+                    a = getEnclosing(a);
+                }
+                else
+                {
+                    b = getEnclosing(b);
+                }
+            }
+
+            return a;
+        };
+
+        AllocatorVector<NodeBase const *> children(m_stlAllocator);
+        AllocatorVector<bool> isClaimed(m_stlAllocator);
+
+        // The regions are added by the constructors of their parents, so the
+        // regions of each parent are adjacent and ordered the same way as
+        // the parents. Visiting the parents before their children makes the
+        // region of each parent final by the time its children are visited.
+        unsigned nextRegion = static_cast<unsigned>(m_conditionalRegions.size());
+
+        for (unsigned position = nodeCount; position-- > 0; )
+        {
+            NodeBase const & node = *m_topologicalSort[position];
+
+            // The nodes without parents within the tree, such as the root and
+            // the nodes used by the preconditions, are evaluated up front.
+            if (m_nodeRegions[position] == c_unused)
+            {
+                m_nodeRegions[position] = 0;
+            }
+
+            const unsigned region = m_nodeRegions[position];
+            const unsigned lastRegion = nextRegion;
+
+            while (nextRegion > 0
+                   && m_conditionalRegions[nextRegion - 1].m_parent->GetId() >= position)
+            {
+                --nextRegion;
+            }
+
+            if (node.HaveChildrenBeenReleased())
+            {
+                continue;
+            }
+
+            for (unsigned r = nextRegion; r < lastRegion; ++r)
+            {
+                ConditionalRegion& conditionalRegion = m_conditionalRegions[r];
+
+                LogThrowAssert(conditionalRegion.m_parent == &node,
+                               "Conditional regions of node %u have not been added in order",
+                               position);
+                conditionalRegion.m_enclosingRegion = region;
+                conditionalRegion.m_depth
+                    = (region == 0 ? 0 : m_conditionalRegions[region - 1].m_depth) + 1;
+            }
+
+            children.clear();
+            node.GetChildren(children);
+
+            // Each conditional region claims one occurrence of its child, the
+            // other occurrences are used in the region of the parent.
+            isClaimed.assign(lastRegion - nextRegion, false);
+
+            for (NodeBase const * childNode : children)
+            {
+                const unsigned child = childNode->GetEvaluatedNode().GetId();
+                unsigned childRegion = region;
+
+                for (unsigned r = nextRegion; r < lastRegion; ++r)
+                {
+                    if (!isClaimed[r - nextRegion]
+                        && m_conditionalRegions[r].m_child->GetEvaluatedNode().GetId() == child)
+                    {
+                        isClaimed[r - nextRegion] = true;
+                        childRegion = r + 1;
+                        break;
+                    }
+                }
+
+                m_nodeRegions[child] = m_nodeRegions[child] == c_unused
+                    ? childRegion
+                    : getCommonRegion(m_nodeRegions[child], childRegion);
+            }
+        }
+
+        if (IsDiagnosticsStreamAvailable())
+        {
+            const auto conditionalCount = std::count_if(m_nodeRegions.begin(),
+                                                        m_nodeRegions.end(),
+                                                        [](unsigned region) { return region != 0; });
+
+            GetDiagnosticsStream() << "Evaluating " << conditionalCount
+                                   << " nodes in " << m_conditionalRegions.size()
+                                   << " conditional regions" << std::endl;
+        }
+    }
+
+
+    bool ExpressionTree::IsWithinRegion(unsigned nodeRegion, unsigned region) const
+    {
+        while (nodeRegion != 0 && nodeRegion != region)
+        {
+            nodeRegion = m_conditionalRegions[nodeRegion - 1].m_enclosingRegion;
+        }
+
+        return nodeRegion == region;
+    }
+
+
+    unsigned ExpressionTree::GetEvaluationRegion(NodeBase const & node) const
+    {
+        const unsigned id = node.GetEvaluatedNode().GetId();
+
+        return id < m_nodeRegions.size() ? m_nodeRegions[id] : 0;
+    }
+
+
+    void ExpressionTree::ConvertIndirectToDirect(Data* data)
+    {
+        // Converting without modification makes all owners refer to the
+        // loaded value and reuses the base register for integer values.
+        if (data->HasFloatTarget())
+        {
+            Storage<double>(data).ConvertToDirect(false);
+        }
+        else
+        {
+            Storage<uint64_t>(data).ConvertToDirect(false);
+        }
+    }
+
+
+    void ExpressionTree::Pass0()
+    {
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "=== Pass0 ===" << std::endl;
+        }
+
+        // Emit RIP-relative constants.
+        for (unsigned i = 0 ; i < m_ripRelatives.size(); ++i)
+        {
+            m_ripRelatives[i]->EmitStaticData(*this);
+        }
+    }
+
+
+    void ExpressionTree::Pass1()
+    {
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "=== Pass1 ===" << std::endl;
+        }
+
+        // Reserve registers used to pass in parameters.
+        for (auto param : m_parameters)
+        {
+            if (param->GetParentCount() > 0)
+            {
+                param->CodeGenCache(*this);
+            }
+        }
+
+        if (m_instrumentationProfile != nullptr)
+        {
+            ProfileCounterEmitter counter(*this, true);
+            counter.EmitIncrement(m_instrumentationProfile->GetCallCounter());
+        }
+
+        // Execute any return-early tests before compiling the expression further.
+        m_isEvaluatingPreconditions = true;
+
+        for (auto test : m_preconditionTests)
+        {
+            test->Evaluate(*this);
+        }
+
+        m_isEvaluatingPreconditions = false;
+    }
+
+
+    void ExpressionTree::HoistLoads()
+    {
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "=== HoistLoads ===" << std::endl;
+        }
+
+        // The registers left for the evaluation of the rest of the tree.
+        const unsigned c_minFreeRegisters = 4;
+
+        // The function calls may modify the memory, so the loads that follow
+        // them in the topological order must not be issued before them.
+        const unsigned end = m_callPositions.empty()
+            ? static_cast<unsigned>(m_topologicalSort.size())
+            : m_callPositions.front();
+
+        for (unsigned i = 0 ; i < end; ++i)
+        {
+            if (m_rxxFreeList.GetFreeCount() <= c_minFreeRegisters
+                || m_xmmFreeList.GetFreeCount() <= c_minFreeRegisters)
+            {
+                break;
+            }
+
+            NodeBase& node = *m_topologicalSort[i];
+
+            // The loads in the conditional regions may depend on the
+            // conditions, f. ex. on a pointer not being null.
+            if (node.GetParentCount() > 0
+                && !node.HasBeenEvaluated()
+                && !node.IsFolded()
+                && GetEvaluationRegion(node) == 0
+                && node.PrepareForHoisting())
+            {
+                node.CodeGenCache(*this);
+            }
+        }
+    }
+
+
+    void ExpressionTree::Pass2()
+    {
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "=== Pass2 ===" << std::endl;
+        }
+
+        // The shared nodes in the conditional regions are evaluated by the
+        // parents of the regions.
+        CodeGenSharedNodes(0);
+    }
+
+
+    void ExpressionTree::Pass3()
+    {
+        if (IsDiagnosticsStreamAvailable())
+        {
+            GetDiagnosticsStream() << "=== Pass3 ===" << std::endl;
+        }
+
+        NodeBase& root = *m_topologicalSort.back();
+
+        // LogThrowAssert(Root node is return, "Root must be a return node.");
+
+        root.CompileAsRoot(*this);
+    }
+
+
+    void ExpressionTree::Print() const
+    {
+        if (!IsDiagnosticsStreamAvailable())
+        {
+            return;
+        }
+
+        std::ostream& out = GetDiagnosticsStream();
+
+        out << "Parameters:" << std::endl;
+        for (unsigned i = 0 ; i < m_parameters.size(); ++i)
+        {
+            m_parameters[i]->Print(out);
+            out << std::endl;
+        }
+        out << std::endl;
+
+        out << "Topological sort:" << std::endl;
+        for (unsigned i = 0 ; i < m_topologicalSort.size(); ++i)
         {
             m_topologicalSort[i]->Print(out);
             out << std::endl;
@@ -455,8 +1229,13 @@ namespace NativeJIT
                       << std::endl;
         }
 
-        out << "Temporaries used: " << m_temporaryCount << std::endl;
-        out << "Temporaries still in use: " << m_temporaryCount - m_temporaries.size() << std::endl;
+        out << "Temporary area bytes: " << GetTemporaryAreaSize() << std::endl;
+        out << "Temporary bytes still in use: "
+            << std::count_if(m_temporaryUnits.begin(),
+                             m_temporaryUnits.end(),
+                             [](uint8_t unit) { return unit != 0; })
+               * sizeof(void*)
+            << std::endl;
 
         out << std::endl;
     }
@@ -475,12 +1254,38 @@ namespace NativeJIT
           m_isFloat(base.c_isFloat),
           m_registerId(base.GetId()),
           m_offset(offset),
-          m_refCount(0)
+          m_refCount(0),
+          m_definingNode(c_unknownNode),
+          m_creationIndex(tree.m_dataCount++),
+          m_hasFloatTarget(false),
+          m_rematerializeFrom(StorageClass::Direct),
+          m_rematerializeImmediate(0),
+          m_rematerializeOffset(0)
     {
         NotifyDataRegisterChange(RegisterChangeType::Initialize);
     }
 
 
+    ExpressionTree::Data::Data(ExpressionTree& tree,
+                               ImmediateWord,
+                               size_t immediate)
+        : m_tree(tree),
+          m_storageClass(StorageClass::Immediate),
+          m_isFloat(false),
+          m_registerId(0),
+          m_offset(0),
+          m_immediate(immediate),
+          m_refCount(0),
+          m_definingNode(c_unknownNode),
+          m_creationIndex(tree.m_dataCount++),
+          m_hasFloatTarget(false),
+          m_rematerializeFrom(StorageClass::Direct),
+          m_rematerializeImmediate(0),
+          m_rematerializeOffset(0)
+    {
+    }
+
+
     ExpressionTree& ExpressionTree::Data::GetTree() const
     {
         return m_tree;
@@ -506,7 +1311,7 @@ namespace NativeJIT
     }
 
 
-    void ExpressionTree::Data::ConvertDirectToIndirect(int32_t offset)
+    void ExpressionTree::Data::ConvertDirectToIndirect(int32_t offset, bool isFloatTarget)
     {
         LogThrowAssert(m_storageClass == StorageClass::Direct,
                        "StorageClass must be Direct, found %u",
@@ -517,6 +1322,12 @@ namespace NativeJIT
 
         m_storageClass = StorageClass::Indirect;
         m_offset = offset;
+        m_hasFloatTarget = isFloatTarget;
+        ClearRematerialization();
+
+        // The data now holds a value computed after any existing JoinPoint,
+        // which can be freely moved around.
+        m_creationIndex = m_tree.m_dataCount++;
     }
 
 
@@ -531,6 +1342,90 @@ namespace NativeJIT
 
         m_storageClass = StorageClass::Direct;
         m_offset = 0;
+        m_hasFloatTarget = false;
+        ClearRematerialization();
+    }
+
+
+    bool ExpressionTree::Data::HasFloatTarget() const
+    {
+        return m_hasFloatTarget;
+    }
+
+
+    bool ExpressionTree::Data::PredatesJoinPoint() const
+    {
+        return m_creationIndex < m_tree.m_joinPointDataCount;
+    }
+
+
+    unsigned ExpressionTree::Data::GetDefiningNode() const
+    {
+        return m_definingNode;
+    }
+
+
+    void ExpressionTree::Data::SetDefiningNode(unsigned nodeId)
+    {
+        m_definingNode = nodeId;
+    }
+
+
+    void ExpressionTree::Data::RecordRematerialization()
+    {
+        if (m_storageClass == StorageClass::Immediate)
+        {
+            m_rematerializeFrom = StorageClass::Immediate;
+            m_rematerializeImmediate = m_immediate;
+        }
+        else if (m_storageClass == StorageClass::Indirect
+                 && PointerRegister(m_registerId).IsRIP())
+        {
+            // RIP-relative data is constant, so it can be loaded again.
+            m_rematerializeFrom = StorageClass::Indirect;
+            m_rematerializeOffset = m_offset;
+        }
+        else
+        {
+            ClearRematerialization();
+        }
+    }
+
+
+    void ExpressionTree::Data::ClearRematerialization()
+    {
+        m_rematerializeFrom = StorageClass::Direct;
+    }
+
+
+    bool ExpressionTree::Data::IsRematerializable() const
+    {
+        return m_storageClass == StorageClass::Direct
+            && m_rematerializeFrom != StorageClass::Direct;
+    }
+
+
+    ExpressionTree::Data* ExpressionTree::Data::Rematerialize() const
+    {
+        LogThrowAssert(IsRematerializable(),
+                       "Data in register %u cannot be rematerialized",
+                       m_registerId);
+
+        Data* data;
+
+        if (m_rematerializeFrom == StorageClass::Immediate)
+        {
+            // The constructor is private, so the data is constructed in place
+            // here rather than through PlacementConstruct().
+            void* memory = m_tree.m_allocator.Allocate(sizeof(Data));
+            data = new (memory) Data(m_tree, ImmediateWord(), m_rematerializeImmediate);
+        }
+        else
+        {
+            data = &m_tree.PlacementConstruct<Data>(m_tree, rip, m_rematerializeOffset);
+        }
+
+        return data;
     }
 
 
@@ -595,6 +1490,377 @@ namespace NativeJIT
     }
 
 
+    //*************************************************************************
+    //
+    // ExpressionTree::JoinPoint
+    //
+    //*************************************************************************
+    ExpressionTree::JoinPoint::JoinPoint(ExpressionTree& tree)
+        : m_tree(tree),
+          m_outerDataCount(tree.m_joinPointDataCount)
+    {
+        auto & rxxFreeList = m_tree.m_rxxFreeList;
+        auto & xmmFreeList = m_tree.m_xmmFreeList;
+
+        for (unsigned i = 0 ; i <= RegisterBase::c_maxIntegerRegisterID; ++i)
+        {
+            if (!rxxFreeList.IsAvailable(i)
+                && !m_tree.IsAnySharedBaseRegister(PointerRegister(i))
+                && rxxFreeList.GetData(i)->GetStorageClass() == StorageClass::Indirect)
+            {
+                m_tree.ConvertIndirectToDirect(rxxFreeList.GetData(i));
+            }
+        }
+
+        for (unsigned i = 0 ; i <= RegisterBase::c_maxIntegerRegisterID; ++i)
+        {
+            m_rxxData[i] = rxxFreeList.IsAvailable(i) ? nullptr : rxxFreeList.GetData(i);
+        }
+
+        for (unsigned i = 0 ; i <= RegisterBase::c_maxFloatRegisterID; ++i)
+        {
+            m_xmmData[i] = xmmFreeList.IsAvailable(i) ? nullptr : xmmFreeList.GetData(i);
+        }
+
+        m_tree.m_joinPointDataCount = m_tree.m_dataCount;
+    }
+
+
+    ExpressionTree::JoinPoint::~JoinPoint()
+    {
+        m_tree.m_joinPointDataCount = m_outerDataCount;
+    }
+
+
+    void ExpressionTree::JoinPoint::Restore()
+    {
+        for (unsigned i = 0 ; i <= RegisterBase::c_maxIntegerRegisterID; ++i)
+        {
+            if (m_rxxData[i] != nullptr
+                && m_rxxData[i]->GetRefCount() > 0
+                && m_rxxData[i]->PredatesJoinPoint())
+            {
+                m_tree.MoveToRegister<uint64_t>(m_rxxData[i], i);
+            }
+        }
+
+        for (unsigned i = 0 ; i <= RegisterBase::c_maxFloatRegisterID; ++i)
+        {
+            if (m_xmmData[i] != nullptr
+                && m_xmmData[i]->GetRefCount() > 0
+                && m_xmmData[i]->PredatesJoinPoint())
+            {
+                m_tree.MoveToRegister<double>(m_xmmData[i], i);
+            }
+        }
+    }
+
+
+    //*************************************************************************
+    //
+    // ExpressionTree::LoopHead
+    //
+    //*************************************************************************
+    ExpressionTree::LoopHead::LoopHead(ExpressionTree& tree)
+        : m_tree(tree),
+          m_joinPoint(tree),
+          m_outerLoop(tree.m_innermostLoop),
+          m_outerTemporaryUnits(tree.m_temporaryUnits),
+          m_deferredTemporaries(tree.m_stlAllocator)
+    {
+        auto & rxxFreeList = m_tree.m_rxxFreeList;
+        auto & xmmFreeList = m_tree.m_xmmFreeList;
+
+        for (unsigned i = 0 ; i <= RegisterBase::c_maxIntegerRegisterID; ++i)
+        {
+            if (!rxxFreeList.IsAvailable(i)
+                && !m_tree.IsAnySharedBaseRegister(PointerRegister(i)))
+            {
+                m_rxxValues[i] = Storage<uint64_t>(rxxFreeList.GetData(i));
+            }
+        }
+
+        for (unsigned i = 0 ; i <= RegisterBase::c_maxFloatRegisterID; ++i)
+        {
+            if (!xmmFreeList.IsAvailable(i))
+            {
+                m_xmmValues[i] = Storage<double>(xmmFreeList.GetData(i));
+            }
+        }
+
+        m_tree.m_innermostLoop = this;
+    }
+
+
+    ExpressionTree::LoopHead::~LoopHead()
+    {
+        // Releasing the values may release the temporaries the body spilled
+        // them to, which still needs to be deferred.
+        for (auto & value : m_rxxValues)
+        {
+            value.Reset();
+        }
+
+        for (auto & value : m_xmmValues)
+        {
+            value.Reset();
+        }
+
+        m_tree.m_innermostLoop = m_outerLoop;
+
+        for (int32_t offset : m_deferredTemporaries)
+        {
+            m_tree.ReleaseIfTemporary(offset);
+        }
+    }
+
+
+    void ExpressionTree::LoopHead::Restore()
+    {
+        m_joinPoint.Restore();
+    }
+
+
+    bool ExpressionTree::LoopHead::DefersRelease(unsigned unit, int32_t offset)
+    {
+        // The temporaries allocated before the loop are not released within
+        // it, so the unit cannot have been reused by another temporary.
+        if (unit < m_outerTemporaryUnits.size()
+            && m_outerTemporaryUnits[unit] != 0)
+        {
+            m_deferredTemporaries.push_back(offset);
+            return true;
+        }
+
+        return false;
+    }
+
+
+    //*************************************************************************
+    //
+    // ExpressionTree::RegionCopies
+    //
+    //*************************************************************************
+    ExpressionTree::RegionCopies::RegionCopies(ExpressionTree& tree,
+                                               unsigned region,
+                                               unsigned copyCount)
+        : m_tree(tree),
+          m_region(region),
+          m_copyCount(copyCount),
+          m_copy(0),
+          m_isInitiallyEvaluated(tree.m_topologicalSort.size(), false, tree.m_stlAllocator),
+          m_initialReferenceCounts(tree.m_topologicalSort.size(), 0, tree.m_stlAllocator)
+    {
+        LogThrowAssert(region > 0 && region <= tree.m_conditionalRegions.size(),
+                       "Invalid conditional region %u",
+                       region);
+        LogThrowAssert(copyCount > 0, "The region must be copied at least once");
+
+        // The nodes within the region may have been evaluated up front as
+        // well, f. ex. the parameters, and their values are shared by the
+        // copies like the values of the nodes outside of it.
+        for (unsigned i = 0 ; i < m_tree.m_topologicalSort.size(); ++i)
+        {
+            NodeBase& node = *m_tree.m_topologicalSort[i];
+
+            m_isInitiallyEvaluated[i] = node.HasBeenEvaluated();
+
+            if (node.IsCached())
+            {
+                const unsigned count = node.GetCacheReferenceCount();
+
+                m_initialReferenceCounts[i] = count;
+                node.AddCacheReferences(count * (m_copyCount - 1));
+            }
+        }
+    }
+
+
+    void ExpressionTree::RegionCopies::BeginNextCopy()
+    {
+        LogThrowAssert(m_copy + 1 < m_copyCount,
+                       "All %u copies of region %u have been generated",
+                       m_copyCount,
+                       m_region);
+        ++m_copy;
+
+        for (unsigned i = 0 ; i < m_tree.m_topologicalSort.size(); ++i)
+        {
+            NodeBase& node = *m_tree.m_topologicalSort[i];
+
+            if (node.HasBeenEvaluated()
+                && !m_isInitiallyEvaluated[i]
+                && m_tree.IsWithinRegion(m_tree.GetEvaluationRegion(node), m_region))
+            {
+                node.ResetEvaluation();
+            }
+        }
+    }
+
+
+    void ExpressionTree::RegionCopies::End()
+    {
+        LogThrowAssert(m_copy + 1 == m_copyCount,
+                       "Generated %u out of %u copies of region %u",
+                       m_copy + 1,
+                       m_copyCount,
+                       m_region);
+
+        for (unsigned i = 0 ; i < m_tree.m_topologicalSort.size(); ++i)
+        {
+            const unsigned initialCount = m_initialReferenceCounts[i];
+
+            if (initialCount == 0)
+            {
+                continue;
+            }
+
+            NodeBase& node = *m_tree.m_topologicalSort[i];
+            const unsigned addedCount = initialCount * (m_copyCount - 1);
+            const unsigned usedCount = initialCount
+                                       + addedCount
+                                       - node.GetCacheReferenceCount();
+
+            // Each copy uses the value the same number of times.
+            LogThrowAssert(usedCount % m_copyCount == 0,
+                           "Copies of region %u used node %u %u times in total",
+                           m_region,
+                           node.GetId(),
+                           usedCount);
+
+            node.ReleaseCacheReferences(addedCount - usedCount / m_copyCount * (m_copyCount - 1));
+        }
+    }
+
+
+    //*************************************************************************
+    //
+    // ExpressionTree::RegionEvaluation
+    //
+    //*************************************************************************
+    ExpressionTree::RegionEvaluation::RegionEvaluation(ExpressionTree& tree,
+                                                       unsigned region)
+        : m_tree(tree),
+          m_region(region),
+          m_outerEvaluation(tree.m_innermostRegionEvaluation),
+          m_isInitiallyEvaluated(tree.m_stlAllocator),
+          m_cacheUses(tree.m_stlAllocator)
+    {
+        LogThrowAssert(region > 0 && region <= tree.m_conditionalRegions.size(),
+                       "Invalid conditional region %u",
+                       region);
+
+        if (tree.m_isEvaluatingPreconditions)
+        {
+            m_isInitiallyEvaluated.resize(tree.m_topologicalSort.size());
+
+            for (unsigned i = 0 ; i < tree.m_topologicalSort.size(); ++i)
+            {
+                m_isInitiallyEvaluated[i] = tree.m_topologicalSort[i]->HasBeenEvaluated();
+            }
+
+            tree.m_innermostRegionEvaluation = this;
+        }
+
+        tree.CodeGenSharedNodes(region);
+    }
+
+
+    ExpressionTree::RegionEvaluation::~RegionEvaluation()
+    {
+        // End() has not been called if the code generation threw.
+        if (m_tree.m_innermostRegionEvaluation == this)
+        {
+            m_tree.m_innermostRegionEvaluation = m_outerEvaluation;
+        }
+    }
+
+
+    void ExpressionTree::RegionEvaluation::End()
+    {
+        if (m_isInitiallyEvaluated.empty())
+        {
+            return;
+        }
+
+        m_tree.m_innermostRegionEvaluation = m_outerEvaluation;
+
+        // The nodes outside of the region which were evaluated within it.
+        // Their children are outside of the region as well.
+        AllocatorVector<bool> isDiscarded(m_isInitiallyEvaluated.size(),
+                                          false,
+                                          m_tree.m_stlAllocator);
+        AllocatorVector<unsigned> usedCounts(m_isInitiallyEvaluated.size(),
+                                             0,
+                                             m_tree.m_stlAllocator);
+
+        for (unsigned i = 0 ; i < m_isInitiallyEvaluated.size(); ++i)
+        {
+            NodeBase const & node = *m_tree.m_topologicalSort[i];
+
+            isDiscarded[i] = !m_isInitiallyEvaluated[i]
+                && node.HasBeenEvaluated()
+                && !m_tree.IsWithinRegion(m_tree.GetEvaluationRegion(node), m_region);
+        }
+
+        // The uses by the discarded nodes are made again when the nodes are
+        // evaluated again, the others are kept for the enclosing region.
+        unsigned keptCount = 0;
+
+        for (unsigned i = 0 ; i < m_cacheUses.size(); ++i)
+        {
+            CacheUse& use = m_cacheUses[i];
+            const unsigned nodeId = use.m_node->GetId();
+            const bool isByDiscarded = use.m_parentId < isDiscarded.size()
+                && isDiscarded[use.m_parentId];
+
+            if (isDiscarded[nodeId])
+            {
+                if (!isByDiscarded)
+                {
+                    ++usedCounts[nodeId];
+                }
+            }
+            else if (isByDiscarded)
+            {
+                use.m_node->RestoreCacheReference(use.m_value);
+            }
+            else
+            {
+                if (keptCount != i)
+                {
+                    m_cacheUses[keptCount] = use;
+                }
+                ++keptCount;
+            }
+        }
+
+        m_cacheUses.resize(keptCount);
+
+        for (unsigned i = 0 ; i < isDiscarded.size(); ++i)
+        {
+            if (isDiscarded[i])
+            {
+                m_tree.m_topologicalSort[i]->DiscardEvaluation(usedCounts[i]);
+            }
+        }
+
+        if (m_outerEvaluation != nullptr)
+        {
+            m_outerEvaluation->m_cacheUses.insert(m_outerEvaluation->m_cacheUses.end(),
+                                                  m_cacheUses.begin(),
+                                                  m_cacheUses.end());
+        }
+
+        m_cacheUses.clear();
+    }
+
+
+    //*************************************************************************
+    //
+    // ReferenceCounter
+    //
+    //*************************************************************************
     ReferenceCounter::ReferenceCounter()
         : m_counter(nullptr)
     {
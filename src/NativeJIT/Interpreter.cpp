@@ -0,0 +1,208 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <algorithm>    // For std::fill.
+
+#include "NativeJIT/Interpreter.h"
+
+
+namespace NativeJIT
+{
+    //*************************************************************************
+    //
+    // Interpreter
+    //
+    //*************************************************************************
+    Interpreter::Interpreter()
+        : m_nodeCount(0),
+          m_result(0)
+    {
+        std::fill(m_parameters, m_parameters + c_maxParameterCount, 0);
+    }
+
+
+    void Interpreter::Reset(unsigned nodeCount)
+    {
+        // The storage only grows so that repeated evaluations don't allocate.
+        if (nodeCount > m_values.size())
+        {
+            m_values.resize(nodeCount);
+            m_variables.resize(nodeCount);
+            m_isEvaluated.resize(nodeCount);
+        }
+
+        m_nodeCount = nodeCount;
+        std::fill(m_isEvaluated.begin(), m_isEvaluated.begin() + nodeCount, 0);
+        m_result = 0;
+    }
+
+
+    uint64_t Interpreter::GetParameter(unsigned position) const
+    {
+        LogThrowAssert(position < c_maxParameterCount, "Invalid parameter position %u", position);
+
+        return m_parameters[position];
+    }
+
+
+    bool Interpreter::IsEvaluated(unsigned nodeId) const
+    {
+        LogThrowAssert(nodeId < m_nodeCount, "Invalid node ID %u", nodeId);
+
+        return m_isEvaluated[nodeId] != 0;
+    }
+
+
+    uint64_t Interpreter::GetValue(unsigned nodeId) const
+    {
+        LogThrowAssert(IsEvaluated(nodeId), "Node %u has not been evaluated", nodeId);
+
+        return m_values[nodeId];
+    }
+
+
+    void Interpreter::SetValue(unsigned nodeId, uint64_t value)
+    {
+        LogThrowAssert(nodeId < m_nodeCount, "Invalid node ID %u", nodeId);
+
+        m_values[nodeId] = value;
+        m_isEvaluated[nodeId] = 1;
+    }
+
+
+    uint64_t* Interpreter::GetVariable(unsigned nodeId)
+    {
+        LogThrowAssert(nodeId < m_nodeCount, "Invalid node ID %u", nodeId);
+
+        return &m_variables[nodeId];
+    }
+
+
+    uint64_t Interpreter::GetResult() const
+    {
+        return m_result;
+    }
+
+
+    void Interpreter::SetResult(uint64_t value)
+    {
+        m_result = value;
+    }
+
+
+    //*************************************************************************
+    //
+    // Interpretation
+    //
+    //*************************************************************************
+    namespace Interpretation
+    {
+        bool IsSupported(OpCode op, bool isFloat)
+        {
+            switch (op)
+            {
+            case OpCode::Add:
+            case OpCode::And:
+            case OpCode::IMul:
+            case OpCode::Or:
+            case OpCode::Sub:
+            case OpCode::Xor:
+                return true;
+
+            case OpCode::Rol:
+            case OpCode::Sar:
+            case OpCode::Shl:
+            case OpCode::Shr:
+                return !isFloat;
+
+            case OpCode::Div:
+            case OpCode::Max:
+            case OpCode::Min:
+                return isFloat;
+
+            default:
+                return false;
+            }
+        }
+
+
+        bool IsCommutative(OpCode op)
+        {
+            switch (op)
+            {
+            case OpCode::Add:
+            case OpCode::And:
+            case OpCode::IMul:
+            case OpCode::Or:
+            case OpCode::Xor:
+                return true;
+
+            default:
+                return false;
+            }
+        }
+
+
+        bool IsConditionMet(JccType jcc, Flags const & flags)
+        {
+            switch (jcc)
+            {
+            case JccType::JO:
+                return flags.m_overflow;
+            case JccType::JNO:
+                return !flags.m_overflow;
+            case JccType::JB:
+                return flags.m_carry;
+            case JccType::JAE:
+                return !flags.m_carry;
+            case JccType::JE:
+                return flags.m_zero;
+            case JccType::JNE:
+                return !flags.m_zero;
+            case JccType::JBE:
+                return flags.m_carry || flags.m_zero;
+            case JccType::JA:
+                return !flags.m_carry && !flags.m_zero;
+            case JccType::JS:
+                return flags.m_sign;
+            case JccType::JNS:
+                return !flags.m_sign;
+            case JccType::JP:
+                return flags.m_parity;
+            case JccType::JNP:
+                return !flags.m_parity;
+            case JccType::JL:
+                return flags.m_sign != flags.m_overflow;
+            case JccType::JGE:
+                return flags.m_sign == flags.m_overflow;
+            case JccType::JLE:
+                return flags.m_zero || flags.m_sign != flags.m_overflow;
+            case JccType::JG:
+                return !flags.m_zero && flags.m_sign == flags.m_overflow;
+            default:
+                LogThrowAbort("Unknown condition %s", X64CodeGenerator::JccName(jcc));
+                return false;
+            }
+        }
+    }
+}
@@ -25,6 +25,7 @@
 
 #include "NativeJIT/ExpressionTree.h"
 #include "NativeJIT/Nodes/Node.h"
+#include "NativeJIT/StructuralKey.h"
 #include "Temporary/Assert.h"
 
 
@@ -39,7 +40,12 @@ namespace NativeJIT
         : m_id(tree.AddNode(*this)),
           m_parentCount(0),
           m_isReferenced(false),
-          m_hasBeenEvaluated(false)
+          m_hasBeenEvaluated(false),
+          m_isConstant(false),
+          m_constantWord(0),
+          m_haveChildrenBeenReleased(false),
+          m_isFolded(false),
+          m_replacement(nullptr)
     {
     }
 
@@ -67,11 +73,15 @@ namespace NativeJIT
                        GetId());
 
         --m_parentCount;
+
+        if (m_replacement != nullptr)
+        {
+            m_replacement->DecrementParentCount();
+        }
+
         // Note: m_isReferenced is not affected by this, decrementing the parent
         // count is optimization-related call which doesn't change the
-        // fact that a node is referenced at least conceptually. This is because
-        // currently having a non-referenced node is considered to be an error,
-        // and not a chance for removing such nodes.
+        // fact that a node is referenced at least conceptually.
     }
 
 
@@ -87,6 +97,16 @@ namespace NativeJIT
     }
 
 
+    void NodeBase::ResetEvaluation()
+    {
+        LogThrowAssert(!IsCached(),
+                       "Cannot reset the evaluation of node %u which holds a cached value",
+                       GetId());
+
+        m_hasBeenEvaluated = false;
+    }
+
+
     bool NodeBase::IsReferenced() const
     {
         return m_isReferenced;
@@ -99,6 +119,97 @@ namespace NativeJIT
     }
 
 
+    bool NodeBase::IsConstant() const
+    {
+        return m_isConstant;
+    }
+
+
+    bool NodeBase::IsFolded() const
+    {
+        return m_isFolded;
+    }
+
+
+    bool NodeBase::IsReplaced() const
+    {
+        return m_replacement != nullptr;
+    }
+
+
+    NodeBase const & NodeBase::GetEvaluatedNode() const
+    {
+        NodeBase const * node = this;
+
+        while (node->m_replacement != nullptr)
+        {
+            node = node->m_replacement;
+        }
+
+        return *node;
+    }
+
+
+    void NodeBase::ReleaseChildren()
+    {
+        if (!m_haveChildrenBeenReleased)
+        {
+            m_haveChildrenBeenReleased = true;
+            ReleaseReferencesToChildren();
+        }
+    }
+
+
+    bool NodeBase::HaveChildrenBeenReleased() const
+    {
+        return m_haveChildrenBeenReleased;
+    }
+
+
+    uint64_t NodeBase::GetConstantWord() const
+    {
+        return m_constantWord;
+    }
+
+
+    void NodeBase::SetConstantWord(uint64_t value)
+    {
+        m_isConstant = true;
+        m_constantWord = value;
+    }
+
+
+    void NodeBase::Fold(NodeBase* replacement)
+    {
+        LogThrowAssert(!m_isFolded, "Node %u has already been folded", GetId());
+        LogThrowAssert(!HasBeenEvaluated(), "Cannot fold node %u after it was evaluated", GetId());
+
+        m_isFolded = true;
+
+        if (replacement != nullptr)
+        {
+            // The replacement takes over the references of node's parents.
+            // They are kept in m_parentCount as well so that parents which
+            // are optimized away later also release the replacement, see
+            // DecrementParentCount().
+            for (unsigned i = 0; i < m_parentCount; ++i)
+            {
+                replacement->IncrementParentCount();
+            }
+
+            m_replacement = replacement;
+        }
+
+        ReleaseChildren();
+    }
+
+
+    NodeBase* NodeBase::GetReplacementBase() const
+    {
+        return m_replacement;
+    }
+
+
     unsigned NodeBase::GetParentCount() const
     {
         return m_parentCount;
@@ -128,4 +239,38 @@ namespace NativeJIT
     {
         return false;
     }
+
+
+    void NodeBase::DescribeStructure(StructuralKeyBuilder& builder) const
+    {
+        builder.MarkInvalid();
+    }
+
+
+    void NodeBase::GetChildren(AllocatorVector<NodeBase const *>& /* children */) const
+    {
+    }
+
+
+    bool NodeBase::IsInterpretable() const
+    {
+        return false;
+    }
+
+
+    bool NodeBase::Simplify()
+    {
+        return false;
+    }
+
+
+    bool NodeBase::PrepareForHoisting()
+    {
+        return false;
+    }
+
+
+    void NodeBase::ResetHoisting()
+    {
+    }
 }
@@ -0,0 +1,185 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <utility>                  // For std::move().
+
+#include "NativeJIT/Nodes/Node.h"
+#include "NativeJIT/StructuralKey.h"
+
+
+namespace NativeJIT
+{
+    // Words which delimit the node descriptions. The values are arbitrary,
+    // they only need to be unlikely to appear as values.
+    static const uint64_t c_nodeStartTag = 0x5354525543544E31ull;
+    static const uint64_t c_nodeEndTag = 0x5354525543544E32ull;
+    static const uint64_t c_backReferenceTag = 0x5354525543544E33ull;
+
+
+    //*************************************************************************
+    //
+    // StructuralKey
+    //
+    //*************************************************************************
+    StructuralKey::StructuralKey(Allocators::IAllocator& allocator)
+        : m_words(Allocators::StlAllocator<uint64_t>(allocator)),
+          m_hash(0),
+          m_isValid(true)
+    {
+    }
+
+
+    bool StructuralKey::IsValid() const
+    {
+        return m_isValid;
+    }
+
+
+    size_t StructuralKey::GetHash() const
+    {
+        return m_hash;
+    }
+
+
+    size_t StructuralKey::GetByteSize() const
+    {
+        return m_words.size() * sizeof(uint64_t);
+    }
+
+
+    uint64_t const * StructuralKey::GetWords() const
+    {
+        return m_words.data();
+    }
+
+
+    size_t StructuralKey::GetWordCount() const
+    {
+        return m_words.size();
+    }
+
+
+    bool StructuralKey::operator==(StructuralKey const & other) const
+    {
+        // Invalid keys describe unknown structures, so they are not equal to
+        // any key, including themselves.
+        return m_isValid
+               && other.m_isValid
+               && m_hash == other.m_hash
+               && m_words == other.m_words;
+    }
+
+
+    bool StructuralKey::operator!=(StructuralKey const & other) const
+    {
+        return !(*this == other);
+    }
+
+
+    size_t StructuralKey::Hasher::operator()(StructuralKey const & key) const
+    {
+        return key.GetHash();
+    }
+
+
+    //*************************************************************************
+    //
+    // StructuralKeyBuilder
+    //
+    //*************************************************************************
+    const size_t StructuralKeyBuilder::c_initialWordCount;
+
+
+    StructuralKeyBuilder::StructuralKeyBuilder(Allocators::IAllocator& allocator)
+        : m_key(allocator),
+          m_visitOrder(Allocators::StlAllocator<unsigned>(allocator)),
+          m_visitedCount(0)
+    {
+    }
+
+
+    void StructuralKeyBuilder::AddNode(NodeBase const & node)
+    {
+        const unsigned id = node.GetId();
+
+        if (id >= m_visitOrder.size())
+        {
+            m_visitOrder.resize(id + 1, 0);
+        }
+
+        if (m_visitOrder[id] != 0)
+        {
+            AddWord(c_backReferenceTag);
+            AddWord(m_visitOrder[id] - 1);
+        }
+        else
+        {
+            m_visitOrder[id] = ++m_visitedCount;
+
+            AddWord(c_nodeStartTag);
+            AddType(typeid(node));
+            AddWord(node.GetParentCount());
+            node.DescribeStructure(*this);
+            AddWord(c_nodeEndTag);
+        }
+    }
+
+
+    void StructuralKeyBuilder::AddType(std::type_info const & type)
+    {
+        AddWord(reinterpret_cast<uint64_t>(&type));
+    }
+
+
+    void StructuralKeyBuilder::MarkInvalid()
+    {
+        m_key.m_isValid = false;
+    }
+
+
+    StructuralKey const & StructuralKeyBuilder::GetKey() const
+    {
+        return m_key;
+    }
+
+
+    StructuralKey StructuralKeyBuilder::TakeKey()
+    {
+        return std::move(m_key);
+    }
+
+
+    void StructuralKeyBuilder::AddWord(uint64_t word)
+    {
+        if (m_key.m_words.empty())
+        {
+            m_key.m_words.reserve(c_initialWordCount);
+        }
+
+        m_key.m_words.push_back(word);
+
+        // Combine the word into the hash using the 64-bit FNV-1a prime.
+        m_key.m_hash = (m_key.m_hash ^ static_cast<size_t>(word)) * 0x100000001b3ull
+                       + (m_key.m_hash >> 29);
+    }
+}
@@ -1420,6 +1420,269 @@ namespace NativeJIT
             ML64Verifier v(ml64Output.c_str(), start);
         }
 
+        TEST_F(CodeGen, ScaledIndexLea)
+        {
+            auto setup = GetSetup();
+            auto& buffer = setup->GetCode();
+
+            uint8_t const * start =  buffer.BufferStart() + buffer.CurrentPosition();
+
+            buffer.EmitScaledIndex<OpCode::Lea>(rax, rbx, rcx, 2, 0);
+            buffer.EmitScaledIndex<OpCode::Lea>(eax, rbx, rcx, 4, 0);
+            buffer.EmitScaledIndex<OpCode::Lea>(rdx, rsi, rsi, 8, 0);
+            buffer.EmitScaledIndex<OpCode::Lea>(r8, r9, r10, 4, 0);
+
+            // [RBP] and [R13] base ==> [base + disp8], RSP base is allowed.
+            buffer.EmitScaledIndex<OpCode::Lea>(rax, rbp, rcx, 1, 0);
+            buffer.EmitScaledIndex<OpCode::Lea>(rax, r13, r12, 2, 0);
+            buffer.EmitScaledIndex<OpCode::Lea>(rcx, rsp, rax, 8, 0x12);
+            buffer.EmitScaledIndex<OpCode::Lea>(ecx, rdx, rbx, 2, 0x1234);
+            buffer.EmitScaledIndex<OpCode::Lea>(r15d, rax, r15, 8, -4);
+
+            // Narrow destinations are written through their 32-bit alias.
+            buffer.EmitScaledIndex<OpCode::Lea>(ax, rbx, rcx, 2, 0);
+            buffer.EmitScaledIndex<OpCode::Lea>(dil, rsi, rdi, 4, 0);
+
+            std::string ml64Output =
+                " 00000000  48/ 8D 04 4B         lea rax, [rbx + rcx * 2]                                           \n"
+                " 00000004  8D 04 8B             lea eax, [rbx + rcx * 4]                                           \n"
+                " 00000007  48/ 8D 14 F6         lea rdx, [rsi + rsi * 8]                                           \n"
+                " 0000000B  4F/ 8D 04 91         lea r8, [r9 + r10 * 4]                                             \n"
+                " 0000000F  48/ 8D 44 0D 00      lea rax, [rbp + rcx * 1]                                           \n"
+                " 00000014  4B/ 8D 44 65 00      lea rax, [r13 + r12 * 2]                                           \n"
+                " 00000019  48/ 8D 4C C4 12      lea rcx, [rsp + rax * 8 + 12h]                                     \n"
+                " 0000001E  8D 8C 5A             lea ecx, [rdx + rbx * 2 + 1234h]                                   \n"
+                "           00001234                                                                                \n"
+                " 00000025  46/ 8D 7C F8 FC      lea r15d, [rax + r15 * 8 - 4h]                                     \n"
+                "                                                                                                   \n"
+                "                                ; narrow destinations use the 32-bit alias                         \n"
+                " 0000002A  8D 04 4B             lea eax, [rbx + rcx * 2]                                           \n"
+                " 0000002D  8D 3C BE             lea edi, [rsi + rdi * 4]                                           \n";
+
+            ML64Verifier v(ml64Output.c_str(), start);
+        }
+
+        TEST_F(CodeGen, FloatingPointArithmetic)
+        {
+            auto setup = GetSetup();
+            auto& buffer = setup->GetCode();
+
+            uint8_t const * start =  buffer.BufferStart() + buffer.CurrentPosition();
+
+            buffer.Emit<OpCode::Div>(xmm1s, xmm2s);
+            buffer.Emit<OpCode::Div>(xmm1, xmm2);
+            buffer.Emit<OpCode::Div>(xmm9, rcx, 0x20);
+            buffer.Emit<OpCode::Sqrt>(xmm0, xmm15);
+            buffer.Emit<OpCode::Sqrt>(xmm1s, xmm1s);
+            buffer.Emit<OpCode::Min>(xmm3s, xmm4s);
+            buffer.Emit<OpCode::Max>(xmm3, xmm4);
+            buffer.Emit<OpCode::And>(xmm1s, xmm2s);
+            buffer.Emit<OpCode::And>(xmm8, xmm1);
+            buffer.EmitImmediate<OpCode::Round>(xmm1, xmm2, static_cast<uint8_t>(9));
+            buffer.EmitImmediate<OpCode::Round>(xmm10s, xmm3s, static_cast<uint8_t>(0xa));
+
+            std::string ml64Output =
+                " 00000000  F3| 0F 5E CA         divss xmm1, xmm2                                                   \n"
+                " 00000004  F2| 0F 5E CA         divsd xmm1, xmm2                                                   \n"
+                " 00000008  F2| 44/ 0F 5E 49     divsd xmm9, qword ptr [rcx + 20h]                                  \n"
+                "           20                                                                                      \n"
+                " 0000000E  F2| 41/ 0F 51 C7     sqrtsd xmm0, xmm15                                                 \n"
+                " 00000013  F3| 0F 51 C9         sqrtss xmm1, xmm1                                                  \n"
+                " 00000017  F3| 0F 5D DC         minss xmm3, xmm4                                                   \n"
+                " 0000001B  F2| 0F 5F DC         maxsd xmm3, xmm4                                                   \n"
+                " 0000001F  0F 54 CA             andps xmm1, xmm2                                                   \n"
+                " 00000022  66| 44/ 0F 54 C1     andpd xmm8, xmm1                                                   \n"
+                " 00000027  66| 0F 3A 0B CA      roundsd xmm1, xmm2, 9                                              \n"
+                "           09                                                                                      \n"
+                " 0000002D  66| 44/ 0F 3A 0A     roundss xmm10, xmm3, 0Ah                                           \n"
+                "           D3 0A                                                                                   \n";
+
+            ML64Verifier v(ml64Output.c_str(), start);
+        }
+
+
+        TEST_F(CodeGen, MulDiv)
+        {
+            auto setup = GetSetup();
+            auto& buffer = setup->GetCode();
+
+            uint8_t const * start =  buffer.BufferStart() + buffer.CurrentPosition();
+
+            // The single operand forms implicitly use rdx:rax.
+            buffer.Emit<OpCode::Div>(rcx);
+            buffer.Emit<OpCode::Div>(ecx);
+            buffer.Emit<OpCode::Div>(cx);
+            buffer.Emit<OpCode::IDiv>(r9);
+            buffer.Emit<OpCode::IDiv>(ebx);
+            buffer.Emit<OpCode::Mul>(rbx);
+            buffer.Emit<OpCode::Mul>(r10d);
+            buffer.Emit<OpCode::IMul>(rcx);
+            buffer.Emit<OpCode::IMul>(esi);
+
+            buffer.Emit<OpCode::Cqo>(ax);
+            buffer.Emit<OpCode::Cqo>(eax);
+            buffer.Emit<OpCode::Cqo>(rax);
+
+            buffer.Emit<OpCode::Sar>(rax);
+            buffer.EmitImmediate<OpCode::Sar>(r12d, static_cast<uint8_t>(5));
+
+            std::string ml64Output =
+                " 00000000  48/ F7 F1            div rcx                                                            \n"
+                " 00000003  F7 F1                div ecx                                                            \n"
+                " 00000005  66| F7 F1            div cx                                                             \n"
+                " 00000008  49/ F7 F9            idiv r9                                                            \n"
+                " 0000000B  F7 FB                idiv ebx                                                           \n"
+                " 0000000D  48/ F7 E3            mul rbx                                                            \n"
+                " 00000010  41/ F7 E2            mul r10d                                                           \n"
+                " 00000013  48/ F7 E9            imul rcx                                                           \n"
+                " 00000016  F7 EE                imul esi                                                           \n"
+                " 00000018  66| 99               cwd                                                                \n"
+                " 0000001A  99                   cdq                                                                \n"
+                " 0000001B  48/ 99               cqo                                                                \n"
+                " 0000001D  48/ D3 F8            sar rax, cl                                                        \n"
+                " 00000020  41/ C1 FC 05         sar r12d, 5                                                        \n";
+
+            ML64Verifier v(ml64Output.c_str(), start);
+        }
+
+
+        TEST_F(CodeGen, ConditionalMoveAndSet)
+        {
+            auto setup = GetSetup();
+            auto& buffer = setup->GetCode();
+
+            uint8_t const * start =  buffer.BufferStart() + buffer.CurrentPosition();
+
+            buffer.EmitConditionalMove<JccType::JG>(rax, rcx);
+            buffer.EmitConditionalMove<JccType::JB>(r9d, eax);
+            buffer.EmitConditionalMove<JccType::JNE>(cx, dx);
+            buffer.EmitConditionalMove<JccType::JL>(eax, rcx, 0x10);
+            buffer.EmitConditionalMove<JccType::JAE>(r8, rbp, -8);
+            buffer.EmitConditionalMove<JccType::JG>(r12w, r13, 0);
+
+            // sil requires an empty REX prefix to not be encoded as dh.
+            buffer.EmitConditionalSet<JccType::JE>(al);
+            buffer.EmitConditionalSet<JccType::JNE>(sil);
+            buffer.EmitConditionalSet<JccType::JL>(r10b);
+
+            // Used to turn the result of setcc into a mask.
+            buffer.Emit<OpCode::Neg>(rax);
+            buffer.Emit<OpCode::Neg>(r11d);
+            buffer.Emit<OpCode::Xor>(xmm1s, xmm2s);
+            buffer.Emit<OpCode::Xor>(xmm8, xmm1);
+
+            std::string ml64Output =
+                " 00000000  48/ 0F 4F C1         cmovg rax, rcx                                                     \n"
+                " 00000004  44/ 0F 42 C8         cmovb r9d, eax                                                     \n"
+                " 00000008  66| 0F 45 CA         cmovne cx, dx                                                      \n"
+                " 0000000C  0F 4C 41 10          cmovl eax, dword ptr [rcx + 10h]                                   \n"
+                " 00000010  4C/ 0F 43 45 F8      cmovae r8, qword ptr [rbp - 8h]                                    \n"
+                " 00000015  66| 45/ 0F 4F 65 00  cmovg r12w, word ptr [r13]                                         \n"
+                " 0000001B  0F 94 C0             sete al                                                            \n"
+                " 0000001E  40/ 0F 95 C6         setne sil                                                          \n"
+                " 00000022  41/ 0F 9C C2         setl r10b                                                          \n"
+                " 00000026  48/ F7 D8            neg rax                                                            \n"
+                " 00000029  41/ F7 DB            neg r11d                                                           \n"
+                " 0000002C  0F 57 CA             xorps xmm1, xmm2                                                   \n"
+                " 0000002F  66| 44/ 0F 57 C1     xorpd xmm8, xmm1                                                   \n";
+
+            ML64Verifier v(ml64Output.c_str(), start);
+        }
+
+        TEST_F(CodeGen, IndirectJump)
+        {
+            auto setup = GetSetup();
+            auto& buffer = setup->GetCode();
+
+            uint8_t const * start =  buffer.BufferStart() + buffer.CurrentPosition();
+
+            buffer.Jmp(rax);
+            buffer.Jmp(rsp);
+            buffer.Jmp(r9);
+            buffer.Jmp(r15);
+
+            // Loads a jump table entry.
+            buffer.Emit<OpCode::MovSX, 8, false, 4, false>(rcx, rax, -4);
+            buffer.Emit<OpCode::MovSX, 8, false, 4, false>(r10, r13, 0);
+
+            std::string ml64Output =
+                " 00000000  FF E0                jmp rax                                                            \n"
+                " 00000002  FF E4                jmp rsp                                                            \n"
+                " 00000004  41/ FF E1            jmp r9                                                             \n"
+                " 00000007  41/ FF E7            jmp r15                                                            \n"
+                " 0000000A  48/ 63 48 FC         movsxd rcx, dword ptr [rax - 4h]                                   \n"
+                " 0000000E  4D/ 63 55 00         movsxd r10, dword ptr [r13]                                        \n";
+
+            ML64Verifier v(ml64Output.c_str(), start);
+        }
+
+        TEST_F(CodeGen, BitManipulation)
+        {
+            auto setup = GetSetup();
+            auto& buffer = setup->GetCode();
+
+            uint8_t const * start =  buffer.BufferStart() + buffer.CurrentPosition();
+
+            buffer.Emit<OpCode::PopCnt>(ax, bx);
+            buffer.Emit<OpCode::PopCnt>(r9d, eax);
+            buffer.Emit<OpCode::PopCnt>(rax, r15);
+            buffer.Emit<OpCode::PopCnt>(rax, r12, 0x12);
+            buffer.Emit<OpCode::PopCnt>(ecx, rbp, -8);
+
+            buffer.Emit<OpCode::LZCnt>(r15, rdx);
+            buffer.Emit<OpCode::LZCnt>(si, r10w);
+            buffer.Emit<OpCode::LZCnt>(eax, rsp, 0x1234);
+
+            buffer.Emit<OpCode::TZCnt>(ecx, r8d);
+            buffer.Emit<OpCode::TZCnt>(rdi, r13, 0);
+
+            buffer.Emit<OpCode::BSwap>(eax);
+            buffer.Emit<OpCode::BSwap>(r12);
+            buffer.Emit<OpCode::BSwap>(rdi);
+            buffer.Emit<OpCode::BSwap>(r8d);
+
+            buffer.EmitVex<OpCode::AndN>(rax, rbx, rcx);
+            buffer.EmitVex<OpCode::AndN>(r9d, r10d, r11d);
+
+            buffer.EmitVex<OpCode::Bzhi>(rax, rbx, rcx);
+            buffer.EmitVex<OpCode::Bzhi>(r11d, r12d, r13d);
+            buffer.EmitVex<OpCode::Bzhi>(eax, ecx, r14d);
+
+            buffer.EmitVex<OpCode::Pdep>(ecx, edx, esi);
+            buffer.EmitVex<OpCode::Pdep>(r15, rax, r13);
+
+            buffer.EmitVex<OpCode::Pext>(rax, rbx, rcx);
+            buffer.EmitVex<OpCode::Pext>(r8, r9, r10);
+
+            std::string ml64Output =
+                " 00000000  66| F3/ 0F B8 C3     popcnt ax, bx                                                      \n"
+                " 00000005  F3/ 44/ 0F B8 C8     popcnt r9d, eax                                                    \n"
+                " 0000000A  F3/ 49/ 0F B8 C7     popcnt rax, r15                                                    \n"
+                " 0000000F  F3/ 49/ 0F B8 44 24 12 popcnt rax, qword ptr [r12 + 12h]                                \n"
+                " 00000016  F3/ 0F B8 4D F8      popcnt ecx, dword ptr [rbp - 8h]                                   \n"
+                " 0000001B  F3/ 4C/ 0F BD FA     lzcnt r15, rdx                                                     \n"
+                " 00000020  66| F3/ 41/ 0F BD F2 lzcnt si, r10w                                                     \n"
+                " 00000026  F3/ 0F BD 84 24      lzcnt eax, dword ptr [rsp + 1234h]                                 \n"
+                "           00001234                                                                                \n"
+                " 0000002F  F3/ 41/ 0F BC C8     tzcnt ecx, r8d                                                     \n"
+                " 00000034  F3/ 49/ 0F BC 7D 00  tzcnt rdi, qword ptr [r13]                                         \n"
+                " 0000003A  0F C8                bswap eax                                                          \n"
+                " 0000003C  49/ 0F CC            bswap r12                                                          \n"
+                " 0000003F  48/ 0F CF            bswap rdi                                                          \n"
+                " 00000042  41/ 0F C8            bswap r8d                                                          \n"
+                " 00000045  C4 E2 E0 F2 C1       andn rax, rbx, rcx                                                 \n"
+                " 0000004A  C4 42 28 F2 CB       andn r9d, r10d, r11d                                               \n"
+                " 0000004F  C4 E2 F0 F5 C3       bzhi rax, rbx, rcx                                                 \n"
+                " 00000054  C4 42 10 F5 DC       bzhi r11d, r12d, r13d                                              \n"
+                " 00000059  C4 E2 08 F5 C1       bzhi eax, ecx, r14d                                                \n"
+                " 0000005E  C4 E2 6B F5 CE       pdep ecx, edx, esi                                                 \n"
+                " 00000063  C4 42 FB F5 FD       pdep r15, rax, r13                                                 \n"
+                " 00000068  C4 E2 E2 F5 C1       pext rax, rbx, rcx                                                 \n"
+                " 0000006D  C4 42 B2 F5 C2       pext r8, r9, r10                                                   \n";
+
+            ML64Verifier v(ml64Output.c_str(), start);
+        }
+
         TEST_CASES_END
     }
 }
@@ -0,0 +1,210 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <vector>
+
+#include "NativeJIT/CodeGen/CodeHeap.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionSpecification.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace CodeHeapUnitTest
+    {
+        TEST(CodeHeap, GrowsOnDemand)
+        {
+            CodeHeap heap(4096);
+
+            ASSERT_EQ(0u, heap.GetSegmentCount());
+
+            std::vector<void*> blocks;
+            for (unsigned i = 0; i < 10; ++i)
+            {
+                void* block = heap.Allocate(1000);
+                ASSERT_TRUE(block != nullptr);
+                ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(block) % CodeHeap::c_blockAlignment);
+                blocks.push_back(block);
+            }
+
+            // Each 1000 byte block plus header rounds up to 1024 bytes, so
+            // four of them fit into a 4096 byte segment.
+            ASSERT_EQ(3u, heap.GetSegmentCount());
+            ASSERT_EQ(10u * 1024, heap.GetBytesInUse());
+
+            for (auto block : blocks)
+            {
+                heap.Deallocate(block);
+            }
+
+            ASSERT_EQ(0u, heap.GetBytesInUse());
+        }
+
+
+        TEST(CodeHeap, ReusesFreedBlocks)
+        {
+            CodeHeap heap(4096);
+
+            void* first = heap.Allocate(200);
+            void* second = heap.Allocate(200);
+            ASSERT_NE(first, second);
+
+            heap.Deallocate(first);
+
+            // A block from the same size class is recycled.
+            void* third = heap.Allocate(180);
+            ASSERT_EQ(first, third);
+
+            // Repeated allocate/free cycles do not grow the heap.
+            for (unsigned i = 0; i < 1000; ++i)
+            {
+                heap.Deallocate(heap.Allocate(3000));
+            }
+
+            ASSERT_EQ(2u, heap.GetSegmentCount());
+            ASSERT_EQ(2u * 4096, heap.GetBytesReserved());
+        }
+
+
+        TEST(CodeHeap, DedicatedSegments)
+        {
+            CodeHeap heap(4096);
+
+            void* large = heap.Allocate(10000);
+            ASSERT_EQ(1u, heap.GetSegmentCount());
+            ASSERT_GE(heap.GetBytesReserved(), 10000u);
+
+            heap.Deallocate(large);
+            ASSERT_EQ(0u, heap.GetSegmentCount());
+            ASSERT_EQ(0u, heap.GetBytesReserved());
+        }
+
+
+        TEST(CodeHeap, MaxReservedSize)
+        {
+            CodeHeap heap(4096, 8192);
+
+            heap.Allocate(4000);
+            heap.Allocate(4000);
+
+            bool exceptionCaught = false;
+
+            try
+            {
+                heap.Allocate(4000);
+            }
+            catch (std::exception const &)
+            {
+                exceptionCaught = true;
+            }
+
+            ASSERT_TRUE(exceptionCaught);
+
+            heap.Reset();
+            ASSERT_EQ(1u, heap.GetSegmentCount());
+            ASSERT_EQ(0u, heap.GetBytesInUse());
+            heap.Allocate(4000);
+        }
+
+
+        TEST(CodeHeap, RoundsSegmentSizeToPowerOfTwo)
+        {
+            CodeHeap heap(5000);
+
+            heap.Allocate(100);
+            ASSERT_EQ(1u, heap.GetSegmentCount());
+
+            // The segment is rounded up to the next power of two rather than
+            // rejected.
+            const size_t reserved = heap.GetBytesReserved();
+            ASSERT_GE(reserved, 5000u);
+            ASSERT_EQ(0u, reserved & (reserved - 1));
+        }
+
+
+        TEST(CodeHeap, HugePages)
+        {
+            CodeHeap heap(4096,
+                          (std::numeric_limits<size_t>::max)(),
+                          CodeHeap::PageType::Huge);
+
+            // Segments are rounded up to the huge page size and are huge
+            // page aligned regardless of whether the explicit huge page pool
+            // is available.
+            void* first = heap.Allocate(100);
+            ASSERT_EQ(1u, heap.GetSegmentCount());
+            ASSERT_EQ(CodeHeap::c_hugePageSize, heap.GetBytesReserved());
+            ASSERT_EQ(0u, (reinterpret_cast<uintptr_t>(first) - 16) % CodeHeap::c_hugePageSize);
+
+            // Small blocks are packed densely into the same huge page.
+            void* second = heap.Allocate(100);
+            ASSERT_EQ(128, static_cast<char*>(second) - static_cast<char*>(first));
+            ASSERT_EQ(1u, heap.GetSegmentCount());
+        }
+
+
+        // Compiles a function returning the specified value into a
+        // FunctionBuffer allocated from the heap.
+        void GenerateReturnValue(FunctionBuffer& code, Allocator& allocator, int32_t value)
+        {
+            FunctionSpecification spec(allocator,
+                                       -1,
+                                       0,
+                                       0,
+                                       0,
+                                       FunctionSpecification::BaseRegisterType::Unused,
+                                       nullptr);
+
+            code.BeginFunctionBodyGeneration(spec);
+            code.EmitImmediate<OpCode::Mov>(eax, value);
+            code.EndFunctionBodyGeneration(spec);
+        }
+
+
+        TEST(CodeHeap, RetireAndRecompileFunctions)
+        {
+            CodeHeap heap(16384);
+            Allocator allocator(8192);
+
+            typedef int32_t (*ReturnFunction)();
+
+            for (int32_t i = 0; i < 100; ++i)
+            {
+                FunctionBuffer code(heap, 1024);
+                allocator.Reset();
+
+                GenerateReturnValue(code, allocator, i);
+                auto function = reinterpret_cast<ReturnFunction>(
+                                    const_cast<void*>(code.GetEntryPoint()));
+
+                ASSERT_EQ(i, function());
+            }
+
+            // Every retired FunctionBuffer returned its block to the heap.
+            ASSERT_EQ(1u, heap.GetSegmentCount());
+            ASSERT_EQ(0u, heap.GetBytesInUse());
+        }
+    }
+}
@@ -0,0 +1,110 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionSpecification.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace ExecutionBufferUnitTest
+    {
+        // Compiles a function returning the specified value.
+        void GenerateReturnValue(FunctionBuffer& code, Allocator& allocator, int32_t value)
+        {
+            FunctionSpecification spec(allocator,
+                                       -1,
+                                       0,
+                                       0,
+                                       0,
+                                       FunctionSpecification::BaseRegisterType::Unused,
+                                       nullptr);
+
+            code.BeginFunctionBodyGeneration(spec);
+            code.EmitImmediate<OpCode::Mov>(eax, value);
+            code.EndFunctionBodyGeneration(spec);
+        }
+
+
+        TEST(ExecutionBuffer, SingleMapping)
+        {
+            ExecutionBuffer buffer(4096);
+            Allocator allocator(4096);
+            FunctionBuffer code(buffer, 1024);
+
+            ASSERT_EQ(0, buffer.GetExecutableAliasOffset(code.BufferStart()));
+            ASSERT_EQ(code.BufferStart(), code.ExecutableBufferStart());
+
+            GenerateReturnValue(code, allocator, 1234);
+            auto function = reinterpret_cast<int32_t (*)()>(
+                                const_cast<void*>(code.GetEntryPoint()));
+
+            ASSERT_EQ(1234, function());
+        }
+
+
+#ifdef __linux__
+        TEST(ExecutionBuffer, DualMapping)
+        {
+            ExecutionBuffer buffer(8192, ExecutionBuffer::MappingType::DualReadWriteAndReadExecute);
+            Allocator allocator(4096);
+
+            FunctionBuffer first(buffer, 1024);
+            FunctionBuffer second(buffer, 1024);
+
+            // The code is written through one view and executed through
+            // the other one.
+            ASSERT_NE(first.BufferStart(), first.ExecutableBufferStart());
+            ASSERT_EQ(first.ExecutableBufferStart() - first.BufferStart(),
+                      second.ExecutableBufferStart() - second.BufferStart());
+
+            GenerateReturnValue(first, allocator, 1);
+            allocator.Reset();
+            GenerateReturnValue(second, allocator, 2);
+
+            auto firstFunction = reinterpret_cast<int32_t (*)()>(
+                                     const_cast<void*>(first.GetEntryPoint()));
+            auto secondFunction = reinterpret_cast<int32_t (*)()>(
+                                      const_cast<void*>(second.GetEntryPoint()));
+
+            ASSERT_EQ(first.ExecutableBufferStart() + first.GetFunctionCodeStartOffset(),
+                      first.GetEntryPoint());
+            ASSERT_EQ(1, firstFunction());
+            ASSERT_EQ(2, secondFunction());
+
+            // Code written after the executable view was used becomes
+            // visible through it without any remapping.
+            first.Reset();
+            allocator.Reset();
+            GenerateReturnValue(first, allocator, 3);
+
+            firstFunction = reinterpret_cast<int32_t (*)()>(
+                                const_cast<void*>(first.GetEntryPoint()));
+            ASSERT_EQ(3, firstFunction());
+        }
+#endif
+    }
+}
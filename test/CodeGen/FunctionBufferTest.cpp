@@ -382,6 +382,63 @@ namespace NativeJIT
         }
 
 
+        TEST_F(FunctionBufferTest, StackProbe)
+        {
+            auto setup = GetSetup();
+            auto & code = setup->GetCode();
+
+            // A function that allocates 1000 stack slots, more than a page.
+            FunctionSpecification spec(setup->GetAllocator(), -1, 1000, 0, 0, FunctionSpecification::BaseRegisterType::Unused, GetDiagnosticsStream());
+            ASSERT_NO_FATAL_FAILURE(ValidateUnwindInfo(spec));
+
+            // 1001 quadword slots for the alignment.
+            ASSERT_EQ(8008, spec.GetOffsetToOriginalRsp());
+
+            // Verify prolog: the stack is probed a page at a time before RSP
+            // is adjusted.
+            std::vector<uint8_t> offsets;
+
+            code.Reset();
+            EmitAndRecordOffset(code,
+                                [](FunctionBuffer& f)
+                                {
+                                    Label loop = f.AllocateLabel();
+
+                                    f.Emit<OpCode::Mov>(r11, rsp);
+                                    f.EmitImmediate<OpCode::Mov>(eax, 1);
+                                    f.PlaceLabel(loop);
+                                    f.EmitImmediate<OpCode::Sub>(r11, 4096);
+                                    f.Emit<OpCode::Cmp>(r11, r11, 0);
+                                    f.EmitImmediate<OpCode::Sub>(eax, 1);
+                                    f.EmitConditionalJump<JccType::JNZ>(loop);
+                                    f.PatchCallSites();
+
+                                    f.EmitImmediate<OpCode::Sub>(rsp, 8008);
+                                },
+                                offsets);
+
+            ASSERT_NO_FATAL_FAILURE(VerifyProlog(spec, code));
+
+            // Verify unwind info.
+            auto & unwindInfo = *reinterpret_cast<UnwindInfo const *>(spec.GetUnwindInfoBuffer());
+            auto unwindCodes = &unwindInfo.m_firstUnwindCode;
+
+            ASSERT_EQ(2, unwindInfo.m_countOfCodes);
+            ASSERT_EQ_UNWIND_CODE2(UnwindCode(offsets.at(0), UnwindCodeOp::UWOP_ALLOC_LARGE, 0),
+                                 UnwindCode(1001),
+                                 unwindCodes[0],
+                                 unwindCodes[1]);
+
+            // Verify epilog.
+            code.Reset();
+
+            code.EmitImmediate<OpCode::Add>(rsp, 8008);
+            code.Emit<OpCode::Ret>();
+
+            VerifyEpilog(spec, code);
+        }
+
+
         TEST_F(FunctionBufferTest, RbpSetToOldRsp)
         {
             auto setup = GetSetup();
@@ -0,0 +1,130 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <stdexcept>
+#include <vector>
+
+#include "NativeJIT/BatchCompiler.h"
+#include "NativeJIT/CompileContextPool.h"
+#include "NativeJIT/Function.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace BatchCompilerUnitTest
+    {
+        const unsigned c_allocatorCapacity = 8192;
+        const unsigned c_codeCapacity = 4096;
+
+        typedef int64_t (*TestFunction)(int64_t);
+
+
+        // Returns a builder for p1 * factor + 1.
+        BatchCompiler::Builder MakeBuilder(int64_t factor)
+        {
+            return [factor](Allocators::IAllocator& allocator, FunctionBuffer& code)
+            {
+                Function<int64_t, int64_t> expression(allocator, code);
+                auto & product = expression.Mul(expression.GetP1(),
+                                                expression.Immediate(factor));
+                expression.Compile(expression.Add(product,
+                                                  expression.Immediate<int64_t>(1)));
+            };
+        }
+
+
+        TEST(BatchCompiler, CompilesAllFunctions)
+        {
+            const unsigned functionCount = 500;
+
+            CompileContextPool pool(0, c_allocatorCapacity, c_codeCapacity);
+
+            // Small sub-arenas force the workers to refill them concurrently.
+            BatchCompiler compiler(pool, 4, 1024);
+
+            std::vector<BatchCompiler::Builder> builders;
+            for (unsigned i = 0; i < functionCount; ++i)
+            {
+                builders.push_back(MakeBuilder(i));
+            }
+
+            auto batch = compiler.Compile(builders);
+            ASSERT_EQ(functionCount, batch->GetFunctionCount());
+            EXPECT_GT(batch->GetBytesReserved(), 0u);
+
+            for (unsigned i = 0; i < functionCount; ++i)
+            {
+                auto function = batch->GetEntryPoint<TestFunction>(i);
+                EXPECT_EQ(static_cast<int64_t>(i) * 3 + 1, function(3));
+            }
+
+            // The functions don't depend on the contexts, which are back in
+            // the pool and can be reused.
+            EXPECT_EQ(pool.GetContextCount(), pool.GetAvailableContextCount());
+            auto secondBatch = compiler.Compile({ MakeBuilder(7) });
+            EXPECT_EQ(22, secondBatch->GetEntryPoint<TestFunction>(0)(3));
+            EXPECT_EQ(4, batch->GetEntryPoint<TestFunction>(1)(3));
+        }
+
+
+        TEST(BatchCompiler, PropagatesExceptions)
+        {
+            CompileContextPool pool(2, c_allocatorCapacity, c_codeCapacity);
+            BatchCompiler compiler(pool, 2);
+
+            std::vector<BatchCompiler::Builder> builders;
+            for (unsigned i = 0; i < 20; ++i)
+            {
+                builders.push_back(MakeBuilder(i));
+            }
+
+            builders[7] = [](Allocators::IAllocator&, FunctionBuffer&)
+            {
+                throw std::runtime_error("Builder failed");
+            };
+
+            EXPECT_THROW(compiler.Compile(builders), std::runtime_error);
+            EXPECT_EQ(pool.GetContextCount(), pool.GetAvailableContextCount());
+        }
+
+
+        TEST(BatchCompiler, PropagatesCodeHeapExceptions)
+        {
+            CompileContextPool pool(0, c_allocatorCapacity, c_codeCapacity);
+
+            // Every worker fails to reserve its sub-arena, including the
+            // ones on the spawned threads.
+            BatchCompiler compiler(pool, 4, ~static_cast<size_t>(0));
+
+            std::vector<BatchCompiler::Builder> builders;
+            for (unsigned i = 0; i < 20; ++i)
+            {
+                builders.push_back(MakeBuilder(i));
+            }
+
+            EXPECT_ANY_THROW(compiler.Compile(builders));
+            EXPECT_EQ(pool.GetContextCount(), pool.GetAvailableContextCount());
+        }
+    }
+}
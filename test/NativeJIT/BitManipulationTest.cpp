@@ -0,0 +1,306 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "NativeJIT/Interpreter.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace BitManipulationUnitTest
+    {
+        TEST_FIXTURE_START(BitManipulation)
+
+        public:
+            // The trees which replace the missing instructions are large, and
+            // interning them takes arena memory on top of the nodes.
+            BitManipulation() : TestFixture(c_defaultCodeAllocatorCapacity, 32 * 1024, TestFixture::c_defaultDiagnosticsStream)
+            {
+            }
+
+        protected:
+            // Returns the extensions enabled in the code generator, bit i
+            // holding the one with CpuFeature value i.
+            static unsigned GetFeatures(FunctionBuffer& code)
+            {
+                unsigned features = 0;
+
+                for (unsigned i = 0; i < static_cast<unsigned>(CpuFeature::CpuFeatureCount); ++i)
+                {
+                    if (code.IsSupported(static_cast<CpuFeature>(i)))
+                    {
+                        features |= 1u << i;
+                    }
+                }
+
+                return features;
+            }
+
+
+            static void SetFeatures(FunctionBuffer& code, unsigned features)
+            {
+                for (unsigned i = 0; i < static_cast<unsigned>(CpuFeature::CpuFeatureCount); ++i)
+                {
+                    code.SetSupported(static_cast<CpuFeature>(i), (features & (1u << i)) != 0);
+                }
+            }
+
+
+            // Returns bit patterns which exercise the edge cases of the
+            // counts and the masks for T.
+            template <typename T>
+            static std::vector<T> GetValues()
+            {
+                std::vector<T> values;
+
+                for (uint64_t word : { 0ull,
+                                       1ull,
+                                       2ull,
+                                       0x80ull,
+                                       0x8000ull,
+                                       0x80000000ull,
+                                       0x8000000000000000ull,
+                                       0xffffffffffffffffull,
+                                       0x5555555555555555ull,
+                                       0xf0f0f0f0f0f0f0f0ull,
+                                       0x0123456789abcdefull,
+                                       0x00ff00000000ff00ull,
+                                       0x0000000700000018ull })
+                {
+                    values.push_back(static_cast<T>(word));
+                }
+
+                return values;
+            }
+
+
+            template <typename T>
+            void VerifyUnary(TestCaseSetup& setup,
+                             Node<T>& (ExpressionNodeFactory::*operation)(Node<T>&),
+                             T (*reference)(T),
+                             char const * name)
+            {
+                // Verify both the instructions supported by the processor and
+                // the code which replaces them.
+                const unsigned processorFeatures = GetFeatures(setup.GetCode());
+
+                for (bool isEnabled : { true, false })
+                {
+                    SetFeatures(setup.GetCode(), isEnabled ? processorFeatures : 0);
+                    setup.GetAllocator().Reset();
+
+                    Function<T, T> expression(setup.GetAllocator(), setup.GetCode());
+                    auto function = expression.Compile((expression.*operation)(expression.GetP1()));
+
+                    for (T value : GetValues<T>())
+                    {
+                        ASSERT_EQ(reference(value), function(value))
+                            << name << "(" << +value << "), size " << sizeof(T)
+                            << ", extensions " << (isEnabled ? "enabled" : "disabled");
+                    }
+                }
+
+                SetFeatures(setup.GetCode(), processorFeatures);
+            }
+
+
+            template <typename T>
+            void VerifyBinary(TestCaseSetup& setup,
+                              Node<T>& (ExpressionNodeFactory::*operation)(Node<T>&, Node<T>&),
+                              T (*reference)(T, T),
+                              char const * name)
+            {
+                // Verify both the instructions supported by the processor and
+                // the code which replaces them.
+                const unsigned processorFeatures = GetFeatures(setup.GetCode());
+
+                for (bool isEnabled : { true, false })
+                {
+                    SetFeatures(setup.GetCode(), isEnabled ? processorFeatures : 0);
+                    setup.GetAllocator().Reset();
+
+                    Function<T, T, T> expression(setup.GetAllocator(), setup.GetCode());
+                    auto function = expression.Compile((expression.*operation)(expression.GetP1(),
+                                                                               expression.GetP2()));
+
+                    for (T left : GetValues<T>())
+                    {
+                        for (T right : GetValues<T>())
+                        {
+                            ASSERT_EQ(reference(left, right), function(left, right))
+                                << name << "(" << +left << ", " << +right << "), size " << sizeof(T)
+                                << ", extensions " << (isEnabled ? "enabled" : "disabled");
+                        }
+                    }
+                }
+
+                SetFeatures(setup.GetCode(), processorFeatures);
+            }
+
+
+            template <typename T>
+            void VerifyAll(TestCaseSetup& setup)
+            {
+                typedef ExpressionNodeFactory F;
+
+                VerifyUnary<T>(setup, &F::PopCount<T>, &Interpretation::ApplyPopCount<T>, "PopCount");
+                VerifyUnary<T>(setup, &F::LeadingZeroCount<T>, &Interpretation::ApplyLeadingZeroCount<T>, "LeadingZeroCount");
+                VerifyUnary<T>(setup, &F::TrailingZeroCount<T>, &Interpretation::ApplyTrailingZeroCount<T>, "TrailingZeroCount");
+                VerifyUnary<T>(setup, &F::ByteSwap<T>, &Interpretation::ApplyByteSwap<T>, "ByteSwap");
+
+                VerifyBinary<T>(setup, &F::AndNot<T>, &Interpretation::ApplyAndNot<T>, "AndNot");
+                VerifyBinary<T>(setup, &F::ExtractBits<T>, &Interpretation::ApplyExtractBits<T>, "ExtractBits");
+                VerifyBinary<T>(setup, &F::DepositBits<T>, &Interpretation::ApplyDepositBits<T>, "DepositBits");
+                VerifyBinary<T>(setup, &F::ZeroHighBits<T>, &Interpretation::ApplyZeroHighBits<T>, "ZeroHighBits");
+            }
+
+
+            // Returns whether the code compiled for the expression contains
+            // the instruction.
+            template <typename T>
+            static bool IsEmitted(Node<T>& (ExpressionNodeFactory::*operation)(Node<T>&, Node<T>&),
+                                  bool isEnabled,
+                                  char const * instruction)
+            {
+                std::stringstream diagnostics;
+                ExecutionBuffer codeAllocator(8192);
+                Allocator allocator(8192);
+                FunctionBuffer code(codeAllocator, 8192);
+
+                if (!isEnabled)
+                {
+                    SetFeatures(code, 0);
+                }
+
+                Function<T, T, T> expression(allocator, code);
+
+                code.EnableDiagnostics(diagnostics);
+                expression.Compile((expression.*operation)(expression.GetP1(), expression.GetP2()));
+
+                return diagnostics.str().find(std::string(instruction) + " ") != std::string::npos;
+            }
+
+
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        TEST_F(BitManipulation, ReferenceImplementation)
+        {
+            EXPECT_EQ(0u, Interpretation::ApplyPopCount(0u));
+            EXPECT_EQ(64, Interpretation::ApplyPopCount<int64_t>(-1));
+            EXPECT_EQ(4, Interpretation::ApplyPopCount<uint8_t>(0xb4));
+
+            EXPECT_EQ(32u, Interpretation::ApplyLeadingZeroCount(0u));
+            EXPECT_EQ(3, Interpretation::ApplyLeadingZeroCount<uint16_t>(0x1fff));
+            EXPECT_EQ(0, Interpretation::ApplyLeadingZeroCount<int8_t>(-1));
+
+            EXPECT_EQ(64ull, Interpretation::ApplyTrailingZeroCount(0ull));
+            EXPECT_EQ(4, Interpretation::ApplyTrailingZeroCount<int32_t>(0x30));
+
+            EXPECT_EQ(0x78563412u, Interpretation::ApplyByteSwap(0x12345678u));
+            EXPECT_EQ(0x3412, Interpretation::ApplyByteSwap<uint16_t>(0x1234));
+
+            EXPECT_EQ(0x0cu, Interpretation::ApplyAndNot(0xf3u, 0x0fu));
+
+            EXPECT_EQ(0xbu, Interpretation::ApplyExtractBits(0xb4u, 0xf0u));
+            EXPECT_EQ(0xb0u, Interpretation::ApplyDepositBits(0xbu, 0xf0u));
+
+            // The mask selects bits 0, 2 and 3.
+            EXPECT_EQ(0x3u, Interpretation::ApplyExtractBits(0x5u, 0xdu));
+            EXPECT_EQ(0x5u, Interpretation::ApplyDepositBits(0x3u, 0xdu));
+
+            EXPECT_EQ(0x3fu, Interpretation::ApplyZeroHighBits(0xffu, 6u));
+            EXPECT_EQ(0xffu, Interpretation::ApplyZeroHighBits(0xffu, 32u));
+            EXPECT_EQ(0x1u, Interpretation::ApplyZeroHighBits(0xffu, 0x101u));
+        }
+
+
+        TEST_F(BitManipulation, Unsigned)
+        {
+            auto setup = GetSetup();
+
+            VerifyAll<uint8_t>(*setup);
+            VerifyAll<uint16_t>(*setup);
+            VerifyAll<uint32_t>(*setup);
+            VerifyAll<uint64_t>(*setup);
+        }
+
+
+        TEST_F(BitManipulation, Signed)
+        {
+            auto setup = GetSetup();
+
+            VerifyAll<int8_t>(*setup);
+            VerifyAll<int16_t>(*setup);
+            VerifyAll<int32_t>(*setup);
+            VerifyAll<int64_t>(*setup);
+        }
+
+
+        TEST_F(BitManipulation, ConstantsAreFolded)
+        {
+            auto setup = GetSetup();
+            Function<uint64_t> expression(setup->GetAllocator(), setup->GetCode());
+
+            auto & count = expression.PopCount(expression.Immediate<uint64_t>(0xf0f0));
+            auto & extracted = expression.ExtractBits(expression.Immediate<uint64_t>(0xabcd),
+                                                      expression.Immediate<uint64_t>(0xff00));
+            auto function = expression.Compile(expression.Add(count, extracted));
+
+            EXPECT_EQ(8u + 0xabu, function());
+        }
+
+
+        TEST_F(BitManipulation, InstructionsFollowFeatures)
+        {
+            typedef ExpressionNodeFactory F;
+
+            FunctionBuffer& code = GetSetup()->GetCode();
+
+            // Without BMI2, pext is replaced by a call.
+            if (code.IsSupported(CpuFeature::Bmi2))
+            {
+                EXPECT_TRUE(IsEmitted<uint64_t>(&F::ExtractBits<uint64_t>, true, "pext"));
+            }
+            EXPECT_FALSE(IsEmitted<uint64_t>(&F::ExtractBits<uint64_t>, false, "pext"));
+            EXPECT_TRUE(IsEmitted<uint64_t>(&F::ExtractBits<uint64_t>, false, "call"));
+
+            if (code.IsSupported(CpuFeature::Bmi1))
+            {
+                EXPECT_TRUE(IsEmitted<uint32_t>(&F::AndNot<uint32_t>, true, "andn"));
+            }
+            EXPECT_FALSE(IsEmitted<uint32_t>(&F::AndNot<uint32_t>, false, "andn"));
+        }
+
+        TEST_CASES_END
+    }
+}
@@ -0,0 +1,175 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/BranchProfile.h"
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace BranchProfileUnitTest
+    {
+        TEST_FIXTURE_START(BranchProfile)
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        typedef Function<int64_t, int64_t> ScoringFunction;
+
+
+        // Returns -1 for negative values, otherwise p1 * 3 if p1 < threshold
+        // and p1 + 100 if not. The tree must be constructed in the same way
+        // for the instrumented and the recompiled function. Returns the IDs
+        // of the precondition and of the conditional node through the
+        // output parameters.
+        ScoringFunction::FunctionType Compile(ScoringFunction& e,
+                                              int64_t threshold,
+                                              unsigned& preconditionId,
+                                              unsigned& conditionalId)
+        {
+            auto & isNonNegative = e.Compare<JccType::JGE>(e.GetP1(), e.Immediate<int64_t>(0));
+            e.AddExecuteOnlyIfStatement(isNonNegative, e.Immediate<int64_t>(-1));
+
+            auto & isBelow = e.Compare<JccType::JL>(e.GetP1(), e.Immediate(threshold));
+            auto & small = e.Mul(e.GetP1(), e.Immediate<int64_t>(3));
+            auto & large = e.Add(e.GetP1(), e.Immediate<int64_t>(100));
+            auto & conditional = e.Conditional(isBelow, small, large);
+
+            preconditionId = isNonNegative.GetId();
+            conditionalId = conditional.GetId();
+
+            return e.Compile(conditional);
+        }
+
+
+        int64_t Expected(int64_t p1, int64_t threshold)
+        {
+            return p1 < 0 ? -1 : (p1 < threshold ? p1 * 3 : p1 + 100);
+        }
+
+
+        TEST_F(BranchProfile, CountsOutcomes)
+        {
+            auto setup = GetSetup();
+            NativeJIT::BranchProfile profile;
+
+            ScoringFunction e(setup->GetAllocator(), setup->GetCode());
+            e.SetInstrumentationProfile(profile);
+
+            unsigned preconditionId;
+            unsigned conditionalId;
+            auto function = Compile(e, 10, preconditionId, conditionalId);
+
+            for (int64_t i = -5; i < 100; ++i)
+            {
+                ASSERT_EQ(Expected(i, 10), function(i)) << "Input " << i;
+            }
+
+            EXPECT_EQ(105u, profile.GetCallCount());
+
+            auto & precondition = profile.GetPreconditionCounters(preconditionId);
+            EXPECT_EQ(100u, precondition.m_trueCount);
+            EXPECT_EQ(5u, precondition.m_falseCount);
+            EXPECT_EQ(NativeJIT::BranchProfile::HotBranch::True,
+                      profile.GetPreconditionHotBranch(preconditionId));
+
+            auto & conditional = profile.GetConditionalCounters(conditionalId);
+            EXPECT_EQ(10u, conditional.m_trueCount);
+            EXPECT_EQ(90u, conditional.m_falseCount);
+            EXPECT_EQ(NativeJIT::BranchProfile::HotBranch::False,
+                      profile.GetConditionalHotBranch(conditionalId));
+
+            profile.Reset();
+            EXPECT_EQ(0u, profile.GetCallCount());
+            EXPECT_EQ(0u, profile.GetConditionalCounters(conditionalId).m_falseCount);
+            EXPECT_EQ(NativeJIT::BranchProfile::HotBranch::Unknown,
+                      profile.GetConditionalHotBranch(conditionalId));
+        }
+
+
+        TEST_F(BranchProfile, RecompilesWithProfile)
+        {
+            // Each threshold makes a different side of the conditional hot.
+            for (int64_t threshold : { 5, 95 })
+            {
+                NativeJIT::BranchProfile profile;
+                unsigned preconditionId;
+                unsigned conditionalId;
+
+                {
+                    ExecutionBuffer codeAllocator(8192);
+                    Allocator allocator(8192);
+                    FunctionBuffer code(codeAllocator, 8192);
+
+                    ScoringFunction e(allocator, code);
+                    e.SetInstrumentationProfile(profile);
+                    auto function = Compile(e, threshold, preconditionId, conditionalId);
+
+                    for (int64_t i = -5; i < 100; ++i)
+                    {
+                        function(i);
+                    }
+                }
+
+                ExecutionBuffer codeAllocator(8192);
+                Allocator allocator(8192);
+                FunctionBuffer code(codeAllocator, 8192);
+
+                ScoringFunction e(allocator, code);
+                e.SetLayoutProfile(profile);
+                auto function = Compile(e, threshold, preconditionId, conditionalId);
+
+                for (int64_t i = -5; i < 100; ++i)
+                {
+                    ASSERT_EQ(Expected(i, threshold), function(i))
+                        << "Threshold " << threshold << ", input " << i;
+                }
+            }
+        }
+
+
+        TEST_F(BranchProfile, ColdEarlyReturn)
+        {
+            auto setup = GetSetup();
+            NativeJIT::BranchProfile profile;
+
+            Function<float, uint64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & condition = e.Compare<JccType::JB>(e.GetP1(), e.Immediate(static_cast<uint64_t>(7)));
+            e.AddExecuteOnlyIfStatement(condition, e.Immediate(0.5f));
+
+            // The early return is cold, so its float constant is moved into
+            // the result register behind the epilog.
+            profile.GetPreconditionCounters(condition.GetId()).m_trueCount = 10;
+            e.SetLayoutProfile(profile);
+
+            auto function = e.Compile(e.Immediate(2.5f));
+
+            EXPECT_EQ(2.5f, function(5));
+            EXPECT_EQ(0.5f, function(10));
+        }
+    }
+}
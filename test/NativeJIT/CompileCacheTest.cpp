@@ -0,0 +1,277 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/CodeGen/CodeHeap.h"
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/CompileCache.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace CompileCacheUnitTest
+    {
+        const unsigned c_bufferCapacity = 8192;
+
+        struct TestStruct
+        {
+            int32_t m_a;
+            int32_t m_b;
+        };
+
+
+        int32_t Increment(int32_t value)
+        {
+            return value + 1;
+        }
+
+
+        int32_t Decrement(int32_t value)
+        {
+            return value - 1;
+        }
+
+
+        // Compiles p1 + value with a temporary FunctionBuffer and returns the
+        // cached code, which outlives the buffer.
+        CompileCache::Entry CompileAdd(CompileCache& cache, int64_t value)
+        {
+            ExecutionBuffer codeAllocator(c_bufferCapacity);
+            Allocator allocator(c_bufferCapacity);
+            FunctionBuffer code(codeAllocator, c_bufferCapacity);
+
+            Function<int64_t, int64_t> expression(allocator, code);
+            expression.Compile(expression.Add(expression.GetP1(),
+                                              expression.Immediate(value)),
+                               cache);
+
+            return expression.GetCompiledCode();
+        }
+
+
+        int64_t CallAdd(CompileCache::Entry const & code, int64_t p1)
+        {
+            return code->GetEntryPoint<int64_t (*)(int64_t)>()(p1);
+        }
+
+
+        TEST(CompileCache, HitsAndMisses)
+        {
+            CodeHeap codeHeap;
+            CompileCache cache(codeHeap, 16, 1 << 20);
+
+            auto code1 = CompileAdd(cache, 5);
+            ASSERT_TRUE(code1 != nullptr);
+            EXPECT_EQ(0u, cache.GetHitCount());
+            EXPECT_EQ(1u, cache.GetMissCount());
+            EXPECT_EQ(1u, cache.GetEntryCount());
+            EXPECT_EQ(12, CallAdd(code1, 7));
+
+            auto code2 = CompileAdd(cache, 5);
+            EXPECT_EQ(1u, cache.GetHitCount());
+            EXPECT_EQ(1u, cache.GetMissCount());
+            EXPECT_EQ(1u, cache.GetEntryCount());
+            EXPECT_EQ(code1, code2);
+
+            // A different immediate is a different structure.
+            auto code3 = CompileAdd(cache, 6);
+            EXPECT_NE(code1, code3);
+            EXPECT_EQ(2u, cache.GetMissCount());
+            EXPECT_EQ(2u, cache.GetEntryCount());
+            EXPECT_EQ(13, CallAdd(code3, 7));
+            EXPECT_EQ(12, CallAdd(code1, 7));
+        }
+
+
+        TEST(CompileCache, DistinctStructures)
+        {
+            ExecutionBuffer codeAllocator(c_bufferCapacity);
+            Allocator allocator(c_bufferCapacity);
+            FunctionBuffer code(codeAllocator, c_bufferCapacity);
+            CodeHeap codeHeap;
+            CompileCache cache(codeHeap, 16, 1 << 20);
+
+            TestStruct testStruct { 10, 20 };
+
+            // Field offsets.
+            for (auto field : { &TestStruct::m_a, &TestStruct::m_b, &TestStruct::m_a })
+            {
+                allocator.Reset();
+                Function<int32_t, TestStruct*> expression(allocator, code);
+
+                auto function
+                    = expression.Compile(expression.Deref(expression.FieldPointer(expression.GetP1(), field)),
+                                         cache);
+                EXPECT_EQ(testStruct.*field, function(&testStruct));
+            }
+
+            EXPECT_EQ(2u, cache.GetEntryCount());
+            EXPECT_EQ(1u, cache.GetHitCount());
+
+            // Call targets.
+            for (auto target : { &Increment, &Decrement, &Increment })
+            {
+                allocator.Reset();
+                Function<int32_t, int32_t> expression(allocator, code);
+
+                auto function
+                    = expression.Compile(expression.Call(expression.Immediate(target),
+                                                         expression.GetP1()),
+                                         cache);
+                EXPECT_EQ(target(3), function(3));
+            }
+
+            EXPECT_EQ(4u, cache.GetEntryCount());
+            EXPECT_EQ(2u, cache.GetHitCount());
+
+            // Shared and duplicated subexpressions.
+            for (unsigned i = 0; i < 3; ++i)
+            {
+                allocator.Reset();
+                Function<int32_t, int32_t> expression(allocator, code);
+
+                // Interning would merge the duplicated subexpression.
+                expression.DisableNodeInterning();
+
+                auto & sum = expression.Add(expression.GetP1(), expression.Immediate(1));
+                auto & right = i == 1
+                    ? expression.Add(expression.GetP1(), expression.Immediate(1))
+                    : sum;
+
+                auto function = expression.Compile(expression.Mul(sum, right), cache);
+                EXPECT_EQ(16, function(3));
+            }
+
+            EXPECT_EQ(6u, cache.GetEntryCount());
+            EXPECT_EQ(3u, cache.GetHitCount());
+        }
+
+
+        // Compiles p1 with p1 bound to the value and returns the cached code.
+        CompileCache::Entry CompileBound(CompileCache& cache, int64_t value)
+        {
+            ExecutionBuffer codeAllocator(c_bufferCapacity);
+            Allocator allocator(c_bufferCapacity);
+            FunctionBuffer code(codeAllocator, c_bufferCapacity);
+
+            Function<int64_t, int64_t> expression(allocator, code);
+            expression.GetP1().Bind(value);
+            expression.Compile(expression.GetP1(), cache);
+
+            return expression.GetCompiledCode();
+        }
+
+
+        TEST(CompileCache, BoundParameters)
+        {
+            CodeHeap codeHeap;
+            CompileCache cache(codeHeap, 16, 1 << 20);
+
+            auto code1 = CompileBound(cache, 1);
+            auto code2 = CompileBound(cache, 2);
+            auto code3 = CompileBound(cache, 1);
+
+            // The bound value is a part of the structure.
+            EXPECT_NE(code1, code2);
+            EXPECT_EQ(code1, code3);
+            EXPECT_EQ(1, code1->GetEntryPoint<int64_t (*)(int64_t)>()(0));
+            EXPECT_EQ(2, code2->GetEntryPoint<int64_t (*)(int64_t)>()(0));
+        }
+
+
+        TEST(CompileCache, EvictsLeastRecentlyUsed)
+        {
+            CodeHeap codeHeap;
+            CompileCache cache(codeHeap, 2, 1 << 20);
+
+            auto code1 = CompileAdd(cache, 1);
+            CompileAdd(cache, 2);
+
+            // Use the first entry, which makes the second one least recently used.
+            CompileAdd(cache, 1);
+            EXPECT_EQ(1u, cache.GetHitCount());
+
+            CompileAdd(cache, 3);
+            EXPECT_EQ(2u, cache.GetEntryCount());
+            EXPECT_EQ(1u, cache.GetEvictionCount());
+
+            EXPECT_EQ(code1, CompileAdd(cache, 1));
+            EXPECT_EQ(2u, cache.GetHitCount());
+
+            // The second entry was evicted and needs to be compiled again.
+            CompileAdd(cache, 2);
+            EXPECT_EQ(4u, cache.GetMissCount());
+            EXPECT_EQ(2u, cache.GetEvictionCount());
+
+            // Code from evicted entries remains valid while it is referenced.
+            EXPECT_EQ(2u, cache.GetEntryCount());
+            cache.Clear();
+            EXPECT_EQ(0u, cache.GetEntryCount());
+            EXPECT_EQ(0u, cache.GetByteSize());
+            EXPECT_EQ(11, CallAdd(code1, 10));
+        }
+
+
+        TEST(CompileCache, BoundedByteSize)
+        {
+            CodeHeap codeHeap;
+            CompileCache unboundedCache(codeHeap, 16, 1 << 20);
+
+            CompileAdd(unboundedCache, 1);
+            const size_t entryByteSize = unboundedCache.GetByteSize();
+            ASSERT_GT(entryByteSize, 0u);
+
+            // Room for two entries only.
+            CompileCache cache(codeHeap, 16, entryByteSize * 2 + entryByteSize / 2);
+
+            for (int64_t i = 0; i < 10; ++i)
+            {
+                auto code = CompileAdd(cache, i);
+                EXPECT_EQ(i + 10, CallAdd(code, 10));
+                EXPECT_LE(cache.GetByteSize(), entryByteSize * 2 + entryByteSize / 2);
+            }
+
+            EXPECT_EQ(2u, cache.GetEntryCount());
+            EXPECT_EQ(8u, cache.GetEvictionCount());
+
+            // Functions that do not fit are not cached and run from the
+            // function buffer.
+            CompileCache tinyCache(codeHeap, 16, 1);
+            ExecutionBuffer codeAllocator(c_bufferCapacity);
+            Allocator allocator(c_bufferCapacity);
+            FunctionBuffer code(codeAllocator, c_bufferCapacity);
+
+            Function<int64_t, int64_t> expression(allocator, code);
+            auto function = expression.Compile(expression.Add(expression.GetP1(),
+                                                              expression.Immediate(5ll)),
+                                               tinyCache);
+
+            EXPECT_TRUE(expression.GetCompiledCode() == nullptr);
+            EXPECT_EQ(0u, tinyCache.GetEntryCount());
+            EXPECT_EQ(8, function(3));
+        }
+    }
+}
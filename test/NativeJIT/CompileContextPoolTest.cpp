@@ -0,0 +1,208 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <thread>
+#include <vector>
+
+#include "NativeJIT/CompileContextPool.h"
+#include "NativeJIT/Function.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace CompileContextPoolUnitTest
+    {
+        const unsigned c_allocatorCapacity = 8192;
+        const unsigned c_codeCapacity = 4096;
+
+
+        // Compiles and runs p1 * factor + 1 using a context from the pool.
+        int64_t CompileAndRun(CompileContextPool& pool, int64_t factor, int64_t p1)
+        {
+            auto lease = pool.Acquire();
+
+            Function<int64_t, int64_t> expression(lease.GetAllocator(), lease.GetCode());
+            auto & product = expression.Mul(expression.GetP1(), expression.Immediate(factor));
+            auto function = expression.Compile(expression.Add(product, expression.Immediate(1ll)));
+
+            return function(p1);
+        }
+
+
+        // Like CompileAndRun(), but uses the function held by the context.
+        int64_t CompileAndRunReused(CompileContextPool& pool, int64_t factor, int64_t p1)
+        {
+            auto lease = pool.Acquire();
+
+            auto & expression = lease.GetFunction<Function<int64_t, int64_t>>();
+            auto & product = expression.Mul(expression.GetP1(), expression.Immediate(factor));
+            auto function = expression.Compile(expression.Add(product, expression.Immediate(1ll)));
+
+            return function(p1);
+        }
+
+
+        TEST(CompileContextPool, ReusesContexts)
+        {
+            CompileContextPool pool(1, c_allocatorCapacity, c_codeCapacity);
+            EXPECT_EQ(1u, pool.GetContextCount());
+            EXPECT_EQ(1u, pool.GetAvailableContextCount());
+
+            for (int64_t i = 0; i < 10; ++i)
+            {
+                EXPECT_EQ(i * 3 + 1, CompileAndRun(pool, i, 3));
+            }
+
+            EXPECT_EQ(1u, pool.GetContextCount());
+            EXPECT_EQ(1u, pool.GetAvailableContextCount());
+
+            {
+                auto lease1 = pool.Acquire();
+                EXPECT_EQ(0u, pool.GetAvailableContextCount());
+
+                // The pool grows when all contexts are checked out.
+                auto lease2 = pool.Acquire();
+                EXPECT_NE(&lease1.GetContext(), &lease2.GetContext());
+                EXPECT_EQ(2u, pool.GetContextCount());
+
+                // Moving the lease transfers the ownership of the context.
+                auto lease3 = std::move(lease2);
+                EXPECT_EQ(0u, pool.GetAvailableContextCount());
+            }
+
+            EXPECT_EQ(2u, pool.GetAvailableContextCount());
+        }
+
+
+        TEST(CompileContextPool, ReusesFunction)
+        {
+            typedef Function<int64_t, int64_t> FunctionType;
+
+            CompileContextPool pool(1, c_allocatorCapacity, c_codeCapacity);
+            FunctionType* function = nullptr;
+
+            {
+                auto lease = pool.Acquire();
+                function = &lease.GetFunction<FunctionType>();
+
+                // The function is kept for the duration of the lease.
+                EXPECT_EQ(function, &lease.GetFunction<FunctionType>());
+            }
+
+            for (int64_t i = 0; i < 10; ++i)
+            {
+                EXPECT_EQ(i * 3 + 1, CompileAndRunReused(pool, i, 3));
+
+                auto lease = pool.Acquire();
+                EXPECT_EQ(function, &lease.GetFunction<FunctionType>());
+            }
+
+            // A function with a different signature replaces the current one.
+            {
+                auto lease = pool.Acquire();
+                auto & expression = lease.GetFunction<Function<int64_t, int64_t, int64_t>>();
+                auto compiled = expression.Compile(expression.Sub(expression.GetP1(),
+                                                                  expression.GetP2()));
+
+                EXPECT_EQ(5, compiled(8, 3));
+            }
+
+            EXPECT_EQ(43, CompileAndRunReused(pool, 7, 6));
+            EXPECT_EQ(1u, pool.GetContextCount());
+        }
+
+
+        TEST(CompileContextPool, ReusesFunctionAfterFailedCompile)
+        {
+            CompileContextPool pool(1, c_allocatorCapacity, c_codeCapacity);
+
+            {
+                auto lease = pool.Acquire();
+                auto & expression = lease.GetFunction<Function<int64_t, int64_t>>();
+
+                // Exhaust the allocator so that building the tree throws
+                // half way through.
+                auto build = [&expression]()
+                {
+                    Node<int64_t>* sum = &expression.GetP1();
+
+                    for (int64_t i = 0; ; ++i)
+                    {
+                        sum = &expression.Add(*sum, expression.Immediate(i));
+                    }
+                };
+
+                EXPECT_ANY_THROW(build());
+            }
+
+            EXPECT_EQ(22, CompileAndRunReused(pool, 3, 7));
+        }
+
+
+        TEST(CompileContextPool, ConcurrentCompiles)
+        {
+            const unsigned threadCount = 4;
+            const unsigned compilesPerThread = 100;
+
+            CompileContextPool pool(2, c_allocatorCapacity, c_codeCapacity);
+            std::vector<unsigned> failures(threadCount, 0);
+            std::vector<std::thread> threads;
+
+            for (unsigned t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([&pool, &failures, t, compilesPerThread]()
+                {
+                    for (unsigned i = 0; i < compilesPerThread; ++i)
+                    {
+                        const int64_t factor = t * compilesPerThread + i;
+
+                        // Alternate between a function constructed for the
+                        // compile and the one held by the context.
+                        const int64_t result = (i % 2 == 0)
+                            ? CompileAndRun(pool, factor, 2)
+                            : CompileAndRunReused(pool, factor, 2);
+
+                        if (result != factor * 2 + 1)
+                        {
+                            ++failures[t];
+                        }
+                    }
+                });
+            }
+
+            for (auto & thread : threads)
+            {
+                thread.join();
+            }
+
+            for (unsigned t = 0; t < threadCount; ++t)
+            {
+                EXPECT_EQ(0u, failures[t]) << "Thread " << t;
+            }
+
+            EXPECT_LE(pool.GetContextCount(), threadCount);
+            EXPECT_EQ(pool.GetContextCount(), pool.GetAvailableContextCount());
+        }
+    }
+}
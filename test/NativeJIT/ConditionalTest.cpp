@@ -22,9 +22,13 @@
 
 
 
+#include <cmath>     // For std::signbit.
+#include <sstream>
+
 #include "NativeJIT/CodeGen/ExecutionBuffer.h"
 #include "NativeJIT/CodeGen/FunctionBuffer.h"
 #include "NativeJIT/Function.h"
+#include "NativeJIT/Interpreter.h"
 #include "Temporary/Allocator.h"
 #include "TestSetup.h"
 
@@ -136,6 +140,577 @@ namespace NativeJIT
             ASSERT_EQ(expected, observed);
         }
 
+
+        //
+        // Branchless selection
+        //
+
+        TEST_F(Conditional, SelectSmallIntegers)
+        {
+            auto setup = GetSetup();
+
+            {
+                // cmov has no byte form, the 32-bit registers are used.
+                Function<uint8_t, int32_t, uint8_t, uint8_t> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & test = e.Conditional(e.Compare<JccType::JL>(e.GetP1(), e.Immediate(0)),
+                                            e.GetP2(),
+                                            e.GetP3());
+                auto function = e.Compile(test);
+
+                ASSERT_EQ(0xab, function(-1, 0xab, 0xcd));
+                ASSERT_EQ(0xcd, function(0, 0xab, 0xcd));
+            }
+
+            {
+                Function<int16_t, int16_t, int16_t> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & test = e.Conditional(e.Compare<JccType::JG>(e.GetP1(), e.GetP2()),
+                                            e.GetP1(),
+                                            e.GetP2());
+                auto function = e.Compile(test);
+
+                ASSERT_EQ(5, function(5, -7));
+                ASSERT_EQ(-3, function(-4, -3));
+            }
+        }
+
+
+        TEST_F(Conditional, SelectFromMemory)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t, int64_t*> e(setup->GetAllocator(), setup->GetCode());
+
+            // Neither value is in a register of its own, the false value is
+            // moved into the result and the true value is loaded for cmov.
+            auto & values = e.GetP2();
+            auto & test = e.Conditional(e.Compare<JccType::JNE>(e.GetP1(), e.Immediate<int64_t>(0)),
+                                        e.Deref(values, 1),
+                                        e.Immediate<int64_t>(0x123456789));
+            auto function = e.Compile(test);
+
+            int64_t data[] = { 0, -77 };
+
+            ASSERT_EQ(-77, function(1, data));
+            ASSERT_EQ(0x123456789, function(0, data));
+        }
+
+
+        TEST_F(Conditional, SelectBool)
+        {
+            auto setup = GetSetup();
+
+            {
+                Function<bool, int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & test = e.Compare<JccType::JLE>(e.GetP1(), e.GetP2());
+                auto function = e.Compile(test);
+
+                ASSERT_TRUE(function(2, 2));
+                ASSERT_FALSE(function(3, 2));
+            }
+
+            {
+                Function<bool, int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+                // The inverted constants are selected with the inverse setcc.
+                auto & test = e.Conditional(e.Compare<JccType::JLE>(e.GetP1(), e.GetP2()),
+                                            e.Immediate(false),
+                                            e.Immediate(true));
+                auto function = e.Compile(test);
+
+                ASSERT_FALSE(function(2, 2));
+                ASSERT_TRUE(function(3, 2));
+            }
+        }
+
+
+        TEST_F(Conditional, SelectFloat)
+        {
+            auto setup = GetSetup();
+
+            {
+                Function<float, int32_t, float, float> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & test = e.Conditional(e.Compare<JccType::JE>(e.GetP1(), e.Immediate(0)),
+                                            e.GetP2(),
+                                            e.GetP3());
+                auto function = e.Compile(test);
+
+                ASSERT_EQ(1.5f, function(0, 1.5f, -2.25f));
+                ASSERT_EQ(-2.25f, function(1, 1.5f, -2.25f));
+            }
+
+            {
+                // Both values are shared with the comparison.
+                Function<double, double, double> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & test = e.Conditional(e.Compare<JccType::JA>(e.GetP1(), e.GetP2()),
+                                            e.GetP1(),
+                                            e.GetP2());
+                auto function = e.Compile(test);
+
+                ASSERT_EQ(3.0, function(3.0, -1.0));
+                ASSERT_EQ(7.5, function(-1.0, 7.5));
+
+                // The values are blended bit by bit, so the sign of zero is kept.
+                ASSERT_TRUE(std::signbit(function(-1.0, -0.0)));
+                ASSERT_FALSE(std::signbit(function(-1.0, 0.0)));
+            }
+        }
+
+
+        TEST_F(Conditional, LazySelectsCheapValues)
+        {
+            auto setup = GetSetup();
+
+            Function<double, int64_t, double> e(setup->GetAllocator(), setup->GetCode());
+
+            // Both values are cheap: one is constant and the other one is
+            // evaluated for the comparison.
+            auto & test = e.LazyConditional(e.Compare<JccType::JL>(e.GetP1(), e.Immediate<int64_t>(10)),
+                                            e.GetP2(),
+                                            e.Immediate(-1.0));
+            auto function = e.Compile(test);
+
+            ASSERT_EQ(2.5, function(3, 2.5));
+            ASSERT_EQ(-1.0, function(30, 2.5));
+        }
+
+
+        //
+        // Lazy conditionals
+        //
+
+        static unsigned g_trueCalls;
+        static unsigned g_falseCalls;
+
+
+        static int64_t CountTrue(int64_t value)
+        {
+            ++g_trueCalls;
+            return value * 2;
+        }
+
+
+        static int64_t CountFalse(int64_t value)
+        {
+            ++g_falseCalls;
+            return value + 1;
+        }
+
+
+        TEST_F(Conditional, LazyEvaluatesOnlySelectedValue)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & condition = e.Compare<JccType::JL>(e.GetP1(), e.GetP2());
+            auto & test = e.LazyConditional(condition,
+                                            e.Call(e.Immediate(CountTrue), e.GetP1()),
+                                            e.Call(e.Immediate(CountFalse), e.GetP2()));
+            auto function = e.Compile(test);
+
+            g_trueCalls = 0;
+            g_falseCalls = 0;
+
+            ASSERT_EQ(6, function(3, 4));
+            ASSERT_EQ(1u, g_trueCalls);
+            ASSERT_EQ(0u, g_falseCalls);
+
+            ASSERT_EQ(4, function(5, 3));
+            ASSERT_EQ(1u, g_trueCalls);
+            ASSERT_EQ(1u, g_falseCalls);
+        }
+
+
+        TEST_F(Conditional, LazyNullPointerGuard)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t*> e(setup->GetAllocator(), setup->GetCode());
+
+            // The dereferenced value is shared within the true branch, so it
+            // must be evaluated there rather than up front.
+            auto & value = e.Deref(e.GetP1());
+            auto & test = e.LazyIfNotZero(e.GetP1(),
+                                          e.Add(value, e.Mul(value, value)),
+                                          e.Immediate<int64_t>(-1));
+            auto function = e.Compile(test);
+
+            int64_t data = 5;
+
+            ASSERT_EQ(30, function(&data));
+            ASSERT_EQ(-1, function(nullptr));
+        }
+
+
+        // The values shared between both branches and the code after them
+        // must be in the same place regardless of the branch taken, even if
+        // a branch spills them around a function call.
+        TEST_F(Conditional, LazyPreservesLiveValues)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & sum = e.Add(e.GetP2(), e.GetP3());
+            auto & product = e.Mul(e.GetP1(), e.GetP3());
+
+            auto & test = e.LazyIf(e.Compare<JccType::JG>(e.GetP1(), e.GetP2()),
+                                   e.Add(e.Call(e.Immediate(CountTrue), sum), product),
+                                   e.Sub(sum, product));
+            auto & root = e.Add(e.Add(test, sum), e.Add(product, e.GetP1()));
+            auto function = e.Compile(root);
+
+            auto expected = [](int64_t p1, int64_t p2, int64_t p3)
+            {
+                const int64_t sum = p2 + p3;
+                const int64_t product = p1 * p3;
+                const int64_t test = p1 > p2 ? sum * 2 + product : sum - product;
+
+                return test + sum + product + p1;
+            };
+
+            ASSERT_EQ(expected(7, 3, 5), function(7, 3, 5));
+            ASSERT_EQ(expected(2, 3, 5), function(2, 3, 5));
+        }
+
+
+        // Same as above, but with more live values than there are registers,
+        // so that the branches spill and bump them.
+        TEST_F(Conditional, LazyUnderRegisterPressure)
+        {
+            // The tree is larger than the default test allocators allow.
+            ExecutionBuffer codeAllocator(1 << 16);
+            Allocator allocator(1 << 16);
+            FunctionBuffer code(codeAllocator, 1 << 16);
+            Function<int64_t, int64_t, int64_t> e(allocator, code);
+
+            const unsigned valueCount = 20;
+            Node<int64_t>* values[valueCount];
+
+            for (unsigned i = 0; i < valueCount; ++i)
+            {
+                values[i] = &e.Mul(e.GetP1(), e.Immediate<int64_t>(i + 2));
+            }
+
+            // Each value is used twice, so all are evaluated up front.
+            Node<int64_t>* trueValue = &e.Call(e.Immediate(CountTrue), *values[0]);
+            Node<int64_t>* falseValue = &e.Immediate<int64_t>(1);
+            Node<int64_t>* sum = &e.Immediate<int64_t>(0);
+
+            for (unsigned i = 0; i < valueCount; ++i)
+            {
+                trueValue = &e.Add(*trueValue, e.Add(*values[i], e.GetP2()));
+                falseValue = &e.Mul(*falseValue, e.Sub(*values[i], e.GetP2()));
+                sum = &e.Add(*sum, *values[i]);
+            }
+
+            auto & test = e.LazyIf(e.Compare<JccType::JG>(e.GetP1(), e.GetP2()),
+                                   *trueValue,
+                                   *falseValue);
+            auto function = e.Compile(e.Add(test, *sum));
+
+            auto expected = [valueCount](int64_t p1, int64_t p2)
+            {
+                int64_t trueValue = p1 * 2 * 2;
+                int64_t falseValue = 1;
+                int64_t sum = 0;
+
+                for (unsigned i = 0; i < valueCount; ++i)
+                {
+                    const int64_t value = p1 * (i + 2);
+                    trueValue += value + p2;
+                    falseValue *= value - p2;
+                    sum += value;
+                }
+
+                return (p1 > p2 ? trueValue : falseValue) + sum;
+            };
+
+            ASSERT_EQ(expected(3, 1), function(3, 1));
+            ASSERT_EQ(expected(1, 3), function(1, 3));
+        }
+
+
+        TEST_F(Conditional, LazyNested)
+        {
+            auto setup = GetSetup();
+
+            Function<double, double*, double*> e(setup->GetAllocator(), setup->GetCode());
+
+            // The second value is used by both inner expressions, so it is
+            // evaluated before the inner conditional, but still only if the
+            // second pointer is not null.
+            auto & first = e.Deref(e.GetP1());
+            auto & second = e.Deref(e.GetP2());
+            auto & half = e.Immediate(0.5);
+            auto & inner = e.LazyIfNotZero(e.GetP1(), e.Add(first, second), e.Add(second, half));
+            auto & test = e.LazyIfNotZero(e.GetP2(), inner, e.Immediate(1.0));
+            auto function = e.Compile(test);
+
+            double a = 1.25;
+            double b = 2.0;
+
+            ASSERT_EQ(3.25, function(&a, &b));
+            ASSERT_EQ(2.5, function(nullptr, &b));
+            ASSERT_EQ(1.0, function(&a, nullptr));
+            ASSERT_EQ(1.0, function(nullptr, nullptr));
+        }
+
+
+        TEST_F(Conditional, LazyMatchesInterpreter)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & difference = e.Sub(e.GetP1(), e.GetP2());
+            auto & test = e.LazyConditional(e.Compare<JccType::JGE>(e.GetP1(), e.GetP2()),
+                                            e.Mul(difference, difference),
+                                            e.Sub(e.Immediate<int64_t>(0), difference));
+            auto function = e.Compile(test);
+            ASSERT_TRUE(e.IsInterpretable());
+
+            NativeJIT::Interpreter interpreter;
+
+            for (int64_t p1 = -3; p1 <= 3; ++p1)
+            {
+                interpreter.SetParameters(p1, 1);
+                e.Interpret(interpreter);
+
+                ASSERT_EQ(function(p1, 1),
+                          InterpreterValue<int64_t>::FromWord(interpreter.GetResult()));
+            }
+        }
+
+        //
+        // Logical operators
+        //
+
+        TEST_F(Conditional, LogicalOperators)
+        {
+            auto setup = GetSetup();
+
+            // The right conditions use only the parameters and constants, so
+            // they are combined without branching.
+            Function<int32_t, int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & isSmall = e.Compare<JccType::JL>(e.GetP1(), e.Immediate(10));
+            auto & isPositive = e.Compare<JccType::JG>(e.GetP2(), e.Immediate(0));
+
+            auto & test = e.Add(e.Add(e.Conditional(e.LogicalAnd(isSmall, isPositive),
+                                                    e.Immediate(1),
+                                                    e.Immediate(0)),
+                                      e.Conditional(e.LogicalOr(isSmall, isPositive),
+                                                    e.Immediate(10),
+                                                    e.Immediate(0))),
+                                e.Conditional(e.LogicalNot(isSmall),
+                                              e.Immediate(100),
+                                              e.Immediate(0)));
+            auto function = e.Compile(test);
+
+            for (int32_t p1 = 9; p1 <= 10; ++p1)
+            {
+                for (int32_t p2 = 0; p2 <= 1; ++p2)
+                {
+                    const int32_t expected = ((p1 < 10 && p2 > 0) ? 1 : 0)
+                                             + ((p1 < 10 || p2 > 0) ? 10 : 0)
+                                             + (!(p1 < 10) ? 100 : 0);
+
+                    ASSERT_EQ(expected, function(p1, p2));
+                }
+            }
+        }
+
+
+        TEST_F(Conditional, LogicalAndNullPointerGuard)
+        {
+            auto setup = GetSetup();
+
+            Function<bool, int64_t*> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & test = e.LogicalAnd(e.Compare<JccType::JNE>(e.GetP1(), e.Immediate<int64_t*>(nullptr)),
+                                       e.Compare<JccType::JG>(e.Deref(e.GetP1()), e.Immediate<int64_t>(0)));
+            auto function = e.Compile(test);
+
+            int64_t positive = 3;
+            int64_t negative = -3;
+
+            ASSERT_TRUE(function(&positive));
+            ASSERT_FALSE(function(&negative));
+            ASSERT_FALSE(function(nullptr));
+        }
+
+
+        TEST_F(Conditional, LogicalOrNested)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t*, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            // The load is guarded by both conditions, so the inner or must not
+            // be evaluated unconditionally even though its own right condition
+            // is in a region of its own.
+            auto & isNull = e.Compare<JccType::JE>(e.GetP1(), e.Immediate<int64_t*>(nullptr));
+            auto & isFlagSet = e.Compare<JccType::JNE>(e.GetP2(), e.Immediate<int64_t>(0));
+            auto & isPositive = e.Compare<JccType::JG>(e.Deref(e.GetP1()), e.Immediate<int64_t>(0));
+
+            auto & test = e.Conditional(e.LogicalOr(isNull, e.LogicalOr(isFlagSet, isPositive)),
+                                        e.Immediate<int64_t>(1),
+                                        e.Immediate<int64_t>(0));
+            auto function = e.Compile(test);
+
+            int64_t positive = 3;
+            int64_t negative = -3;
+
+            ASSERT_EQ(1, function(nullptr, 0));
+            ASSERT_EQ(1, function(&negative, 1));
+            ASSERT_EQ(1, function(&positive, 0));
+            ASSERT_EQ(0, function(&negative, 0));
+        }
+
+
+        TEST_F(Conditional, LogicalPrecondition)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t*, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & p = e.GetP1();
+            auto & isUsable = e.LogicalAnd(e.Compare<JccType::JNE>(p, e.Immediate<int64_t*>(nullptr)),
+                                           e.LogicalNot(e.Compare<JccType::JE>(e.Deref(p), e.GetP2())));
+            e.AddExecuteOnlyIfStatement(isUsable, e.Immediate<int64_t>(-1));
+
+            auto function = e.Compile(e.Sub(e.Deref(p), e.GetP2()));
+
+            int64_t data = 10;
+
+            ASSERT_EQ(-1, function(nullptr, 0));
+            ASSERT_EQ(-1, function(&data, 10));
+            ASSERT_EQ(3, function(&data, 7));
+        }
+
+
+        TEST_F(Conditional, LogicalBranchesDirectly)
+        {
+            std::stringstream diagnostics;
+            ExecutionBuffer codeAllocator(8192);
+            Allocator allocator(8192);
+            FunctionBuffer code(codeAllocator, 8192);
+            Function<int64_t, int64_t*, int64_t> e(allocator, code);
+
+            // Both the precondition and the lazy conditional jump on the
+            // outcomes of the compares rather than on a materialized value.
+            auto & p = e.GetP1();
+            auto & isUsable = e.LogicalAnd(e.Compare<JccType::JNE>(p, e.Immediate<int64_t*>(nullptr)),
+                                           e.Compare<JccType::JG>(e.Deref(p), e.Immediate<int64_t>(0)));
+            e.AddExecuteOnlyIfStatement(isUsable, e.Immediate<int64_t>(-1));
+
+            auto & isEdge = e.LogicalOr(e.Compare<JccType::JE>(e.GetP2(), e.Immediate<int64_t>(0)),
+                                        e.Compare<JccType::JE>(e.Deref(p, 1), e.GetP2()));
+            auto & test = e.LazyConditional(isEdge,
+                                            e.Deref(p),
+                                            e.Add(e.Deref(p), e.GetP2()));
+
+            code.EnableDiagnostics(diagnostics);
+            auto function = e.Compile(test);
+
+            int64_t data[] = { 10, 5 };
+            int64_t negative[] = { -10, 5 };
+
+            ASSERT_EQ(-1, function(nullptr, 0));
+            ASSERT_EQ(-1, function(negative, 1));
+            ASSERT_EQ(10, function(data, 0));
+            ASSERT_EQ(10, function(data, 5));
+            ASSERT_EQ(13, function(data, 3));
+
+            EXPECT_EQ(diagnostics.str().find("set"), std::string::npos);
+        }
+
+
+        TEST_F(Conditional, PreconditionSharesConditionalNodes)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t*, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            // The sum and the dereference are computed only if p2 is zero,
+            // so the body computes them again if it is not.
+            auto & p = e.GetP1();
+            auto & sum = e.Add(e.Deref(p), e.GetP2());
+            auto & isUsable = e.LogicalOr(e.Compare<JccType::JNE>(e.GetP2(), e.Immediate<int64_t>(0)),
+                                          e.Compare<JccType::JG>(sum, e.Immediate<int64_t>(0)));
+            e.AddExecuteOnlyIfStatement(isUsable, e.Immediate<int64_t>(-1));
+
+            auto function = e.Compile(e.Add(sum, e.Deref(p)));
+
+            int64_t positive = 10;
+            int64_t negative = -10;
+
+            ASSERT_EQ(20, function(&positive, 0));
+            ASSERT_EQ(-1, function(&negative, 0));
+            ASSERT_EQ(25, function(&positive, 5));
+            ASSERT_EQ(-15, function(&negative, 5));
+        }
+
+
+        TEST_F(Conditional, PreconditionSharesLazyConditionalNodes)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t*, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & p = e.GetP1();
+            auto & sum = e.Add(e.Deref(p), e.GetP2());
+            auto & value = e.LazyConditional(e.Compare<JccType::JE>(e.GetP2(), e.Immediate<int64_t>(0)),
+                                             e.Deref(p, 1),
+                                             sum);
+            e.AddExecuteOnlyIfStatement(e.Compare<JccType::JG>(value, e.Immediate<int64_t>(0)),
+                                        e.Immediate<int64_t>(-1));
+
+            auto function = e.Compile(e.Add(sum, e.Deref(p)));
+
+            int64_t data[] = { 10, 1 };
+            int64_t negative[] = { -10, -1 };
+
+            ASSERT_EQ(20, function(data, 0));
+            ASSERT_EQ(-1, function(negative, 0));
+            ASSERT_EQ(25, function(data, 5));
+            ASSERT_EQ(-1, function(negative, 5));
+            ASSERT_EQ(-5, function(negative, 15));
+        }
+
+
+        TEST_F(Conditional, LogicalMatchesInterpreter)
+        {
+            auto setup = GetSetup();
+
+            Function<bool, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & test = e.LogicalOr(e.LogicalAnd(e.Compare<JccType::JL>(e.GetP1(), e.GetP2()),
+                                                   e.Compare<JccType::JE>(e.Mul(e.GetP1(), e.GetP1()),
+                                                                          e.Immediate<int64_t>(4))),
+                                      e.LogicalNot(e.Compare<JccType::JNE>(e.GetP2(), e.Immediate<int64_t>(0))));
+            auto function = e.Compile(test);
+            ASSERT_TRUE(e.IsInterpretable());
+
+            NativeJIT::Interpreter interpreter;
+
+            for (int64_t p1 = -3; p1 <= 3; ++p1)
+            {
+                for (int64_t p2 = -1; p2 <= 1; ++p2)
+                {
+                    interpreter.SetParameters(p1, p2);
+                    e.Interpret(interpreter);
+
+                    ASSERT_EQ(function(p1, p2),
+                              InterpreterValue<bool>::FromWord(interpreter.GetResult()));
+                }
+            }
+        }
+
         TEST_CASES_END
     }
 }
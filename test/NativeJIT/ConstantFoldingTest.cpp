@@ -0,0 +1,207 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <limits>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace ConstantFoldingUnitTest
+    {
+        TEST_FIXTURE_START(ConstantFolding)
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        TEST_F(ConstantFolding, ImmediateOperands)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            // The sum of the immediates replaces the immediates, which
+            // eliminates both of them.
+            auto & sum = e.Add(e.Immediate<int64_t>(3), e.Immediate<int64_t>(4));
+            auto function = e.Compile(e.Add(sum, e.GetP1()));
+
+            EXPECT_EQ(2u, e.GetEliminatedNodeCount());
+            EXPECT_EQ(7, function(0));
+            EXPECT_EQ(2, function(-5));
+        }
+
+
+        TEST_F(ConstantFolding, PropagatesThroughTree)
+        {
+            auto setup = GetSetup();
+            Function<uint32_t, uint32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & product = e.Mul(e.Immediate(6u), e.Immediate(7u));
+            auto & shifted = e.Shl(e.Sub(product, e.Immediate(2u)), static_cast<uint8_t>(4));
+            auto & shld = e.Shld(shifted, e.Immediate(0xf0000000u), 4);
+            auto function = e.Compile(e.Or(shld, e.GetP1()));
+
+            // Only the Shld node remains from the constant subexpression.
+            EXPECT_EQ(7u, e.GetEliminatedNodeCount());
+            EXPECT_EQ(10255u, function(0));
+            EXPECT_EQ(0x10000u | 10255u, function(0x10000u));
+        }
+
+
+        TEST_F(ConstantFolding, IntegerIdentities)
+        {
+            auto setup = GetSetup();
+            Function<int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & product = e.Mul(e.GetP1(), e.Immediate(1));
+            auto & sum = e.Add(e.Immediate(0), product);
+            auto & shifted = e.Shl(sum, static_cast<uint8_t>(0));
+            auto & rotated = e.Rol(shifted, static_cast<uint8_t>(32));
+            auto & masked = e.And(rotated, e.Immediate(-1));
+            auto function = e.Compile(e.Or(masked, e.Immediate(0)));
+
+            // All the operations and their immediates (with the two zeros
+            // interned into one node) are eliminated and the result is the
+            // parameter itself.
+            EXPECT_EQ(9u, e.GetEliminatedNodeCount());
+
+            for (int32_t value : { 0, 1, -1, 12345, std::numeric_limits<int32_t>::min() })
+            {
+                EXPECT_EQ(value, function(value));
+            }
+        }
+
+
+        TEST_F(ConstantFolding, Annihilators)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & product = e.Mul(e.GetP1(), e.Immediate<int64_t>(0));
+            auto function = e.Compile(e.Add(product, e.GetP2()));
+
+            // The product becomes a zero constant, which makes the sum an
+            // identity and leaves only the second parameter.
+            EXPECT_EQ(4u, e.GetEliminatedNodeCount());
+            EXPECT_EQ(5, function(3, 5));
+            EXPECT_EQ(-1, function(-7, -1));
+        }
+
+
+        TEST_F(ConstantFolding, SharedFoldedConstants)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            // The 64-bit constant doesn't fit an immediate and is used twice.
+            auto & constant = e.Sub(e.Immediate<int64_t>(0x100000000ll), e.Immediate<int64_t>(1));
+            auto function = e.Compile(e.Add(e.Mul(e.GetP1(), constant), constant));
+
+            EXPECT_EQ(2u, e.GetEliminatedNodeCount());
+            EXPECT_EQ(0xffffffffll, function(0));
+            EXPECT_EQ(3 * 0xffffffffll, function(2));
+        }
+
+
+        TEST_F(ConstantFolding, FloatingPoint)
+        {
+            auto setup = GetSetup();
+            Function<double, double> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & sum = e.Add(e.Immediate(1.5), e.Cast<double>(e.Immediate(2)));
+            auto & product = e.Mul(sum, e.GetP1());
+
+            // Identities are not applied to floating point values, so the
+            // multiplication by one is kept.
+            auto function = e.Compile(e.Mul(product, e.Immediate(1.0)));
+
+            EXPECT_EQ(3u, e.GetEliminatedNodeCount());
+            EXPECT_EQ(3.5, function(1.0));
+            EXPECT_EQ(-7.0, function(-2.0));
+        }
+
+
+        TEST_F(ConstantFolding, Casts)
+        {
+            auto setup = GetSetup();
+            Function<float, float> e(setup->GetAllocator(), setup->GetCode());
+
+            // Conversion of uint64_t to float requires a composite cast.
+            auto & large = e.Cast<float>(e.Immediate<uint64_t>(0x8000000000000000ull));
+            auto & small = e.Cast<float>(e.Cast<int32_t>(e.Immediate(-3.75)));
+            auto function = e.Compile(e.Add(e.Add(large, small), e.GetP1()));
+
+            EXPECT_GT(e.GetEliminatedNodeCount(), 4u);
+            EXPECT_EQ(9223372036854775808.0f - 3.0f, function(0.0f));
+        }
+
+
+        TEST_F(ConstantFolding, OutOfRangeCastIsNotFolded)
+        {
+            auto setup = GetSetup();
+            Function<int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto function = e.Compile(e.Cast<int32_t>(e.Immediate(1e10)));
+
+            EXPECT_EQ(0u, e.GetEliminatedNodeCount());
+            EXPECT_EQ(std::numeric_limits<int32_t>::min(), function());
+        }
+
+
+        TEST_F(ConstantFolding, ConstantCondition)
+        {
+            auto setup = GetSetup();
+            Function<int32_t, int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & condition = e.Compare<JccType::JL>(e.Immediate(1), e.Immediate(2));
+            auto function = e.Compile(e.Conditional(condition, e.GetP1(), e.GetP2()));
+
+            // The Conditional, the comparison with its immediates and the
+            // unused second parameter are eliminated.
+            EXPECT_EQ(5u, e.GetEliminatedNodeCount());
+            EXPECT_EQ(3, function(3, 4));
+        }
+
+
+        TEST_F(ConstantFolding, ConstantComparisonValue)
+        {
+            auto setup = GetSetup();
+            Function<bool, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & comparison = e.Compare<JccType::JE>(e.Immediate(5), e.Immediate(5));
+            auto function = e.Compile(e.Or(comparison, e.Compare<JccType::JE>(e.GetP1(), e.Immediate(0))));
+
+            // The comparison of the (interned) immediates is folded into a
+            // constant.
+            EXPECT_EQ(1u, e.GetEliminatedNodeCount());
+            EXPECT_TRUE(function(0));
+            EXPECT_TRUE(function(1));
+        }
+
+
+        TEST_CASES_END
+    }
+}
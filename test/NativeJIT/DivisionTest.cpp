@@ -0,0 +1,320 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace DivisionUnitTest
+    {
+        TEST_FIXTURE_START(Division)
+
+        protected:
+            // Returns the dividends around zero, the powers of two and the
+            // limits of T, including the ones which make the sequences for
+            // the constant divisors overflow if they are off by one.
+            template <typename T>
+            static std::vector<T> GetDividends()
+            {
+                std::vector<T> values;
+
+                for (int value = -20; value <= 20; ++value)
+                {
+                    values.push_back(static_cast<T>(value));
+                }
+
+                for (unsigned shift = 3; shift < 8 * sizeof(T); ++shift)
+                {
+                    const T power = static_cast<T>(static_cast<uint64_t>(1) << shift);
+
+                    values.push_back(power);
+                    values.push_back(static_cast<T>(power - 1));
+                    values.push_back(static_cast<T>(power + 1));
+                    values.push_back(static_cast<T>(0 - power));
+                    values.push_back(static_cast<T>(1 - power));
+                }
+
+                for (T offset = 0; offset < 20; ++offset)
+                {
+                    values.push_back(static_cast<T>(std::numeric_limits<T>::max() - offset));
+                    values.push_back(static_cast<T>(std::numeric_limits<T>::min() + offset));
+                }
+
+                values.push_back(static_cast<T>(0x123456789abcdef0ull));
+                values.push_back(static_cast<T>(0xfedcba9876543210ull));
+
+                return values;
+            }
+
+
+            // Compiles left / divisor or left % divisor through
+            // DivImmediate() or ModImmediate() and verifies it against C++.
+            template <typename T>
+            void VerifyConstantDivisor(TestCaseSetup& setup, T divisor, bool isRemainder)
+            {
+                setup.GetAllocator().Reset();
+                Function<T, T> expression(setup.GetAllocator(), setup.GetCode());
+                auto function = expression.Compile(
+                    isRemainder
+                    ? expression.ModImmediate(expression.GetP1(), divisor)
+                    : expression.DivImmediate(expression.GetP1(), divisor));
+
+                for (T value : GetDividends<T>())
+                {
+                    if (std::is_signed<T>::value
+                        && value == std::numeric_limits<T>::min()
+                        && divisor == static_cast<T>(-1))
+                    {
+                        continue;
+                    }
+
+                    const T expected = static_cast<T>(isRemainder ? value % divisor
+                                                                  : value / divisor);
+
+                    EXPECT_EQ(expected, function(value))
+                        << +value << (isRemainder ? " % " : " / ") << +divisor;
+                }
+            }
+
+
+            template <typename T>
+            void VerifyConstantDivisor(TestCaseSetup& setup, T divisor)
+            {
+                VerifyConstantDivisor(setup, divisor, false);
+                VerifyConstantDivisor(setup, divisor, true);
+            }
+
+
+            template <typename T>
+            void VerifyConstantDivisors(TestCaseSetup& setup)
+            {
+                for (int divisor = 1; divisor <= 100; ++divisor)
+                {
+                    VerifyConstantDivisor<T>(setup, static_cast<T>(divisor));
+
+                    if (std::is_signed<T>::value)
+                    {
+                        VerifyConstantDivisor<T>(setup, static_cast<T>(-divisor));
+                    }
+                }
+
+                for (unsigned shift = 7; shift < 8 * sizeof(T); ++shift)
+                {
+                    const T power = static_cast<T>(static_cast<uint64_t>(1) << shift);
+
+                    VerifyConstantDivisor<T>(setup, power);
+                    VerifyConstantDivisor<T>(setup, static_cast<T>(power - 1));
+                    VerifyConstantDivisor<T>(setup, static_cast<T>(power + 1));
+                }
+
+                VerifyConstantDivisor<T>(setup, std::numeric_limits<T>::max());
+                VerifyConstantDivisor<T>(setup, static_cast<T>(std::numeric_limits<T>::max() - 1));
+                VerifyConstantDivisor<T>(setup, std::numeric_limits<T>::min() + (std::is_signed<T>::value ? 0 : 1));
+                VerifyConstantDivisor<T>(setup, static_cast<T>(1000000007));
+            }
+
+
+            // Compiles left / right or left % right with two parameters and
+            // verifies it against C++.
+            template <typename T>
+            void VerifyVariableDivisor(TestCaseSetup& setup, bool isRemainder)
+            {
+                setup.GetAllocator().Reset();
+                Function<T, T, T> expression(setup.GetAllocator(), setup.GetCode());
+                auto function = expression.Compile(
+                    isRemainder
+                    ? expression.Mod(expression.GetP1(), expression.GetP2())
+                    : expression.Div(expression.GetP1(), expression.GetP2()));
+
+                auto const values = GetDividends<T>();
+
+                for (T left : values)
+                {
+                    for (T right : values)
+                    {
+                        if (right == 0
+                            || (std::is_signed<T>::value
+                                && left == std::numeric_limits<T>::min()
+                                && right == static_cast<T>(-1)))
+                        {
+                            continue;
+                        }
+
+                        const T expected = static_cast<T>(isRemainder ? left % right
+                                                                      : left / right);
+
+                        EXPECT_EQ(expected, function(left, right))
+                            << +left << (isRemainder ? " % " : " / ") << +right;
+                    }
+                }
+            }
+
+
+            template <typename T>
+            void VerifyVariableDivisor(TestCaseSetup& setup)
+            {
+                VerifyVariableDivisor<T>(setup, false);
+                VerifyVariableDivisor<T>(setup, true);
+            }
+
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        TEST_F(Division, VariableDivisor)
+        {
+            auto setup = GetSetup();
+
+            VerifyVariableDivisor<int64_t>(*setup);
+            VerifyVariableDivisor<uint64_t>(*setup);
+            VerifyVariableDivisor<int32_t>(*setup);
+            VerifyVariableDivisor<uint32_t>(*setup);
+            VerifyVariableDivisor<int16_t>(*setup);
+            VerifyVariableDivisor<uint16_t>(*setup);
+            VerifyVariableDivisor<int8_t>(*setup);
+            VerifyVariableDivisor<uint8_t>(*setup);
+        }
+
+
+        TEST_F(Division, ConstantDivisor)
+        {
+            auto setup = GetSetup();
+
+            VerifyConstantDivisors<int64_t>(*setup);
+            VerifyConstantDivisors<uint64_t>(*setup);
+            VerifyConstantDivisors<int32_t>(*setup);
+            VerifyConstantDivisors<uint32_t>(*setup);
+            VerifyConstantDivisors<int16_t>(*setup);
+            VerifyConstantDivisors<uint8_t>(*setup);
+        }
+
+
+        TEST_F(Division, ConstantDivisorAvoidsDiv)
+        {
+            std::stringstream diagnostics;
+            ExecutionBuffer codeAllocator(8192);
+            Allocator allocator(8192);
+            FunctionBuffer code(codeAllocator, 8192);
+            Function<int64_t, int64_t> expression(allocator, code);
+
+            // The immediate divisor folded from a Node is lowered as well.
+            code.EnableDiagnostics(diagnostics);
+            auto function = expression.Compile(
+                expression.Div(expression.GetP1(), expression.Immediate<int64_t>(7)));
+
+            EXPECT_EQ(-142, function(-1000));
+            EXPECT_EQ(diagnostics.str().find("div "), std::string::npos);
+            EXPECT_NE(diagnostics.str().find("imul "), std::string::npos);
+        }
+
+
+        TEST_F(Division, OperandsInRaxAndRdx)
+        {
+            auto setup = GetSetup();
+
+            // Keep several values live across the divisions so that the
+            // operands and the other values compete for rax and rdx.
+            Function<int64_t, int64_t, int64_t, int64_t> expression(setup->GetAllocator(), setup->GetCode());
+
+            auto & a = expression.GetP1();
+            auto & b = expression.GetP2();
+            auto & c = expression.GetP3();
+            auto & sum = expression.Add(a, expression.Add(b, c));
+            auto & quotient = expression.Div(sum, c);
+            auto & remainder = expression.Mod(a, b);
+            auto & product = expression.Mul(quotient, remainder);
+            auto & root = expression.Add(expression.Add(product, sum),
+                                         expression.Div(expression.Sub(c, a), b));
+
+            auto function = expression.Compile(root);
+
+            for (int64_t x : { -100, -7, 3, 55, 1000 })
+            {
+                for (int64_t y : { -9, -2, 1, 6, 123 })
+                {
+                    for (int64_t z : { -5, 4, 17, 333 })
+                    {
+                        const int64_t expected =
+                            ((x + y + z) / z) * (x % y) + (x + y + z) + (z - x) / y;
+
+                        EXPECT_EQ(expected, function(x, y, z)) << x << ", " << y << ", " << z;
+                    }
+                }
+            }
+        }
+
+
+        TEST_F(Division, MulHigh)
+        {
+            auto setup = GetSetup();
+
+            {
+                Function<uint64_t, uint64_t, uint64_t> expression(setup->GetAllocator(), setup->GetCode());
+                auto function = expression.Compile(
+                    expression.MulHigh(expression.GetP1(), expression.GetP2()));
+
+                EXPECT_EQ(0u, function(0xffffffffull, 0xffffffffull));
+                EXPECT_EQ(0xfffffffffffffffeull, function(~0ull, ~0ull));
+                EXPECT_EQ(0x1u, function(1ull << 32, 1ull << 32));
+            }
+
+            {
+                setup->GetAllocator().Reset();
+                Function<int32_t, int32_t, int32_t> expression(setup->GetAllocator(), setup->GetCode());
+                auto function = expression.Compile(
+                    expression.MulHigh(expression.GetP1(), expression.GetP2()));
+
+                EXPECT_EQ(-1, function(-1, 1));
+                EXPECT_EQ(0, function(-1, -1));
+                EXPECT_EQ(0x40000000, function(std::numeric_limits<int32_t>::min(),
+                                               std::numeric_limits<int32_t>::min()));
+            }
+        }
+
+
+        TEST_F(Division, ConstantsAreFolded)
+        {
+            auto setup = GetSetup();
+            Function<int32_t> expression(setup->GetAllocator(), setup->GetCode());
+
+            auto function = expression.Compile(
+                expression.Add(expression.Div(expression.Immediate(-17), expression.Immediate(5)),
+                               expression.Mod(expression.Immediate(-17), expression.Immediate(5))));
+
+            EXPECT_EQ(-3 + -2, function());
+        }
+
+
+        TEST_CASES_END
+    }
+}
@@ -22,6 +22,8 @@
 
 
 #include <iostream>
+#include <sstream>
+#include <vector>
 
 #include "NativeJIT/CodeGen/ExecutionBuffer.h"
 #include "NativeJIT/CodeGen/FunctionBuffer.h"
@@ -477,6 +479,355 @@ namespace NativeJIT
         }
 
 
+        // Verify that the released temporaries are reused closest to the base
+        // pointer first and that XMM temporaries are 16-byte aligned.
+        TEST_F(ExpressionTree, TemporaryPacking)
+        {
+            auto setup = GetSetup();
+            ExpressionNodeFactory e(setup->GetAllocator(), setup->GetCode());
+
+            auto t1 = e.Temporary<int>();
+            auto t2 = e.Temporary<int>();
+            auto t3 = e.Temporary<int>();
+
+            ASSERT_EQ(-8, t1.GetOffset());
+            ASSERT_EQ(-16, t2.GetOffset());
+            ASSERT_EQ(-24, t3.GetOffset());
+
+            // The base pointer is 8 bytes off a 16-byte boundary, so the
+            // first aligned 16-byte slot past t3 is at -40.
+            auto x1 = e.XmmTemporary<double>();
+            ASSERT_EQ(-40, x1.GetOffset());
+            ASSERT_EQ(40u, e.GetTemporaryAreaSize());
+
+            // The freed 8-byte slots are packed before the frame grows.
+            t2.Reset();
+            t3.Reset();
+
+            auto x2 = e.XmmTemporary<double>();
+            ASSERT_EQ(-24, x2.GetOffset());
+
+            auto t4 = e.Temporary<int>();
+            ASSERT_EQ(-48, t4.GetOffset());
+
+            t1.Reset();
+            auto t5 = e.Temporary<int>();
+            ASSERT_EQ(-8, t5.GetOffset());
+            ASSERT_EQ(48u, e.GetTemporaryAreaSize());
+        }
+
+
+        // Verify that spilling an immediate which was loaded into a register
+        // turns the other owners back into the immediate instead of storing
+        // the register to a temporary.
+        TEST_F(ExpressionTree, RematerializeImmediate)
+        {
+            auto setup = GetSetup();
+            ExpressionNodeFactory e(setup->GetAllocator(), setup->GetCode());
+            std::vector<Storage<int>> storages;
+
+            auto s = e.ExpressionTree::Immediate<int>(1234);
+            auto s2 = s;
+            s.ConvertToDirect(false);
+            ASSERT_EQ(s2.GetStorageClass(), StorageClass::Direct);
+
+            while (s2.GetStorageClass() == StorageClass::Direct)
+            {
+                storages.push_back(e.Direct<int>());
+            }
+
+            ASSERT_EQ(s2.GetStorageClass(), StorageClass::Immediate);
+            ASSERT_EQ(s2.GetImmediate(), 1234);
+            ASSERT_EQ(s.GetStorageClass(), StorageClass::Immediate);
+
+            // No temporary was used.
+            ASSERT_EQ(e.Temporary<int>().GetOffset(), -static_cast<int32_t>(sizeof(void*)));
+        }
+
+
+        // Verify that spilling a RIP-relative constant which was loaded into
+        // a register makes it RIP-relative again.
+        TEST_F(ExpressionTree, RematerializeRIPRelative)
+        {
+            auto setup = GetSetup();
+            ExpressionNodeFactory e(setup->GetAllocator(), setup->GetCode());
+            std::vector<Storage<double>> storages;
+
+            auto s = e.RIPRelative<double>(16);
+            auto s2 = s;
+            s.ConvertToDirect(false);
+            ASSERT_EQ(s2.GetStorageClass(), StorageClass::Direct);
+
+            while (s2.GetStorageClass() == StorageClass::Direct)
+            {
+                storages.push_back(e.Direct<double>());
+            }
+
+            ASSERT_EQ(s2.GetStorageClass(), StorageClass::Indirect);
+            ASSERT_TRUE(s2.GetBaseRegister().IsRIP());
+            ASSERT_EQ(s2.GetOffset(), 16);
+            ASSERT_EQ(e.Temporary<double>().GetOffset(), -static_cast<int32_t>(sizeof(void*)));
+        }
+
+
+        // Verify that a value which was converted for modification is
+        // spilled to a temporary since it no longer matches its source.
+        TEST_F(ExpressionTree, NoRematerializationAfterModification)
+        {
+            auto setup = GetSetup();
+            ExpressionNodeFactory e(setup->GetAllocator(), setup->GetCode());
+            std::vector<Storage<int>> storages;
+
+            auto s = e.ExpressionTree::Immediate<int>(1234);
+            auto s2 = s;
+            s.ConvertToDirect(false);
+            s2.Reset();
+            s.ConvertToDirect(true);
+            s2 = s;
+
+            while (s2.GetStorageClass() == StorageClass::Direct)
+            {
+                storages.push_back(e.Direct<int>());
+            }
+
+            ASSERT_EQ(s2.GetStorageClass(), StorageClass::Indirect);
+            ASSERT_EQ(s2.GetBaseRegister(), rbp);
+            ASSERT_EQ(s2.GetOffset(), -static_cast<int32_t>(sizeof(void*)));
+        }
+
+
+        static unsigned s_speculativeCallCount = 0;
+
+        int32_t CountedSquare(int32_t value)
+        {
+            ++s_speculativeCallCount;
+            return value * value;
+        }
+
+
+        // Verify that the nodes which are not referenced by the tree are
+        // pruned together with their exclusive children rather than rejected.
+        TEST_F(ExpressionTree, UnreferencedNodesArePruned)
+        {
+            auto setup = GetSetup();
+            Function<int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & shared = e.Add(e.GetP1(), e.Immediate(1));
+
+            // A speculatively built alternative which is then discarded. Only
+            // the shared subexpression is also used by the final tree.
+            auto & square = e.Call(e.Immediate(CountedSquare), shared);
+            e.Mul(square, e.Immediate<int32_t>(3));
+
+            auto function = e.Compile(e.Mul(shared, e.Immediate<int32_t>(5)));
+
+            s_speculativeCallCount = 0;
+            EXPECT_EQ(20, function(3));
+            EXPECT_EQ(0u, s_speculativeCallCount);
+        }
+
+
+        // Builds an expression with more shared values than there are
+        // registers, so that some of them need to be spilled in Pass2.
+        Node<int64_t>& BuildWideExpression(Function<int64_t, int64_t, int64_t>& e)
+        {
+            const unsigned sharedCount = 20;
+            std::vector<Node<int64_t>*> shared;
+
+            for (unsigned i = 0; i < sharedCount; ++i)
+            {
+                shared.push_back(&e.Mul(e.Add(e.GetP1(), e.Immediate<int64_t>(i)),
+                                        e.GetP2()));
+            }
+
+            // The shared values are used first in the order of creation and
+            // then in the reverse order.
+            Node<int64_t>* forward = &e.Immediate<int64_t>(0);
+            Node<int64_t>* backward = &e.Immediate<int64_t>(0);
+
+            for (unsigned i = 0; i < sharedCount; ++i)
+            {
+                forward = &e.Add(*forward, *shared[i]);
+                backward = &e.Add(*backward,
+                                  e.Shl(*shared[sharedCount - 1 - i],
+                                        static_cast<uint8_t>(1)));
+            }
+
+            return e.Sub(*forward, *backward);
+        }
+
+
+        static int64_t Twice(int64_t value)
+        {
+            return 2 * value;
+        }
+
+
+        // Builds an expression with values that are live across two calls.
+        Node<int64_t>& BuildCallExpression(Function<int64_t, int64_t, int64_t>& e)
+        {
+            auto & sum = e.Add(e.GetP1(), e.GetP2());
+            auto & first = e.Call(e.Immediate(Twice), sum);
+            auto & second = e.Call(e.Immediate(Twice), e.GetP1());
+
+            return e.Add(e.Add(e.Mul(sum, first), sum),
+                         e.Add(second, e.GetP1()));
+        }
+
+
+        // Compiles the expression with the specified register allocation,
+        // verifies its result and returns the number of values stored to the
+        // stack frame.
+        unsigned CompileAndCountStores(
+            RegisterAllocation allocation,
+            Node<int64_t>& (*build)(Function<int64_t, int64_t, int64_t>&),
+            int64_t expected)
+        {
+            std::stringstream diagnostics;
+            ExecutionBuffer codeAllocator(65536);
+            Allocator allocator(65536);
+            FunctionBuffer code(codeAllocator, 65536);
+            Function<int64_t, int64_t, int64_t> e(allocator, code);
+
+            e.SetRegisterAllocation(allocation);
+            code.EnableDiagnostics(diagnostics);
+
+            auto function = e.Compile(build(e));
+            EXPECT_EQ(expected, function(3, 5));
+
+            unsigned count = 0;
+            std::string line;
+
+            while (std::getline(diagnostics, line))
+            {
+                if (line.find("ptr [rbp - ") != std::string::npos
+                    && line.find("], ") != std::string::npos)
+                {
+                    ++count;
+                }
+            }
+
+            return count;
+        }
+
+
+        TEST_F(ExpressionTree, NextUseSpillingMatchesGreedy)
+        {
+            // Sum of (3 + i) * 5 for i in [0, 20) minus twice as much.
+            const int64_t expected = -1250;
+
+            CompileAndCountStores(RegisterAllocation::Greedy, BuildWideExpression, expected);
+            CompileAndCountStores(RegisterAllocation::NextUseSpilling, BuildWideExpression, expected);
+        }
+
+
+        TEST_F(ExpressionTree, NextUseSpillingKeepsValuesLiveAcrossCalls)
+        {
+            // (3 + 5) * 16 + 8 + 6 + 3.
+            const int64_t expected = 145;
+
+            const unsigned greedyStores =
+                CompileAndCountStores(RegisterAllocation::Greedy, BuildCallExpression, expected);
+            const unsigned nextUseStores =
+                CompileAndCountStores(RegisterAllocation::NextUseSpilling, BuildCallExpression, expected);
+
+            // Values used after a call are placed in non-volatile registers
+            // rather than saved around each call.
+            EXPECT_LT(nextUseStores, greedyStores);
+        }
+
+
+        // Builds a weighted sum of the features, one of which is read through
+        // a second load, with more loads than there are registers.
+        Node<int64_t>& BuildScore(Function<int64_t, int64_t*, int64_t**>& e)
+        {
+            const int32_t featureCount = 16;
+            Node<int64_t>* score = &e.Deref(e.Deref(e.GetP2()), 1);
+
+            for (int32_t i = 0; i < featureCount; ++i)
+            {
+                score = &e.Add(*score, e.Mul(e.Deref(e.GetP1(), i),
+                                             e.Immediate<int64_t>(i + 1)));
+            }
+
+            return *score;
+        }
+
+
+        TEST_F(ExpressionTree, HoistedLoadsMatchInOrder)
+        {
+            int64_t features[16];
+            int64_t boosts[] = { 0, 1000 };
+            int64_t* boostsPointer = boosts;
+            int64_t expected = 1000;
+
+            for (int64_t i = 0; i < 16; ++i)
+            {
+                features[i] = 3 * i - 7;
+                expected += features[i] * (i + 1);
+            }
+
+            for (auto scheduling : { LoadScheduling::InOrder, LoadScheduling::Hoisted })
+            {
+                ExecutionBuffer codeAllocator(65536);
+                Allocator allocator(65536);
+                FunctionBuffer code(codeAllocator, 65536);
+                Function<int64_t, int64_t*, int64_t**> e(allocator, code);
+
+                e.SetLoadScheduling(scheduling);
+
+                auto function = e.Compile(BuildScore(e));
+                EXPECT_EQ(expected, function(features, &boostsPointer));
+            }
+        }
+
+
+        TEST_F(ExpressionTree, HoistedFloatLoads)
+        {
+            auto setup = GetSetup();
+            Function<double, double*> e(setup->GetAllocator(), setup->GetCode());
+
+            e.SetLoadScheduling(LoadScheduling::Hoisted);
+
+            auto & first = e.Mul(e.Deref(e.GetP1(), 0), e.Deref(e.GetP1(), 1));
+            auto & second = e.Mul(e.Deref(e.GetP1(), 2), e.Deref(e.GetP1(), 3));
+            auto function = e.Compile(e.Sub(first, second));
+
+            double values[] = { 1.5, 4.0, 0.5, 2.0 };
+            EXPECT_EQ(5.0, function(values));
+        }
+
+
+        static int64_t s_counter = 0;
+
+        static int64_t IncrementCounter(int64_t* counter)
+        {
+            return ++*counter;
+        }
+
+
+        // The loads that follow a call may observe the memory written by it,
+        // so they must not be issued ahead of the call.
+        TEST_F(ExpressionTree, LoadsAreNotHoistedAboveCalls)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t*> e(setup->GetAllocator(), setup->GetCode());
+
+            e.SetLoadScheduling(LoadScheduling::Hoisted);
+
+            auto & increment = e.Immediate(IncrementCounter);
+
+            auto & before = e.Deref(e.GetP1());
+            auto & call = e.Call(increment, e.GetP1());
+            auto & after = e.Deref(e.GetP1(), 0);
+
+            auto function = e.Compile(e.Add(e.Mul(before, e.Immediate<int64_t>(100)),
+                                            e.Add(call, after)));
+
+            s_counter = 5;
+            EXPECT_EQ(5 * 100 + 6 + 6, function(&s_counter));
+        }
+
         TEST_CASES_END
     }
 }
@@ -21,6 +21,8 @@
 // THE SOFTWARE.
 
 
+#include <cmath>
+#include <limits>
 
 #include "NativeJIT/Function.h"
 #include "NativeJIT/CodeGen/ExecutionBuffer.h"
@@ -168,6 +170,153 @@ namespace NativeJIT
             }
         }
 
+
+        TEST_F(FloatingPoint, DivideMinMax)
+        {
+            auto setup = GetSetup();
+
+            {
+                Function<double, double, double> expression(setup->GetAllocator(), setup->GetCode());
+
+                // (p1 / p2) clamped to [-1, 1].
+                auto & quotient = expression.Div(expression.GetP1(), expression.GetP2());
+                auto & clamped = expression.Max(expression.Min(quotient, expression.Immediate(1.0)),
+                                                expression.Immediate(-1.0));
+                auto function = expression.Compile(clamped);
+
+                ASSERT_EQ(0.25, function(1.0, 4.0));
+                ASSERT_EQ(-0.5, function(-3.0, 6.0));
+                ASSERT_EQ(1.0, function(10.0, 3.0));
+                ASSERT_EQ(-1.0, function(1.0, -0.0));
+            }
+
+            {
+                setup->GetAllocator().Reset();
+                Function<float, float, float> expression(setup->GetAllocator(), setup->GetCode());
+
+                auto & min = expression.Min(expression.GetP1(), expression.GetP2());
+                auto & max = expression.Max(expression.GetP1(), expression.GetP2());
+                auto function = expression.Compile(expression.Div(max, min));
+
+                ASSERT_EQ(2.5f, function(2.0f, 5.0f));
+                ASSERT_EQ(2.5f, function(5.0f, 2.0f));
+
+                // Like MinSS/MaxSS, both return the right operand for NaN.
+                ASSERT_TRUE(std::isnan(function(1.0f, std::numeric_limits<float>::quiet_NaN())));
+            }
+        }
+
+
+        TEST_F(FloatingPoint, UnaryOperations)
+        {
+            auto setup = GetSetup();
+            const double values[] = { 0.0, -0.0, 2.5, -2.5, 3.0, -7.75, 1e300, -1e-300 };
+
+            {
+                Function<double, double> expression(setup->GetAllocator(), setup->GetCode());
+
+                // Sums the results of all the operations scaled apart so that
+                // a wrong result in one of them doesn't cancel out.
+                auto & p1 = expression.GetP1();
+                auto & abs = expression.Abs(p1);
+                auto & sum = expression.Add(
+                    expression.Add(expression.Mul(expression.Floor(p1), expression.Immediate(1000.0)),
+                                   expression.Mul(expression.Ceil(p1), expression.Immediate(10.0))),
+                    expression.Add(abs, expression.Sqrt(abs)));
+                auto function = expression.Compile(sum);
+
+                for (double value : values)
+                {
+                    const double expected = std::floor(value) * 1000.0 + std::ceil(value) * 10.0
+                                            + (std::fabs(value) + std::sqrt(std::fabs(value)));
+
+                    ASSERT_EQ(expected, function(value)) << value;
+                }
+            }
+
+            {
+                setup->GetAllocator().Reset();
+                Function<float, float> expression(setup->GetAllocator(), setup->GetCode());
+
+                auto & p1 = expression.GetP1();
+                auto function = expression.Compile(
+                    expression.Sub(expression.Ceil(p1),
+                                   expression.Sqrt(expression.Abs(expression.Floor(p1)))));
+
+                for (float value : { 0.0f, 4.5f, -8.25f, 16.0f })
+                {
+                    const float expected = std::ceil(value) - std::sqrt(std::fabs(std::floor(value)));
+
+                    ASSERT_EQ(expected, function(value)) << value;
+                }
+            }
+
+            {
+                // Abs clears the sign bit of the result.
+                setup->GetAllocator().Reset();
+                Function<double, double> expression(setup->GetAllocator(), setup->GetCode());
+                auto function = expression.Compile(expression.Abs(expression.GetP1()));
+
+                ASSERT_FALSE(std::signbit(function(-0.0)));
+                ASSERT_EQ(std::numeric_limits<double>::infinity(),
+                          function(-std::numeric_limits<double>::infinity()));
+            }
+        }
+
+
+        TEST_F(FloatingPoint, RoundingWithoutSse41)
+        {
+            auto setup = GetSetup();
+            auto & code = setup->GetCode();
+            const bool isSupported = code.IsSupported(CpuFeature::Sse41);
+
+            // Without RoundSD/RoundSS, Floor and Ceil call the C++ functions.
+            code.SetSupported(CpuFeature::Sse41, false);
+
+            {
+                Function<double, double> expression(setup->GetAllocator(), code);
+
+                auto & p1 = expression.GetP1();
+                auto function = expression.Compile(
+                    expression.Add(expression.Mul(expression.Floor(p1), expression.Immediate(1000.0)),
+                                   expression.Ceil(p1)));
+
+                for (double value : { 0.0, -0.0, 2.5, -2.5, 3.0, -7.75, 1e300 })
+                {
+                    ASSERT_EQ(std::floor(value) * 1000.0 + std::ceil(value), function(value)) << value;
+                }
+            }
+
+            {
+                setup->GetAllocator().Reset();
+                Function<float, float> expression(setup->GetAllocator(), code);
+
+                auto & p1 = expression.GetP1();
+                auto function = expression.Compile(
+                    expression.Sub(expression.Ceil(p1), expression.Floor(p1)));
+
+                for (float value : { 0.0f, 4.5f, -8.25f, 16.0f })
+                {
+                    ASSERT_EQ(std::ceil(value) - std::floor(value), function(value)) << value;
+                }
+            }
+
+            code.SetSupported(CpuFeature::Sse41, isSupported);
+        }
+
+
+        TEST_F(FloatingPoint, UnaryOperationsAreFolded)
+        {
+            auto setup = GetSetup();
+            Function<double> expression(setup->GetAllocator(), setup->GetCode());
+
+            auto & root = expression.Div(expression.Sqrt(expression.Immediate(16.0)),
+                                         expression.Floor(expression.Immediate(-2.5)));
+            auto function = expression.Compile(root);
+
+            ASSERT_EQ(4.0 / -3.0, function());
+        }
+
         TEST_CASES_END
     }
 }
@@ -551,6 +551,31 @@ namespace NativeJIT
         }
 
 
+        static double Halve(double value)
+        {
+            return value / 2;
+        }
+
+
+        TEST_F(FunctionTest, CallWithSharedFloatParameter)
+        {
+            auto setup = GetSetup();
+
+            {
+                // The parameter of Halve() and its result are both passed in
+                // XMM0, and the parameter is still needed after the call.
+                Function<double, double> expression(setup->GetAllocator(), setup->GetCode());
+
+                typedef double (*F)(double);
+                auto & p1 = expression.GetP1();
+                auto & halved = expression.Call(expression.Immediate<F>(Halve), p1);
+                auto function = expression.Compile(expression.Sub(p1, halved));
+
+                ASSERT_EQ(3.0, function(6.0));
+            }
+        }
+
+
         // Verifies that the references to stack variables are in a sane
         // memory range.
         // The *Internal method is needed because GTest requires a void method
@@ -619,6 +644,42 @@ namespace NativeJIT
         }
 
 
+        static int SetStackVariable(uint64_t& variable)
+        {
+            variable = 7;
+
+            return 1;
+        }
+
+
+        // Verifies that a function whose frame is larger than a page, which
+        // needs the stack to be probed in the prolog, runs correctly.
+        TEST_F(FunctionTest, LargeStackFrame)
+        {
+            // The tree is larger than the default test allocators allow.
+            ExecutionBuffer codeAllocator(1 << 20);
+            Allocator allocator(1 << 20);
+            FunctionBuffer code(codeAllocator, 1 << 20);
+            Function<int> e(allocator, code);
+
+            auto & setFunction = e.Immediate(SetStackVariable);
+            const unsigned variableCount = 600;
+
+            Node<int>* sum = &e.Immediate(0);
+
+            for (unsigned i = 0; i < variableCount; ++i)
+            {
+                auto & variable = e.StackVariable<uint64_t>();
+                sum = &e.Add(*sum, e.Call(setFunction, variable));
+            }
+
+            auto function = e.Compile(*sum);
+
+            ASSERT_EQ(static_cast<int>(variableCount), function());
+            ASSERT_GT(e.GetTemporaryAreaSize(), 4096u);
+        }
+
+
         // Verifies that pointer and reference arguments refer to the same
         // memory location and that it contains the expected value.
         // The *Internal method is needed because GTest requires a void method
@@ -0,0 +1,471 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "NativeJIT/Interpreter.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace InterpreterUnitTest
+    {
+        TEST_FIXTURE_START(Interpreter)
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        // Compiles the expression and verifies that the interpreter produces
+        // the same results as the compiled code for all the inputs.
+        template <typename R, typename P1, typename P2>
+        void VerifyMatchesCompiled(Function<R, P1, P2>& expression,
+                                   Node<R>& root,
+                                   std::vector<std::pair<P1, P2>> const & inputs)
+        {
+            auto function = expression.Compile(root);
+            ASSERT_TRUE(expression.IsInterpretable());
+
+            NativeJIT::Interpreter interpreter;
+
+            for (auto const & input : inputs)
+            {
+                interpreter.SetParameters(input.first, input.second);
+                expression.Interpret(interpreter);
+
+                EXPECT_EQ(function(input.first, input.second),
+                          InterpreterValue<R>::FromWord(interpreter.GetResult()));
+            }
+        }
+
+
+        template <JccType JCC, typename T>
+        void VerifyComparison(TestFixture& fixture, std::vector<std::pair<T, T>> const & inputs)
+        {
+            auto setup = fixture.GetSetup();
+            Function<int32_t, T, T> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & condition = e.template Compare<JCC>(e.GetP1(), e.GetP2());
+            auto & root = e.Conditional(condition, e.Immediate(1), e.Immediate(0));
+
+            VerifyMatchesCompiled(e, root, inputs);
+        }
+
+
+        template <typename T>
+        void VerifyComparisons(TestFixture& fixture, std::vector<std::pair<T, T>> const & inputs)
+        {
+            VerifyComparison<JccType::JE>(fixture, inputs);
+            VerifyComparison<JccType::JNE>(fixture, inputs);
+            VerifyComparison<JccType::JA>(fixture, inputs);
+            VerifyComparison<JccType::JAE>(fixture, inputs);
+            VerifyComparison<JccType::JB>(fixture, inputs);
+            VerifyComparison<JccType::JBE>(fixture, inputs);
+            VerifyComparison<JccType::JG>(fixture, inputs);
+            VerifyComparison<JccType::JGE>(fixture, inputs);
+            VerifyComparison<JccType::JL>(fixture, inputs);
+            VerifyComparison<JccType::JLE>(fixture, inputs);
+            VerifyComparison<JccType::JS>(fixture, inputs);
+            VerifyComparison<JccType::JO>(fixture, inputs);
+            VerifyComparison<JccType::JP>(fixture, inputs);
+        }
+
+
+        static unsigned s_callCount = 0;
+
+        int64_t CountedNegate(int64_t value)
+        {
+            ++s_callCount;
+            return -value;
+        }
+
+
+        int64_t MultiplyAdd(int64_t a, int64_t b, int32_t c)
+        {
+            return a * b + c;
+        }
+
+
+        int64_t StoreDouble(int64_t& target, int64_t value)
+        {
+            target = 2 * value;
+            return 0;
+        }
+
+
+        struct TestStruct
+        {
+            int32_t m_a;
+            int64_t m_b;
+            uint16_t* m_c;
+        };
+
+
+        TEST_F(Interpreter, IntegerArithmetic)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & sum = e.Add(e.GetP1(), e.GetP2());
+            auto & product = e.Mul(sum, e.GetP1());
+            auto & masked = e.And(e.Or(product, e.Immediate<int64_t>(0x1234)),
+                                  e.Immediate<int64_t>(-16));
+            auto & root = e.Sub(masked, e.MulImmediate(e.GetP2(), 7u));
+
+            VerifyMatchesCompiled(e, root, {
+                { 0, 0 },
+                { 3, 5 },
+                { -12, 7 },
+                { std::numeric_limits<int64_t>::max(), 2 },
+                { std::numeric_limits<int64_t>::min(), -1 }
+            });
+        }
+
+
+        TEST_F(Interpreter, NarrowIntegerWraparound)
+        {
+            auto setup = GetSetup();
+            Function<uint16_t, uint16_t, uint16_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & root = e.Sub(e.Mul(e.GetP1(), e.GetP2()), e.Immediate<uint16_t>(20000));
+
+            VerifyMatchesCompiled(e, root, {
+                { 0, 0 },
+                { 256, 256 },
+                { 65535, 65535 },
+                { 1000, 3 }
+            });
+        }
+
+
+        TEST_F(Interpreter, Shifts)
+        {
+            auto setup = GetSetup();
+            Function<uint32_t, uint32_t, uint32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & root = e.Add(e.Shl(e.GetP1(), 3),
+                                e.Add(e.Shr(e.GetP2(), 5),
+                                      e.Rol(e.GetP1(), 7)));
+
+            VerifyMatchesCompiled(e, root, {
+                { 0u, 0u },
+                { 1u, 0xffffffffu },
+                { 0x80000001u, 0x12345678u },
+                { 0xdeadbeefu, 0x40u }
+            });
+        }
+
+
+        TEST_F(Interpreter, SignedShiftRightIsLogical)
+        {
+            auto setup = GetSetup();
+            Function<int32_t, int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & root = e.Add(e.Shr(e.GetP1(), 4), e.Shld(e.GetP1(), e.GetP2(), 9));
+
+            VerifyMatchesCompiled(e, root, {
+                { -1, -1 },
+                { -256, 12345 },
+                { 0x7fffffff, -0x7fffffff }
+            });
+        }
+
+
+        TEST_F(Interpreter, Division)
+        {
+            auto setup = GetSetup();
+            Function<int32_t, int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            // Mixes the div/idiv nodes with the sequences for constant divisors
+            // built from MulHigh and Sar.
+            auto & quotient = e.Div(e.GetP1(), e.GetP2());
+            auto & remainder = e.Mod(e.GetP1(), e.GetP2());
+            auto & root = e.Add(e.Mul(quotient, remainder),
+                                e.Sub(e.DivImmediate(e.GetP1(), -7),
+                                      e.ModImmediate(e.GetP2(), 16)));
+
+            VerifyMatchesCompiled(e, root, {
+                { 0, 1 },
+                { 17, 5 },
+                { -17, 5 },
+                { 17, -5 },
+                { std::numeric_limits<int32_t>::max(), 3 },
+                { std::numeric_limits<int32_t>::min(), -2 }
+            });
+        }
+
+
+        TEST_F(Interpreter, FloatingPoint)
+        {
+            auto setup = GetSetup();
+            Function<double, double, double> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & root = e.Sub(e.Mul(e.Add(e.GetP1(), e.GetP2()), e.GetP1()),
+                                e.Immediate(0.25));
+
+            VerifyMatchesCompiled(e, root, {
+                { 0.0, 0.0 },
+                { 1.5, -2.25 },
+                { 1e300, 1e10 }
+            });
+        }
+
+
+        TEST_F(Interpreter, FloatingPointDivisionAndRounding)
+        {
+            auto setup = GetSetup();
+            Function<double, double, double> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & quotient = e.Div(e.GetP1(), e.GetP2());
+            auto & root = e.Add(e.Max(e.Floor(quotient), e.Sqrt(e.Abs(e.GetP2()))),
+                                e.Min(e.Ceil(quotient), e.GetP1()));
+
+            VerifyMatchesCompiled(e, root, {
+                { 0.0, 1.0 },
+                { 7.5, -2.0 },
+                { -9.0, 4.0 },
+                { 1e300, 1e-10 }
+            });
+        }
+
+
+        TEST_F(Interpreter, IntegerComparisons)
+        {
+            VerifyComparisons<int32_t>(*this, {
+                { 0, 0 },
+                { -1, 1 },
+                { 1, -1 },
+                { std::numeric_limits<int32_t>::min(), 1 },
+                { std::numeric_limits<int32_t>::max(), -1 },
+                { 3, 3 }
+            });
+
+            VerifyComparisons<uint64_t>(*this, {
+                { 0, 0 },
+                { 0, ~0ull },
+                { ~0ull, 1 },
+                { 1ull << 63, 5 }
+            });
+        }
+
+
+        TEST_F(Interpreter, FloatingPointComparisons)
+        {
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+
+            VerifyComparisons<double>(*this, {
+                { 0.0, 0.0 },
+                { -1.5, 1.5 },
+                { 2.0, 1.0 },
+                { nan, 1.0 },
+                { 1.0, nan }
+            });
+        }
+
+
+        TEST_F(Interpreter, Casts)
+        {
+            {
+                auto setup = GetSetup();
+                Function<int64_t, int32_t, uint8_t> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & root = e.Add(e.Cast<int64_t>(e.GetP1()), e.Cast<int64_t>(e.GetP2()));
+
+                VerifyMatchesCompiled(e, root, {
+                    { -5, 250 },
+                    { std::numeric_limits<int32_t>::min(), 0 }
+                });
+            }
+
+            {
+                auto setup = GetSetup();
+                Function<double, int32_t, float> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & root = e.Add(e.Cast<double>(e.GetP1()), e.Cast<double>(e.GetP2()));
+
+                VerifyMatchesCompiled(e, root, {
+                    { -5, 0.5f },
+                    { 123456, -1e20f }
+                });
+            }
+
+            {
+                auto setup = GetSetup();
+                Function<int32_t, double, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & root = e.Add(e.Cast<int32_t>(e.GetP1()), e.Cast<int32_t>(e.GetP2()));
+
+                VerifyMatchesCompiled(e, root, {
+                    { -5.75, 0x100000007ll },
+                    { 1e9, -1 }
+                });
+            }
+
+            {
+                // A composite cast.
+                auto setup = GetSetup();
+                Function<double, uint64_t, uint64_t> e(setup->GetAllocator(), setup->GetCode());
+
+                auto & root = e.Add(e.Cast<double>(e.GetP1()), e.Cast<double>(e.GetP2()));
+
+                VerifyMatchesCompiled(e, root, {
+                    { 0, 1 },
+                    { ~0ull, 1ull << 63 }
+                });
+            }
+        }
+
+
+        TEST_F(Interpreter, FieldsAndArrays)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, TestStruct*, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & a = e.Cast<int64_t>(e.Deref(e.FieldPointer(e.GetP1(), &TestStruct::m_a)));
+            auto & b = e.Deref(e.FieldPointer(e.GetP1(), &TestStruct::m_b));
+            auto & c = e.Cast<int64_t>(e.Deref(e.Deref(e.FieldPointer(e.GetP1(), &TestStruct::m_c)), 2));
+            auto & root = e.Add(e.Add(a, b), e.Add(c, e.GetP2()));
+
+            uint16_t array[] = { 1, 2, 60000, 4 };
+            TestStruct s1 = { -3, 1ll << 40, array };
+            TestStruct s2 = { 7, -9, array + 1 };
+
+            VerifyMatchesCompiled(e, root, {
+                { &s1, 0 },
+                { &s2, 11 }
+            });
+        }
+
+
+        TEST_F(Interpreter, Calls)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & root = e.Call(e.Immediate(MultiplyAdd),
+                                 e.GetP1(),
+                                 e.GetP2(),
+                                 e.Immediate<int32_t>(-4));
+
+            VerifyMatchesCompiled(e, root, {
+                { 0, 0 },
+                { 6, -7 }
+            });
+        }
+
+
+        TEST_F(Interpreter, StackVariable)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & variable = e.StackVariable<int64_t>();
+            auto & store = e.Call(e.Immediate(StoreDouble), variable, e.GetP1());
+            // The stored value is read only after the call. The call returns
+            // zero and is also added to reference it.
+            auto & root = e.Add(e.Add(e.Dependent(e.Deref(variable), store), store),
+                                e.GetP2());
+
+            VerifyMatchesCompiled(e, root, {
+                { 1, 2 },
+                { -21, 100 }
+            });
+        }
+
+
+        TEST_F(Interpreter, Precondition)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            e.AddExecuteOnlyIfStatement(e.Compare<JccType::JL>(e.GetP1(), e.GetP2()),
+                                        e.Immediate<int64_t>(-1));
+            auto & root = e.Sub(e.GetP2(), e.GetP1());
+
+            VerifyMatchesCompiled(e, root, {
+                { 1, 5 },
+                { 5, 1 },
+                { 3, 3 }
+            });
+        }
+
+
+        TEST_F(Interpreter, Switch)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int32_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            std::vector<int32_t> keys = { -4, 3, 9, 27 };
+            std::vector<Node<int64_t>*> cases = {
+                &e.Add(e.GetP2(), e.Immediate<int64_t>(1)),
+                &e.Mul(e.GetP2(), e.GetP2()),
+                &e.Immediate<int64_t>(9),
+                &e.Add(e.GetP2(), e.Immediate<int64_t>(1))
+            };
+            auto & root = e.Switch(e.GetP1(), keys, cases, e.Sub(e.Immediate<int64_t>(0), e.GetP2()));
+
+            VerifyMatchesCompiled(e, root, {
+                { -4, 2 },
+                { 3, 5 },
+                { 9, 5 },
+                { 27, -3 },
+                { 10, 7 },
+                { -5, 7 }
+            });
+        }
+
+
+        TEST_F(Interpreter, EvaluatesOnlySelectedBranch)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & negated = e.Call(e.Immediate(CountedNegate), e.GetP1());
+            auto & root = e.Conditional(e.Compare<JccType::JGE>(e.GetP1(), e.Immediate<int64_t>(0)),
+                                        e.GetP1(),
+                                        negated);
+            e.Compile(root);
+
+            NativeJIT::Interpreter interpreter;
+            s_callCount = 0;
+
+            interpreter.SetParameters(static_cast<int64_t>(5));
+            e.Interpret(interpreter);
+            EXPECT_EQ(5, InterpreterValue<int64_t>::FromWord(interpreter.GetResult()));
+            EXPECT_EQ(0u, s_callCount);
+
+            interpreter.SetParameters(static_cast<int64_t>(-5));
+            e.Interpret(interpreter);
+            EXPECT_EQ(5, InterpreterValue<int64_t>::FromWord(interpreter.GetResult()));
+            EXPECT_EQ(1u, s_callCount);
+        }
+
+
+        TEST_CASES_END
+    }
+}
@@ -0,0 +1,167 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace NodeInterningUnitTest
+    {
+        TEST_FIXTURE_START(NodeInterning)
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        struct Record
+        {
+            int32_t m_value;
+            int64_t m_counter;
+        };
+
+
+        static unsigned s_callCount = 0;
+
+        int64_t CountedIncrement(Record* record)
+        {
+            ++s_callCount;
+            return ++record->m_counter;
+        }
+
+
+        TEST_F(NodeInterning, DuplicateSubexpressions)
+        {
+            auto setup = GetSetup();
+            Function<int32_t, Record*> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & first = e.Deref(e.FieldPointer(e.GetP1(), &Record::m_value));
+            auto & second = e.Deref(e.FieldPointer(e.GetP1(), &Record::m_value));
+
+            // Both the field pointer and the dereference are reused.
+            EXPECT_EQ(&first, &second);
+            EXPECT_EQ(2u, e.GetInternedNodeCount());
+
+            auto function = e.Compile(e.Add(first, second));
+
+            Record record = { 21, 0 };
+            EXPECT_EQ(42, function(&record));
+        }
+
+
+        TEST_F(NodeInterning, DistinctValues)
+        {
+            auto setup = GetSetup();
+            Function<double, double> e(setup->GetAllocator(), setup->GetCode());
+
+            EXPECT_EQ(&e.Immediate(1.0), &e.Immediate(1.0));
+            EXPECT_NE(&e.Immediate(0.0), &e.Immediate(-0.0));
+            EXPECT_NE(static_cast<NodeBase*>(&e.Immediate(1)),
+                      static_cast<NodeBase*>(&e.Immediate(1u)));
+
+            auto & sum = e.Add(e.GetP1(), e.Immediate(1.0));
+            EXPECT_EQ(&sum, &e.Add(e.GetP1(), e.Immediate(1.0)));
+            EXPECT_NE(&sum, &e.Add(e.Immediate(1.0), e.GetP1()));
+            EXPECT_NE(&sum, &e.Sub(e.GetP1(), e.Immediate(1.0)));
+        }
+
+
+        TEST_F(NodeInterning, PureCalls)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, Record*> e(setup->GetAllocator(), setup->GetCode());
+
+            auto & function = e.Immediate(CountedIncrement);
+            e.MarkPure(function);
+
+            auto & first = e.Call(function, e.GetP1());
+            auto & second = e.Call(function, e.GetP1());
+
+            EXPECT_EQ(&first, &second);
+
+            auto compiled = e.Compile(e.Add(first, second));
+
+            Record record = { 0, 0 };
+            s_callCount = 0;
+
+            EXPECT_EQ(2, compiled(&record));
+            EXPECT_EQ(1u, s_callCount);
+        }
+
+
+        TEST_F(NodeInterning, ImpureCalls)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, Record*> e(setup->GetAllocator(), setup->GetCode());
+
+            // The functions are impure unless marked otherwise.
+            auto & function = e.Immediate(CountedIncrement);
+
+            auto & counter = e.FieldPointer(e.GetP1(), &Record::m_counter);
+            auto & before = e.Deref(counter);
+            auto & first = e.Call(function, e.GetP1());
+            auto & second = e.Call(function, e.GetP1());
+            auto & after = e.Deref(counter);
+
+            EXPECT_NE(&first, &second);
+            EXPECT_NE(&before, &after);
+            EXPECT_EQ(&after, &e.Deref(counter));
+
+            auto & loads = e.Add(before, after);
+            auto compiled = e.Compile(e.Add(e.Add(first, second), loads));
+
+            Record record = { 0, 10 };
+            s_callCount = 0;
+            compiled(&record);
+
+            EXPECT_EQ(12, record.m_counter);
+            EXPECT_EQ(2u, s_callCount);
+        }
+
+
+        TEST_F(NodeInterning, Disabled)
+        {
+            auto setup = GetSetup();
+            Function<int32_t, int32_t> e(setup->GetAllocator(), setup->GetCode());
+
+            e.DisableNodeInterning();
+            auto & first = e.Add(e.GetP1(), e.Immediate(1));
+            auto & second = e.Add(e.GetP1(), e.Immediate(1));
+
+            EXPECT_NE(&first, &second);
+            EXPECT_EQ(0u, e.GetInternedNodeCount());
+
+            e.EnableNodeInterning();
+            auto & two = e.Immediate(2);
+            EXPECT_EQ(&two, &e.Immediate(2));
+
+            auto function = e.Compile(e.Add(e.Mul(first, second), two));
+            EXPECT_EQ(18, function(3));
+        }
+
+
+        TEST_CASES_END
+    }
+}
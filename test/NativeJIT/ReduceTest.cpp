@@ -0,0 +1,505 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace ReduceUnitTest
+    {
+        TEST_FIXTURE_START(Reduce)
+
+        public:
+            // Compiling the unrolled loops with calls in the body takes more
+            // than the default arena once the interned nodes are added.
+            Reduce() : TestFixture(c_defaultCodeAllocatorCapacity, 32 * 1024, TestFixture::c_defaultDiagnosticsStream)
+            {
+            }
+
+        protected:
+            // The element counts which exercise the empty array, the unrolled
+            // loop with and without the remainder loop and several iterations
+            // of both.
+            static std::vector<uint32_t> GetCounts()
+            {
+                std::vector<uint32_t> counts;
+
+                for (uint32_t count = 0; count <= 19; ++count)
+                {
+                    counts.push_back(count);
+                }
+
+                return counts;
+            }
+
+
+            // Returns values of T which include both negative and positive
+            // ones for signed types and the limits of integral T. Unrolling
+            // changes the order of the floating point additions, so their
+            // sums must not depend on it.
+            template <typename T>
+            static std::vector<T> GetValues()
+            {
+                std::vector<T> values;
+
+                for (int i = 0; i < 19; ++i)
+                {
+                    values.push_back(static_cast<T>((i * 37) % 23 - 11));
+                }
+
+                if (std::is_integral<T>::value)
+                {
+                    values.push_back(std::numeric_limits<T>::max());
+                    values.push_back(std::numeric_limits<T>::lowest());
+                }
+                else
+                {
+                    values.push_back(static_cast<T>(0.5));
+                    values.push_back(static_cast<T>(-0.25));
+                }
+
+                std::reverse(values.begin() + 5, values.end());
+
+                return values;
+            }
+
+
+            // Compiles the reduction of the array elements by OP starting with
+            // the initial value and verifies it against C++ for all counts.
+            template <OpCode OP, typename T>
+            void VerifyReduction(TestCaseSetup& setup, unsigned unrollCount)
+            {
+                setup.GetAllocator().Reset();
+                Function<T, T*, uint32_t, T> expression(setup.GetAllocator(), setup.GetCode());
+
+                auto & element = expression.template ReduceElement<T>();
+                auto & reduction = expression.template Reduce<OP>(expression.GetP1(),
+                                                                  expression.GetP2(),
+                                                                  element,
+                                                                  expression.Deref(element),
+                                                                  expression.GetP3(),
+                                                                  unrollCount);
+                auto function = expression.Compile(reduction);
+
+                auto values = GetValues<T>();
+                const T initial = static_cast<T>(3);
+
+                for (uint32_t count : GetCounts())
+                {
+                    T expected = initial;
+
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        expected = OP == OpCode::Add ? static_cast<T>(expected + values[i])
+                                   : OP == OpCode::Min ? std::min(expected, values[i])
+                                   : std::max(expected, values[i]);
+                    }
+
+                    EXPECT_EQ(expected, function(values.data(), count, initial))
+                        << "count " << count << ", unroll " << unrollCount;
+                }
+            }
+
+
+            template <OpCode OP, typename T>
+            void VerifyReduction(TestCaseSetup& setup)
+            {
+                VerifyReduction<OP, T>(setup, 1);
+                VerifyReduction<OP, T>(setup, 2);
+                VerifyReduction<OP, T>(setup, 4);
+                VerifyReduction<OP, T>(setup, 5);
+            }
+
+
+            struct Term
+            {
+                uint32_t m_id;
+                double m_weight;
+                int64_t m_frequency;
+            };
+
+
+            struct Document
+            {
+                Term* m_terms;
+                uint32_t m_termCount;
+            };
+
+
+            static int64_t Square(int64_t value)
+            {
+                return value * value;
+            }
+
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        //
+        // Reductions of the elements.
+        //
+
+        TEST_F(Reduce, Sum)
+        {
+            auto setup = GetSetup();
+
+            VerifyReduction<OpCode::Add, int64_t>(*setup);
+            VerifyReduction<OpCode::Add, uint32_t>(*setup);
+            VerifyReduction<OpCode::Add, int16_t>(*setup);
+            VerifyReduction<OpCode::Add, double>(*setup);
+            VerifyReduction<OpCode::Add, float>(*setup);
+        }
+
+
+        TEST_F(Reduce, Min)
+        {
+            auto setup = GetSetup();
+
+            VerifyReduction<OpCode::Min, int64_t>(*setup);
+            VerifyReduction<OpCode::Min, uint64_t>(*setup);
+            VerifyReduction<OpCode::Min, int32_t>(*setup);
+            VerifyReduction<OpCode::Min, uint16_t>(*setup);
+            VerifyReduction<OpCode::Min, int8_t>(*setup);
+            VerifyReduction<OpCode::Min, double>(*setup);
+            VerifyReduction<OpCode::Min, float>(*setup);
+        }
+
+
+        TEST_F(Reduce, Max)
+        {
+            auto setup = GetSetup();
+
+            VerifyReduction<OpCode::Max, int64_t>(*setup);
+            VerifyReduction<OpCode::Max, uint32_t>(*setup);
+            VerifyReduction<OpCode::Max, int16_t>(*setup);
+            VerifyReduction<OpCode::Max, uint8_t>(*setup);
+            VerifyReduction<OpCode::Max, double>(*setup);
+        }
+
+
+        //
+        // Loop bodies.
+        //
+
+        TEST_F(Reduce, StructFieldsAndInvariantValues)
+        {
+            auto setup = GetSetup();
+
+            for (unsigned unrollCount = 1; unrollCount <= 3; ++unrollCount)
+            {
+                setup->GetAllocator().Reset();
+                Function<double, Term*, uint32_t, double> expression(setup->GetAllocator(), setup->GetCode());
+
+                // The scale is evaluated once, before the loop, since it is
+                // also used outside of it.
+                auto & scale = expression.Add(expression.GetP3(), expression.Immediate(1.0));
+                auto & term = expression.ReduceElement<Term>();
+                auto & contribution
+                    = expression.Mul(expression.Deref(expression.FieldPointer(term, &Term::m_weight)),
+                                     scale);
+                auto & sum = expression.Reduce<OpCode::Add>(expression.GetP1(),
+                                                            expression.GetP2(),
+                                                            term,
+                                                            contribution,
+                                                            expression.Immediate(0.0),
+                                                            unrollCount);
+                auto function = expression.Compile(expression.Add(sum, scale));
+
+                std::vector<Term> terms;
+
+                for (uint32_t i = 0; i < 11; ++i)
+                {
+                    terms.push_back({ i, 0.5 * i, static_cast<int64_t>(i) - 5 });
+                }
+
+                for (uint32_t count = 0; count <= terms.size(); ++count)
+                {
+                    const double factor = 2.5;
+                    double expected = 0;
+
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        expected += terms[i].m_weight * (factor + 1);
+                    }
+
+                    EXPECT_EQ(expected + factor + 1, function(terms.data(), count, factor))
+                        << "count " << count << ", unroll " << unrollCount;
+                }
+            }
+        }
+
+
+        TEST_F(Reduce, Count)
+        {
+            auto setup = GetSetup();
+
+            for (unsigned unrollCount = 1; unrollCount <= 4; ++unrollCount)
+            {
+                setup->GetAllocator().Reset();
+                Function<uint32_t, Term*, uint32_t, int64_t> expression(setup->GetAllocator(), setup->GetCode());
+
+                auto & term = expression.ReduceElement<Term>();
+                auto & isFrequent
+                    = expression.Compare<JccType::JGE>(expression.Deref(expression.FieldPointer(term, &Term::m_frequency)),
+                                                       expression.GetP3());
+                auto function = expression.Compile(
+                    expression.ReduceCount(expression.GetP1(),
+                                           expression.GetP2(),
+                                           term,
+                                           isFrequent,
+                                           unrollCount));
+
+                std::vector<Term> terms;
+
+                for (uint32_t i = 0; i < 13; ++i)
+                {
+                    terms.push_back({ i, 0, static_cast<int64_t>((i * 7) % 5) - 2 });
+                }
+
+                for (int64_t threshold = -3; threshold <= 3; ++threshold)
+                {
+                    for (uint32_t count = 0; count <= terms.size(); ++count)
+                    {
+                        uint32_t expected = 0;
+
+                        for (uint32_t i = 0; i < count; ++i)
+                        {
+                            expected += terms[i].m_frequency >= threshold ? 1 : 0;
+                        }
+
+                        EXPECT_EQ(expected, function(terms.data(), count, threshold))
+                            << "count " << count << ", threshold " << threshold;
+                    }
+                }
+            }
+        }
+
+
+        TEST_F(Reduce, CallInBody)
+        {
+            auto setup = GetSetup();
+
+            for (unsigned unrollCount = 1; unrollCount <= 3; unrollCount += 2)
+            {
+                setup->GetAllocator().Reset();
+                Function<int64_t, Term*, uint32_t, int64_t> expression(setup->GetAllocator(), setup->GetCode());
+
+                // The values computed before the loop are kept in volatile
+                // registers, which the calls save and restore.
+                auto & offset = expression.Mul(expression.GetP3(), expression.GetP3());
+                auto & term = expression.ReduceElement<Term>();
+                auto & square = expression.Call(expression.Immediate(Square),
+                                                expression.Deref(expression.FieldPointer(term, &Term::m_frequency)));
+                auto & sum = expression.Reduce<OpCode::Add>(expression.GetP1(),
+                                                            expression.GetP2(),
+                                                            term,
+                                                            expression.Add(square, offset),
+                                                            offset,
+                                                            unrollCount);
+                auto function = expression.Compile(expression.Sub(sum, expression.GetP3()));
+
+                std::vector<Term> terms;
+
+                for (uint32_t i = 0; i < 7; ++i)
+                {
+                    terms.push_back({ i, 0, static_cast<int64_t>(i) * 3 - 10 });
+                }
+
+                for (uint32_t count = 0; count <= terms.size(); ++count)
+                {
+                    const int64_t p3 = 4;
+                    int64_t expected = p3 * p3;
+
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        expected += Square(terms[i].m_frequency) + p3 * p3;
+                    }
+
+                    EXPECT_EQ(expected - p3, function(terms.data(), count, p3))
+                        << "count " << count << ", unroll " << unrollCount;
+                }
+            }
+        }
+
+
+        TEST_F(Reduce, ManyLiveValues)
+        {
+            ExecutionBuffer codeAllocator(16384);
+            Allocator allocator(65536);
+            FunctionBuffer code(codeAllocator, 16384);
+            const unsigned valueCount = 20;
+
+            for (unsigned unrollCount = 1; unrollCount <= 2; ++unrollCount)
+            {
+                allocator.Reset();
+                Function<int64_t, int64_t*, uint32_t, int64_t> expression(allocator, code);
+
+                // More values are live across the loop than there are
+                // registers, so some of them are spilled before the loop and
+                // some within it.
+                std::vector<Node<int64_t>*> values;
+
+                for (unsigned i = 0; i < valueCount; ++i)
+                {
+                    values.push_back(&expression.Mul(expression.GetP3(),
+                                                     expression.Immediate<int64_t>(i + 2)));
+                }
+
+                auto & element = expression.ReduceElement<int64_t>();
+                Node<int64_t>* body = &expression.Deref(element);
+                Node<int64_t>* total = &expression.Immediate<int64_t>(0);
+
+                for (unsigned i = 0; i < valueCount; ++i)
+                {
+                    body = &expression.Add(*body, expression.Mul(expression.Deref(element), *values[i]));
+                    total = &expression.Add(*total, *values[i]);
+                }
+
+                auto & sum = expression.Reduce<OpCode::Add>(expression.GetP1(),
+                                                            expression.GetP2(),
+                                                            element,
+                                                            *body,
+                                                            expression.Immediate<int64_t>(0),
+                                                            unrollCount);
+                auto function = expression.Compile(expression.Add(sum, *total));
+
+                std::vector<int64_t> elements;
+
+                for (int64_t i = 0; i < 9; ++i)
+                {
+                    elements.push_back(i * i - 7);
+                }
+
+                for (uint32_t count = 0; count <= elements.size(); ++count)
+                {
+                    const int64_t p3 = 3;
+                    int64_t expected = 0;
+
+                    for (unsigned i = 0; i < valueCount; ++i)
+                    {
+                        expected += p3 * (i + 2);
+
+                        for (uint32_t j = 0; j < count; ++j)
+                        {
+                            expected += elements[j] * p3 * (i + 2);
+                        }
+                    }
+
+                    for (uint32_t j = 0; j < count; ++j)
+                    {
+                        expected += elements[j];
+                    }
+
+                    EXPECT_EQ(expected, function(elements.data(), count, p3))
+                        << "count " << count << ", unroll " << unrollCount;
+                }
+            }
+        }
+
+
+        TEST_F(Reduce, NestedLoops)
+        {
+            auto setup = GetSetup();
+
+            Function<double, Document*, uint32_t> expression(setup->GetAllocator(), setup->GetCode());
+
+            // Sums the weights of the terms of all documents.
+            auto & document = expression.ReduceElement<Document>();
+            auto & term = expression.ReduceElement<Term>();
+            auto & termWeights
+                = expression.Reduce<OpCode::Add>(expression.Deref(expression.FieldPointer(document, &Document::m_terms)),
+                                                 expression.Deref(expression.FieldPointer(document, &Document::m_termCount)),
+                                                 term,
+                                                 expression.Deref(expression.FieldPointer(term, &Term::m_weight)),
+                                                 expression.Immediate(0.0));
+            auto & sum = expression.Reduce<OpCode::Add>(expression.GetP1(),
+                                                        expression.GetP2(),
+                                                        document,
+                                                        termWeights,
+                                                        expression.Immediate(0.0),
+                                                        2);
+            auto function = expression.Compile(sum);
+
+            // Document i holds the 2 * i terms starting at term i, so the
+            // last one ends at term 3 * 4 - 1.
+            std::vector<Term> terms;
+
+            for (uint32_t i = 0; i < 12; ++i)
+            {
+                terms.push_back({ i, 1.0 + i, 0 });
+            }
+
+            std::vector<Document> documents;
+
+            for (uint32_t i = 0; i < 5; ++i)
+            {
+                documents.push_back({ terms.data() + i, 2 * i });
+            }
+
+            for (uint32_t count = 0; count <= documents.size(); ++count)
+            {
+                double expected = 0;
+
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    for (uint32_t j = 0; j < documents[i].m_termCount; ++j)
+                    {
+                        expected += documents[i].m_terms[j].m_weight;
+                    }
+                }
+
+                EXPECT_EQ(expected, function(documents.data(), count)) << "count " << count;
+            }
+        }
+
+
+        TEST_F(Reduce, ElementOutsideOfLoop)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t*, uint32_t> expression(setup->GetAllocator(), setup->GetCode());
+
+            auto & element = expression.ReduceElement<int64_t>();
+            auto & sum = expression.Reduce<OpCode::Add>(expression.GetP1(),
+                                                        expression.GetP2(),
+                                                        element,
+                                                        expression.Deref(element),
+                                                        expression.Immediate<int64_t>(0));
+
+            EXPECT_THROW(expression.Compile(expression.Add(sum, expression.Deref(element))),
+                         std::runtime_error);
+        }
+    }
+}
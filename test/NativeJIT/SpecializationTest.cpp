@@ -0,0 +1,154 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace SpecializationUnitTest
+    {
+        TEST_FIXTURE_START(Specialization)
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        struct Model
+        {
+            int64_t m_weight;
+            int64_t m_bias;
+            double m_scale;
+            int64_t* m_table;
+        };
+
+
+        TEST_F(Specialization, BoundParameter)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            e.GetP1().Bind(10);
+            auto function = e.Compile(e.Sub(e.GetP1(), e.GetP2()));
+
+            // The value passed for the bound parameter is ignored.
+            EXPECT_EQ(7, function(10, 3));
+            EXPECT_EQ(7, function(12345, 3));
+        }
+
+
+        TEST_F(Specialization, LoadsFromConstantMemory)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, Model*, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            int64_t table[] = { 100, 200, 300 };
+            Model model = { 3, 5, 0.0, table };
+
+            e.GetP1().Bind(&model);
+            e.AddConstantMemory(&model, sizeof(model));
+            e.AddConstantMemory(table, sizeof(table));
+
+            auto & model1 = e.GetP1();
+            auto & weight = e.Deref(e.FieldPointer(model1, &Model::m_weight));
+            auto & bias = e.Deref(e.FieldPointer(model1, &Model::m_bias));
+            auto & entry = e.Deref(e.Deref(e.FieldPointer(model1, &Model::m_table)), 2);
+
+            auto function = e.Compile(e.Add(e.Add(e.Mul(e.GetP2(), weight), bias), entry));
+
+            // The weight, the bias and the table entry become constants, which
+            // leaves the load of the table pointer and the bound parameter
+            // itself unused.
+            EXPECT_EQ(2u, e.GetEliminatedNodeCount());
+
+            // The model is no longer accessed through the parameter.
+            EXPECT_EQ(3 * 7 + 5 + 300, function(nullptr, 7));
+
+            // The values were copied into the code.
+            model.m_weight = 0;
+            table[2] = 0;
+            EXPECT_EQ(3 * 7 + 5 + 300, function(nullptr, 7));
+        }
+
+
+        TEST_F(Specialization, FloatFromConstantMemory)
+        {
+            auto setup = GetSetup();
+            Function<double, Model*, double> e(setup->GetAllocator(), setup->GetCode());
+
+            Model model = { 0, 0, 1.5, nullptr };
+
+            e.GetP1().Bind(&model);
+            e.AddConstantMemory(&model, sizeof(model));
+
+            auto & scale = e.Deref(e.FieldPointer(e.GetP1(), &Model::m_scale));
+            auto function = e.Compile(e.Mul(e.GetP2(), scale));
+
+            EXPECT_EQ(3.0, function(nullptr, 2.0));
+        }
+
+
+        TEST_F(Specialization, MutableMemoryUsesAbsoluteAddress)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, Model*> e(setup->GetAllocator(), setup->GetCode());
+
+            Model model = { 3, 0, 0.0, nullptr };
+
+            // The memory isn't declared constant, so the bound address is
+            // used for the load, but the load itself remains.
+            e.GetP1().Bind(&model);
+
+            auto function = e.Compile(e.Deref(e.FieldPointer(e.GetP1(), &Model::m_weight)));
+
+            EXPECT_EQ(3, function(nullptr));
+
+            model.m_weight = 4;
+            EXPECT_EQ(4, function(nullptr));
+        }
+
+
+        TEST_F(Specialization, PartiallyConstantRange)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, Model*> e(setup->GetAllocator(), setup->GetCode());
+
+            Model model = { 3, 5, 0.0, nullptr };
+
+            // Only the weight is declared constant.
+            e.GetP1().Bind(&model);
+            e.AddConstantMemory(&model.m_weight, sizeof(model.m_weight));
+
+            auto & weight = e.Deref(e.FieldPointer(e.GetP1(), &Model::m_weight));
+            auto & bias = e.Deref(e.FieldPointer(e.GetP1(), &Model::m_bias));
+            auto function = e.Compile(e.Add(weight, bias));
+
+            model.m_weight = 0;
+            model.m_bias = 6;
+            EXPECT_EQ(9, function(nullptr));
+        }
+
+    }
+}
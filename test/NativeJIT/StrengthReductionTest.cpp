@@ -0,0 +1,211 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <cstdint>
+#include <sstream>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace StrengthReductionUnitTest
+    {
+        TEST_FIXTURE_START(StrengthReduction)
+
+        protected:
+            // Compiles x * factor through MulImmediate() and verifies it
+            // against the C++ product for a few values of x.
+            template <typename T, typename FACTOR>
+            void VerifyProduct(TestCaseSetup& setup, FACTOR factor)
+            {
+                setup.GetAllocator().Reset();
+                Function<T, T> expression(setup.GetAllocator(), setup.GetCode());
+
+                auto function = expression.Compile(expression.MulImmediate(expression.GetP1(),
+                                                                           factor));
+
+                for (T value : { T(0), T(1), T(7), T(-1), T(-12345), T(0x12345678) })
+                {
+                    EXPECT_EQ(static_cast<T>(value * static_cast<T>(factor)), function(value))
+                        << value << " * " << factor;
+                }
+            }
+
+
+            // Returns the number of instructions with the mnemonic emitted for
+            // x * factor, not counting the prolog and epilog which use rsp.
+            template <typename T>
+            unsigned CountInstructions(uint32_t factor, char const * instruction)
+            {
+                std::stringstream diagnostics;
+                ExecutionBuffer codeAllocator(8192);
+                Allocator allocator(8192);
+                FunctionBuffer code(codeAllocator, 8192);
+                Function<T, T> expression(allocator, code);
+
+                code.EnableDiagnostics(diagnostics);
+                expression.Compile(expression.MulImmediate(expression.GetP1(), factor));
+
+                unsigned count = 0;
+                std::string line;
+
+                while (std::getline(diagnostics, line))
+                {
+                    if (line.find(std::string(instruction) + " ") != std::string::npos
+                        && line.find("rsp") == std::string::npos)
+                    {
+                        ++count;
+                    }
+                }
+
+                return count;
+            }
+
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        TEST_F(StrengthReduction, ProductsMatchMultiplication)
+        {
+            auto setup = GetSetup();
+
+            for (uint32_t factor = 0; factor <= 100; ++factor)
+            {
+                VerifyProduct<uint64_t>(*setup, factor);
+                VerifyProduct<int32_t>(*setup, static_cast<int32_t>(factor));
+                VerifyProduct<int32_t>(*setup, -static_cast<int32_t>(factor));
+            }
+
+            for (unsigned shift = 1; shift < 31; ++shift)
+            {
+                VerifyProduct<int64_t>(*setup, (1 << shift) - 1);
+                VerifyProduct<int64_t>(*setup, (1 << shift) + 1);
+                VerifyProduct<uint32_t>(*setup, (1u << shift) - 1);
+                VerifyProduct<uint32_t>(*setup, (1u << shift) + 1);
+                VerifyProduct<uint32_t>(*setup, 9u << shift);
+            }
+
+            VerifyProduct<uint32_t>(*setup, 0xffffffffu);
+            VerifyProduct<uint16_t>(*setup, static_cast<uint16_t>(45));
+            VerifyProduct<uint16_t>(*setup, static_cast<uint16_t>(0xffff));
+        }
+
+
+        TEST_F(StrengthReduction, InstructionSelection)
+        {
+            // 3, 5 and 9 take a single lea, products of two of them two leas.
+            EXPECT_EQ(1u, CountInstructions<uint64_t>(5, "lea"));
+            EXPECT_EQ(0u, CountInstructions<uint64_t>(5, "imul"));
+            EXPECT_EQ(2u, CountInstructions<uint64_t>(45, "lea"));
+
+            // The power of two factor is a shift after the lea.
+            EXPECT_EQ(1u, CountInstructions<uint32_t>(24, "lea"));
+            EXPECT_EQ(1u, CountInstructions<uint32_t>(24, "shl"));
+
+            // 2^k + 1 and 2^k - 1 are a shift and an add or a sub.
+            EXPECT_EQ(1u, CountInstructions<uint64_t>(33, "add"));
+            EXPECT_EQ(1u, CountInstructions<uint64_t>(127, "sub"));
+            EXPECT_EQ(0u, CountInstructions<uint64_t>(127, "imul"));
+
+            // Other factors still use imul.
+            EXPECT_EQ(1u, CountInstructions<uint64_t>(11, "imul"));
+        }
+
+
+        TEST_F(StrengthReduction, ArrayIndexingUsesScale)
+        {
+            auto setup = GetSetup();
+
+            struct Triple
+            {
+                int32_t m_a;
+                int32_t m_b;
+                int32_t m_c;
+            };
+
+            int64_t quadwords[] = { 10, 20, 30, 40 };
+            Triple triples[] = { { 1, 2, 3 }, { 4, 5, 6 }, { 7, 8, 9 } };
+            uint8_t bytes[] = { 11, 22, 33 };
+
+            {
+                Function<int64_t, int64_t*, uint32_t> expression(setup->GetAllocator(), setup->GetCode());
+                auto function = expression.Compile(
+                    expression.Deref(expression.Add(expression.GetP1(), expression.GetP2())));
+
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    EXPECT_EQ(quadwords[i], function(quadwords, i));
+                }
+            }
+
+            {
+                setup->GetAllocator().Reset();
+                Function<int32_t, Triple*, uint64_t> expression(setup->GetAllocator(), setup->GetCode());
+                auto & element = expression.Add(expression.GetP1(), expression.GetP2());
+                auto function = expression.Compile(
+                    expression.Deref(expression.FieldPointer(element, &Triple::m_c)));
+
+                for (uint64_t i = 0; i < 3; ++i)
+                {
+                    EXPECT_EQ(triples[i].m_c, function(triples, i));
+                }
+            }
+
+            {
+                setup->GetAllocator().Reset();
+                Function<uint8_t, uint8_t*, int32_t> expression(setup->GetAllocator(), setup->GetCode());
+                auto function = expression.Compile(
+                    expression.Deref(expression.Add(expression.GetP1(), expression.GetP2())));
+
+                for (int32_t i = 0; i < 3; ++i)
+                {
+                    EXPECT_EQ(bytes[i], function(bytes, i));
+                }
+            }
+        }
+
+
+        TEST_F(StrengthReduction, ConstantIndexIsFolded)
+        {
+            auto setup = GetSetup();
+            Function<int64_t, int64_t*> expression(setup->GetAllocator(), setup->GetCode());
+
+            int64_t values[] = { 3, 5, 7 };
+
+            // The lea with a zero index is replaced by the array pointer, which
+            // eliminates it along with the index and its cast.
+            auto & element = expression.Add(expression.GetP1(), expression.Immediate<uint32_t>(0));
+            auto function = expression.Compile(expression.Deref(element));
+
+            EXPECT_EQ(3, function(values));
+            EXPECT_EQ(3u, expression.GetEliminatedNodeCount());
+        }
+
+
+        TEST_CASES_END
+    }
+}
@@ -0,0 +1,427 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Function.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace SwitchUnitTest
+    {
+        TEST_FIXTURE_START(Switch)
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        static unsigned g_calls[4];
+
+
+        template <unsigned INDEX>
+        static int64_t CountCall(int64_t value)
+        {
+            ++g_calls[INDEX];
+            return value * 10 + INDEX;
+        }
+
+
+        //
+        // Dispatch
+        //
+
+        TEST_F(Switch, DenseKeysUseJumpTable)
+        {
+            std::stringstream diagnostics;
+            ExecutionBuffer codeAllocator(8192);
+            Allocator allocator(16384);
+            FunctionBuffer code(codeAllocator, 8192);
+            Function<int64_t, int32_t, int64_t> e(allocator, code);
+
+            // Key 4 is missing and selects the default case.
+            std::vector<int32_t> keys = { -2, -1, 0, 1, 2, 3, 5 };
+            std::vector<Node<int64_t>*> cases;
+
+            for (int32_t key : keys)
+            {
+                cases.push_back(&e.Add(e.Mul(e.GetP2(), e.Immediate<int64_t>(key)),
+                                       e.Immediate<int64_t>(100)));
+            }
+
+            code.EnableDiagnostics(diagnostics);
+            auto function = e.Compile(e.Switch(e.GetP1(), keys, cases, e.Sub(e.GetP2(), e.Immediate<int64_t>(1))));
+
+            for (int32_t selector = -5; selector <= 8; ++selector)
+            {
+                const bool isKey = selector >= -2 && selector <= 5 && selector != 4;
+                const int64_t expected = isKey ? 7 * selector + 100 : 6;
+
+                EXPECT_EQ(expected, function(selector, 7)) << "selector " << selector;
+            }
+
+            EXPECT_EQ(6, function(std::numeric_limits<int32_t>::min(), 7));
+            EXPECT_EQ(6, function(std::numeric_limits<int32_t>::max(), 7));
+
+            EXPECT_NE(diagnostics.str().find("jmp r"), std::string::npos);
+        }
+
+
+        TEST_F(Switch, SparseKeysUseBinarySearch)
+        {
+            std::stringstream diagnostics;
+            ExecutionBuffer codeAllocator(8192);
+            Allocator allocator(16384);
+            FunctionBuffer code(codeAllocator, 8192);
+            Function<int64_t, int64_t> e(allocator, code);
+
+            std::vector<int64_t> keys = { 1000000, -5, 17, 3, std::numeric_limits<int64_t>::min(),
+                                          100, 1ll << 40, -(1ll << 33), 4096 };
+            std::vector<Node<int64_t>*> cases;
+
+            for (unsigned i = 0; i < keys.size(); ++i)
+            {
+                cases.push_back(&e.Immediate<int64_t>(i + 1));
+            }
+
+            code.EnableDiagnostics(diagnostics);
+            auto function = e.Compile(e.Switch(e.GetP1(), keys, cases, e.Immediate<int64_t>(0)));
+
+            for (unsigned i = 0; i < keys.size(); ++i)
+            {
+                EXPECT_EQ(i + 1, function(keys[i])) << "key " << keys[i];
+                EXPECT_EQ(0, function(keys[i] + 1)) << "key " << keys[i] << " + 1";
+                EXPECT_EQ(0, function(keys[i] - 1)) << "key " << keys[i] << " - 1";
+            }
+
+            EXPECT_EQ(diagnostics.str().find("jmp r"), std::string::npos);
+        }
+
+
+        TEST_F(Switch, UnsignedSelector)
+        {
+            auto setup = GetSetup();
+
+            {
+                // The keys above INT64_MAX compare as unsigned.
+                Function<uint64_t, uint64_t> e(setup->GetAllocator(), setup->GetCode());
+
+                const uint64_t max = std::numeric_limits<uint64_t>::max();
+                std::vector<uint64_t> keys = { 0, 7, 1ull << 63, max - 1, max, 12, 90 };
+                std::vector<Node<uint64_t>*> cases;
+
+                for (unsigned i = 0; i < keys.size(); ++i)
+                {
+                    cases.push_back(&e.Immediate<uint64_t>(i + 1));
+                }
+
+                auto function = e.Compile(e.Switch(e.GetP1(), keys, cases, e.Immediate<uint64_t>(0)));
+
+                for (unsigned i = 0; i < keys.size(); ++i)
+                {
+                    EXPECT_EQ(i + 1, function(keys[i])) << "key " << keys[i];
+                }
+
+                EXPECT_EQ(0u, function(1));
+                EXPECT_EQ(0u, function(max - 2));
+                EXPECT_EQ(0u, function((1ull << 63) - 1));
+            }
+
+            {
+                // A narrow selector is zero extended, f. ex. an enumeration.
+                setup->GetAllocator().Reset();
+                Function<int32_t, uint8_t> e(setup->GetAllocator(), setup->GetCode());
+
+                std::vector<Node<int32_t>*> cases;
+
+                for (int32_t i = 0; i < 6; ++i)
+                {
+                    cases.push_back(&e.Immediate<int32_t>(i * i));
+                }
+
+                auto function = e.Compile(e.Switch(e.GetP1(), cases, e.Immediate<int32_t>(-1)));
+
+                for (unsigned selector = 0; selector <= 255; ++selector)
+                {
+                    const int32_t expected = selector < 6 ? static_cast<int32_t>(selector * selector) : -1;
+
+                    EXPECT_EQ(expected, function(static_cast<uint8_t>(selector))) << "selector " << selector;
+                }
+            }
+        }
+
+
+        TEST_F(Switch, NarrowSignedSelector)
+        {
+            auto setup = GetSetup();
+
+            Function<double, int16_t, double> e(setup->GetAllocator(), setup->GetCode());
+
+            std::vector<int16_t> keys = { -3, -2, -1, 1, 2 };
+            std::vector<Node<double>*> cases;
+
+            for (int16_t key : keys)
+            {
+                cases.push_back(&e.Mul(e.GetP2(), e.Immediate(static_cast<double>(key))));
+            }
+
+            auto function = e.Compile(e.Switch(e.GetP1(), keys, cases, e.GetP2()));
+
+            for (int selector = -6; selector <= 6; ++selector)
+            {
+                const bool isKey = selector >= -3 && selector <= 2 && selector != 0;
+                const double expected = isKey ? 1.5 * selector : 1.5;
+
+                EXPECT_EQ(expected, function(static_cast<int16_t>(selector), 1.5)) << "selector " << selector;
+            }
+
+            EXPECT_EQ(1.5, function(std::numeric_limits<int16_t>::min(), 1.5));
+        }
+
+
+        //
+        // Cases
+        //
+
+        TEST_F(Switch, KeysShareCases)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            // Keys 2 and 6 select the default case explicitly.
+            auto & even = e.Mul(e.GetP2(), e.Immediate<int64_t>(2));
+            auto & odd = e.Add(e.GetP2(), e.Immediate<int64_t>(1));
+            auto & other = e.Immediate<int64_t>(-1);
+            std::vector<int64_t> keys = { 0, 1, 2, 3, 4, 5, 6, 7 };
+            std::vector<Node<int64_t>*> cases = { &even, &odd, &other, &odd, &even, &odd, &other, &odd };
+
+            auto function = e.Compile(e.Switch(e.GetP1(), keys, cases, other));
+
+            for (int64_t selector = -1; selector <= 9; ++selector)
+            {
+                const int64_t expected = selector < 0 || selector > 7 || selector % 4 == 2
+                    ? -1
+                    : selector % 2 == 0 ? 20 : 11;
+
+                EXPECT_EQ(expected, function(selector, 10)) << "selector " << selector;
+            }
+        }
+
+
+        TEST_F(Switch, EvaluatesOnlySelectedCase)
+        {
+            ExecutionBuffer codeAllocator(8192);
+            Allocator allocator(16384);
+            FunctionBuffer code(codeAllocator, 8192);
+            Function<int64_t, int64_t, int64_t> e(allocator, code);
+
+            // The value shared by the first two cases and the rest of the tree
+            // is evaluated before the dispatch, the calls only in their cases.
+            auto & shared = e.Mul(e.GetP2(), e.GetP2());
+            std::vector<Node<int64_t>*> cases = {
+                &e.Call(e.Immediate(CountCall<0>), shared),
+                &e.Call(e.Immediate(CountCall<1>), shared),
+                &e.Call(e.Immediate(CountCall<2>), e.GetP2()),
+                &e.Call(e.Immediate(CountCall<2>), e.Sub(e.GetP2(), e.GetP1()))
+            };
+            auto & result = e.Switch(e.GetP1(), cases, e.Call(e.Immediate(CountCall<3>), e.GetP1()));
+            auto function = e.Compile(e.Add(result, shared));
+
+            for (int64_t selector = -1; selector <= 4; ++selector)
+            {
+                std::fill(std::begin(g_calls), std::end(g_calls), 0);
+
+                const int64_t p2 = 3;
+                const int64_t expected
+                    = selector == 0 ? 90 + 9
+                    : selector == 1 ? 91 + 9
+                    : selector == 2 ? 32 + 9
+                    : selector == 3 ? 2 + 9
+                    : selector * 10 + 3 + 9;
+
+                EXPECT_EQ(expected, function(selector, p2)) << "selector " << selector;
+
+                const unsigned caseIndex = selector >= 0 && selector < 4
+                    ? (selector == 3 ? 2 : static_cast<unsigned>(selector))
+                    : 3;
+
+                for (unsigned i = 0; i < 4; ++i)
+                {
+                    EXPECT_EQ(i == caseIndex ? 1u : 0u, g_calls[i])
+                        << "selector " << selector << ", function " << i;
+                }
+            }
+        }
+
+
+        TEST_F(Switch, NullPointerGuard)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int32_t, int64_t*> e(setup->GetAllocator(), setup->GetCode());
+
+            // The dereferenced value is shared within a single case, so it is
+            // evaluated only when that case is selected. The values shared by
+            // several cases would be evaluated before the dispatch.
+            auto & value = e.Deref(e.GetP2());
+            std::vector<int32_t> keys = { 10, 20, 30, 40 };
+            std::vector<Node<int64_t>*> cases = {
+                &e.Add(value, e.Mul(value, value)),
+                &e.Immediate<int64_t>(-20),
+                &e.Immediate<int64_t>(-30),
+                &e.Cast<int64_t>(e.GetP1())
+            };
+            auto function = e.Compile(e.Switch(e.GetP1(), keys, cases, e.Immediate<int64_t>(0)));
+
+            int64_t data = 7;
+
+            EXPECT_EQ(56, function(10, &data));
+            EXPECT_EQ(-20, function(20, nullptr));
+            EXPECT_EQ(-30, function(30, nullptr));
+            EXPECT_EQ(40, function(40, nullptr));
+            EXPECT_EQ(0, function(25, nullptr));
+        }
+
+
+        TEST_F(Switch, ManyCases)
+        {
+            ExecutionBuffer codeAllocator(16384);
+            Allocator allocator(65536);
+            FunctionBuffer code(codeAllocator, 16384);
+
+            // More cases than a node had conditional regions before, both as
+            // a table and as a binary search.
+            for (int64_t stride = 1; stride <= 5; stride += 4)
+            {
+                allocator.Reset();
+                Function<int64_t, int64_t, int64_t> e(allocator, code);
+
+                std::vector<int64_t> keys;
+                std::vector<Node<int64_t>*> cases;
+
+                for (int64_t i = 0; i < 40; ++i)
+                {
+                    keys.push_back(i * stride);
+                    cases.push_back(&e.Add(e.GetP2(), e.Immediate<int64_t>(i)));
+                }
+
+                auto function = e.Compile(e.Switch(e.GetP1(), keys, cases, e.Immediate<int64_t>(-1)));
+
+                for (int64_t selector = -2; selector < 45 * stride; ++selector)
+                {
+                    const int64_t expected
+                        = selector >= 0 && selector % stride == 0 && selector / stride < 40
+                          ? 1000 + selector / stride
+                          : -1;
+
+                    EXPECT_EQ(expected, function(selector, 1000))
+                        << "selector " << selector << ", stride " << stride;
+                }
+            }
+        }
+
+
+        TEST_F(Switch, ConstantSelector)
+        {
+            auto setup = GetSetup();
+
+            Function<int64_t, int64_t> e(setup->GetAllocator(), setup->GetCode());
+
+            std::vector<Node<int64_t>*> cases = { &e.GetP1(), &e.Add(e.GetP1(), e.GetP1()) };
+            auto & selector = e.Add(e.Immediate<int32_t>(0), e.Immediate<int32_t>(1));
+            auto function = e.Compile(e.Switch(selector, cases, e.Immediate<int64_t>(0)));
+
+            EXPECT_EQ(10, function(5));
+        }
+
+
+        TEST_F(Switch, InUnrolledLoop)
+        {
+            ExecutionBuffer codeAllocator(16384);
+            Allocator allocator(65536);
+            FunctionBuffer code(codeAllocator, 16384);
+
+            // The first copy of the body uses the jump table, the others
+            // fall back to the binary search.
+            for (unsigned unrollCount = 1; unrollCount <= 3; ++unrollCount)
+            {
+                allocator.Reset();
+                Function<int64_t, uint32_t*, uint32_t, int64_t> e(allocator, code);
+
+                auto & element = e.ReduceElement<uint32_t>();
+                auto & value = e.Deref(element);
+                std::vector<Node<int64_t>*> cases = {
+                    &e.GetP3(),
+                    &e.Mul(e.GetP3(), e.GetP3()),
+                    &e.Cast<int64_t>(value),
+                    &e.Immediate<int64_t>(1000),
+                    &e.Sub(e.Immediate<int64_t>(0), e.GetP3())
+                };
+                auto & body = e.Switch(value, cases, e.Immediate<int64_t>(1));
+                auto function = e.Compile(e.Reduce<OpCode::Add>(e.GetP1(),
+                                                                e.GetP2(),
+                                                                element,
+                                                                body,
+                                                                e.Immediate<int64_t>(0),
+                                                                unrollCount));
+
+                std::vector<uint32_t> elements;
+
+                for (uint32_t i = 0; i < 17; ++i)
+                {
+                    elements.push_back((i * 5) % 7);
+                }
+
+                for (uint32_t count = 0; count <= elements.size(); ++count)
+                {
+                    const int64_t p3 = 6;
+                    int64_t expected = 0;
+
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        const uint32_t selector = elements[i];
+
+                        expected += selector == 0 ? p3
+                                    : selector == 1 ? p3 * p3
+                                    : selector == 2 ? 2
+                                    : selector == 3 ? 1000
+                                    : selector == 4 ? -p3
+                                    : 1;
+                    }
+
+                    EXPECT_EQ(expected, function(elements.data(), count, p3))
+                        << "count " << count << ", unroll " << unrollCount;
+                }
+            }
+        }
+
+        TEST_CASES_END
+    }
+}
@@ -0,0 +1,133 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/Packed.h"
+#include "NativeJIT/TieredFunction.h"
+#include "Temporary/Allocator.h"
+#include "TestSetup.h"
+
+
+namespace NativeJIT
+{
+    namespace TieredFunctionUnitTest
+    {
+        TEST_FIXTURE_START(TieredFunction)
+        TEST_FIXTURE_END_TEST_CASES_BEGIN
+
+
+        TEST_F(TieredFunction, InterpretsUntilThreshold)
+        {
+            auto setup = GetSetup();
+            NativeJIT::TieredFunction<int64_t, int64_t, int32_t> e(setup->GetAllocator(),
+                                                                 setup->GetCode(),
+                                                                 3);
+
+            e.SetExpression(e.Add(e.Mul(e.GetP1(), e.GetP1()),
+                                  e.Cast<int64_t>(e.GetP2())));
+
+            EXPECT_EQ(11, e.Call(3, 2));
+            EXPECT_EQ(-1, e.Call(0, -1));
+            EXPECT_TRUE(e.GetNativeEntryPoint() == nullptr);
+            EXPECT_EQ(2u, e.GetInterpretedCallCount());
+
+            // The third call starts the compilation and is still interpreted.
+            EXPECT_EQ(100, e.Call(10, 0));
+            EXPECT_EQ(3u, e.GetInterpretedCallCount());
+
+            e.WaitForCompilation();
+            ASSERT_TRUE(e.GetNativeEntryPoint() != nullptr);
+
+            EXPECT_EQ(11, e.Call(3, 2));
+            EXPECT_EQ(-1, e.Call(0, -1));
+            EXPECT_EQ(3u, e.GetInterpretedCallCount());
+        }
+
+
+        TEST_F(TieredFunction, CallsDuringCompilation)
+        {
+            auto setup = GetSetup();
+            NativeJIT::TieredFunction<double, double> e(setup->GetAllocator(),
+                                                        setup->GetCode(),
+                                                        1);
+
+            auto & condition = e.Compare<JccType::JA>(e.GetP1(), e.Immediate(0.0));
+            e.SetExpression(e.Conditional(condition,
+                                          e.Mul(e.GetP1(), e.Immediate(2.0)),
+                                          e.Immediate(-1.0)));
+
+            // The results are the same regardless of which tier runs the call.
+            for (int i = 0; i < 1000; ++i)
+            {
+                const double value = i - 500;
+
+                ASSERT_EQ(value > 0 ? 2 * value : -1.0, e.Call(value));
+            }
+
+            e.WaitForCompilation();
+            EXPECT_TRUE(e.GetNativeEntryPoint() != nullptr);
+            EXPECT_EQ(8.0, e.Call(4.0));
+        }
+
+
+        TEST_F(TieredFunction, ZeroThreshold)
+        {
+            auto setup = GetSetup();
+            NativeJIT::TieredFunction<int32_t> e(setup->GetAllocator(), setup->GetCode(), 0);
+
+            e.SetExpression(e.Immediate(42));
+            e.WaitForCompilation();
+
+            ASSERT_TRUE(e.GetNativeEntryPoint() != nullptr);
+            EXPECT_EQ(42, e.Call());
+            EXPECT_EQ(0u, e.GetInterpretedCallCount());
+        }
+
+
+        TEST_F(TieredFunction, NotInterpretable)
+        {
+            typedef Packed<3, 4, 5> PackedType;
+
+            auto setup = GetSetup();
+            NativeJIT::TieredFunction<PackedType, PackedType, PackedType> e(setup->GetAllocator(),
+                                                                           setup->GetCode(),
+                                                                           10);
+
+            // PackedMax is not supported by the interpreter, so the function
+            // is compiled right away.
+            e.SetExpression(e.PackedMax(e.GetP1(), e.GetP2()));
+            ASSERT_TRUE(e.GetNativeEntryPoint() != nullptr);
+
+            const auto expected = PackedType::FromComponents(7, 15, 31);
+            const auto observed = e.Call(PackedType::FromComponents(1, 15, 31),
+                                         PackedType::FromComponents(7, 1, 1));
+
+            EXPECT_EQ(expected.m_bits, observed.m_bits);
+            EXPECT_EQ(0u, e.GetInterpretedCallCount());
+        }
+
+
+        TEST_CASES_END
+    }
+}